@@ -9,8 +9,13 @@ LOCAL_SRC_FILES:=                       \
         DashPlayerDriver.cpp            \
         DashPlayerRenderer.cpp          \
         DashPlayerStats.cpp             \
+        DashPlayerHistogram.cpp         \
+        DashPlayerMediaClock.cpp        \
+        DashPlayerDropPolicy.cpp        \
+        DashPlayerVsyncScheduler.cpp    \
         DashPlayerDecoder.cpp           \
         DashPacketSource.cpp            \
+        DashPrefetchSource.cpp          \
         DashFactory.cpp                 \
         DashCodec.cpp
 
@@ -52,4 +57,94 @@ LOCAL_MODULE:= libdashplayer
 LOCAL_MODULE_TAGS := eng
 
 include $(BUILD_SHARED_LIBRARY)
+
+# ---------------------------------------------------------------------------------
+#            Make the vsync scheduler test (dashplayer-vsync-test)
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                       \
+        test/DashPlayerVsyncSchedulerTest.cpp \
+        DashPlayerVsyncScheduler.cpp
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libcutils                   \
+    libgui                      \
+    liblog                      \
+    libstagefright_foundation   \
+    libutils                    \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)                                                 \
+
+LOCAL_MODULE:= dashplayer-vsync-test
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+#            Make the media clock test (dashplayer-clock-test)
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                       \
+        test/DashPlayerMediaClockTest.cpp \
+        DashPlayerMediaClock.cpp
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libcutils                   \
+    liblog                      \
+    libutils                    \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)                                                 \
+
+LOCAL_MODULE:= dashplayer-clock-test
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+#            Make the prefetch test (dashplayer-prefetch-test)
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=                       \
+        test/DashPrefetchSourceTest.cpp \
+        test/DashLocalFileSource.cpp
+
+LOCAL_SHARED_LIBRARIES :=       \
+    libbinder                   \
+    libcutils                   \
+    libdashplayer               \
+    liblog                      \
+    libmedia                    \
+    libstagefright              \
+    libstagefright_foundation   \
+    libutils                    \
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)                                                 \
+    $(TOP)/frameworks/av/media/libstagefright/timedtext           \
+	$(TOP)/frameworks/native/include/media/hardware               \
+	$(TOP)/frameworks/native/include/media/openmax                \
+	$(TOP)/frameworks/av/media/libstagefright/httplive            \
+	$(TOP)/frameworks/av/media/libmediaplayerservice/nuplayer     \
+	$(TOP)/frameworks/av/media/libmediaplayerservice              \
+	$(TOP)/frameworks/av/media/libstagefright/include             \
+	$(TOP)/frameworks/av/media/libstagefright/mpeg2ts             \
+	$(TOP)/frameworks/av/media/libstagefright/rtsp                \
+	$(TOP)/hardware/qcom/media/mm-core/inc                        \
+
+ifeq ($(PLATFORM_SDK_VERSION), 18)
+  LOCAL_CFLAGS += -DANDROID_JB_MR2
+endif
+
+LOCAL_MODULE:= dashplayer-prefetch-test
+
+LOCAL_MODULE_TAGS := debug
+
+include $(BUILD_EXECUTABLE)
 #endif
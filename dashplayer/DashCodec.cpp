@@ -38,17 +38,18 @@
 #include <media/hardware/HardwareAPI.h>
 #include <OMX_QCOMExtns.h>
 #include <OMX_Component.h>
+#include <cutils/atomic.h>
 #include <cutils/properties.h>
 #include "avc_utils.h"
 
 //Smmoth streaming settings
 //Max resolution 1080p
-#define MAX_WIDTH 1920;
-#define MAX_HEIGHT 1080;
+#define MAX_WIDTH 1920
+#define MAX_HEIGHT 1080
 
 //Min resolution QVGA
-#define MIN_WIDTH 480;
-#define MIN_HEIGHT 320;
+#define MIN_WIDTH 480
+#define MIN_HEIGHT 320
 
 namespace android {
 
@@ -378,7 +379,8 @@ DashCodec::DashCodec()
       mEncoderPadding(0),
       mChannelMaskPresent(false),
       mChannelMask(0),
-      mSmoothStreaming(false) {
+      mSmoothStreaming(false),
+      mSmoothStreamingPublished(0) {
     mUninitializedState = new UninitializedState(this);
     mLoadedState = new LoadedState(this);
     mLoadedToIdleState = new LoadedToIdleState(this);
@@ -2302,6 +2304,14 @@ void DashCodec::sendFormatChange() {
     mSentFormat = true;
 }
 
+bool DashCodec::canAdaptTo(int32_t width, int32_t height) const {
+    // In smooth streaming mode the output buffers are allocated for the
+    // max resolution, so smaller streams only change the crop.
+    return android_atomic_acquire_load(&mSmoothStreamingPublished)
+        && width > 0 && height > 0
+        && width <= MAX_WIDTH && height <= MAX_HEIGHT;
+}
+
 status_t DashCodec::InitSmoothStreaming() {
      status_t err = mOMX->setParameter(mNode, (OMX_INDEXTYPE)OMX_QcomIndexParamEnableSmoothStreaming,&err, sizeof(int32_t));
     if (err != OMX_ErrorNone) {
@@ -3358,6 +3368,8 @@ bool DashCodec::LoadedState::onConfigureComponent(
             }
         }
     }
+    android_atomic_release_store(mCodec->mSmoothStreaming,
+                                 &mCodec->mSmoothStreamingPublished);
 
     if (msg->findInt32("secure-op", &value) && (value == 1)) {
         mCodec->mFlags |= kFlagIsSecureOPOnly;
@@ -62,6 +62,12 @@ struct DashCodec : public AHierarchicalStateMachine {
     void initiateStart();
 
     void signalRequestIDRFrame();
+
+    // True if a stream of this size can follow the current one after a
+    // plain flush, without reallocating the component or its buffers.
+    // Safe to call from any thread.
+    bool canAdaptTo(int32_t width, int32_t height) const;
+
     void queueNextFormat();
     void clearCachedFormats();
     struct PortDescription : public RefBase {
@@ -280,6 +286,8 @@ private:
 
     status_t InitSmoothStreaming();
     bool mSmoothStreaming;
+    // mSmoothStreaming as published to canAdaptTo callers on other threads
+    volatile int32_t mSmoothStreamingPublished;
     Vector<OMX_PARAM_PORTDEFINITIONTYPE*> mFormats;
     Vector<OMX_CONFIG_RECTTYPE*> mOutputCrops;
     DISALLOW_EVIL_CONSTRUCTORS(DashCodec);
@@ -26,6 +26,7 @@
 #include <media/stagefright/foundation/hexdump.h>
 #include <media/stagefright/MediaBuffer.h>
 #include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <utils/Vector.h>
 
@@ -35,6 +36,15 @@ DashPacketSource::DashPacketSource(const sp<MetaData> &meta)
     : mIsAudio(false),
       mFormat(meta),
       mEOSResult(OK),
+      mEntries(new Entry[kInitialCapacity]),
+      mCapacity(kInitialCapacity),
+      mReadPos(0),
+      mWritePos(0),
+      mSyncIndex(new int32_t[kInitialCapacity]),
+      mSyncReadPos(0),
+      mSyncWritePos(0),
+      mSegment(0),
+      mSegmentFirstTimeUs(-1),
       mStreamPID(0),
       mProgramPID(0),
       mFirstPTS(0) {
@@ -47,17 +57,22 @@ DashPacketSource::DashPacketSource(const sp<MetaData> &meta)
 }
 
 void DashPacketSource::setFormat(const sp<MetaData> &meta) {
-    Mutex::Autolock autoLock(mLock);
+    Mutex::Autolock autoLock(mFormatLock);
     CHECK(mFormat == NULL);
     mFormat = meta;
 }
 
 void DashPacketSource::updateFormat(const sp<MetaData> &meta) {
-    Mutex::Autolock autoLock(mLock);
+    Mutex::Autolock autoLock(mFormatLock);
     mFormat = meta;
 }
 
 DashPacketSource::~DashPacketSource() {
+    delete[] mEntries;
+    mEntries = NULL;
+
+    delete[] mSyncIndex;
+    mSyncIndex = NULL;
 }
 
 status_t DashPacketSource::start(MetaData *params) {
@@ -82,71 +97,152 @@ status_t DashPacketSource::getStreamInfo(unsigned& streamPID, unsigned& programP
 }
 
 sp<MetaData> DashPacketSource::getFormat() {
-    Mutex::Autolock autoLock(mLock);
+    Mutex::Autolock autoLock(mFormatLock);
     return mFormat;
 }
 
-status_t DashPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
-    buffer->clear();
-
-    Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
-        mCondition.wait(mLock);
+// Appends one entry, growing the array first if it is full.
+void DashPacketSource::pushLocked(
+        const sp<ABuffer> &buffer, int64_t timeUs,
+        bool isDiscontinuity, bool isSync) {
+    if (mWritePos - mReadPos == mCapacity) {
+        growLocked();
     }
 
-    if (!mBuffers.empty()) {
-        *buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+    Entry &entry = entryAt(mWritePos);
+    entry.mBuffer = buffer;
+    entry.mTimeUs = timeUs;
+    entry.mIsDiscontinuity = isDiscontinuity;
+    entry.mSegment = mSegment;
+    if (!isDiscontinuity && mSegmentFirstTimeUs < 0) {
+        mSegmentFirstTimeUs = timeUs;
+    }
+    entry.mSegmentFirstTimeUs = mSegmentFirstTimeUs;
+
+    if (isSync) {
+        // With the stale entries gone there are fewer live sync samples
+        // than queued entries, so the index never overruns itself.
+        while (mSyncReadPos != mSyncWritePos
+                && mSyncIndex[mSyncReadPos & (mCapacity - 1)] - mReadPos < 0) {
+            ++mSyncReadPos;
+        }
+        mSyncIndex[mSyncWritePos & (mCapacity - 1)] = mWritePos;
+        ++mSyncWritePos;
+    }
 
-        int32_t discontinuity;
-        if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
+    ++mWritePos;
+    mCondition.signal();
+}
 
-            return INFO_DISCONTINUITY;
-        }
+// Doubles the array. Positions are free-running, so the queued entries
+// keep theirs and only move to where the wider mask puts them.
+void DashPacketSource::growLocked() {
+    int32_t oldCapacity = mCapacity;
+    int32_t newCapacity = oldCapacity * 2;
+    Entry *entries = new Entry[newCapacity];
+    int32_t *syncIndex = new int32_t[newCapacity];
 
-        return OK;
+    for (int32_t pos = mReadPos; pos != mWritePos; ++pos) {
+        entries[pos & (newCapacity - 1)] = mEntries[pos & (oldCapacity - 1)];
     }
+    for (int32_t i = mSyncReadPos; i != mSyncWritePos; ++i) {
+        syncIndex[i & (newCapacity - 1)] = mSyncIndex[i & (oldCapacity - 1)];
+    }
+
+    delete[] mEntries;
+    mEntries = entries;
+    delete[] mSyncIndex;
+    mSyncIndex = syncIndex;
+    mCapacity = newCapacity;
 
-    return mEOSResult;
+    ALOGI("%s access unit queue full, grown to %d entries",
+          mIsAudio ? "audio" : "video", newCapacity);
 }
 
-status_t DashPacketSource::read(
-        MediaBuffer **out, const ReadOptions *) {
-    *out = NULL;
+void DashPacketSource::flushLocked() {
+    for (int32_t pos = mReadPos; pos != mWritePos; ++pos) {
+        entryAt(pos).mBuffer.clear();
+    }
+    mReadPos = mWritePos;
+    mSyncReadPos = mSyncWritePos;
+}
 
-    Mutex::Autolock autoLock(mLock);
-    while (mEOSResult == OK && mBuffers.empty()) {
+// Leaves only discontinuities in the queue, in their order.
+void DashPacketSource::dropAccessUnitsLocked() {
+    int32_t keepPos = mWritePos;
+    for (int32_t pos = mWritePos - 1; pos - mReadPos >= 0; --pos) {
+        Entry &entry = entryAt(pos);
+        if (entry.mIsDiscontinuity && --keepPos != pos) {
+            entryAt(keepPos) = entry;
+        }
+    }
+
+    for (int32_t pos = mReadPos; pos != keepPos; ++pos) {
+        entryAt(pos).mBuffer.clear();
+    }
+    mReadPos = keepPos;
+    mSyncReadPos = mSyncWritePos;
+}
+
+status_t DashPacketSource::dequeueLocked(sp<ABuffer> *buffer) {
+    while (mEOSResult == OK && mReadPos == mWritePos) {
         mCondition.wait(mLock);
     }
 
-    if (!mBuffers.empty()) {
-        const sp<ABuffer> buffer = *mBuffers.begin();
-        mBuffers.erase(mBuffers.begin());
+    if (mReadPos == mWritePos) {
+        return mEOSResult;
+    }
+
+    Entry &entry = entryAt(mReadPos);
+    *buffer = entry.mBuffer;
+    entry.mBuffer.clear();
+    ++mReadPos;
+
+    int32_t discontinuity;
+    if ((*buffer)->meta()->findInt32("discontinuity", &discontinuity)) {
+        if (wasFormatChange(discontinuity)) {
+            sp<RefBase> format;
+            (*buffer)->meta()->findObject("format", &format);
+
+            Mutex::Autolock autoLock(mFormatLock);
+            mFormat = static_cast<MetaData *>(format.get());
+        }
+
+        return INFO_DISCONTINUITY;
+    }
 
-        int32_t discontinuity;
-        if (buffer->meta()->findInt32("discontinuity", &discontinuity)) {
-            if (wasFormatChange(discontinuity)) {
-                mFormat.clear();
-            }
+    return OK;
+}
 
-            return INFO_DISCONTINUITY;
-        } else {
-            int64_t timeUs;
-            CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+status_t DashPacketSource::dequeueAccessUnit(sp<ABuffer> *buffer) {
+    buffer->clear();
 
-            MediaBuffer *mediaBuffer = new MediaBuffer(buffer);
+    Mutex::Autolock autoLock(mLock);
+    return dequeueLocked(buffer);
+}
 
-            mediaBuffer->meta_data()->setInt64(kKeyTime, timeUs);
+status_t DashPacketSource::read(
+        MediaBuffer **out, const ReadOptions *) {
+    *out = NULL;
 
-            *out = mediaBuffer;
-            return OK;
+    sp<ABuffer> buffer;
+    {
+        Mutex::Autolock autoLock(mLock);
+        status_t err = dequeueLocked(&buffer);
+        if (err != OK) {
+            return err;
         }
     }
 
-    return mEOSResult;
+    int64_t timeUs;
+    CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
+
+    MediaBuffer *mediaBuffer = new MediaBuffer(buffer);
+
+    mediaBuffer->meta_data()->setInt64(kKeyTime, timeUs);
+
+    *out = mediaBuffer;
+    return OK;
 }
 
 bool DashPacketSource::wasFormatChange(
@@ -169,53 +265,52 @@ void DashPacketSource::queueAccessUnit(const sp<ABuffer> &buffer) {
     CHECK(buffer->meta()->findInt64("timeUs", &timeUs));
     ALOGV("queueAccessUnit timeUs=%lld us (%.2f secs)", timeUs, timeUs / 1E6);
 
+    int32_t isSync = 0;
+    buffer->meta()->findInt32("isSync", &isSync);
+
     Mutex::Autolock autoLock(mLock);
-    mBuffers.push_back(buffer);
-    ALOGV("@@@@:: DashPacketSource --> size is %d ",mBuffers.size() );
-    mCondition.signal();
+    pushLocked(buffer, timeUs, false /* isDiscontinuity */, mIsAudio || isSync);
+    ALOGV("@@@@:: DashPacketSource --> size is %d ", mWritePos - mReadPos);
 }
 
 int DashPacketSource::getQueueSize() {
-    return mBuffers.size();
+    Mutex::Autolock autoLock(mLock);
+    return mWritePos - mReadPos;
 }
 
 void DashPacketSource::queueDiscontinuity(
         ATSParser::DiscontinuityType type,
-        const sp<AMessage> &extra) {
+        const sp<AMessage> &extra,
+        bool discard,
+        const sp<MetaData> &format) {
     Mutex::Autolock autoLock(mLock);
 
-    if (type == ATSParser::DISCONTINUITY_SEEK ||
-        type == ATSParser::DISCONTINUITY_SEEK) {
+    // Start a new segment for the buffered duration bookkeeping.
+    ++mSegment;
+    mSegmentFirstTimeUs = -1;
+
+    if (discard && (type == ATSParser::DISCONTINUITY_SEEK ||
+        type == ATSParser::DISCONTINUITY_SEEK)) {
         ALOGI("Flushing all Access units for seek");
-        mBuffers.clear();
+        flushLocked();
         mEOSResult = OK;
         mCondition.signal();
         return;
     }
 
-    // Leave only discontinuities in the queue.
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        sp<ABuffer> oldBuffer = *it;
-
-        int32_t oldDiscontinuityType;
-        if (!oldBuffer->meta()->findInt32(
-                    "discontinuity", &oldDiscontinuityType)) {
-            it = mBuffers.erase(it);
-            continue;
-        }
-
-        ++it;
+    if (discard) {
+        dropAccessUnitsLocked();
     }
-
     mEOSResult = OK;
 
     sp<ABuffer> buffer = new ABuffer(0);
     buffer->meta()->setInt32("discontinuity", static_cast<int32_t>(type));
     buffer->meta()->setMessage("extra", extra);
+    if (format != NULL) {
+        buffer->meta()->setObject("format", format);
+    }
 
-    mBuffers.push_back(buffer);
-    mCondition.signal();
+    pushLocked(buffer, -1, true /* isDiscontinuity */, false /* isSync */);
 }
 
 void DashPacketSource::signalEOS(status_t result) {
@@ -228,7 +323,7 @@ void DashPacketSource::signalEOS(status_t result) {
 
 bool DashPacketSource::hasBufferAvailable(status_t *finalResult) {
     Mutex::Autolock autoLock(mLock);
-    if (!mBuffers.empty()) {
+    if (mReadPos != mWritePos) {
         return true;
     }
 
@@ -241,33 +336,22 @@ int64_t DashPacketSource::getBufferedDurationUs(status_t *finalResult) {
 
     *finalResult = mEOSResult;
 
-    if (mBuffers.empty()) {
+    if (mReadPos == mWritePos) {
         return 0;
     }
 
-    int64_t time1 = -1;
-    int64_t time2 = -1;
-
-    List<sp<ABuffer> >::iterator it = mBuffers.begin();
-    while (it != mBuffers.end()) {
-        const sp<ABuffer> &buffer = *it;
-
-        int64_t timeUs;
-        if (buffer->meta()->findInt64("timeUs", &timeUs)) {
-            if (time1 < 0) {
-                time1 = timeUs;
-            }
+    const Entry &first = entryAt(mReadPos);
+    const Entry &last = entryAt(mWritePos - 1);
 
-            time2 = timeUs;
-        } else {
-            // This is a discontinuity, reset everything.
-            time1 = time2 = -1;
-        }
+    if (last.mIsDiscontinuity) {
+        return 0;
+    }
 
-        ++it;
+    if (!first.mIsDiscontinuity && first.mSegment == last.mSegment) {
+        return last.mTimeUs - first.mTimeUs;
     }
 
-    return time2 - time1;
+    return last.mTimeUs - last.mSegmentFirstTimeUs;
 }
 
 status_t DashPacketSource::nextBufferTime(int64_t *timeUs) {
@@ -275,11 +359,11 @@ status_t DashPacketSource::nextBufferTime(int64_t *timeUs) {
 
     Mutex::Autolock autoLock(mLock);
 
-    if (mBuffers.empty()) {
+    if (mReadPos == mWritePos) {
         return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
+    sp<ABuffer> buffer = entryAt(mReadPos).mBuffer;
     CHECK(buffer->meta()->findInt64("timeUs", timeUs));
     return OK;
 }
@@ -288,11 +372,11 @@ status_t DashPacketSource::nextBufferIsSync(bool* isSyncFrame) {
     Mutex::Autolock autoLock(mLock);
     CHECK(isSyncFrame != NULL);
 
-    if (mBuffers.empty()) {
+    if (mReadPos == mWritePos) {
         return mEOSResult != OK ? mEOSResult : -EWOULDBLOCK;
     }
 
-    sp<ABuffer> buffer = *mBuffers.begin();
+    sp<ABuffer> buffer = entryAt(mReadPos).mBuffer;
 
     *isSyncFrame = false;
     int32_t value = 0;
@@ -302,4 +386,132 @@ status_t DashPacketSource::nextBufferIsSync(bool* isSyncFrame) {
     return OK;
 }
 
+status_t DashPacketSource::findSyncLocked(
+        int64_t timeUs, SeekMode mode, int32_t *syncPos) {
+    if (mReadPos == mWritePos) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    const Entry &first = entryAt(mReadPos);
+    const Entry &last = entryAt(mWritePos - 1);
+    if (first.mIsDiscontinuity || last.mIsDiscontinuity
+            || first.mSegment != last.mSegment
+            || timeUs < first.mTimeUs || timeUs > last.mTimeUs) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    while (mSyncReadPos != mSyncWritePos
+            && mSyncIndex[mSyncReadPos & (mCapacity - 1)] - mReadPos < 0) {
+        ++mSyncReadPos;
+    }
+
+    // One entry per GOP for video, so a linear walk is cheap enough.
+    int32_t bestPos = 0;
+    int64_t bestTimeUs = -1;
+    bool found = false;
+    for (int32_t i = mSyncReadPos; i != mSyncWritePos; ++i) {
+        int32_t pos = mSyncIndex[i & (mCapacity - 1)];
+
+        const Entry &entry = entryAt(pos);
+        if (entry.mTimeUs <= timeUs) {
+            bestPos = pos;
+            bestTimeUs = entry.mTimeUs;
+            found = true;
+            continue;
+        }
+
+        if (mode == kSeekClosestSync
+                && (!found || entry.mTimeUs - timeUs < timeUs - bestTimeUs)) {
+            bestPos = pos;
+            found = true;
+        }
+        break;
+    }
+
+    if (!found) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    *syncPos = bestPos;
+    return OK;
+}
+
+// Drops everything queued before syncPos, which becomes the next access
+// unit dequeued.
+void DashPacketSource::seekToLocked(int32_t syncPos) {
+    ALOGV("%s seek within buffer resumes at %lld us (%d units skipped)",
+          mIsAudio ? "audio" : "video", entryAt(syncPos).mTimeUs,
+          syncPos - mReadPos);
+
+    for (int32_t pos = mReadPos; pos != syncPos; ++pos) {
+        entryAt(pos).mBuffer.clear();
+    }
+    mReadPos = syncPos;
+}
+
+// Called with the locks of both queues held.
+status_t DashPacketSource::seekWithinBuffersLocked(
+        const sp<DashPacketSource> &video, const sp<DashPacketSource> &audio,
+        int64_t timeUs, SeekMode mode, int64_t *syncTimeUs) {
+    int64_t audioTimeUs = timeUs;
+    int32_t videoPos = 0;
+    if (video != NULL) {
+        status_t err = video->findSyncLocked(timeUs, mode, &videoPos);
+        if (err != OK) {
+            return err;
+        }
+        if (mode == kSeekClosestSync) {
+            audioTimeUs = video->entryAt(videoPos).mTimeUs;
+        }
+    }
+
+    int32_t audioPos = 0;
+    if (audio != NULL) {
+        status_t err = audio->findSyncLocked(audioTimeUs, kSeekPreviousSync, &audioPos);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    if (video != NULL) {
+        video->seekToLocked(videoPos);
+        *syncTimeUs = video->entryAt(videoPos).mTimeUs;
+    }
+    if (audio != NULL) {
+        audio->seekToLocked(audioPos);
+        if (video == NULL) {
+            *syncTimeUs = audio->entryAt(audioPos).mTimeUs;
+        }
+    }
+
+    return OK;
+}
+
+status_t DashPacketSource::seekWithinBuffers(
+        const sp<DashPacketSource> &video, const sp<DashPacketSource> &audio,
+        int64_t timeUs, SeekMode mode, int64_t *syncTimeUs) {
+    if (video == NULL && audio == NULL) {
+        return ERROR_OUT_OF_RANGE;
+    }
+
+    // Always video before audio, nothing else holds both.
+    if (video != NULL) {
+        video->mLock.lock();
+    }
+    if (audio != NULL) {
+        audio->mLock.lock();
+    }
+
+    status_t err = seekWithinBuffersLocked(video, audio, timeUs, mode, syncTimeUs);
+
+    if (audio != NULL) {
+        audio->mLock.unlock();
+    }
+    if (video != NULL) {
+        video->mLock.unlock();
+    }
+
+    return err;
+}
+
 }  // namespace android
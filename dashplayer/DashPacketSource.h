@@ -24,7 +24,6 @@
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/MediaSource.h>
 #include <utils/threads.h>
-#include <utils/List.h>
 
 #include "ATSParser.h"
 
@@ -32,6 +31,14 @@ namespace android {
 
 struct ABuffer;
 
+// Access units and in-band discontinuity markers are kept in queue order
+// in a circular array under mLock. The array doubles when it fills up, so
+// queueing never blocks and any number of threads may queue, as with the
+// list it replaces; like that list it is not bounded, callers keep it
+// short through getBufferedDurationUs. Entries are reused once the array
+// has grown to the working set, so steady state allocates nothing per
+// access unit, and the buffered duration is kept per entry instead of
+// being found by a walk over the queue.
 struct DashPacketSource : public MediaSource {
     DashPacketSource(const sp<MetaData> &meta);
 
@@ -54,8 +61,14 @@ struct DashPacketSource : public MediaSource {
 
     void queueAccessUnit(const sp<ABuffer> &buffer);
 
+    // With discard set (the default) queued access units are flushed as
+    // well; without it the marker is only appended, as when relaying a
+    // discontinuity some other queue has already applied. A format given
+    // with a format change becomes getFormat() once the marker has been
+    // dequeued, instead of no format at all.
     void queueDiscontinuity(
-            ATSParser::DiscontinuityType type, const sp<AMessage> &extra);
+            ATSParser::DiscontinuityType type, const sp<AMessage> &extra,
+            bool discard = true, const sp<MetaData> &format = NULL);
 
     void signalEOS(status_t result);
 
@@ -69,23 +82,95 @@ struct DashPacketSource : public MediaSource {
 
     status_t nextBufferIsSync(bool* isSyncFrame);
 
+    enum SeekMode {
+        kSeekPreviousSync,  // latest sync sample at or before the target
+        kSeekClosestSync,   // sync sample closest to the target
+    };
+
+    // Repositions both queues at timeUs from what they have queued, using
+    // the sync sample index instead of the source. Video resumes from the
+    // sync sample mode picks. Audio, where every access unit counts as a
+    // sync sample, resumes at timeUs for kSeekPreviousSync and at the
+    // video sync sample for kSeekClosestSync, i.e. where video rendering
+    // resumes. Either queue may be NULL; *syncTimeUs is the video sync
+    // sample time, or the audio one without video.
+    //
+    // The look-up and the drop happen under both queue locks, so neither
+    // queue can change in between, and nothing is dropped unless both have
+    // their position queued: timeUs must lie between the next access unit
+    // and the last one queued without a discontinuity in between.
+    // Otherwise returns ERROR_OUT_OF_RANGE.
+    static status_t seekWithinBuffers(
+            const sp<DashPacketSource> &video, const sp<DashPacketSource> &audio,
+            int64_t timeUs, SeekMode mode, int64_t *syncTimeUs);
+
 protected:
     virtual ~DashPacketSource();
 
 private:
+    enum {
+        kInitialCapacity = 4096,   // power of two
+    };
+
+    struct Entry {
+        sp<ABuffer> mBuffer;
+        int64_t mTimeUs;
+        // Time of the first access unit after the preceding discontinuity,
+        // so the buffered duration never needs a walk over the queue.
+        int64_t mSegmentFirstTimeUs;
+        int32_t mSegment;
+        bool mIsDiscontinuity;
+    };
+
     Mutex mLock;
     Condition mCondition;
+    Mutex mFormatLock;
 
     bool mIsAudio;
     sp<MetaData> mFormat;
-    List<sp<ABuffer> > mBuffers;
     status_t mEOSResult;
+
+    // Queued entries live at free-running positions [mReadPos, mWritePos),
+    // masked with mCapacity - 1.
+    Entry *mEntries;
+    int32_t mCapacity;
+    int32_t mReadPos;
+    int32_t mWritePos;
+
+    // Positions of queued sync samples in queue order, as large as
+    // mEntries. Entries behind mReadPos are stale and skipped lazily.
+    int32_t *mSyncIndex;
+    int32_t mSyncReadPos;
+    int32_t mSyncWritePos;
+
+    // Segment the next entry belongs to, a new one after every
+    // discontinuity, and the time its first access unit was queued at.
+    int32_t mSegment;
+    int64_t mSegmentFirstTimeUs;
+
     unsigned mStreamPID;
     unsigned mProgramPID;
     uint64_t mFirstPTS;
 
     bool wasFormatChange(int32_t discontinuityType) const;
 
+    Entry &entryAt(int32_t pos) const {
+        return mEntries[pos & (mCapacity - 1)];
+    }
+
+    void pushLocked(
+            const sp<ABuffer> &buffer, int64_t timeUs,
+            bool isDiscontinuity, bool isSync);
+    void growLocked();
+    void flushLocked();
+    void dropAccessUnitsLocked();
+    status_t dequeueLocked(sp<ABuffer> *buffer);
+    status_t findSyncLocked(int64_t timeUs, SeekMode mode, int32_t *syncPos);
+    void seekToLocked(int32_t syncPos);
+    static status_t seekWithinBuffersLocked(
+            const sp<DashPacketSource> &video, const sp<DashPacketSource> &audio,
+            int64_t timeUs, SeekMode mode, int64_t *syncTimeUs);
+
     DISALLOW_EVIL_CONSTRUCTORS(DashPacketSource);
 };
 
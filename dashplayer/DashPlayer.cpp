@@ -32,6 +32,7 @@
 #include "DashPlayerDriver.h"
 #include "DashPlayerRenderer.h"
 #include "DashPlayerSource.h"
+#include "DashPrefetchSource.h"
 #include "DashCodec.h"
 //#include "RTSPSource.h"
 //#include "StreamingSource.h"
@@ -59,6 +60,19 @@
 
 namespace android {
 
+// Media time between the sync frames fed at 2x is twice this, and so on.
+static const int64_t kTrickPlayStepUs = 100000ll;
+static const int32_t kMinTrickPlayRate = 2;
+static const int32_t kMaxTrickPlayRate = 32;
+// Steps covered by each seek of a reverse scan.
+static const int64_t kTrickPlayWindowSteps = 8;
+// Most audio access units discarded per fill request while scanning.
+static const int kMaxTrickPlayAudioDrain = 32;
+
+static int64_t TrickPlayStepUs(int32_t rate) {
+    return kTrickPlayStepUs * ((rate < 0) ? -rate : rate);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 DashPlayer::DashPlayer()
@@ -81,10 +95,22 @@ DashPlayer::DashPlayer()
       mNumFramesDropped(0ll),
       mPauseIndication(false),
       mSourceType(kDefaultSource),
+      mSeekMode(kSeekModeAccurate),
+      mTrickPlayRate(1),
+      mTrickPlayNextUs(-1ll),
+      mTrickPlayLastUs(-1ll),
+      mTrickPlayLastSyncUs(-1ll),
+      mTrickPlaySyncIntervalUs(-1ll),
+      mTrickPlaySeekAhead(true),
+      mTrickPlayWindowEndUs(-1ll),
+      mTrickPlaySeekPending(false),
+      mLastPositionUs(-1ll),
       mRenderer(NULL),
       mIsSecureInputBuffers(false),
       mStats(NULL),
       mBufferingNotification(false),
+      mSourceBuffering(false),
+      mPrefetchBuffering(false),
       mSRid(0) {
       mTrackName = new char[6];
 }
@@ -136,6 +162,12 @@ void DashPlayer::setDataSource(
            ALOGV("DashPlayer setDataSource url sting %s",url);
            source = LoadCreateSource(url, headers, mUIDValid, mUID,kHttpDashSource);
            if (source != NULL) {
+              char value[PROPERTY_VALUE_MAX];
+              // Off by default, persist.dash.prefetch.enable=true turns it on.
+              property_get("persist.dash.prefetch.enable", value, "false");
+              if (!strcasecmp(value, "true") || !strcmp(value, "1")) {
+                  source = createPrefetchSource(source);
+              }
               mSourceType = kHttpDashSource;
               msg->setObject("source", source);
               msg->post();
@@ -288,6 +320,17 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 mRenderer = new Renderer(
                         mAudioSink,
                         new AMessage(kWhatRendererNotify, id()));
+
+                // On by default, persist.dash.vsync.enable=false turns it off.
+                char value[PROPERTY_VALUE_MAX];
+                property_get("persist.dash.vsync.enable", value, "true");
+                if (!strcasecmp(value, "true") || !strcmp(value, "1")) {
+                    sp<DashPlayerDisplayVsyncSource> vsync =
+                        new DashPlayerDisplayVsyncSource();
+                    if (vsync->initCheck() == OK) {
+                        mRenderer->setVsyncSource(vsync);
+                    }
+                }
 #ifdef QCOM_WFD_SINK
             }
 #endif /* QCOM_WFD_SINK */
@@ -610,6 +653,7 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 CHECK(msg->findInt64("positionUs", &positionUs));
 
                 CHECK(msg->findInt64("videoLateByUs", &mVideoLateByUs));
+                mLastPositionUs = positionUs;
                 ALOGV("@@@@:: Dashplayer :: MESSAGE FROM RENDERER ***************** kWhatPosition:: position(%lld) VideoLateBy(%lld)",positionUs,mVideoLateByUs);
 
                 if (mDriver != NULL) {
@@ -623,6 +667,15 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                                 mNumFramesTotal, mNumFramesDropped);
                     }
                 }
+            } else if (what == Renderer::kWhatDropModeChanged) {
+                int32_t mode;
+                CHECK(msg->findInt32("mode", &mode));
+                ALOGV("@@@@:: Dashplayer :: MESSAGE FROM RENDERER ***************** kWhatDropModeChanged:: %d",mode);
+
+                if (mVideoDecoder != NULL) {
+                    mVideoDecoder->setDropMode(
+                            static_cast<DashPlayerDropPolicy::DropMode>(mode));
+                }
             } else if (what == Renderer::kWhatFlushComplete) {
                 CHECK_EQ(what, (int32_t)Renderer::kWhatFlushComplete);
 
@@ -701,7 +754,18 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             ALOGW("kWhatSeek seekTimeUs=%lld us (%.2f secs)",
                  seekTimeUs, seekTimeUs / 1E6);
 
-            nRet = mSource->seekTo(seekTimeUs);
+            bool accurate = (mSeekMode == kSeekModeAccurate);
+            int64_t resumeTimeUs = -1;
+            // With persist.dash.prefetch.enable set, DASH sources go
+            // through the prefetch stage; anything it has not buffered
+            // falls back to seeking the source.
+            bool seekInBuffer = (mPrefetchSource != NULL)
+                    && (mPrefetchSource->seekWithinBuffer(
+                            seekTimeUs, accurate, &resumeTimeUs) == OK);
+
+            if (!seekInBuffer) {
+                nRet = mSource->seekTo(seekTimeUs);
+            }
 
             if (mSourceType == kHttpLiveSource) {
                 mSource->getNewSeekTime(&newSeekTime);
@@ -760,14 +824,31 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                }
             }
 
+            mLastPositionUs = seekTimeUs;
+
+            if (mTrickPlayRate != 1) {
+                // Keep scanning from the new position, where a forward
+                // scan finds the source already.
+                startTrickPlayScan(seekTimeUs, false);
+            } else if (resumeTimeUs >= 0) {
+                // Nothing before the resume point reaches the renderer,
+                // and non-reference video before it is not even decoded.
+                mSkipRenderingAudioUntilMediaTimeUs = resumeTimeUs;
+                mSkipRenderingVideoUntilMediaTimeUs = resumeTimeUs;
+            }
+
             if(mStats != NULL) {
                 mStats->logSeek(seekTimeUs);
             }
 
             if (mDriver != NULL) {
                 sp<DashPlayerDriver> driver = mDriver.promote();
+                int32_t trickPlayExit = 0;
+                msg->findInt32("trick-play-exit", &trickPlayExit);
                 if (driver != NULL) {
-                    driver->notifySeekComplete();
+                    if (!trickPlayExit) {
+                        driver->notifySeekComplete();
+                    }
                     if( newSeekTime >= 0 ) {
                         driver->notifyPosition( newSeekTime );
                         mSource->notifyRenderingPosition(newSeekTime);
@@ -866,6 +947,21 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
                 msg->post(100000ll);
             }
             break;
+
+        case kWhatSetTrickPlayRate:
+        {
+            uint32_t replyID;
+            CHECK(msg->senderAwaitsResponse(&replyID));
+
+            int32_t rate;
+            CHECK(msg->findInt32("rate", &rate));
+
+            sp<AMessage> response = new AMessage;
+            response->setInt32("err", onSetTrickPlayRate(rate));
+            response->postReply(replyID);
+            break;
+        }
+
         case kWhatSourceNotify:
         {
             Mutex::Autolock autoLock(mLock);
@@ -896,10 +992,28 @@ void DashPlayer::onMessageReceived(const sp<AMessage> &msg) {
             sourceRequest->findInt64("track", &track);
             getTrackName((int)track,mTrackName);
 
+            if (what == kWhatBufferingStart || what == kWhatBufferingEnd) {
+              // The prefetch stage and the source it wraps report
+              // buffering separately; the listener hears about it while
+              // either of them is buffering.
+              int32_t prefetch = 0;
+              sourceRequest->findInt32("prefetch", &prefetch);
+              if (prefetch) {
+                  mPrefetchBuffering = (what == kWhatBufferingStart);
+              } else {
+                  mSourceBuffering = (what == kWhatBufferingStart);
+              }
+              what = (mSourceBuffering || mPrefetchBuffering)
+                  ? kWhatBufferingStart : kWhatBufferingEnd;
+            }
+
             if (what == kWhatBufferingStart) {
               ALOGE("Source Notified Buffering Start for %s ",mTrackName);
               if (mBufferingNotification == false) {
                  mBufferingNotification = true;
+                 if(mStats != NULL) {
+                   mStats->notifyBufferingStart();
+                 }
                  notifyListener(MEDIA_INFO, MEDIA_INFO_BUFFERING_START, 0);
               }
               else {
@@ -1022,8 +1136,14 @@ void DashPlayer::finishReset() {
         ALOGV("finishReset calling mSource->stop");
         mSource->stop();
         mSource.clear();
+        mPrefetchSource.clear();
     }
 
+    mTrickPlayRate = 1;
+    mTrickPlaySeekPending = false;
+    mTrickPlayFrames.clear();
+    mLastPositionUs = -1;
+
     if ( (mSourceType == kHttpDashSource) && (mTextDecoder != NULL) && (mTextNotify != NULL))
     {
       sp<AMessage> codecRequest;
@@ -1187,12 +1307,63 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
     getTrackName(track,mTrackName);
 
     sp<ABuffer> accessUnit;
+    bool audioFormatChange = false;
+
+    if (track == kAudio && mTrickPlayRate != 1) {
+        // Not played while scanning; the seek back to normal play
+        // repositions it. What the source produces meanwhile is thrown
+        // away so a full audio queue cannot hold the video scan up, all
+        // but format changes, which the decoder still has to see.
+        for (int n = 0; n < kMaxTrickPlayAudioDrain; ++n) {
+            sp<ABuffer> discarded;
+            status_t err = mSource->dequeueAccessUnit(kAudio, &discarded);
+            int32_t type;
+            if (err == INFO_DISCONTINUITY
+                    && discarded->meta()->findInt32("discontinuity", &type)
+                    && (type & ATSParser::DISCONTINUITY_AUDIO_FORMAT)) {
+                accessUnit = discarded;
+                audioFormatChange = true;
+                break;
+            }
+            if (err != OK && err != INFO_DISCONTINUITY) {
+                break;
+            }
+        }
+        if (!audioFormatChange) {
+            return -EWOULDBLOCK;
+        }
+    }
 
     bool dropAccessUnit;
     do {
 
         status_t err = UNKNOWN_ERROR;
 
+        if (track == kVideo && mTrickPlayRate < 0 && !mTrickPlayFrames.empty()) {
+            // Feed the frames picked from the last window, newest first,
+            // no closer than a step to the one fed before.
+            accessUnit = mTrickPlayFrames.top();
+            mTrickPlayFrames.pop();
+
+            int64_t timeUs;
+            CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+            dropAccessUnit = mTrickPlayLastUs >= 0
+                && timeUs > mTrickPlayLastUs - TrickPlayStepUs(mTrickPlayRate);
+            if (!dropAccessUnit) {
+                mTrickPlayLastUs = timeUs;
+            }
+            continue;
+        }
+
+        if (track == kVideo && mTrickPlaySeekPending) {
+            if (mTrickPlayNextUs < 0) {
+                // A reverse scan that reached the start holds there.
+                return -EWOULDBLOCK;
+            }
+            mTrickPlaySeekPending = false;
+            mSource->seekTo(mTrickPlayNextUs);
+        }
+
         if (mIsSecureInputBuffers && track == kVideo) {
             msg->findBuffer("buffer", &accessUnit);
 
@@ -1205,7 +1376,12 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
             }
         }
 
-        err = mSource->dequeueAccessUnit(track, &accessUnit);
+        if (audioFormatChange) {
+            audioFormatChange = false;
+            err = INFO_DISCONTINUITY;
+        } else {
+            err = mSource->dequeueAccessUnit(track, &accessUnit);
+        }
 
         if (err == -EWOULDBLOCK) {
             return err;
@@ -1225,6 +1401,13 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
                 ALOGW("%s discontinuity (formatChange=%d, time=%d)",
                      mTrackName, formatChange, timeChange);
 
+                if (track == kVideo && mTrickPlayRate != 1 && !formatChange) {
+                    // Only sync frames are fed while scanning, so the
+                    // decoder needs no flush across a time jump.
+                    dropAccessUnit = true;
+                    continue;
+                }
+
                 if (track == kAudio) {
                     mSkipRenderingAudioUntilMediaTimeUs = -1;
                 } else if (track == kVideo) {
@@ -1256,7 +1439,20 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
                     mTimeDiscontinuityPending || timeChange;
 
                 if (formatChange || timeChange) {
-                    flushDecoder(track, formatChange);
+                    bool needShutdown = formatChange;
+
+                    if (formatChange && track == kVideo && mVideoDecoder != NULL) {
+                        // A representation switch the codec can absorb
+                        // costs a flush rather than a full teardown.
+                        sp<MetaData> meta = mSource->getFormat(kVideo);
+                        if (mVideoDecoder->supportsSeamlessFormatChange(meta)) {
+                            ALOGI("reusing the video decoder across the format change");
+                            mVideoDecoder->updateFormat(meta);
+                            needShutdown = false;
+                        }
+                    }
+
+                    flushDecoder(track, needShutdown);
                 } else {
                     // This stream is unaffected by the discontinuity
 
@@ -1272,6 +1468,14 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
                 }
             }
 
+            if (track == kVideo && mTrickPlayRate < 0
+                    && err == ERROR_END_OF_STREAM) {
+                // The window ran into the end of the stream.
+                finishTrickPlayWindow();
+                dropAccessUnit = true;
+                continue;
+            }
+
             if ( (track == kAudio) ||
                  (track == kVideo))
             {
@@ -1287,21 +1491,47 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
         }
 
         dropAccessUnit = false;
-        if (track == kVideo) {
+        if (track == kVideo && mTrickPlayRate != 1) {
+            dropAccessUnit = !acceptTrickPlayFrame(accessUnit);
+        } else if (track == kVideo) {
             ++mNumFramesTotal;
 
             if(mStats != NULL) {
                 mStats->incrementTotalFrames();
             }
 
-            if (mVideoLateByUs > 100000ll
-                    && mVideoIsAVC
-                    && !mIsSecureInputBuffers
+            DashPlayerStats::DropReason reason;
+            if (mVideoDecoder != NULL
+                    && mVideoDecoder->shouldDropAccessUnit(
+                            accessUnit,
+                            mVideoIsAVC && !mIsSecureInputBuffers,
+                            &reason)) {
+                dropAccessUnit = true;
+                ++mNumFramesDropped;
+                if(mStats != NULL) {
+                    int64_t mediaTimeUs = -1;
+                    accessUnit->meta()->findInt64("timeUs", &mediaTimeUs);
+                    mStats->incrementDroppedFrames();
+                    mStats->recordDrop(reason, mediaTimeUs);
+                }
+            }
+
+            int64_t mediaTimeUs;
+            if (!dropAccessUnit
+                    && mSkipRenderingVideoUntilMediaTimeUs >= 0
+                    && mVideoIsAVC && !mIsSecureInputBuffers
+                    && accessUnit->meta()->findInt64("timeUs", &mediaTimeUs)
+                    && mediaTimeUs < mSkipRenderingVideoUntilMediaTimeUs
                     && !IsAVCReferenceFrame(accessUnit)) {
+                // It would only be decoded to be skipped at render time.
+                ALOGV("dropping non-reference frame at %lld us before seek target",
+                      mediaTimeUs);
                 dropAccessUnit = true;
                 ++mNumFramesDropped;
                 if(mStats != NULL) {
                     mStats->incrementDroppedFrames();
+                    mStats->recordDrop(
+                            DashPlayerStats::kDropReasonSeekPreroll, mediaTimeUs);
                 }
             }
         }
@@ -1317,6 +1547,12 @@ status_t DashPlayer::feedDecoderInputData(int track, const sp<AMessage> &msg) {
          mediaTimeUs / 1E6);
 #endif
     if (track == kVideo || track == kAudio) {
+        if (track == kVideo && mStats != NULL) {
+            int64_t mediaTimeUs;
+            if (accessUnit->meta()->findInt64("timeUs", &mediaTimeUs)) {
+                mStats->notifyDecoderInput(mediaTimeUs);
+            }
+        }
         reply->setBuffer("buffer", accessUnit);
         reply->post();
     } else if (mSourceType == kHttpDashSource && track == kText) {
@@ -1351,6 +1587,13 @@ void DashPlayer::renderBuffer(bool audio, const sp<AMessage> &msg) {
     sp<ABuffer> buffer;
     CHECK(msg->findBuffer("buffer", &buffer));
 
+    if (!audio && mStats != NULL) {
+        int64_t mediaTimeUs;
+        if (buffer->meta()->findInt64("timeUs", &mediaTimeUs)) {
+            mStats->notifyDecoderOutput(mediaTimeUs);
+        }
+    }
+
     int64_t &skipUntilMediaTimeUs =
         audio
             ? mSkipRenderingAudioUntilMediaTimeUs
@@ -1508,6 +1751,18 @@ status_t DashPlayer::getParameter(int key, Parcel *reply)
 
     status_t err = OK;
 
+    if (key == KEY_DASH_QOE_METRICS) {
+        sp<DashPlayerStats> stats = mStats;
+        if (stats == NULL) {
+            ALOGE("No statistics before playback starts\n");
+            return NO_INIT;
+        }
+
+        AString json;
+        stats->exportJSON(&json);
+        return reply->writeString16(String16(json.c_str()));
+    }
+
     if (mSource == NULL)
     {
       ALOGE("Source is NULL in getParameter\n");
@@ -1537,6 +1792,37 @@ status_t DashPlayer::getParameter(int key, Parcel *reply)
 status_t DashPlayer::setParameter(int key, const Parcel &request)
 {
     status_t err = OK;
+    if (key == KEY_DASH_SEEK_MODE) {
+        int32_t mode = request.readInt32();
+        if (mode != kSeekModeAccurate && mode != kSeekModeNearestSync) {
+            ALOGE("unknown seek mode %d", mode);
+            return BAD_VALUE;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        mSeekMode = mode;
+        return OK;
+    }
+
+    if (key == KEY_DASH_TRICK_PLAY_RATE) {
+        int32_t rate = request.readInt32();
+        int32_t speed = (rate < 0) ? -rate : rate;
+        if (rate != 1 && (speed < kMinTrickPlayRate || speed > kMaxTrickPlayRate)) {
+            ALOGE("unsupported trick play rate %d", rate);
+            return BAD_VALUE;
+        }
+
+        sp<AMessage> msg = new AMessage(kWhatSetTrickPlayRate, id());
+        msg->setInt32("rate", rate);
+
+        sp<AMessage> response;
+        status_t err = msg->postAndAwaitResponse(&response);
+        if (err == OK) {
+            CHECK(response->findInt32("err", &err));
+        }
+        return err;
+    }
+
     if (key == 8002) {
 
         size_t len = 0;
@@ -1685,9 +1971,206 @@ void DashPlayer::getTrackName(int track, char* name)
     }
 }
 
+status_t DashPlayer::onSetTrickPlayRate(int32_t rate) {
+    if (rate == mTrickPlayRate) {
+        return OK;
+    }
+
+    if (mRenderer == NULL || mVideoDecoder == NULL) {
+        ALOGE("trick play needs video playback to have started");
+        return INVALID_OPERATION;
+    }
+
+    if (rate < 0 && !mSource->isSeekable()) {
+        ALOGE("reverse trick play needs a seekable source");
+        return INVALID_OPERATION;
+    }
+
+    if (rate < 0 && mIsSecureInputBuffers) {
+        // The source writes into the decoder's own buffer, so there is
+        // nowhere to hold the frames picked from a window.
+        ALOGE("reverse trick play is not supported with secure input buffers");
+        return INVALID_OPERATION;
+    }
+
+    ALOGI("trick play rate %d -> %d", mTrickPlayRate, rate);
+
+    int32_t oldRate = mTrickPlayRate;
+    mTrickPlayRate = rate;
+    mRenderer->setTrickPlayRate(rate);
+
+    int64_t positionUs = (mLastPositionUs < 0) ? 0 : mLastPositionUs;
+
+    if (rate == 1) {
+        // Resume normal play at the frame on screen. This is the only
+        // flush a scan costs.
+        mTrickPlaySeekPending = false;
+        mTrickPlayFrames.clear();
+
+        sp<AMessage> msg = new AMessage(kWhatSeek, id());
+        msg->setInt64("seekTimeUs", positionUs);
+        msg->setInt32("trick-play-exit", true);
+        msg->post();
+        return OK;
+    }
+
+    if (oldRate == 1) {
+        startTrickPlayScan(positionUs, false);
+    } else if ((rate > 0) != (oldRate > 0)) {
+        // A reverse scan leaves the source somewhere before the frame on
+        // screen, a forward one somewhere after it.
+        startTrickPlayScan(positionUs, true);
+    }
+    // A new speed in the same direction carries on; the step follows it.
+    return OK;
+}
+
+// Starts scanning at positionUs in the direction of mTrickPlayRate. seek
+// says whether a forward scan has to move the source there first; a
+// reverse scan always does.
+void DashPlayer::startTrickPlayScan(int64_t positionUs, bool seek) {
+    mTrickPlayLastUs = -1;
+    mTrickPlayLastSyncUs = -1;
+    mTrickPlaySyncIntervalUs = -1;
+    mTrickPlaySeekAhead = true;
+    mTrickPlayFrames.clear();
+
+    if (mTrickPlayRate > 0) {
+        mTrickPlayNextUs = positionUs;
+        mTrickPlaySeekPending = seek;
+    } else {
+        // Frames at or after the position have been shown already.
+        int64_t spanUs = TrickPlayStepUs(mTrickPlayRate) * kTrickPlayWindowSteps;
+        mTrickPlayWindowEndUs = positionUs;
+        mTrickPlayNextUs = (positionUs > spanUs) ? positionUs - spanUs : 0;
+        mTrickPlaySeekPending = true;
+    }
+}
+
+// Picks the video access units shown while scanning. Forward, it returns
+// whether to feed this one and moves the scan on past it. Reverse, it
+// collects the sync frames of the current window into mTrickPlayFrames
+// and always returns false; they are fed once the window has been read.
+bool DashPlayer::acceptTrickPlayFrame(const sp<ABuffer> &accessUnit) {
+    int64_t timeUs;
+    if (!accessUnit->meta()->findInt64("timeUs", &timeUs)) {
+        return false;
+    }
+
+    int32_t isSync;
+    if (!accessUnit->meta()->findInt32("isSync", &isSync)) {
+        if (!mVideoIsAVC || mIsSecureInputBuffers) {
+            // Nothing tells the sync frames of this stream apart, and
+            // feeding the others would show broken pictures.
+            ALOGE("video access units carry no sync flag, leaving trick play");
+            onSetTrickPlayRate(1);
+            return false;
+        }
+        isSync = IsIDR(accessUnit);
+    }
+
+    int64_t stepUs = TrickPlayStepUs(mTrickPlayRate);
+
+    if (mTrickPlayRate < 0) {
+        if (timeUs >= mTrickPlayWindowEndUs) {
+            finishTrickPlayWindow();
+            return false;
+        }
+
+        // At most one pick per step keeps the window's frames bounded.
+        int64_t lastPickUs = -1;
+        if (!mTrickPlayFrames.empty()) {
+            CHECK(mTrickPlayFrames.top()->meta()->findInt64("timeUs", &lastPickUs));
+        }
+        if (isSync && (lastPickUs < 0 || timeUs >= lastPickUs + stepUs)) {
+            mTrickPlayFrames.push(accessUnit);
+        }
+        return false;
+    }
+
+    if (!isSync) {
+        return false;
+    }
+
+    if (mTrickPlayLastSyncUs < 0 && mTrickPlayLastUs >= 0
+            && timeUs <= mTrickPlayLastUs) {
+        // The seek went back to the last pick or before it; this source
+        // seeks too coarsely to skip ahead with.
+        mTrickPlaySeekAhead = false;
+    }
+    if (mTrickPlayLastSyncUs >= 0 && timeUs > mTrickPlayLastSyncUs) {
+        mTrickPlaySyncIntervalUs = timeUs - mTrickPlayLastSyncUs;
+    }
+    mTrickPlayLastSyncUs = timeUs;
+
+    if (timeUs < mTrickPlayNextUs) {
+        return false;
+    }
+    mTrickPlayNextUs = timeUs + stepUs;
+    mTrickPlayLastUs = timeUs;
+
+    if (mTrickPlaySeekAhead && mTrickPlaySyncIntervalUs > 0
+            && stepUs >= 2 * mTrickPlaySyncIntervalUs) {
+        // At least one whole GOP lies before the next pick; seek over it
+        // rather than download it.
+        mTrickPlaySeekPending = true;
+        mTrickPlayLastSyncUs = -1;
+    }
+    return true;
+}
+
+// Reverse scan: the window up to mTrickPlayWindowEndUs has been read. The
+// next one ends where this one found its first sync frame, since nothing
+// before that can be decoded from it.
+void DashPlayer::finishTrickPlayWindow() {
+    int64_t startUs = mTrickPlayNextUs;
+    int64_t endUs = startUs;
+    if (!mTrickPlayFrames.empty()) {
+        int64_t firstPickUs;
+        CHECK(mTrickPlayFrames[0]->meta()->findInt64("timeUs", &firstPickUs));
+        if (firstPickUs < endUs) {
+            endUs = firstPickUs;
+        }
+    }
+
+    int64_t spanUs = TrickPlayStepUs(mTrickPlayRate) * kTrickPlayWindowSteps;
+    mTrickPlayWindowEndUs = endUs;
+    if (startUs <= 0) {
+        // That was the first window; hold once its frames are fed.
+        mTrickPlayNextUs = -1;
+    } else {
+        mTrickPlayNextUs = (endUs > spanUs) ? endUs - spanUs : 0;
+    }
+    mTrickPlaySeekPending = true;
+}
+
+sp<DashPlayer::Source> DashPlayer::createPrefetchSource(const sp<Source> &source)
+{
+    sp<PrefetchSource> prefetch = new PrefetchSource(source);
+
+    // Watermarks are in milliseconds.
+    char value[PROPERTY_VALUE_MAX];
+    int64_t lowUs = PrefetchSource::kDefaultLowWatermarkUs;
+    int64_t highUs = PrefetchSource::kDefaultHighWatermarkUs;
+    int64_t targetUs = PrefetchSource::kDefaultTargetDurationUs;
+    if (property_get("persist.dash.prefetch.low", value, NULL)) {
+        lowUs = atoll(value) * 1000ll;
+    }
+    if (property_get("persist.dash.prefetch.high", value, NULL)) {
+        highUs = atoll(value) * 1000ll;
+    }
+    if (property_get("persist.dash.prefetch.target", value, NULL)) {
+        targetUs = atoll(value) * 1000ll;
+    }
+    prefetch->setWatermarks(lowUs, highUs, targetUs);
+
+    mPrefetchSource = prefetch;
+    return prefetch;
+}
+
 void DashPlayer::prepareSource()
 {
-    if (mSourceType = kHttpDashSource)
+    if (mSourceType == kHttpDashSource)
     {
        mSourceNotify = new AMessage(kWhatSourceNotify ,id());
        if (mSource != NULL)
@@ -1699,8 +2182,25 @@ void DashPlayer::prepareSource()
 
 status_t DashPlayer::dump(int fd, const Vector<String16> &args)
 {
-    if(mStats != NULL) {
-      mStats->setFileDescAndOutputStream(fd);
+    sp<DashPlayerStats> stats = mStats;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == String16("--json")) {
+            // One QoE snapshot instead of switching the text log to fd.
+            AString json;
+            if (stats != NULL) {
+                stats->exportJSON(&json);
+            } else {
+                json = "{}";
+            }
+            json.append("\n");
+            write(fd, json.c_str(), json.size());
+            return OK;
+        }
+    }
+
+    if(stats != NULL) {
+      stats->setFileDescAndOutputStream(fd);
     }
 
     return OK;
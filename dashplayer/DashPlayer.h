@@ -25,6 +25,9 @@
 #include <media/stagefright/foundation/ABuffer.h>
 #define KEY_DASH_ADAPTION_PROPERTIES 8002
 #define KEY_DASH_MPD_QUERY           8003
+#define KEY_DASH_SEEK_MODE           8004
+#define KEY_DASH_QOE_METRICS         8005
+#define KEY_DASH_TRICK_PLAY_RATE     8006
 
 namespace android {
 
@@ -73,6 +76,25 @@ public:
     struct DASHHTTPLiveSource;
     struct WFDSource;
 
+    // Public so that dashplayer-prefetch-test can run the prefetch stage
+    // over the file-backed stand-in without a player.
+    struct Source;
+    struct PrefetchSource;
+    struct LocalFileSource;
+
+    enum TrackName {
+        kVideo = 0,
+        kAudio,
+        kText,
+        kTrackAll,
+    };
+
+    // What a source reports in the "source-request" of its notification.
+    enum {
+        kWhatBufferingStart             = 'bfst',
+        kWhatBufferingEnd               = 'bfen',
+    };
+
 protected:
     virtual ~DashPlayer();
 
@@ -81,7 +103,6 @@ protected:
 private:
     struct Decoder;
     struct Renderer;
-    struct Source;
 
     enum {
           // These keys must be in sync with the keys in QCTimedText.java
@@ -134,19 +155,17 @@ private:
         kWhatPrepareAsync               = 'pras',
         kWhatIsPrepareDone              = 'prdn',
         kWhatSourceNotify               = 'snfy',
+        kWhatSetTrickPlayRate           = 'trkP',
         kKeySmoothStreaming             = 'ESmS',  //bool (int32_t)
         kKeyEnableDecodeOrder           = 'EDeO',  //bool (int32_t)
     };
 
-    enum {
-        kWhatBufferingStart             = 'bfst',
-        kWhatBufferingEnd               = 'bfen',
-    };
-
     wp<DashPlayerDriver> mDriver;
     bool mUIDValid;
     uid_t mUID;
     sp<Source> mSource;
+    // Set when mSource is a prefetch stage, for seeks it can serve itself.
+    sp<PrefetchSource> mPrefetchSource;
     sp<NativeWindowWrapper> mNativeWindow;
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<Decoder> mVideoDecoder;
@@ -161,13 +180,10 @@ private:
     bool mScanSourcesPending;
     int32_t mScanSourcesGeneration;
     bool mBufferingNotification;
-
-    enum TrackName {
-        kVideo = 0,
-        kAudio,
-        kText,
-        kTrackAll,
-    };
+    // Who is buffering: the source itself, and the prefetch stage in
+    // front of it.
+    bool mSourceBuffering;
+    bool mPrefetchBuffering;
 
     enum FlushStatus {
         NONE,
@@ -221,6 +237,34 @@ private:
     };
     NuSourceType mSourceType;
 
+    // Values of KEY_DASH_SEEK_MODE.
+    enum SeekMode {
+        kSeekModeAccurate = 0,      // resume exactly at the requested time
+        kSeekModeNearestSync,       // resume at the closest sync frame
+    };
+    int32_t mSeekMode;
+
+    // Trick play, set through KEY_DASH_TRICK_PLAY_RATE as a signed
+    // multiple of normal speed. While it is not 1 audio is drained and
+    // only video sync frames are fed, about one per |rate| * 100 ms of
+    // media. A forward scan seeks over the GOPs between two picks once
+    // they are known to be shorter than the step. A reverse scan seeks
+    // back one window of several steps at a time, reads it forward and
+    // feeds the sync frames it picked newest first.
+    int32_t mTrickPlayRate;
+    int64_t mTrickPlayNextUs;       // forward: media time the next frame is
+                                    // picked from; reverse: start of the
+                                    // next window, -1 once at the start
+    int64_t mTrickPlayLastUs;       // last frame fed, -1 if none yet
+    int64_t mTrickPlayLastSyncUs;   // forward: last sync frame read since
+                                    // the last seek, -1 if none
+    int64_t mTrickPlaySyncIntervalUs; // forward: sync frame spacing, -1 if unknown
+    bool mTrickPlaySeekAhead;       // forward: seeks land past the last pick
+    int64_t mTrickPlayWindowEndUs;  // reverse: end of the window being read
+    Vector<sp<ABuffer> > mTrickPlayFrames; // reverse: picks, oldest first
+    bool mTrickPlaySeekPending;     // seek the source to mTrickPlayNextUs first
+    int64_t mLastPositionUs;
+
     bool mIsSecureInputBuffers;
 
     int32_t mSRid;
@@ -228,6 +272,10 @@ private:
     status_t instantiateDecoder(int track, sp<Decoder> *decoder);
 
     status_t feedDecoderInputData(int track, const sp<AMessage> &msg);
+    status_t onSetTrickPlayRate(int32_t rate);
+    void startTrickPlayScan(int64_t positionUs, bool seek);
+    bool acceptTrickPlayFrame(const sp<ABuffer> &accessUnit);
+    void finishTrickPlayWindow();
     void renderBuffer(bool audio, const sp<AMessage> &msg);
 
     void notifyListener(int msg, int ext1, int ext2, const Parcel *obj=NULL);
@@ -252,6 +300,7 @@ private:
     void sendTextPacket(sp<ABuffer> accessUnit, status_t err);
     void getTrackName(int track, char* name);
     void prepareSource();
+    sp<Source> createPrefetchSource(const sp<Source> &source);
 
     struct QueueEntry {
         sp<AMessage>  mMessageToBeConsumed;
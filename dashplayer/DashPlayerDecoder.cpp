@@ -29,6 +29,7 @@
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include "avc_utils.h"
 
 namespace android {
 
@@ -36,7 +37,10 @@ DashPlayer::Decoder::Decoder(
         const sp<AMessage> &notify,
         const sp<NativeWindowWrapper> &nativeWindow)
     : mNotify(notify),
-      mNativeWindow(nativeWindow) {
+      mNativeWindow(nativeWindow),
+      mIsSecure(false),
+      mDropMode(DashPlayerDropPolicy::kDropModeNone),
+      mSkipToSync(false) {
       mAudioSink = NULL;
 }
 
@@ -62,6 +66,10 @@ void DashPlayer::Decoder::configure(const sp<MetaData> &meta) {
 
     ALOGV("@@@@:: Decoder::configure :: mime is --- %s ---",mime);
 
+    mMime = mime;
+    int32_t secure = 0;
+    mIsSecure = meta->findInt32(kKeyRequiresSecureBuffers, &secure) && secure;
+
     sp<AMessage> notifyMsg =
         new AMessage(kWhatCodecNotify, id());
 
@@ -103,6 +111,36 @@ void DashPlayer::Decoder::configure(const sp<MetaData> &meta) {
 
 }
 
+bool DashPlayer::Decoder::supportsSeamlessFormatChange(const sp<MetaData> &meta) {
+    if (mCodec == NULL || meta == NULL) {
+        return false;
+    }
+
+    const char *mime;
+    if (!meta->findCString(kKeyMIMEType, &mime) || strcasecmp(mime, mMime.c_str())) {
+        return false;
+    }
+
+    int32_t secure = 0;
+    if ((meta->findInt32(kKeyRequiresSecureBuffers, &secure) && secure) != mIsSecure) {
+        return false;
+    }
+
+    int32_t width, height;
+    if (!meta->findInt32(kKeyWidth, &width) || !meta->findInt32(kKeyHeight, &height)) {
+        return false;
+    }
+
+    return mCodec->canAdaptTo(width, height);
+}
+
+void DashPlayer::Decoder::updateFormat(const sp<MetaData> &meta) {
+    // Posted ahead of the flush, so it is seen before the flush completes.
+    sp<AMessage> msg = new AMessage(kWhatUpdateFormat, id());
+    msg->setObject("meta", meta);
+    msg->post();
+}
+
 void DashPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
     switch (msg->what()) {
         case kWhatCodecNotify:
@@ -113,6 +151,15 @@ void DashPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
             if (what == DashCodec::kWhatFillThisBuffer) {
                 onFillThisBuffer(msg);
             }else {
+                if (what == DashCodec::kWhatFlushCompleted
+                        && mPendingFormat != NULL) {
+                    // Buffers requested after this point belong to the
+                    // new representation.
+                    mCSD.clear();
+                    makeFormat(mPendingFormat);
+                    mPendingFormat.clear();
+                }
+
                 sp<AMessage> notify = mNotify->dup();
                 notify->setMessage("codec-request", msg);
                 notify->post();
@@ -120,6 +167,14 @@ void DashPlayer::Decoder::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatUpdateFormat:
+        {
+            sp<RefBase> obj;
+            CHECK(msg->findObject("meta", &obj));
+            mPendingFormat = static_cast<MetaData *>(obj.get());
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -215,6 +270,47 @@ void DashPlayer::Decoder::onFillThisBuffer(const sp<AMessage> &msg) {
     notify->post();
 }
 
+void DashPlayer::Decoder::setDropMode(DashPlayerDropPolicy::DropMode mode) {
+    ALOGV("drop mode %d -> %d", mDropMode, mode);
+    if (mode == DashPlayerDropPolicy::kDropModeSkipToSync) {
+        // One-shot: keep dropping non-reference frames after the skip.
+        mSkipToSync = true;
+        mode = DashPlayerDropPolicy::kDropModeNonReference;
+    } else if (mode == DashPlayerDropPolicy::kDropModeNone) {
+        mSkipToSync = false;
+    }
+    mDropMode = mode;
+}
+
+bool DashPlayer::Decoder::shouldDropAccessUnit(
+        const sp<ABuffer> &accessUnit, bool isAVC,
+        DashPlayerStats::DropReason *reason) {
+    if (mSkipToSync) {
+        int32_t isSync = 0;
+        bool syncKnown = accessUnit->meta()->findInt32("isSync", &isSync);
+        if (!syncKnown && isAVC) {
+            isSync = IsIDR(accessUnit);
+            syncKnown = true;
+        }
+
+        if (!syncKnown || isSync) {
+            // Without sync information there is nothing safe to skip to.
+            mSkipToSync = false;
+        } else {
+            *reason = DashPlayerStats::kDropReasonSkipToSync;
+            return true;
+        }
+    }
+
+    if (mDropMode == DashPlayerDropPolicy::kDropModeNonReference
+            && isAVC && !IsAVCReferenceFrame(accessUnit)) {
+        *reason = DashPlayerStats::kDropReasonNonReference;
+        return true;
+    }
+
+    return false;
+}
+
 void DashPlayer::Decoder::signalFlush() {
     if (mCodec != NULL) {
         mCodec->signalFlush();
@@ -21,6 +21,7 @@
 #include "DashPlayerRenderer.h"
 #include "DashPlayer.h"
 #include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/AString.h>
 
 namespace android {
 
@@ -32,11 +33,22 @@ struct DashPlayer::Decoder : public AHandler {
 
     void configure(const sp<MetaData> &meta);
 
+    // Representation switches the running codec can take with a flush
+    // instead of a shutdown; updateFormat then swaps in the codec
+    // specific data once the flush that follows it completes.
+    bool supportsSeamlessFormatChange(const sp<MetaData> &meta);
+    void updateFormat(const sp<MetaData> &meta);
+
     void signalFlush();
     void signalResume();
     void initiateShutdown();
     void setSink(const sp<MediaPlayerBase::AudioSink> &sink, sp<Renderer> Renderer);
 
+    // Pre-decode dropping requested by the renderer's drop policy.
+    void setDropMode(DashPlayerDropPolicy::DropMode mode);
+    bool shouldDropAccessUnit(const sp<ABuffer> &accessUnit, bool isAVC,
+                              DashPlayerStats::DropReason *reason);
+
 protected:
     virtual ~Decoder();
 
@@ -45,6 +57,7 @@ protected:
 private:
     enum {
         kWhatCodecNotify        = 'cdcN',
+        kWhatUpdateFormat       = 'updF',
     };
 
     sp<AMessage> mNotify;
@@ -55,8 +68,16 @@ private:
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<Renderer> mRenderer;
 
+    AString mMime;
+    bool mIsSecure;
+
     Vector<sp<ABuffer> > mCSD;
     size_t mCSDIndex;
+    // Installed when the codec reports the next flush complete.
+    sp<MetaData> mPendingFormat;
+
+    DashPlayerDropPolicy::DropMode mDropMode;
+    bool mSkipToSync;
 
     sp<AMessage> makeFormat(const sp<MetaData> &meta);
 
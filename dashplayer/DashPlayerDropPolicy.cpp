@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashPlayerDropPolicy"
+#include <utils/Log.h>
+#include "DashPlayerDropPolicy.h"
+
+namespace android {
+
+// Frames later than this are not rendered at all.
+static const int64_t kMaxRenderLateUs = 40000ll;
+// Average lateness that starts dropping non-reference frames before decode.
+static const int64_t kNonRefLateUs = 15000ll;
+// Decoder slack below which the decoder is considered to be falling behind
+// even though nothing is late yet.
+static const int64_t kMinSlackUs = 5000ll;
+// Average lateness under which pre-decode dropping is switched off again.
+static const int64_t kRecoverLateUs = 0ll;
+// Average lateness / run of late frames that triggers a skip to the next
+// sync frame; kSkipCooldownFrames frames must pass before another one.
+static const int64_t kSkipToSyncLateUs = 200000ll;
+static const uint32_t kSustainedLateFrames = 8;
+static const uint32_t kSkipCooldownFrames = 30;
+// Observations are clamped so a single stall cannot dominate the average.
+static const int64_t kMaxSampleUs = 1000000ll;
+// Moving averages use a weight of 1/8 for the newest sample.
+static const int kAvgWeightShift = 3;
+
+DashPlayerDefaultDropPolicy::DashPlayerDefaultDropPolicy() {
+    reset();
+}
+
+DashPlayerDefaultDropPolicy::~DashPlayerDefaultDropPolicy() {
+}
+
+void DashPlayerDefaultDropPolicy::reset() {
+    Mutex::Autolock autoLock(mLock);
+    mMode = kDropModeNone;
+    mAvgLateUs = 0;
+    mAvgSlackUs = 0;
+    mAvgDepthQ4 = 0;
+    mNumSamples = 0;
+    mConsecutiveLate = 0;
+    mFramesSinceSkip = kSkipCooldownFrames;
+}
+
+bool DashPlayerDefaultDropPolicy::onVideoFrame(
+        int64_t lateByUs, int64_t slackUs, size_t queueDepth,
+        DashPlayerStats::DropReason *reason) {
+    Mutex::Autolock autoLock(mLock);
+
+    int64_t late = lateByUs;
+    if (late > kMaxSampleUs) late = kMaxSampleUs;
+    if (late < -kMaxSampleUs) late = -kMaxSampleUs;
+    int64_t slack = slackUs;
+    if (slack > kMaxSampleUs) slack = kMaxSampleUs;
+    if (slack < -kMaxSampleUs) slack = -kMaxSampleUs;
+    int32_t depthQ4 = (int32_t)(queueDepth > 64 ? 64 : queueDepth) << 4;
+
+    if (mNumSamples == 0) {
+        mAvgLateUs = late;
+        mAvgSlackUs = slack;
+        mAvgDepthQ4 = depthQ4;
+    } else {
+        mAvgLateUs += (late - mAvgLateUs) / (1 << kAvgWeightShift);
+        mAvgSlackUs += (slack - mAvgSlackUs) / (1 << kAvgWeightShift);
+        mAvgDepthQ4 += (depthQ4 - mAvgDepthQ4) / (1 << kAvgWeightShift);
+    }
+    ++mNumSamples;
+    ++mFramesSinceSkip;
+
+    bool drop = (lateByUs > kMaxRenderLateUs);
+    if (drop) {
+        ++mConsecutiveLate;
+        if (reason != NULL) {
+            *reason = DashPlayerStats::kDropReasonLate;
+        }
+    } else {
+        mConsecutiveLate = 0;
+    }
+
+    updateModeLocked();
+
+    return drop;
+}
+
+DashPlayerDropPolicy::DropMode DashPlayerDefaultDropPolicy::getDecodeDropMode() {
+    Mutex::Autolock autoLock(mLock);
+    return mMode;
+}
+
+void DashPlayerDefaultDropPolicy::updateModeLocked() {
+    DropMode mode = mMode;
+
+    // A skip request is one-shot: the renderer forwards it once and the
+    // decoder keeps skipping on its own until it sees a sync frame.
+    if (mode == kDropModeSkipToSync) {
+        mode = kDropModeNonReference;
+    }
+
+    // The decoder handing over frames with almost no time to spare while
+    // the renderer queue runs dry predicts lateness before it shows up.
+    bool starving = (mAvgSlackUs < kMinSlackUs) && (mAvgDepthQ4 < (2 << 4));
+
+    if ((mConsecutiveLate >= kSustainedLateFrames
+            || mAvgLateUs > kSkipToSyncLateUs)
+            && mFramesSinceSkip >= kSkipCooldownFrames) {
+        mode = kDropModeSkipToSync;
+        mConsecutiveLate = 0;
+        mFramesSinceSkip = 0;
+    } else if (mAvgLateUs > kNonRefLateUs || starving) {
+        mode = kDropModeNonReference;
+    } else if (mAvgLateUs <= kRecoverLateUs && mAvgSlackUs >= kMinSlackUs) {
+        mode = kDropModeNone;
+    }
+
+    if (mode != mMode) {
+        ALOGV("decode drop mode %d -> %d (avgLate %lld us, avgSlack %lld us, "
+              "avgDepth %d/16)", mMode, mode, mAvgLateUs, mAvgSlackUs,
+              mAvgDepthQ4);
+        mMode = mode;
+    }
+}
+
+} // namespace android
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASHPLAYER_DROP_POLICY_H_
+
+#define DASHPLAYER_DROP_POLICY_H_
+
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+#include "DashPlayerStats.h"
+
+namespace android {
+
+// Decides which video frames the player gives up on. The renderer feeds
+// it one observation per dequeued frame and asks whether to drop that
+// frame; the resulting pre-decode drop mode is forwarded to the video
+// decoder so frames can be discarded before they cost any decode time.
+class DashPlayerDropPolicy : public RefBase {
+  public:
+    enum DropMode {
+        kDropModeNone = 0,
+        kDropModeNonReference,  // drop non-reference frames before decode
+        kDropModeSkipToSync,    // drop everything up to the next sync frame
+    };
+
+    DashPlayerDropPolicy() {}
+
+    // Forget all history, e.g. after a flush or seek.
+    virtual void reset() = 0;
+
+    // lateByUs:   how late the frame is against its render deadline
+    // slackUs:    how long before its deadline the decoder delivered it
+    // queueDepth: decoded frames waiting in the renderer, this one included
+    // Returns true (and the reason) if the frame must not be rendered.
+    virtual bool onVideoFrame(int64_t lateByUs, int64_t slackUs,
+                              size_t queueDepth,
+                              DashPlayerStats::DropReason *reason) = 0;
+
+    virtual DropMode getDecodeDropMode() = 0;
+
+  protected:
+    virtual ~DashPlayerDropPolicy() {}
+
+  private:
+    DashPlayerDropPolicy(const DashPlayerDropPolicy &);
+    DashPlayerDropPolicy &operator=(const DashPlayerDropPolicy &);
+};
+
+// Default policy: keeps moving averages of lateness, decoder slack and
+// renderer queue depth, and escalates to pre-decode dropping while the
+// trend says the decoder is falling behind rather than once frames are
+// already far past their deadline.
+class DashPlayerDefaultDropPolicy : public DashPlayerDropPolicy {
+  public:
+    DashPlayerDefaultDropPolicy();
+
+    virtual void reset();
+    virtual bool onVideoFrame(int64_t lateByUs, int64_t slackUs,
+                              size_t queueDepth,
+                              DashPlayerStats::DropReason *reason);
+    virtual DropMode getDecodeDropMode();
+
+  protected:
+    virtual ~DashPlayerDefaultDropPolicy();
+
+  private:
+    void updateModeLocked();
+
+    Mutex mLock;
+    DropMode mMode;
+    int64_t mAvgLateUs;
+    int64_t mAvgSlackUs;
+    int32_t mAvgDepthQ4;
+    uint32_t mNumSamples;
+    uint32_t mConsecutiveLate;
+    uint32_t mFramesSinceSkip;
+};
+
+} // namespace android
+
+#endif // DASHPLAYER_DROP_POLICY_H_
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DashPlayerHistogram.h"
+
+#include <cutils/atomic.h>
+#include <media/stagefright/foundation/AString.h>
+
+namespace android {
+
+DashPlayerHistogram::DashPlayerHistogram() {
+    reset();
+}
+
+void DashPlayerHistogram::reset() {
+    for (int i = 0; i < kNumBuckets; ++i) {
+        android_atomic_release_store(0, &mCounts[i]);
+    }
+    android_atomic_release_store(0, &mTotal);
+    android_atomic_release_store(0, &mMaxUs);
+}
+
+// static
+int DashPlayerHistogram::bucketIndex(int32_t valueUs) {
+    if (valueUs < kSubBuckets) {
+        return valueUs;
+    }
+
+    int msb = 31 - __builtin_clz(valueUs);
+    int sub = (valueUs >> (msb - kSubBucketBits)) & (kSubBuckets - 1);
+    return (msb - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+// static
+int64_t DashPlayerHistogram::bucketUpperUs(int index) {
+    if (index < kSubBuckets) {
+        return index;
+    }
+
+    int msb = index / kSubBuckets + kSubBucketBits - 1;
+    int sub = index % kSubBuckets;
+    int64_t lower = (int64_t)(kSubBuckets + sub) << (msb - kSubBucketBits);
+    return lower + (1ll << (msb - kSubBucketBits)) - 1;
+}
+
+void DashPlayerHistogram::record(int64_t valueUs) {
+    if (valueUs < 0) {
+        valueUs = 0;
+    } else if (valueUs > 0x7fffffffll) {
+        valueUs = 0x7fffffffll;
+    }
+    int32_t value = (int32_t)valueUs;
+
+    android_atomic_inc(&mCounts[bucketIndex(value)]);
+    android_atomic_inc(&mTotal);
+
+    int32_t oldMax;
+    while (value > (oldMax = android_atomic_acquire_load(&mMaxUs))) {
+        if (android_atomic_cmpxchg(oldMax, value, &mMaxUs) == 0) {
+            break;
+        }
+    }
+}
+
+int32_t DashPlayerHistogram::count() const {
+    return android_atomic_acquire_load(&mTotal);
+}
+
+int64_t DashPlayerHistogram::maxUs() const {
+    return android_atomic_acquire_load(&mMaxUs);
+}
+
+int64_t DashPlayerHistogram::percentileUs(double percent) const {
+    int32_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    int64_t target = (int64_t)(total * percent / 100.0 + 0.5);
+    if (target < 1) {
+        target = 1;
+    }
+
+    int64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        seen += android_atomic_acquire_load(&mCounts[i]);
+        if (seen >= target) {
+            int64_t upperUs = bucketUpperUs(i);
+            int64_t maxValueUs = maxUs();
+            return upperUs < maxValueUs ? upperUs : maxValueUs;
+        }
+    }
+
+    return maxUs();
+}
+
+void DashPlayerHistogram::appendJSON(AString *out) const {
+    out->append(StringPrintf(
+            "{\"count\":%d,\"p50\":%lld,\"p90\":%lld,\"p99\":%lld,\"max\":%lld}",
+            count(), percentileUs(50), percentileUs(90), percentileUs(99),
+            maxUs()));
+}
+
+} // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASHPLAYER_HISTOGRAM_H_
+
+#define DASHPLAYER_HISTOGRAM_H_
+
+#include <stdint.h>
+
+namespace android {
+
+struct AString;
+
+// Log-linear histogram of microsecond values, in the style of HDR
+// histograms: every power of two is split into kSubBuckets linear
+// buckets, so any value is kept to within 1/kSubBuckets of itself from
+// 1us up to ~35 minutes. record() is lock-free and may be called from any
+// thread; readers see a snapshot that is consistent per bucket only.
+class DashPlayerHistogram {
+  public:
+    DashPlayerHistogram();
+
+    void record(int64_t valueUs);
+    void reset();
+
+    int32_t count() const;
+    int64_t maxUs() const;
+
+    // Smallest recorded bucket value that at least percent% of the
+    // samples do not exceed.
+    int64_t percentileUs(double percent) const;
+
+    // Appends {"count":..,"p50":..,"p90":..,"p99":..,"max":..}.
+    void appendJSON(AString *out) const;
+
+  private:
+    enum {
+        kSubBucketBits  = 4,
+        kSubBuckets     = 1 << kSubBucketBits,
+        // Values below kSubBuckets get a bucket each, every power of two
+        // above that up to 2^30 gets kSubBuckets.
+        kNumBuckets     = (31 - kSubBucketBits + 1) * kSubBuckets,
+    };
+
+    volatile int32_t mCounts[kNumBuckets];
+    volatile int32_t mTotal;
+    volatile int32_t mMaxUs;
+
+    static int bucketIndex(int32_t valueUs);
+    static int64_t bucketUpperUs(int index);
+
+    DashPlayerHistogram(const DashPlayerHistogram &);
+    DashPlayerHistogram &operator=(const DashPlayerHistogram &);
+};
+
+} // namespace android
+
+#endif // DASHPLAYER_HISTOGRAM_H_
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashPlayerMediaClock"
+#include <utils/Log.h>
+#include "DashPlayerMediaClock.h"
+
+namespace android {
+
+// Filter gains, tuned for one observation per audio buffer (~20-40 ms)
+// with a few ms of jitter in the sink position: the offset settles within
+// ~60 observations and the rate follows drift over tens of seconds.
+static const double kPhaseGain = 1.0 / 64;
+static const double kRateGain = 1.0 / 8192;
+static const double kIntervalGain = 1.0 / 16;
+// Sink clocks are never off by more than this.
+static const double kMaxRateDeviation = 0.001;
+// An observation this far off is a jump (underrun, resume, new sink), not
+// jitter, and re-anchors the clock.
+static const int64_t kResyncThresholdUs = 100000ll;
+
+DashPlayerMediaClock::DashPlayerMediaClock() {
+    reset();
+}
+
+DashPlayerMediaClock::~DashPlayerMediaClock() {
+}
+
+void DashPlayerMediaClock::reset() {
+    Mutex::Autolock autoLock(mLock);
+    mValid = false;
+    mPaused = false;
+    mAnchorMediaUs = -1;
+    mAnchorRealUs = -1;
+    mRate = 1.0;
+    mIntervalUs = 0;
+    mPausedMediaUs = -1;
+    mLastMediaUs = -1;
+}
+
+void DashPlayerMediaClock::anchorLocked(int64_t mediaUs, int64_t realUs) {
+    mAnchorMediaUs = mediaUs;
+    mAnchorRealUs = realUs;
+    // A re-anchor is a deliberate jump, the floor starts over.
+    mLastMediaUs = -1;
+    mValid = true;
+}
+
+double DashPlayerMediaClock::mediaTimeAtLocked(int64_t realUs) const {
+    return mAnchorMediaUs + mRate * (realUs - mAnchorRealUs);
+}
+
+void DashPlayerMediaClock::updateFromAudio(int64_t mediaUs, int64_t realUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (mPaused) {
+        return;
+    }
+
+    if (!mValid) {
+        anchorLocked(mediaUs, realUs);
+        return;
+    }
+
+    int64_t dtUs = realUs - mAnchorRealUs;
+    double predictedUs = mediaTimeAtLocked(realUs);
+    double errorUs = mediaUs - predictedUs;
+
+    if (errorUs > kResyncThresholdUs || errorUs < -kResyncThresholdUs) {
+        ALOGV("audio clock jumped by %.0f us, re-anchoring", errorUs);
+        anchorLocked(mediaUs, realUs);
+        return;
+    }
+
+    mAnchorMediaUs = predictedUs + kPhaseGain * errorUs;
+    mAnchorRealUs = realUs;
+
+    if (dtUs > 0) {
+        // The observed interval carries the jitter of the observation, and
+        // that jitter is correlated with errorUs; dividing by it would bias
+        // the rate. Divide by the smoothed interval instead.
+        if (mIntervalUs == 0) {
+            mIntervalUs = dtUs;
+        } else {
+            mIntervalUs += kIntervalGain * (dtUs - mIntervalUs);
+        }
+        mRate += kRateGain * errorUs / mIntervalUs;
+        if (mRate > 1.0 + kMaxRateDeviation) {
+            mRate = 1.0 + kMaxRateDeviation;
+        } else if (mRate < 1.0 - kMaxRateDeviation) {
+            mRate = 1.0 - kMaxRateDeviation;
+        }
+    }
+}
+
+void DashPlayerMediaClock::setAnchor(int64_t mediaUs, int64_t realUs) {
+    Mutex::Autolock autoLock(mLock);
+    anchorLocked(mediaUs, realUs);
+    mPaused = false;
+}
+
+void DashPlayerMediaClock::pause(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mValid || mPaused) {
+        return;
+    }
+
+    mPausedMediaUs = (int64_t)mediaTimeAtLocked(nowUs);
+    if (mPausedMediaUs < mLastMediaUs) {
+        mPausedMediaUs = mLastMediaUs;
+    }
+    mPaused = true;
+}
+
+void DashPlayerMediaClock::resume(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mPaused) {
+        return;
+    }
+
+    mPaused = false;
+    mAnchorMediaUs = mPausedMediaUs;
+    mAnchorRealUs = nowUs;
+}
+
+bool DashPlayerMediaClock::isValid() {
+    Mutex::Autolock autoLock(mLock);
+    return mValid;
+}
+
+int64_t DashPlayerMediaClock::getMediaTimeUs(int64_t nowUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mValid) {
+        return -1;
+    }
+
+    if (mPaused) {
+        return mPausedMediaUs;
+    }
+
+    int64_t mediaUs = (int64_t)mediaTimeAtLocked(nowUs);
+    if (mediaUs < mLastMediaUs) {
+        // A filter correction stepped back a little; hold until caught up.
+        mediaUs = mLastMediaUs;
+    }
+    mLastMediaUs = mediaUs;
+    return mediaUs;
+}
+
+int64_t DashPlayerMediaClock::getRealTimeForMediaUs(int64_t mediaUs) {
+    Mutex::Autolock autoLock(mLock);
+    if (!mValid) {
+        return -1;
+    }
+
+    return mAnchorRealUs + (int64_t)((mediaUs - mAnchorMediaUs) / mRate);
+}
+
+int32_t DashPlayerMediaClock::getDriftPpm() {
+    Mutex::Autolock autoLock(mLock);
+    return (int32_t)((mRate - 1.0) * 1E6);
+}
+
+} // namespace android
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASHPLAYER_MEDIA_CLOCK_H_
+
+#define DASHPLAYER_MEDIA_CLOCK_H_
+
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+
+namespace android {
+
+// Maps media time to ALooper::GetNowUs() real time for the renderer.
+// With audio it is slaved to the sink: every estimate of when a media
+// time reaches the speaker feeds an alpha-beta filter that tracks both
+// the offset (sink latency included) and the rate of the sink clock
+// against the system clock, so jitter in individual estimates is smoothed
+// out and drift is followed instead of accumulating. Without audio it
+// free-runs from a single anchor. Media time read from the clock never
+// goes backwards between resets.
+class DashPlayerMediaClock : public RefBase {
+  public:
+    DashPlayerMediaClock();
+
+    // Forget the anchor and the drift estimate, e.g. on a time
+    // discontinuity.
+    void reset();
+
+    // Audio observation: mediaUs is expected to be heard at realUs.
+    void updateFromAudio(int64_t mediaUs, int64_t realUs);
+
+    // Hard anchor used when there is no audio to follow.
+    void setAnchor(int64_t mediaUs, int64_t realUs);
+
+    // Freezes media time at nowUs until resume(), which continues from
+    // there.
+    void pause(int64_t nowUs);
+    void resume(int64_t nowUs);
+
+    bool isValid();
+
+    // Returns -1 if the clock has no anchor yet.
+    int64_t getMediaTimeUs(int64_t nowUs);
+    int64_t getRealTimeForMediaUs(int64_t mediaUs);
+
+    // Sink clock rate against the system clock, in parts per million.
+    int32_t getDriftPpm();
+
+  protected:
+    virtual ~DashPlayerMediaClock();
+
+  private:
+    void anchorLocked(int64_t mediaUs, int64_t realUs);
+    double mediaTimeAtLocked(int64_t realUs) const;
+
+    Mutex mLock;
+    bool mValid;
+    bool mPaused;
+    double mAnchorMediaUs;  // filtered media time at mAnchorRealUs
+    int64_t mAnchorRealUs;
+    double mRate;           // media us per real us
+    double mIntervalUs;     // smoothed real time between observations
+    int64_t mPausedMediaUs;
+    int64_t mLastMediaUs;   // floor that keeps reads monotonic
+
+    DashPlayerMediaClock(const DashPlayerMediaClock &);
+    DashPlayerMediaClock &operator=(const DashPlayerMediaClock &);
+};
+
+} // namespace android
+
+#endif // DASHPLAYER_MEDIA_CLOCK_H_
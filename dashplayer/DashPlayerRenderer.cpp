@@ -28,6 +28,10 @@ namespace android {
 
 // static
 const int64_t DashPlayer::Renderer::kMinPositionUpdateDelayUs = 100000ll;
+// static
+const int64_t DashPlayer::Renderer::kMaxLateWithoutClockUs = 40000ll;
+// static
+const int64_t DashPlayer::Renderer::kMaxTrickPlayFrameDelayUs = 1000000ll;
 
 DashPlayer::Renderer::Renderer(
         const sp<MediaPlayerBase::AudioSink> &sink,
@@ -39,8 +43,7 @@ DashPlayer::Renderer::Renderer(
       mDrainVideoQueuePending(false),
       mAudioQueueGeneration(0),
       mVideoQueueGeneration(0),
-      mAnchorTimeMediaUs(-1),
-      mAnchorTimeRealUs(-1),
+      mClock(new DashPlayerMediaClock),
       mFlushingAudio(false),
       mFlushingVideo(false),
       mHasAudio(false),
@@ -50,6 +53,12 @@ DashPlayer::Renderer::Renderer(
       mWasPaused(false),
       mLastPositionUpdateUs(-1ll),
       mVideoLateByUs(0ll),
+      mDropPolicy(new DashPlayerDefaultDropPolicy),
+      mDecodeDropMode(DashPlayerDropPolicy::kDropModeNone),
+      mVsyncScheduler(NULL),
+      mTrickPlayRate(1),
+      mTrickPlayAnchorMediaUs(-1),
+      mTrickPlayAnchorRealUs(-1),
       mStats(NULL) {
 }
 
@@ -101,11 +110,32 @@ void DashPlayer::Renderer::flush(bool audio) {
     msg->post();
 }
 
+void DashPlayer::Renderer::setDropPolicy(const sp<DashPlayerDropPolicy> &policy) {
+    Mutex::Autolock autoLock(mDropPolicyLock);
+    mDropPolicy = (policy != NULL) ? policy : new DashPlayerDefaultDropPolicy;
+}
+
+void DashPlayer::Renderer::setVsyncSource(const sp<DashPlayerVsyncSource> &source) {
+    sp<AMessage> msg = new AMessage(kWhatSetVsyncSource, id());
+    msg->setObject("source", source);
+    msg->post();
+}
+
+void DashPlayer::Renderer::setTrickPlayRate(int32_t rate) {
+    sp<AMessage> msg = new AMessage(kWhatSetTrickPlayRate, id());
+    msg->setInt32("rate", rate);
+    msg->post();
+}
+
+sp<DashPlayerDropPolicy> DashPlayer::Renderer::dropPolicy() {
+    Mutex::Autolock autoLock(mDropPolicyLock);
+    return mDropPolicy;
+}
+
 void DashPlayer::Renderer::signalTimeDiscontinuity() {
     CHECK(mAudioQueue.empty());
     CHECK(mVideoQueue.empty());
-    mAnchorTimeMediaUs = -1;
-    mAnchorTimeRealUs = -1;
+    mClock->reset();
     mWasPaused = false;
     mSyncQueues = mHasAudio && mHasVideo;
     ALOGI("signalTimeDiscontinuity mHasAudio %d mHasVideo %d mSyncQueues %d",mHasAudio,mHasVideo,mSyncQueues);
@@ -204,6 +234,26 @@ void DashPlayer::Renderer::onMessageReceived(const sp<AMessage> &msg) {
             break;
         }
 
+        case kWhatSetVsyncSource:
+        {
+            sp<RefBase> obj;
+            CHECK(msg->findObject("source", &obj));
+
+            DashPlayerVsyncSource *source =
+                static_cast<DashPlayerVsyncSource *>(obj.get());
+            mVsyncScheduler = (source != NULL)
+                ? new DashPlayerVsyncScheduler(source) : NULL;
+            break;
+        }
+
+        case kWhatSetTrickPlayRate:
+        {
+            int32_t rate;
+            CHECK(msg->findInt32("rate", &rate));
+            onSetTrickPlayRate(rate);
+            break;
+        }
+
         default:
             TRESPASS();
             break;
@@ -269,8 +319,6 @@ bool DashPlayer::Renderer::onDrainAudioQueue() {
 
             ALOGV("rendering audio at media time %.2f secs", mediaTimeUs / 1E6);
 
-            mAnchorTimeMediaUs = mediaTimeUs;
-
             uint32_t numFramesPlayed;
             CHECK_EQ(mAudioSink->getPosition(&numFramesPlayed), (status_t)OK);
 
@@ -284,8 +332,8 @@ bool DashPlayer::Renderer::onDrainAudioQueue() {
 
             // ALOGI("realTimeOffsetUs = %lld us", realTimeOffsetUs);
 
-            mAnchorTimeRealUs =
-                ALooper::GetNowUs() + realTimeOffsetUs;
+            mClock->updateFromAudio(
+                    mediaTimeUs, ALooper::GetNowUs() + realTimeOffsetUs);
         }
 
         size_t copy = entry->mBuffer->size() - entry->mOffset;
@@ -338,25 +386,47 @@ void DashPlayer::Renderer::postDrainVideoQueue() {
         int64_t mediaTimeUs;
         CHECK(entry.mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
 
-        if (mAnchorTimeMediaUs < 0) {
+        if (mTrickPlayRate != 1) {
+            int64_t nowUs = ALooper::GetNowUs();
+            delayUs = trickPlayRealTimeUs(mediaTimeUs, nowUs) - nowUs;
+        } else if (!mClock->isValid()) {
             delayUs = 0;
 
             if (!mHasAudio) {
-                mAnchorTimeMediaUs = mediaTimeUs;
-                mAnchorTimeRealUs = ALooper::GetNowUs();
+                mClock->setAnchor(mediaTimeUs, ALooper::GetNowUs());
             }
         } else {
             if ( (!mHasAudio && mHasVideo) && (mWasPaused == true))
             {
-               mAnchorTimeMediaUs = mediaTimeUs;
-               mAnchorTimeRealUs = ALooper::GetNowUs();
+               mClock->setAnchor(mediaTimeUs, ALooper::GetNowUs());
                mWasPaused = false;
             }
 
-            int64_t realTimeUs =
-                (mediaTimeUs - mAnchorTimeMediaUs) + mAnchorTimeRealUs;
-
-            delayUs = realTimeUs - ALooper::GetNowUs();
+            int64_t realTimeUs = mClock->getRealTimeForMediaUs(mediaTimeUs);
+
+            if (mVsyncScheduler != NULL) {
+                // Look one frame ahead so the scheduler can pace the
+                // cadence and spot frames that would share a refresh.
+                int64_t nextRealTimeUs = -1;
+                List<QueueEntry>::iterator it = mVideoQueue.begin();
+                if (++it != mVideoQueue.end() && (*it).mBuffer != NULL) {
+                    int64_t nextMediaTimeUs;
+                    if ((*it).mBuffer->meta()->findInt64("timeUs", &nextMediaTimeUs)) {
+                        nextRealTimeUs =
+                            mClock->getRealTimeForMediaUs(nextMediaTimeUs);
+                    }
+                }
+
+                entry.mPresentTimeUs = mVsyncScheduler->schedule(
+                        realTimeUs, nextRealTimeUs, &entry.mRedundant);
+
+                // Hand the buffer over half a refresh ahead so it is
+                // latched on the vsync it was scheduled for.
+                delayUs = entry.mPresentTimeUs
+                    - mVsyncScheduler->getPeriodUs() / 2 - ALooper::GetNowUs();
+            } else {
+                delayUs = realTimeUs - ALooper::GetNowUs();
+            }
         }
     }
 
@@ -390,20 +460,75 @@ void DashPlayer::Renderer::onDrainVideoQueue() {
     int64_t mediaTimeUs;
     CHECK(entry->mBuffer->meta()->findInt64("timeUs", &mediaTimeUs));
 
-    int64_t realTimeUs = mediaTimeUs - mAnchorTimeMediaUs + mAnchorTimeRealUs;
+    if (mTrickPlayRate != 1) {
+        // Sync frames picked by the player; each one is shown, and the
+        // position holds at it until the next.
+        int64_t nowUs = ALooper::GetNowUs();
+        mTrickPlayAnchorMediaUs = mediaTimeUs;
+        mTrickPlayAnchorRealUs = nowUs;
+        mClock->setAnchor(mediaTimeUs, nowUs);
+        mClock->pause(nowUs);
+        mVideoLateByUs = 0ll;
+
+        if(mStats != NULL) {
+            mStats->incrementTotalRenderingFrames();
+        }
+
+        entry->mNotifyConsumed->setInt32("render", true);
+        entry->mNotifyConsumed->post();
+        mVideoQueue.erase(mVideoQueue.begin());
+        entry = NULL;
+
+        notifyPosition();
+        return;
+    }
+
+    bool hasClock = mClock->isValid();
     int64_t nowUs = ALooper::GetNowUs();
+    int64_t realTimeUs =
+        hasClock ? mClock->getRealTimeForMediaUs(mediaTimeUs) : mediaTimeUs;
     mVideoLateByUs = nowUs - realTimeUs;
 
-    bool tooLate = (mVideoLateByUs > 40000);
+    bool tooLate = false;
+    DashPlayerStats::DropReason reason = DashPlayerStats::kDropReasonLate;
+    sp<DashPlayerDropPolicy> policy = dropPolicy();
+    if (hasClock) {
+        tooLate = policy->onVideoFrame(
+                mVideoLateByUs, realTimeUs - entry->mQueuedTimeUs,
+                mVideoQueue.size(), &reason);
+
+        DashPlayerDropPolicy::DropMode mode = policy->getDecodeDropMode();
+        if (mode != mDecodeDropMode) {
+            mDecodeDropMode = mode;
+            notifyDropMode(mode);
+        }
+    } else {
+        // No clock to measure against yet, nothing for the policy to learn.
+        tooLate = (mVideoLateByUs > kMaxLateWithoutClockUs);
+    }
 
     if (tooLate) {
         ALOGV("video late by %lld us (%.2f secs)",
              mVideoLateByUs, mVideoLateByUs / 1E6);
         if(mStats != NULL) {
-            mStats->recordLate(realTimeUs,nowUs,mVideoLateByUs,mAnchorTimeRealUs);
+            mStats->recordLate(realTimeUs,nowUs,mVideoLateByUs,nowUs);
+            mStats->recordDrop(reason, mediaTimeUs);
+        }
+    } else if (entry->mRedundant) {
+        ALOGV("video frame at %.2f secs shares a refresh with the next one",
+             mediaTimeUs / 1E6);
+        tooLate = true;
+        if(mStats != NULL) {
+            mStats->recordDrop(DashPlayerStats::kDropReasonCadence, mediaTimeUs);
         }
     } else {
         ALOGV("rendering video at media time %.2f secs", mediaTimeUs / 1E6);
+        if (mVsyncScheduler != NULL && entry->mPresentTimeUs >= 0) {
+            mVsyncScheduler->onFramePresented(realTimeUs, entry->mPresentTimeUs);
+            if(mStats != NULL) {
+                mStats->recordPresentationError(entry->mPresentTimeUs - realTimeUs);
+            }
+        }
         if(mStats != NULL) {
             mStats->recordOnTime(realTimeUs,nowUs,mVideoLateByUs);
             mStats->incrementTotalRenderingFrames();
@@ -441,6 +566,19 @@ void DashPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
         return;
     }
 
+    if (mTrickPlayRate != 1) {
+        // There is no audio to line video up with while scanning; what
+        // still arrives was decoded before the scan started.
+        syncQueuesDone();
+
+        if (audio) {
+            sp<AMessage> notifyConsumed;
+            CHECK(msg->findMessage("notifyConsumed", &notifyConsumed));
+            notifyConsumed->post();
+            return;
+        }
+    }
+
     sp<ABuffer> buffer;
     CHECK(msg->findBuffer("buffer", &buffer));
 
@@ -452,6 +590,9 @@ void DashPlayer::Renderer::onQueueBuffer(const sp<AMessage> &msg) {
     entry.mNotifyConsumed = notifyConsumed;
     entry.mOffset = 0;
     entry.mFinalResult = OK;
+    entry.mQueuedTimeUs = ALooper::GetNowUs();
+    entry.mPresentTimeUs = -1;
+    entry.mRedundant = false;
 
     if (audio) {
         mAudioQueue.push_back(entry);
@@ -527,6 +668,9 @@ void DashPlayer::Renderer::onQueueEOS(const sp<AMessage> &msg) {
     QueueEntry entry;
     entry.mOffset = 0;
     entry.mFinalResult = finalResult;
+    entry.mQueuedTimeUs = ALooper::GetNowUs();
+    entry.mPresentTimeUs = -1;
+    entry.mRedundant = false;
 
     if (audio) {
         mAudioQueue.push_back(entry);
@@ -570,6 +714,15 @@ void DashPlayer::Renderer::onFlush(const sp<AMessage> &msg) {
         if(mStats != NULL) {
             mStats->setVeryFirstFrame(true);
         }
+
+        dropPolicy()->reset();
+        if (mVsyncScheduler != NULL) {
+            mVsyncScheduler->reset();
+        }
+        if (mDecodeDropMode != DashPlayerDropPolicy::kDropModeNone) {
+            mDecodeDropMode = DashPlayerDropPolicy::kDropModeNone;
+            notifyDropMode(mDecodeDropMode);
+        }
     }
 
     notifyFlushComplete(audio);
@@ -588,6 +741,13 @@ void DashPlayer::Renderer::flushQueue(List<QueueEntry> *queue) {
     }
 }
 
+void DashPlayer::Renderer::notifyDropMode(DashPlayerDropPolicy::DropMode mode) {
+    sp<AMessage> notify = mNotify->dup();
+    notify->setInt32("what", kWhatDropModeChanged);
+    notify->setInt32("mode", static_cast<int32_t>(mode));
+    notify->post();
+}
+
 void DashPlayer::Renderer::notifyFlushComplete(bool audio) {
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatFlushComplete);
@@ -630,7 +790,7 @@ void DashPlayer::Renderer::onAudioSinkChanged() {
 }
 
 void DashPlayer::Renderer::notifyPosition(bool isEOS) {
-    if (mAnchorTimeRealUs < 0 || mAnchorTimeMediaUs < 0) {
+    if (!mClock->isValid()) {
         return;
     }
 
@@ -642,7 +802,7 @@ void DashPlayer::Renderer::notifyPosition(bool isEOS) {
     }
     mLastPositionUpdateUs = nowUs;
 
-    int64_t positionUs = (nowUs - mAnchorTimeRealUs) + mAnchorTimeMediaUs;
+    int64_t positionUs = mClock->getMediaTimeUs(nowUs);
 
     sp<AMessage> notify = mNotify->dup();
     notify->setInt32("what", kWhatPosition);
@@ -669,14 +829,14 @@ void DashPlayer::Renderer::onPause() {
 
     mPaused = true;
     mWasPaused = true;
+    mClock->pause(ALooper::GetNowUs());
 
     if(mStats != NULL) {
         int64_t positionUs;
-        if(mAnchorTimeRealUs < 0 || mAnchorTimeMediaUs < 0) {
+        if(!mClock->isValid()) {
             positionUs = -1000;
         } else {
-            int64_t nowUs = ALooper::GetNowUs();
-            positionUs = (nowUs - mAnchorTimeRealUs) + mAnchorTimeMediaUs;
+            positionUs = mClock->getMediaTimeUs(ALooper::GetNowUs());
         }
 
         mStats->logPause(positionUs);
@@ -693,6 +853,11 @@ void DashPlayer::Renderer::onResume() {
     }
 
     mPaused = false;
+    if (mTrickPlayRate == 1) {
+        mClock->resume(ALooper::GetNowUs());
+    } else {
+        mTrickPlayAnchorRealUs = -1;
+    }
 
     if (!mAudioQueue.empty()) {
         postDrainAudioQueue();
@@ -703,6 +868,62 @@ void DashPlayer::Renderer::onResume() {
     }
 }
 
+void DashPlayer::Renderer::onSetTrickPlayRate(int32_t rate) {
+    if (rate == mTrickPlayRate) {
+        return;
+    }
+
+    ALOGI("trick play rate %d -> %d", mTrickPlayRate, rate);
+
+    bool wasScanning = (mTrickPlayRate != 1);
+    mTrickPlayRate = rate;
+    mTrickPlayAnchorMediaUs = -1;
+    mTrickPlayAnchorRealUs = -1;
+
+    if (rate != 1 && !wasScanning) {
+        flushQueue(&mAudioQueue);
+        mDrainAudioQueuePending = false;
+        ++mAudioQueueGeneration;
+        syncQueuesDone();
+
+        if (mHasAudio && !mPaused) {
+            mAudioSink->pause();
+        }
+    } else if (rate == 1 && wasScanning) {
+        if (mHasAudio && !mPaused) {
+            mAudioSink->start();
+        }
+    }
+
+    // Retime whatever frame is already scheduled.
+    if (mDrainVideoQueuePending) {
+        mDrainVideoQueuePending = false;
+        ++mVideoQueueGeneration;
+        postDrainVideoQueue();
+    }
+}
+
+// A scanned frame is due |rate| times sooner than its media time distance
+// to the frame on screen. A frame that is already late is shown at once
+// and the cadence restarts from it, rather than bunching the following
+// frames up behind a slow seek or decode.
+int64_t DashPlayer::Renderer::trickPlayRealTimeUs(int64_t mediaTimeUs, int64_t nowUs) {
+    if (mTrickPlayAnchorRealUs < 0) {
+        return nowUs;
+    }
+
+    int64_t delayUs = (mediaTimeUs - mTrickPlayAnchorMediaUs) / mTrickPlayRate;
+    if (delayUs < 0) {
+        // Queued before a change of direction.
+        delayUs = 0;
+    } else if (delayUs > kMaxTrickPlayFrameDelayUs) {
+        delayUs = kMaxTrickPlayFrameDelayUs;
+    }
+
+    int64_t realTimeUs = mTrickPlayAnchorRealUs + delayUs;
+    return realTimeUs > nowUs ? realTimeUs : nowUs;
+}
+
 void DashPlayer::Renderer::registerStats(sp<DashPlayerStats> stats) {
     if(mStats != NULL) {
         mStats = NULL;
@@ -19,6 +19,9 @@
 #define DASHPLAYER_RENDERER_H_
 
 #include "DashPlayer.h"
+#include "DashPlayerDropPolicy.h"
+#include "DashPlayerMediaClock.h"
+#include "DashPlayerVsyncScheduler.h"
 
 namespace android {
 
@@ -60,8 +63,22 @@ struct DashPlayer::Renderer : public AHandler {
         kWhatEOS                = 'eos ',
         kWhatFlushComplete      = 'fluC',
         kWhatPosition           = 'posi',
+        kWhatDropModeChanged    = 'drpM',
     };
 
+    // Replaces the default frame drop policy.
+    void setDropPolicy(const sp<DashPlayerDropPolicy> &policy);
+
+    // Aligns video presentation to the given vsync source; NULL turns
+    // vsync alignment off, which is also the default.
+    void setVsyncSource(const sp<DashPlayerVsyncSource> &source);
+
+    // Scans at the given signed multiple of normal speed: audio is
+    // discarded and each video frame is presented |rate| times faster
+    // than its media time distance to the previous one. 1 resumes
+    // normal clocking, which the player follows with a seek.
+    void setTrickPlayRate(int32_t rate);
+
 protected:
     virtual ~Renderer();
 
@@ -77,6 +94,8 @@ private:
         kWhatAudioSinkChanged   = 'auSC',
         kWhatPause              = 'paus',
         kWhatResume             = 'resm',
+        kWhatSetVsyncSource     = 'vsyS',
+        kWhatSetTrickPlayRate   = 'trkR',
     };
 
     struct QueueEntry {
@@ -84,9 +103,14 @@ private:
         sp<AMessage> mNotifyConsumed;
         size_t mOffset;
         status_t mFinalResult;
+        int64_t mQueuedTimeUs;
+        int64_t mPresentTimeUs;
+        bool mRedundant;
     };
 
     static const int64_t kMinPositionUpdateDelayUs;
+    static const int64_t kMaxLateWithoutClockUs;
+    static const int64_t kMaxTrickPlayFrameDelayUs;
 
     sp<MediaPlayerBase::AudioSink> mAudioSink;
     sp<AMessage> mNotify;
@@ -99,8 +123,9 @@ private:
     int32_t mAudioQueueGeneration;
     int32_t mVideoQueueGeneration;
 
-    int64_t mAnchorTimeMediaUs;
-    int64_t mAnchorTimeRealUs;
+    // Media to real time mapping, slaved to the audio sink when there is
+    // audio.
+    sp<DashPlayerMediaClock> mClock;
 
     Mutex mFlushLock;  // protects the following 2 member vars.
     bool mFlushingAudio;
@@ -116,6 +141,16 @@ private:
     int64_t mLastPositionUpdateUs;
     int64_t mVideoLateByUs;
 
+    Mutex mDropPolicyLock;  // protects mDropPolicy.
+    sp<DashPlayerDropPolicy> mDropPolicy;
+    DashPlayerDropPolicy::DropMode mDecodeDropMode;
+
+    sp<DashPlayerVsyncScheduler> mVsyncScheduler;
+
+    int32_t mTrickPlayRate;
+    int64_t mTrickPlayAnchorMediaUs;
+    int64_t mTrickPlayAnchorRealUs;
+
     bool onDrainAudioQueue();
     void postDrainAudioQueue(int64_t delayUs = 0);
 
@@ -131,11 +166,15 @@ private:
     void onAudioSinkChanged();
     void onPause();
     void onResume();
+    void onSetTrickPlayRate(int32_t rate);
+    int64_t trickPlayRealTimeUs(int64_t mediaTimeUs, int64_t nowUs);
 
     void notifyEOS(bool audio, status_t finalResult);
     void notifyFlushComplete(bool audio);
     void notifyPosition(bool isEOS = false);
     void notifyVideoLateBy(int64_t lateByUs);
+    void notifyDropMode(DashPlayerDropPolicy::DropMode mode);
+    sp<DashPlayerDropPolicy> dropPolicy();
 
     void flushQueue(List<QueueEntry> *queue);
     bool dropBufferWhileFlushing(bool audio, const sp<AMessage> &msg);
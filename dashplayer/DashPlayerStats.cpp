@@ -30,6 +30,9 @@
 #include <utils/Log.h>
 #include "DashPlayerStats.h"
 
+#include <cutils/atomic.h>
+#include <media/stagefright/foundation/AString.h>
+
 #define NO_MIMETYPE_AVAILABLE "N/A"
 
 namespace android {
@@ -41,6 +44,20 @@ DashPlayerStats::DashPlayerStats() {
       mNumVideoFramesDecoded = 0;
       mNumVideoFramesDropped = 0;
       mConsecutiveFramesDropped = 0;
+      for (int i = 0; i < kDropReasonCount; ++i) {
+          mNumDropsByReason[i] = 0;
+      }
+      mNumRebuffers = 0;
+      memset(mDecodeInputs, 0, sizeof(mDecodeInputs));
+      for (int i = 0; i < kDecodeTrackSize; ++i) {
+          mDecodeInputs[i].mMediaTimeUs = -1;
+      }
+      mDecodeInputPos = 0;
+      mBufferingStartUs = -1;
+      mLastSnapshotUs = 0;
+      mNumPresentedFrames = 0;
+      mSumPresentationErrorUs = 0;
+      mMaxPresentationErrorUs = 0;
       mCatchupTimeStart = 0;
       mNumTimesSyncLoss = 0;
       mMaxEarlyDelta = 0;
@@ -107,24 +124,73 @@ void DashPlayerStats::notifySeek() {
     mSeekPerformed = true;
 }
 
+void DashPlayerStats::notifyBufferingStart() {
+    Mutex::Autolock autoLock(mStatsLock);
+    mBufferingStartUs = getTimeOfDayUs();
+}
+
 void DashPlayerStats::notifyBufferingEvent() {
     Mutex::Autolock autoLock(mStatsLock);
     mBufferingEvent = true;
+    if (mBufferingStartUs >= 0) {
+        android_atomic_inc(&mNumRebuffers);
+        mRebufferHist.record(getTimeOfDayUs() - mBufferingStartUs);
+        mBufferingStartUs = -1;
+    }
 }
 
 void DashPlayerStats::incrementTotalFrames() {
-    Mutex::Autolock autoLock(mStatsLock);
-    mTotalFrames++;
+    android_atomic_inc(&mTotalFrames);
 }
 
 void DashPlayerStats::incrementTotalRenderingFrames() {
-    Mutex::Autolock autoLock(mStatsLock);
-    mTotalRenderingFrames++;
+    android_atomic_inc(&mTotalRenderingFrames);
 }
 
 void DashPlayerStats::incrementDroppedFrames() {
+    android_atomic_inc(&mNumVideoFramesDropped);
+}
+
+void DashPlayerStats::recordDrop(DropReason reason, int64_t mediaTimeUs) {
+    if (reason < 0 || reason >= kDropReasonCount) {
+        return;
+    }
+    android_atomic_inc(&mNumDropsByReason[reason]);
+    ALOGV("dropped video frame at %lld us, reason %d", mediaTimeUs, reason);
+}
+
+void DashPlayerStats::notifyDecoderInput(int64_t mediaTimeUs) {
+    DecodeInput *input = &mDecodeInputs[mDecodeInputPos];
+    input->mMediaTimeUs = mediaTimeUs;
+    input->mInputTimeUs = getTimeOfDayUs();
+    mDecodeInputPos = (mDecodeInputPos + 1) % kDecodeTrackSize;
+}
+
+void DashPlayerStats::notifyDecoderOutput(int64_t mediaTimeUs) {
+    // Newest first: output order is close to input order.
+    for (int i = 1; i <= kDecodeTrackSize; ++i) {
+        DecodeInput *input =
+            &mDecodeInputs[(mDecodeInputPos + kDecodeTrackSize - i) % kDecodeTrackSize];
+        if (input->mMediaTimeUs == mediaTimeUs) {
+            mDecodeLatencyHist.record(getTimeOfDayUs() - input->mInputTimeUs);
+            input->mMediaTimeUs = -1;
+            return;
+        }
+    }
+}
+
+// errorUs is the distance between the vsync a frame was scheduled on and
+// its exact due time.
+void DashPlayerStats::recordPresentationError(int64_t errorUs) {
     Mutex::Autolock autoLock(mStatsLock);
-    mNumVideoFramesDropped++;
+    if (errorUs < 0) {
+        errorUs = -errorUs;
+    }
+    mNumPresentedFrames++;
+    mSumPresentationErrorUs += errorUs;
+    if (errorUs > mMaxPresentationErrorUs) {
+        mMaxPresentationErrorUs = errorUs;
+    }
 }
 
 void DashPlayerStats::logStatistics() {
@@ -132,11 +198,41 @@ void DashPlayerStats::logStatistics() {
         Mutex::Autolock autoLock(mStatsLock);
         fprintf(mFileOut, "=====================================================\n");
         fprintf(mFileOut, "Mime Type: %s\n",mMIME);
-        fprintf(mFileOut, "Number of total frames: %llu\n",mTotalFrames);
-        fprintf(mFileOut, "Number of frames dropped: %lld\n",mNumVideoFramesDropped);
-        fprintf(mFileOut, "Number of frames rendered: %llu\n",mTotalRenderingFrames);
+        int32_t totalFrames = android_atomic_acquire_load(&mTotalFrames);
+        int32_t framesDropped = android_atomic_acquire_load(&mNumVideoFramesDropped);
+        fprintf(mFileOut, "Number of total frames: %d\n",totalFrames);
+        fprintf(mFileOut, "Number of frames dropped: %d\n",framesDropped);
+        fprintf(mFileOut, "Number of frames rendered: %d\n",
+                           android_atomic_acquire_load(&mTotalRenderingFrames));
         fprintf(mFileOut, "Percentage dropped: %.2f\n",
-                           mTotalFrames == 0 ? 0.0 : (double)mNumVideoFramesDropped / mTotalFrames);
+                           totalFrames == 0 ? 0.0 : (double)framesDropped / totalFrames);
+        fprintf(mFileOut, "Dropped late at renderer: %d\n",
+                           android_atomic_acquire_load(&mNumDropsByReason[kDropReasonLate]));
+        fprintf(mFileOut, "Dropped non-reference before decode: %d\n",
+                           android_atomic_acquire_load(&mNumDropsByReason[kDropReasonNonReference]));
+        fprintf(mFileOut, "Dropped skipping to sync frame: %d\n",
+                           android_atomic_acquire_load(&mNumDropsByReason[kDropReasonSkipToSync]));
+        fprintf(mFileOut, "Dropped for vsync cadence: %d\n",
+                           android_atomic_acquire_load(&mNumDropsByReason[kDropReasonCadence]));
+        fprintf(mFileOut, "Dropped before seek target: %d\n",
+                           android_atomic_acquire_load(&mNumDropsByReason[kDropReasonSeekPreroll]));
+        fprintf(mFileOut, "Average presentation error: %lld us\n",
+                           mNumPresentedFrames == 0 ? 0 :
+                           mSumPresentationErrorUs / mNumPresentedFrames);
+        fprintf(mFileOut, "Max presentation error: %lld us\n",
+                           mMaxPresentationErrorUs);
+        fprintf(mFileOut, "Render lateness p50/p99/max: %lld/%lld/%lld us\n",
+                           mRenderLatenessHist.percentileUs(50),
+                           mRenderLatenessHist.percentileUs(99),
+                           mRenderLatenessHist.maxUs());
+        fprintf(mFileOut, "Decode latency p50/p99/max: %lld/%lld/%lld us\n",
+                           mDecodeLatencyHist.percentileUs(50),
+                           mDecodeLatencyHist.percentileUs(99),
+                           mDecodeLatencyHist.maxUs());
+        fprintf(mFileOut, "Rebuffers: %d, duration p50/max: %lld/%lld ms\n",
+                           android_atomic_acquire_load(&mNumRebuffers),
+                           mRebufferHist.percentileUs(50) / 1000,
+                           mRebufferHist.maxUs() / 1000);
         fprintf(mFileOut, "=====================================================\n");
     }
 }
@@ -160,8 +256,10 @@ void DashPlayerStats::logSeek(int64_t seekTimeUs) {
 }
 
 void DashPlayerStats::recordLate(int64_t ts, int64_t clock, int64_t delta, int64_t anchorTime) {
+    mRenderLatenessHist.record(delta);
+    android_atomic_inc(&mNumVideoFramesDropped);
+
     Mutex::Autolock autoLock(mStatsLock);
-    mNumVideoFramesDropped++;
     mConsecutiveFramesDropped++;
     if (mConsecutiveFramesDropped == 1){
       mCatchupTimeStart = anchorTime;
@@ -171,6 +269,9 @@ void DashPlayerStats::recordLate(int64_t ts, int64_t clock, int64_t delta, int64
 }
 
 void DashPlayerStats::recordOnTime(int64_t ts, int64_t clock, int64_t delta) {
+    // Early frames count as on time.
+    mRenderLatenessHist.record(delta > 0 ? delta : 0);
+
     Mutex::Autolock autoLock(mStatsLock);
     mNumVideoFramesDecoded++;
     mConsecutiveFramesDropped = 0;
@@ -193,8 +294,9 @@ void DashPlayerStats::logFps() {
     if (mFileOut) {
         Mutex::Autolock autoLock(mStatsLock);
         int64_t now = getTimeOfDayUs();
+        int32_t totalRenderingFrames = android_atomic_acquire_load(&mTotalRenderingFrames);
 
-        if(mTotalRenderingFrames < 2){
+        if(totalRenderingFrames < 2){
            mLastFrameUs = now;
            mFirstFrameTime = now;
         }
@@ -202,15 +304,15 @@ void DashPlayerStats::logFps() {
         mTotalTime = now - mFirstFrameTime;
         int64_t diff = now - mLastFrameUs;
         if (diff > 250000 && !mVeryFirstFrame && !mBufferingEvent) {
-             double fps =((mTotalRenderingFrames - mLastFrame) * 1E6)/diff;
+             double fps =((totalRenderingFrames - mLastFrame) * 1E6)/diff;
              if (mStatisticsFrames == 0) {
-                 fps =((mTotalRenderingFrames - mLastFrame - 1) * 1E6)/diff;
+                 fps =((totalRenderingFrames - mLastFrame - 1) * 1E6)/diff;
              }
              fprintf(mFileOut, "Frames per second: %.4f, Duration of measurement: %lld\n", fps,diff);
              mFPSSumUs += fps;
              ++mStatisticsFrames;
              mLastFrameUs = now;
-             mLastFrame = mTotalRenderingFrames;
+             mLastFrame = totalRenderingFrames;
          }
 
         if(mSeekPerformed) {
@@ -222,9 +324,16 @@ void DashPlayerStats::logFps() {
             mLastFrameUs = now;
         } else if(mBufferingEvent) {
             mLastFrameUs = now;
-            mLastFrame = mTotalRenderingFrames;
+            mLastFrame = totalRenderingFrames;
         }
         mBufferingEvent = false;
+
+        if (now - mLastSnapshotUs >= kSnapshotIntervalUs) {
+            AString json;
+            appendJSONLocked(&json);
+            fprintf(mFileOut, "QoE snapshot: %s\n", json.c_str());
+            mLastSnapshotUs = now;
+        }
     }
 }
 
@@ -236,12 +345,51 @@ void DashPlayerStats::logFpsSummary() {
             Mutex::Autolock autoLock(mStatsLock);
             fprintf(mFileOut, "=========================================================\n");
             fprintf(mFileOut, "Average Frames Per Second: %.4f\n", mFPSSumUs/((double)mStatisticsFrames));
-            fprintf(mFileOut, "Total Frames (rendered) / Total Time: %.4f\n", ((double)(mTotalRenderingFrames-1)*1E6)/((double)mTotalTime));
+            fprintf(mFileOut, "Total Frames (rendered) / Total Time: %.4f\n",
+                    ((double)(android_atomic_acquire_load(&mTotalRenderingFrames)-1)*1E6)/((double)mTotalTime));
             fprintf(mFileOut, "========================================================\n");
         }
     }
 }
 
+void DashPlayerStats::exportJSON(AString *out) {
+    Mutex::Autolock autoLock(mStatsLock);
+    appendJSONLocked(out);
+}
+
+static const char *kDropReasonNames[DashPlayerStats::kDropReasonCount] = {
+    "late", "non_reference", "skip_to_sync", "cadence", "seek_preroll",
+};
+
+void DashPlayerStats::appendJSONLocked(AString *out) {
+    out->append(StringPrintf(
+            "{\"time_us\":%lld,\"mime\":\"%s\",\"frames\":%d,\"rendered\":%d,"
+            "\"dropped\":%d,\"drops\":{",
+            getTimeOfDayUs(), mMIME,
+            android_atomic_acquire_load(&mTotalFrames),
+            android_atomic_acquire_load(&mTotalRenderingFrames),
+            android_atomic_acquire_load(&mNumVideoFramesDropped)));
+
+    for (int i = 0; i < kDropReasonCount; ++i) {
+        out->append(StringPrintf("%s\"%s\":%d", i == 0 ? "" : ",",
+                kDropReasonNames[i],
+                android_atomic_acquire_load(&mNumDropsByReason[i])));
+    }
+
+    out->append(StringPrintf(
+            "},\"sync_losses\":%u,\"max_sync_loss_us\":%u,\"rebuffers\":%d,"
+            "\"avg_fps\":%.2f,\"render_lateness_us\":",
+            mNumTimesSyncLoss, mMaxTimeSyncLoss,
+            android_atomic_acquire_load(&mNumRebuffers),
+            mStatisticsFrames == 0 ? 0.0 : mFPSSumUs / mStatisticsFrames));
+    mRenderLatenessHist.appendJSON(out);
+    out->append(",\"decode_latency_us\":");
+    mDecodeLatencyHist.appendJSON(out);
+    out->append(",\"rebuffer_us\":");
+    mRebufferHist.appendJSON(out);
+    out->append("}");
+}
+
 int64_t DashPlayerStats::getTimeOfDayUs() {
     struct timeval tv;
     gettimeofday(&tv, NULL);
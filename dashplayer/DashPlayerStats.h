@@ -33,19 +33,33 @@
 
 #include <utils/RefBase.h>
 #include <utils/threads.h>
+#include "DashPlayerHistogram.h"
 
 namespace android {
 
+struct AString;
+
 class DashPlayerStats : public RefBase {
   public:
     DashPlayerStats();
     ~DashPlayerStats();
 
+    enum DropReason {
+        kDropReasonLate = 0,        // too late at the renderer
+        kDropReasonNonReference,    // non-reference frame dropped before decode
+        kDropReasonSkipToSync,      // dropped while skipping to a sync frame
+        kDropReasonCadence,         // replaced by the next frame on the same vsync
+        kDropReasonSeekPreroll,     // non-reference frame before an accurate seek target
+        kDropReasonCount,
+    };
+
     void setMime(const char* mime);
     void setVeryFirstFrame(bool vff);
     void notifySeek();
     void incrementTotalFrames();
     void incrementDroppedFrames();
+    void recordDrop(DropReason reason, int64_t mediaTimeUs);
+    void recordPresentationError(int64_t errorUs);
     void logStatistics();
     void logPause(int64_t positionUs);
     void logSeek(int64_t seekTimeUs);
@@ -56,10 +70,33 @@ class DashPlayerStats : public RefBase {
     void logFpsSummary();
     static int64_t getTimeOfDayUs();
     void incrementTotalRenderingFrames();
+    void notifyBufferingStart();
     void notifyBufferingEvent();
     void setFileDescAndOutputStream(int fd);
 
+    // Decode latency is measured from the access unit being handed to
+    // the video decoder to its output buffer reaching the player, matched
+    // by media time. Both are called from the player looper only.
+    void notifyDecoderInput(int64_t mediaTimeUs);
+    void notifyDecoderOutput(int64_t mediaTimeUs);
+
+    // Machine readable snapshot of the QoE counters and histograms.
+    void exportJSON(AString *out);
+
   private:
+    enum {
+        kDecodeTrackSize = 64,  // access units in flight inside the decoder
+    };
+
+    // How often logFps() writes a JSON snapshot to the dump stream.
+    static const int64_t kSnapshotIntervalUs = 10000000ll;
+
+    struct DecodeInput {
+        int64_t mMediaTimeUs;
+        int64_t mInputTimeUs;
+    };
+
+    void appendJSONLocked(AString *out);
     void logFirstFrame();
     void logCatchUp(int64_t ts, int64_t clock, int64_t delta);
     void logLate(int64_t ts, int64_t clock, int64_t delta);
@@ -69,14 +106,28 @@ class DashPlayerStats : public RefBase {
     bool mStatistics;
     char* mMIME;
     int64_t mNumVideoFramesDecoded;
-    int64_t mNumVideoFramesDropped;
+    // Counters bumped on the decode and render paths are atomics so
+    // those paths never wait for mStatsLock.
+    volatile int32_t mNumVideoFramesDropped;
     int64_t mConsecutiveFramesDropped;
+    volatile int32_t mNumDropsByReason[kDropReasonCount];
+    volatile int32_t mNumRebuffers;
+    DashPlayerHistogram mRenderLatenessHist;
+    DashPlayerHistogram mDecodeLatencyHist;
+    DashPlayerHistogram mRebufferHist;
+    DecodeInput mDecodeInputs[kDecodeTrackSize];
+    int32_t mDecodeInputPos;
+    int64_t mBufferingStartUs;
+    int64_t mLastSnapshotUs;
+    int64_t mNumPresentedFrames;
+    int64_t mSumPresentationErrorUs;
+    int64_t mMaxPresentationErrorUs;
     uint32_t mCatchupTimeStart;
     uint32_t mNumTimesSyncLoss;
     uint32_t mMaxEarlyDelta;
     uint32_t mMaxLateDelta;
     uint32_t mMaxTimeSyncLoss;
-    uint64_t mTotalFrames;
+    volatile int32_t mTotalFrames;
     int64_t mFirstFrameLatencyStartUs;
     int64_t mLastFrame;
     int64_t mLastFrameUs;
@@ -86,7 +137,7 @@ class DashPlayerStats : public RefBase {
     bool mSeekPerformed;
     int64_t mTotalTime;
     int64_t mFirstFrameTime;
-    uint64_t mTotalRenderingFrames;
+    volatile int32_t mTotalRenderingFrames;
     bool mBufferingEvent;
     int mFd;
     FILE *mFileOut;
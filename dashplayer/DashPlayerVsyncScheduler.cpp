@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashPlayerVsyncScheduler"
+#include <utils/Log.h>
+#include "DashPlayerVsyncScheduler.h"
+
+#include <gui/DisplayEventReceiver.h>
+#include <media/stagefright/foundation/ALooper.h>
+
+namespace android {
+
+// Longest cadence (in frames) looked for when locking the grid, and how
+// far (Q16 fraction of a refresh, accumulated over the cadence) the frame
+// duration may be off from an exact multiple.
+static const int kMaxCadenceFrames = 8;
+static const int64_t kCadenceToleranceQ16 = 1311;  // ~2%
+
+DashPlayerTimerVsyncSource::DashPlayerTimerVsyncSource(int64_t periodUs)
+    : mPeriodUs(periodUs > 0 ? periodUs : kDefaultPeriodUs),
+      mEpochUs(ALooper::GetNowUs()) {
+}
+
+DashPlayerTimerVsyncSource::~DashPlayerTimerVsyncSource() {
+}
+
+status_t DashPlayerTimerVsyncSource::getVsync(int64_t *vsyncUs, int64_t *periodUs) {
+    int64_t nowUs = ALooper::GetNowUs();
+    *vsyncUs = mEpochUs + ((nowUs - mEpochUs) / mPeriodUs) * mPeriodUs;
+    *periodUs = mPeriodUs;
+    return OK;
+}
+
+// Refresh periods outside 20..125 Hz are taken as a dropped or merged
+// event rather than a real display rate.
+static const int64_t kMinDisplayPeriodUs = 8000ll;
+static const int64_t kMaxDisplayPeriodUs = 50000ll;
+static const size_t kDisplayEventBatch = 8;
+
+DashPlayerDisplayVsyncSource::DashPlayerDisplayVsyncSource()
+    : mReceiver(new DisplayEventReceiver()),
+      mLastVsyncUs(-1),
+      mLastCount(0),
+      mPeriodUs(DashPlayerTimerVsyncSource::kDefaultPeriodUs) {
+    if (mReceiver->initCheck() == NO_ERROR) {
+        // Every vsync, for as long as this source lives.
+        mReceiver->setVsyncRate(1);
+    } else {
+        ALOGE("no display event connection, vsync alignment disabled");
+    }
+}
+
+DashPlayerDisplayVsyncSource::~DashPlayerDisplayVsyncSource() {
+    if (mReceiver->initCheck() == NO_ERROR) {
+        mReceiver->setVsyncRate(0);
+    }
+    delete mReceiver;
+    mReceiver = NULL;
+}
+
+status_t DashPlayerDisplayVsyncSource::initCheck() const {
+    return mReceiver->initCheck();
+}
+
+void DashPlayerDisplayVsyncSource::drainEventsLocked() {
+    DisplayEventReceiver::Event events[kDisplayEventBatch];
+    ssize_t n;
+    while ((n = mReceiver->getEvents(events, kDisplayEventBatch)) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            if (events[i].header.type != DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+                continue;
+            }
+            // Event timestamps are CLOCK_MONOTONIC, as is ALooper::GetNowUs().
+            int64_t vsyncUs = events[i].header.timestamp / 1000ll;
+            uint32_t count = events[i].vsync.count;
+            if (mLastVsyncUs >= 0 && count > mLastCount && vsyncUs > mLastVsyncUs) {
+                int64_t periodUs = (vsyncUs - mLastVsyncUs) / (count - mLastCount);
+                if (periodUs >= kMinDisplayPeriodUs && periodUs <= kMaxDisplayPeriodUs) {
+                    mPeriodUs = (mPeriodUs * 7 + periodUs) / 8;
+                }
+            }
+            mLastVsyncUs = vsyncUs;
+            mLastCount = count;
+        }
+    }
+}
+
+status_t DashPlayerDisplayVsyncSource::getVsync(int64_t *vsyncUs, int64_t *periodUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mReceiver->initCheck() != NO_ERROR) {
+        return NO_INIT;
+    }
+
+    drainEventsLocked();
+
+    if (mLastVsyncUs < 0) {
+        // No vsync seen yet, present unaligned until one arrives.
+        return WOULD_BLOCK;
+    }
+
+    int64_t nowUs = ALooper::GetNowUs();
+    *vsyncUs = mLastVsyncUs;
+    if (nowUs > mLastVsyncUs) {
+        *vsyncUs += ((nowUs - mLastVsyncUs) / mPeriodUs) * mPeriodUs;
+    }
+    *periodUs = mPeriodUs;
+    return OK;
+}
+
+DashPlayerVsyncScheduler::DashPlayerVsyncScheduler(
+        const sp<DashPlayerVsyncSource> &source)
+    : mSource(source),
+      mPeriodUs(0) {
+    reset();
+}
+
+DashPlayerVsyncScheduler::~DashPlayerVsyncScheduler() {
+}
+
+void DashPlayerVsyncScheduler::reset() {
+    Mutex::Autolock autoLock(mLock);
+    mLocked = false;
+    mOffsetUs = 0;
+    mLastRealTimeUs = -1;
+    mLastPresentUs = -1;
+}
+
+int64_t DashPlayerVsyncScheduler::getPeriodUs() {
+    Mutex::Autolock autoLock(mLock);
+    return mPeriodUs;
+}
+
+// Nearest vsync to timeUs on the grid through vsyncUs.
+int64_t DashPlayerVsyncScheduler::snapLocked(
+        int64_t timeUs, int64_t vsyncUs, int64_t periodUs) {
+    int64_t delta = timeUs - vsyncUs + periodUs / 2;
+    int64_t n = delta / periodUs;
+    if (delta < 0 && (delta % periodUs) != 0) {
+        --n;
+    }
+    return vsyncUs + n * periodUs;
+}
+
+void DashPlayerVsyncScheduler::lockGridLocked(
+        int64_t realTimeUs, int64_t frameDurationUs,
+        int64_t vsyncUs, int64_t periodUs) {
+    // Fractional refresh advance per frame; frames then fall on q evenly
+    // spaced phases, q being the cadence length (1 for 30 fps on 60 Hz,
+    // 2 for 24 fps on 60 Hz, 5 for 25 fps on 60 Hz).
+    int64_t stepQ16 = ((frameDurationUs % periodUs) << 16) / periodUs;
+    int q = 1;
+    for (; q <= kMaxCadenceFrames; ++q) {
+        int64_t rem = (stepQ16 * q) & 0xffff;
+        if (rem < kCadenceToleranceQ16 || (0x10000 - rem) < kCadenceToleranceQ16) {
+            break;
+        }
+    }
+    if (q > kMaxCadenceFrames) {
+        q = 1;
+    }
+
+    // Place the phases as far as possible from the half-refresh rounding
+    // boundary: on the vsync for odd cadences, half a phase step off it
+    // for even ones.
+    int64_t targetPhaseUs = (q & 1) ? 0 : periodUs / (2 * q);
+
+    int64_t phaseUs = (realTimeUs - vsyncUs) % periodUs;
+    if (phaseUs < 0) {
+        phaseUs += periodUs;
+    }
+
+    mOffsetUs = targetPhaseUs - phaseUs;
+    if (mOffsetUs > periodUs / 2) {
+        mOffsetUs -= periodUs;
+    } else if (mOffsetUs <= -periodUs / 2) {
+        mOffsetUs += periodUs;
+    }
+    mLocked = true;
+
+    ALOGV("grid locked: frame %lld us, refresh %lld us, cadence %d, "
+          "offset %lld us", frameDurationUs, periodUs, q, mOffsetUs);
+}
+
+int64_t DashPlayerVsyncScheduler::schedule(
+        int64_t realTimeUs, int64_t nextRealTimeUs, bool *redundant) {
+    Mutex::Autolock autoLock(mLock);
+
+    *redundant = false;
+
+    int64_t vsyncUs, periodUs;
+    if (mSource == NULL
+            || mSource->getVsync(&vsyncUs, &periodUs) != OK
+            || periodUs <= 0) {
+        return realTimeUs;
+    }
+    mPeriodUs = periodUs;
+
+    int64_t frameDurationUs = -1;
+    if (nextRealTimeUs > realTimeUs) {
+        frameDurationUs = nextRealTimeUs - realTimeUs;
+    } else if (mLastRealTimeUs >= 0 && realTimeUs > mLastRealTimeUs) {
+        frameDurationUs = realTimeUs - mLastRealTimeUs;
+    }
+
+    if (!mLocked && frameDurationUs > 0) {
+        lockGridLocked(realTimeUs, frameDurationUs, vsyncUs, periodUs);
+    }
+
+    int64_t presentUs = snapLocked(realTimeUs + mOffsetUs, vsyncUs, periodUs);
+
+    // Never put two frames on the same refresh.
+    if (mLastPresentUs >= 0 && presentUs <= mLastPresentUs) {
+        presentUs = mLastPresentUs + periodUs;
+    }
+
+    if (nextRealTimeUs >= 0) {
+        int64_t nextPresentUs =
+            snapLocked(nextRealTimeUs + mOffsetUs, vsyncUs, periodUs);
+        *redundant = (nextPresentUs <= presentUs);
+    }
+
+    return presentUs;
+}
+
+void DashPlayerVsyncScheduler::onFramePresented(int64_t realTimeUs, int64_t vsyncUs) {
+    Mutex::Autolock autoLock(mLock);
+    mLastRealTimeUs = realTimeUs;
+    mLastPresentUs = vsyncUs;
+}
+
+} // namespace android
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASHPLAYER_VSYNC_SCHEDULER_H_
+
+#define DASHPLAYER_VSYNC_SCHEDULER_H_
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/threads.h>
+
+namespace android {
+
+class DisplayEventReceiver;
+
+// Source of display refresh timing. Times are in the ALooper::GetNowUs()
+// time base.
+class DashPlayerVsyncSource : public RefBase {
+  public:
+    DashPlayerVsyncSource() {}
+
+    // Returns the time of the most recent vsync and the refresh period.
+    virtual status_t getVsync(int64_t *vsyncUs, int64_t *periodUs) = 0;
+
+  protected:
+    virtual ~DashPlayerVsyncSource() {}
+
+  private:
+    DashPlayerVsyncSource(const DashPlayerVsyncSource &);
+    DashPlayerVsyncSource &operator=(const DashPlayerVsyncSource &);
+};
+
+// Free-running vsync grid with a fixed period, for testing the scheduler
+// on its own. It is not tied to the display and is never used by default.
+class DashPlayerTimerVsyncSource : public DashPlayerVsyncSource {
+  public:
+    DashPlayerTimerVsyncSource(int64_t periodUs = kDefaultPeriodUs);
+
+    virtual status_t getVsync(int64_t *vsyncUs, int64_t *periodUs);
+
+    static const int64_t kDefaultPeriodUs = 16667ll;
+
+  protected:
+    virtual ~DashPlayerTimerVsyncSource();
+
+  private:
+    int64_t mPeriodUs;
+    int64_t mEpochUs;
+};
+
+// Vsync timing of the primary display, read from SurfaceFlinger's
+// display event stream. Events are drained when the scheduler asks for
+// timing, so nothing wakes up between frames; the last vsync seen is
+// extrapolated to now with the measured refresh period.
+class DashPlayerDisplayVsyncSource : public DashPlayerVsyncSource {
+  public:
+    DashPlayerDisplayVsyncSource();
+
+    status_t initCheck() const;
+
+    virtual status_t getVsync(int64_t *vsyncUs, int64_t *periodUs);
+
+  protected:
+    virtual ~DashPlayerDisplayVsyncSource();
+
+  private:
+    void drainEventsLocked();
+
+    Mutex mLock;
+    DisplayEventReceiver *mReceiver;
+    int64_t mLastVsyncUs;
+    uint32_t mLastCount;
+    int64_t mPeriodUs;
+};
+
+// Snaps video render times to the vsync grid. The grid is locked to the
+// stream's cadence on the first frame after a reset so that frames land
+// away from the rounding boundary between two vsyncs, which keeps e.g.
+// 24 fps on a 60 Hz panel in a stable 3:2 pattern instead of jittering
+// between neighbouring refreshes.
+class DashPlayerVsyncScheduler : public RefBase {
+  public:
+    DashPlayerVsyncScheduler(const sp<DashPlayerVsyncSource> &source);
+
+    void reset();
+
+    // Returns the vsync the frame due at realTimeUs should be shown on,
+    // or realTimeUs itself when no vsync timing is available.
+    // nextRealTimeUs is the due time of the following frame (-1 if not
+    // queued yet); *redundant is set if both frames map to the same vsync,
+    // i.e. this one would be replaced before it is ever displayed.
+    int64_t schedule(int64_t realTimeUs, int64_t nextRealTimeUs,
+                     bool *redundant);
+
+    // Commits the vsync a frame due at realTimeUs was handed over for.
+    void onFramePresented(int64_t realTimeUs, int64_t vsyncUs);
+
+    int64_t getPeriodUs();
+
+  protected:
+    virtual ~DashPlayerVsyncScheduler();
+
+  private:
+    int64_t snapLocked(int64_t timeUs, int64_t vsyncUs, int64_t periodUs);
+    void lockGridLocked(int64_t realTimeUs, int64_t frameDurationUs,
+                        int64_t vsyncUs, int64_t periodUs);
+
+    Mutex mLock;
+    sp<DashPlayerVsyncSource> mSource;
+    bool mLocked;
+    int64_t mOffsetUs;
+    int64_t mPeriodUs;
+    int64_t mLastRealTimeUs;
+    int64_t mLastPresentUs;
+
+    DashPlayerVsyncScheduler(const DashPlayerVsyncScheduler &);
+    DashPlayerVsyncScheduler &operator=(const DashPlayerVsyncScheduler &);
+};
+
+} // namespace android
+
+#endif // DASHPLAYER_VSYNC_SCHEDULER_H_
@@ -0,0 +1,534 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashPrefetchSource"
+#include <utils/Log.h>
+
+#include "DashPrefetchSource.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+// Most access units pulled per track in one pass, so a fast source cannot
+// hold mLock for long.
+static const int kMaxUnitsPerPass = 32;
+// Pass interval when the source had nothing ready, and when every track
+// is already filled up to its target.
+static const int64_t kStarvedRetryUs = 10000ll;
+static const int64_t kFullPollUs = 50000ll;
+
+struct DashPlayer::PrefetchSource::Handler : public AHandler {
+    Handler(PrefetchSource *source)
+        : mSource(source) {
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        mSource->onMessageReceived(msg);
+    }
+
+private:
+    PrefetchSource *mSource;
+
+    DISALLOW_EVIL_CONSTRUCTORS(Handler);
+};
+
+DashPlayer::PrefetchSource::PrefetchSource(const sp<Source> &source)
+    : mSource(source),
+      mLowWatermarkUs(kDefaultLowWatermarkUs),
+      mHighWatermarkUs(kDefaultHighWatermarkUs),
+      mTargetDurationUs(kDefaultTargetDurationUs),
+      mGeneration(0),
+      mStarted(false),
+      mBuffering(false) {
+    for (int i = 0; i < kNumTracks; ++i) {
+        mTracks[i].mPassThrough = false;
+        mTracks[i].mEOS = false;
+    }
+
+    mLooper = new ALooper;
+    mLooper->setName("DashPrefetch");
+    mHandler = new Handler(this);
+    mLooper->registerHandler(mHandler);
+}
+
+DashPlayer::PrefetchSource::~PrefetchSource() {
+    mLooper->stop();
+    mLooper->unregisterHandler(mHandler->id());
+}
+
+void DashPlayer::PrefetchSource::setWatermarks(
+        int64_t lowUs, int64_t highUs, int64_t targetUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (lowUs < 0 || highUs < lowUs || targetUs < highUs) {
+        ALOGE("ignoring bad prefetch watermarks low %lld high %lld target %lld",
+              lowUs, highUs, targetUs);
+        return;
+    }
+
+    mLowWatermarkUs = lowUs;
+    mHighWatermarkUs = highUs;
+    mTargetDurationUs = targetUs;
+}
+
+status_t DashPlayer::PrefetchSource::seekWithinBuffer(
+        int64_t timeUs, bool accurate, int64_t *resumeTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    for (int track = 0; track < kNumTracks; ++track) {
+        const TrackState &state = mTracks[track];
+        if (state.mPassThrough
+                || (state.mQueue == NULL && mSource->getFormat(track) != NULL)) {
+            return ERROR_OUT_OF_RANGE;
+        }
+    }
+
+    // Look-up and drop in one call, under the queue locks, so that a
+    // failure leaves both queues as they were for the network seek.
+    int64_t syncTimeUs;
+    status_t err = DashPacketSource::seekWithinBuffers(
+            mTracks[kVideo].mQueue, mTracks[kAudio].mQueue, timeUs,
+            accurate ? DashPacketSource::kSeekPreviousSync
+                     : DashPacketSource::kSeekClosestSync,
+            &syncTimeUs);
+    if (err != OK) {
+        return err;
+    }
+
+    *resumeTimeUs = accurate ? timeUs : syncTimeUs;
+
+    ALOGI("seek to %lld us served from the prefetch buffer, resuming at %lld us",
+          timeUs, *resumeTimeUs);
+
+    if (mStarted) {
+        updateBufferingStateLocked();
+        schedulePrefetchLocked(0);
+    }
+
+    return OK;
+}
+
+void DashPlayer::PrefetchSource::start() {
+    Mutex::Autolock autoLock(mLock);
+    mSource->start();
+
+    mLooper->start();
+    mStarted = true;
+    // Buffering is only reported once a pass finds the queues below the
+    // low watermark.
+    schedulePrefetchLocked(0);
+}
+
+void DashPlayer::PrefetchSource::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        ++mGeneration;
+        mStarted = false;
+    }
+
+    mLooper->stop();
+
+    Mutex::Autolock autoLock(mLock);
+    mSource->stop();
+}
+
+status_t DashPlayer::PrefetchSource::feedMoreTSData() {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->feedMoreTSData();
+}
+
+sp<MetaData> DashPlayer::PrefetchSource::getFormat(int audio) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (audio == kVideo || audio == kAudio) {
+        const TrackState &state = mTracks[audio];
+        if (!state.mPassThrough && state.mQueue != NULL) {
+            // The format of what the decoder dequeues next.
+            sp<MetaData> format = state.mQueue->getFormat();
+            if (format != NULL) {
+                return format;
+            }
+        }
+    }
+
+    return mSource->getFormat(audio);
+}
+
+status_t DashPlayer::PrefetchSource::dequeueAccessUnit(
+        int track, sp<ABuffer> *accessUnit) {
+    sp<DashPacketSource> queue;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (track != kVideo && track != kAudio) {
+            return mSource->dequeueAccessUnit(track, accessUnit);
+        }
+
+        TrackState *state = &mTracks[track];
+        if (state->mPassThrough || state->mQueue == NULL) {
+            // Nothing has been prefetched for this track, so reading
+            // straight from the source keeps the order intact.
+            return mSource->dequeueAccessUnit(track, accessUnit);
+        }
+        queue = state->mQueue;
+    }
+
+    status_t finalResult;
+    if (!queue->hasBufferAvailable(&finalResult)) {
+        if (finalResult != OK) {
+            return finalResult;
+        }
+
+        Mutex::Autolock autoLock(mLock);
+        schedulePrefetchLocked(0);
+        return -EWOULDBLOCK;
+    }
+
+    return queue->dequeueAccessUnit(accessUnit);
+}
+
+status_t DashPlayer::PrefetchSource::getDuration(int64_t *durationUs) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->getDuration(durationUs);
+}
+
+status_t DashPlayer::PrefetchSource::seekTo(int64_t seekTimeUs) {
+    Mutex::Autolock autoLock(mLock);
+
+    status_t err = mSource->seekTo(seekTimeUs);
+    if (err != OK) {
+        return err;
+    }
+
+    // The player flushes and restarts its decoders around a seek, so the
+    // queues are simply dropped rather than fed a discontinuity; they are
+    // recreated from the source format on the next pass.
+    for (int i = 0; i < kNumTracks; ++i) {
+        mTracks[i].mQueue.clear();
+        mTracks[i].mEOS = false;
+    }
+
+    if (mStarted) {
+        schedulePrefetchLocked(0);
+    }
+
+    return OK;
+}
+
+bool DashPlayer::PrefetchSource::isSeekable() {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->isSeekable();
+}
+
+status_t DashPlayer::PrefetchSource::getNewSeekTime(int64_t* newSeek) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->getNewSeekTime(newSeek);
+}
+
+status_t DashPlayer::PrefetchSource::prepareAsync() {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->prepareAsync();
+}
+
+bool DashPlayer::PrefetchSource::isPrepareDone() {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->isPrepareDone();
+}
+
+status_t DashPlayer::PrefetchSource::getParameter(int key, void **data, size_t *size) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->getParameter(key, data, size);
+}
+
+status_t DashPlayer::PrefetchSource::setParameter(int key, void *data, size_t size) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->setParameter(key, data, size);
+}
+
+void DashPlayer::PrefetchSource::notifyRenderingPosition(int64_t nRenderingTS) {
+    Mutex::Autolock autoLock(mLock);
+    mSource->notifyRenderingPosition(nRenderingTS);
+}
+
+status_t DashPlayer::PrefetchSource::setupSourceData(const sp<AMessage> &msg, int iTrack) {
+    Mutex::Autolock autoLock(mLock);
+    if (iTrack == kTrackAll) {
+        mNotify = msg;
+    }
+    return mSource->setupSourceData(msg, iTrack);
+}
+
+status_t DashPlayer::PrefetchSource::postNextTextSample(
+        sp<ABuffer> accessUnit, const sp<AMessage> &msg, int iTrack) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->postNextTextSample(accessUnit, msg, iTrack);
+}
+
+status_t DashPlayer::PrefetchSource::getMediaPresence(bool &audio, bool &video, bool &text) {
+    Mutex::Autolock autoLock(mLock);
+    return mSource->getMediaPresence(audio, video, text);
+}
+
+void DashPlayer::PrefetchSource::pause() {
+    Mutex::Autolock autoLock(mLock);
+    mSource->pause();
+}
+
+void DashPlayer::PrefetchSource::resume() {
+    Mutex::Autolock autoLock(mLock);
+    mSource->resume();
+}
+
+void DashPlayer::PrefetchSource::onMessageReceived(const sp<AMessage> &msg) {
+    switch (msg->what()) {
+        case kWhatPrefetch:
+        {
+            int32_t generation;
+            CHECK(msg->findInt32("generation", &generation));
+
+            Mutex::Autolock autoLock(mLock);
+            if (generation != mGeneration || !mStarted) {
+                break;
+            }
+
+            onPrefetch();
+            break;
+        }
+
+        default:
+            TRESPASS();
+            break;
+    }
+}
+
+// Called with mLock held.
+void DashPlayer::PrefetchSource::onPrefetch() {
+    bool starved = false;
+    bool full = true;
+
+    for (int track = 0; track < kNumTracks; ++track) {
+        TrackState *state = &mTracks[track];
+
+        if (state->mQueue == NULL && !state->mPassThrough) {
+            sp<MetaData> meta = mSource->getFormat(track);
+            if (meta == NULL) {
+                continue;
+            }
+
+            int32_t secure = 0;
+            if (meta->findInt32(kKeyRequiresSecureBuffers, &secure) && secure) {
+                // The decoder hands its own secure buffer to the source.
+                ALOGI("%s track uses secure buffers, not prefetching",
+                      track == kAudio ? "audio" : "video");
+                state->mPassThrough = true;
+                continue;
+            }
+
+            state->mQueue = new DashPacketSource(meta);
+        }
+
+        if (state->mPassThrough || state->mEOS) {
+            continue;
+        }
+
+        if (!prefetchTrackLocked(track, state)) {
+            starved = true;
+        }
+
+        if (state->mQueue == NULL) {
+            // Dropped by a seek while the lock was released.
+            continue;
+        }
+
+        status_t finalResult;
+        if (state->mQueue->getBufferedDurationUs(&finalResult) < mTargetDurationUs
+                && finalResult == OK) {
+            full = false;
+        }
+    }
+
+    updateBufferingStateLocked();
+
+    int64_t delayUs = 0;
+    if (starved) {
+        mSource->feedMoreTSData();
+        delayUs = kStarvedRetryUs;
+    } else if (full) {
+        delayUs = kFullPollUs;
+    }
+    schedulePrefetchLocked(delayUs);
+}
+
+// Returns false if the source had nothing ready for this track.
+bool DashPlayer::PrefetchSource::prefetchTrackLocked(int track, TrackState *state) {
+    for (int n = 0; n < kMaxUnitsPerPass; ++n) {
+        status_t finalResult;
+        if (state->mQueue->getBufferedDurationUs(&finalResult) >= mTargetDurationUs) {
+            break;
+        }
+
+        sp<ABuffer> accessUnit;
+        status_t err = mSource->dequeueAccessUnit(track, &accessUnit);
+
+        if (err == -EWOULDBLOCK) {
+            return false;
+        } else if (err == INFO_DISCONTINUITY) {
+            int32_t type;
+            CHECK(accessUnit->meta()->findInt32("discontinuity", &type));
+
+            sp<AMessage> extra;
+            accessUnit->meta()->findMessage("extra", &extra);
+
+            // The source has switched to the new format by now; it goes
+            // with the marker so the player sees it only when it gets
+            // there.
+            sp<MetaData> format;
+            int32_t formatChange = (track == kAudio)
+                ? ATSParser::DISCONTINUITY_AUDIO_FORMAT
+                : ATSParser::DISCONTINUITY_VIDEO_FORMAT;
+            if (type & formatChange) {
+                format = mSource->getFormat(track);
+            }
+
+            // The source already dropped what the discontinuity flushes;
+            // just keep the marker in order for the decoder.
+            enqueueUnlocked(state, err, accessUnit, type, extra, format);
+        } else if (err != OK) {
+            ALOGV("%s prefetch reached end of stream (%d)",
+                  track == kAudio ? "audio" : "video", err);
+            state->mEOS = true;
+            enqueueUnlocked(state, err, NULL, 0, NULL, NULL);
+            break;
+        } else {
+            enqueueUnlocked(state, err, accessUnit, 0, NULL, NULL);
+        }
+
+        if (!mStarted || state->mQueue == NULL) {
+            break;
+        }
+    }
+
+    return true;
+}
+
+// Called with mLock held, which is dropped while the entry is queued so
+// the decoders and control calls are not held up behind the queue. A
+// queue dropped by seekTo meanwhile is simply not read any more.
+void DashPlayer::PrefetchSource::enqueueUnlocked(
+        TrackState *state, status_t err, const sp<ABuffer> &accessUnit,
+        int32_t discontinuityType, const sp<AMessage> &extra,
+        const sp<MetaData> &format) {
+    sp<DashPacketSource> queue = state->mQueue;
+
+    mLock.unlock();
+    if (err == INFO_DISCONTINUITY) {
+        queue->queueDiscontinuity(
+                static_cast<ATSParser::DiscontinuityType>(discontinuityType),
+                extra, false /* discard */, format);
+    } else if (err != OK) {
+        queue->signalEOS(err);
+    } else {
+        queue->queueAccessUnit(accessUnit);
+    }
+    mLock.lock();
+}
+
+void DashPlayer::PrefetchSource::schedulePrefetchLocked(int64_t delayUs) {
+    // Only the most recently scheduled pass runs.
+    sp<AMessage> msg = new AMessage(kWhatPrefetch, mHandler->id());
+    msg->setInt32("generation", ++mGeneration);
+    msg->post(delayUs);
+}
+
+void DashPlayer::PrefetchSource::updateBufferingStateLocked() {
+    bool haveTrack = false;
+    int64_t minBufferedUs = -1;
+
+    for (int track = 0; track < kNumTracks; ++track) {
+        const TrackState &state = mTracks[track];
+        if (state.mQueue == NULL || state.mPassThrough) {
+            continue;
+        }
+
+        status_t finalResult;
+        int64_t bufferedUs = state.mQueue->getBufferedDurationUs(&finalResult);
+        if (finalResult != OK) {
+            // Nothing more is coming, this track cannot hold playback up.
+            continue;
+        }
+
+        if (!haveTrack || bufferedUs < minBufferedUs) {
+            minBufferedUs = bufferedUs;
+        }
+        haveTrack = true;
+    }
+
+    if (!haveTrack) {
+        if (mBuffering) {
+            notifyBufferingLocked(kWhatBufferingEnd);
+        }
+        return;
+    }
+
+    if (!mBuffering && minBufferedUs < mLowWatermarkUs) {
+        notifyBufferingLocked(kWhatBufferingStart);
+    } else if (mBuffering && minBufferedUs >= mHighWatermarkUs) {
+        notifyBufferingLocked(kWhatBufferingEnd);
+    }
+}
+
+void DashPlayer::PrefetchSource::notifyBufferingLocked(int32_t what) {
+    mBuffering = (what == kWhatBufferingStart);
+
+    if (mNotify == NULL) {
+        return;
+    }
+
+    ALOGV("prefetch buffering %s", mBuffering ? "start" : "end");
+
+    sp<AMessage> sourceRequest = new AMessage;
+    sourceRequest->setInt32("what", what);
+    sourceRequest->setInt64("track", kTrackAll);
+    sourceRequest->setInt32("prefetch", 1);
+
+    // A message of our own: the wrapped source may have left its fields
+    // on mNotify.
+    sp<AMessage> notify = new AMessage(mNotify->what(), mNotify->target());
+    notify->setMessage("source-request", sourceRequest);
+    notify->post();
+}
+
+}  // namespace android
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASH_PREFETCH_SOURCE_H_
+
+#define DASH_PREFETCH_SOURCE_H_
+
+#include "DashPlayerSource.h"
+#include "DashPacketSource.h"
+
+#include <media/stagefright/foundation/AHandler.h>
+
+namespace android {
+
+struct ALooper;
+
+// Wraps another source and pulls its audio and video access units on a
+// worker looper, ahead of the decoders, into per-track DashPacketSource
+// queues. Buffering start/end is raised from low/high watermarks on the
+// buffered duration, tagged "prefetch" so the player can tell it from the
+// wrapped source's own buffering events. Tracks that need secure input
+// buffers, and the text track, are passed straight through.
+//
+// getFormat() follows the queues: a format change reaches the player
+// with the discontinuity it was queued with, not when the wrapped source,
+// which runs ahead, moves on.
+struct DashPlayer::PrefetchSource : public DashPlayer::Source {
+    PrefetchSource(const sp<Source> &source);
+
+    // lowUs:    buffering starts when a track drops below this
+    // highUs:   buffering ends once every track is back above this
+    // targetUs: how far ahead of the decoder each track is filled
+    void setWatermarks(int64_t lowUs, int64_t highUs, int64_t targetUs);
+
+    // Repositions the prefetched queues at timeUs without going back to
+    // the wrapped source. Video resumes from the previous sync sample
+    // when accurate is set, or else from the closest one, which audio
+    // then follows. *resumeTimeUs is the first media time to render.
+    // Fails, leaving the queues alone, unless every track has the
+    // position buffered. Tracks passed straight through (secure buffers,
+    // in-place input) have no queue, so any such track makes it fail.
+    status_t seekWithinBuffer(int64_t timeUs, bool accurate, int64_t *resumeTimeUs);
+
+    virtual void start();
+    virtual void stop();
+
+    virtual status_t feedMoreTSData();
+
+    virtual sp<MetaData> getFormat(int audio);
+
+    virtual status_t dequeueAccessUnit(
+            int track, sp<ABuffer> *accessUnit);
+
+    virtual status_t getDuration(int64_t *durationUs);
+    virtual status_t seekTo(int64_t seekTimeUs);
+    virtual bool isSeekable();
+    virtual status_t getNewSeekTime(int64_t* newSeek);
+    virtual status_t prepareAsync();
+    virtual bool isPrepareDone();
+    virtual status_t getParameter(int key, void **data, size_t *size);
+    virtual status_t setParameter(int key, void *data, size_t size);
+    virtual void notifyRenderingPosition(int64_t nRenderingTS);
+    virtual status_t setupSourceData(const sp<AMessage> &msg, int iTrack);
+    virtual status_t postNextTextSample(sp<ABuffer> accessUnit,const sp<AMessage> &msg,int iTrack);
+    virtual status_t getMediaPresence(bool &audio, bool &video, bool &text);
+    virtual void pause();
+    virtual void resume();
+
+    static const int64_t kDefaultLowWatermarkUs = 1000000ll;
+    static const int64_t kDefaultHighWatermarkUs = 3000000ll;
+    static const int64_t kDefaultTargetDurationUs = 5000000ll;
+
+protected:
+    virtual ~PrefetchSource();
+
+private:
+    struct Handler;
+
+    enum {
+        kWhatPrefetch           = 'pftc',
+    };
+
+    enum {
+        kNumTracks              = 2,    // kVideo and kAudio
+    };
+
+    struct TrackState {
+        sp<DashPacketSource> mQueue;
+        bool mPassThrough;
+        bool mEOS;
+    };
+
+    // Serializes all calls into mSource and the track state. It is not
+    // held while feeding the queues, and the decoders consume from the
+    // queues without it.
+    Mutex mLock;
+    sp<Source> mSource;
+    sp<ALooper> mLooper;
+    sp<Handler> mHandler;
+    sp<AMessage> mNotify;
+
+    TrackState mTracks[kNumTracks];
+    int64_t mLowWatermarkUs;
+    int64_t mHighWatermarkUs;
+    int64_t mTargetDurationUs;
+    int32_t mGeneration;
+    bool mStarted;
+    bool mBuffering;
+
+    void onMessageReceived(const sp<AMessage> &msg);
+    void onPrefetch();
+    bool prefetchTrackLocked(int track, TrackState *state);
+    void enqueueUnlocked(
+            TrackState *state, status_t err, const sp<ABuffer> &accessUnit,
+            int32_t discontinuityType, const sp<AMessage> &extra,
+            const sp<MetaData> &format);
+    void schedulePrefetchLocked(int64_t delayUs);
+    void updateBufferingStateLocked();
+    void notifyBufferingLocked(int32_t what);
+
+    DISALLOW_EVIL_CONSTRUCTORS(PrefetchSource);
+};
+
+}  // namespace android
+
+#endif  // DASH_PREFETCH_SOURCE_H_
@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "DashLocalFileSource"
+#include <utils/Log.h>
+
+#include "DashLocalFileSource.h"
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+
+namespace android {
+
+DashPlayer::LocalFileSource::LocalFileSource(
+        int fd, int64_t offset, int64_t length)
+    : mInitCheck(NO_INIT),
+      mDurationUs(-1ll) {
+    for (int i = 0; i < 2; ++i) {
+        mTracks[i].mStarted = false;
+        mTracks[i].mEOS = false;
+        mTracks[i].mPendingSeek = false;
+        mTracks[i].mSeekTimeUs = 0;
+    }
+
+    sp<DataSource> dataSource = new FileSource(dup(fd), offset, length);
+    if (dataSource->initCheck() != OK) {
+        ALOGE("cannot open fd %d", fd);
+        return;
+    }
+
+    sp<MediaExtractor> extractor = MediaExtractor::Create(dataSource);
+    if (extractor == NULL) {
+        ALOGE("no extractor for fd %d", fd);
+        mInitCheck = ERROR_UNSUPPORTED;
+        return;
+    }
+
+    for (size_t i = 0; i < extractor->countTracks(); ++i) {
+        sp<MetaData> meta = extractor->getTrackMetaData(i);
+
+        const char *mime;
+        CHECK(meta->findCString(kKeyMIMEType, &mime));
+
+        int track;
+        if (!strncasecmp(mime, "audio/", 6)) {
+            track = kAudio;
+        } else if (!strncasecmp(mime, "video/", 6)) {
+            track = kVideo;
+        } else {
+            continue;
+        }
+
+        if (mTracks[track].mSource != NULL) {
+            continue;
+        }
+
+        mTracks[track].mSource = extractor->getTrack(i);
+
+        int64_t durationUs;
+        if (meta->findInt64(kKeyDuration, &durationUs)
+                && durationUs > mDurationUs) {
+            mDurationUs = durationUs;
+        }
+    }
+
+    if (mTracks[kAudio].mSource == NULL && mTracks[kVideo].mSource == NULL) {
+        ALOGE("no audio or video track in fd %d", fd);
+        mInitCheck = ERROR_UNSUPPORTED;
+        return;
+    }
+
+    mInitCheck = OK;
+}
+
+DashPlayer::LocalFileSource::~LocalFileSource() {
+    for (int i = 0; i < 2; ++i) {
+        if (mTracks[i].mStarted) {
+            mTracks[i].mSource->stop();
+        }
+    }
+}
+
+status_t DashPlayer::LocalFileSource::initCheck() const {
+    return mInitCheck;
+}
+
+void DashPlayer::LocalFileSource::start() {
+    for (int i = 0; i < 2; ++i) {
+        if (mTracks[i].mSource != NULL && !mTracks[i].mStarted) {
+            CHECK_EQ(mTracks[i].mSource->start(), (status_t)OK);
+            mTracks[i].mStarted = true;
+        }
+    }
+}
+
+status_t DashPlayer::LocalFileSource::feedMoreTSData() {
+    // Reads are synchronous, there is nothing to feed.
+    return OK;
+}
+
+sp<MetaData> DashPlayer::LocalFileSource::getFormat(int audio) {
+    if (audio != kVideo && audio != kAudio) {
+        return NULL;
+    }
+
+    const sp<MediaSource> &source = mTracks[audio].mSource;
+    return source == NULL ? NULL : source->getFormat();
+}
+
+status_t DashPlayer::LocalFileSource::dequeueAccessUnit(
+        int track, sp<ABuffer> *accessUnit) {
+    if (track != kVideo && track != kAudio) {
+        return -EWOULDBLOCK;
+    }
+
+    Track *t = &mTracks[track];
+    if (t->mSource == NULL) {
+        return -EWOULDBLOCK;
+    }
+
+    MediaSource::ReadOptions options;
+    if (t->mPendingSeek) {
+        options.setSeekTo(
+                t->mSeekTimeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        t->mPendingSeek = false;
+        t->mEOS = false;
+    }
+
+    if (t->mEOS) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    MediaBuffer *mbuf;
+    status_t err = t->mSource->read(&mbuf, &options);
+
+    if (err == INFO_FORMAT_CHANGED) {
+        // The new format is picked up through getFormat().
+        return -EWOULDBLOCK;
+    } else if (err != OK) {
+        t->mEOS = true;
+        return err;
+    }
+
+    sp<ABuffer> buffer = new ABuffer(mbuf->range_length());
+    memcpy(buffer->data(),
+           (const uint8_t *)mbuf->data() + mbuf->range_offset(),
+           mbuf->range_length());
+
+    int64_t timeUs;
+    CHECK(mbuf->meta_data()->findInt64(kKeyTime, &timeUs));
+    buffer->meta()->setInt64("timeUs", timeUs);
+
+    int32_t isSync;
+    if (mbuf->meta_data()->findInt32(kKeyIsSyncFrame, &isSync)) {
+        buffer->meta()->setInt32("isSync", isSync);
+    }
+
+    mbuf->release();
+    mbuf = NULL;
+
+    *accessUnit = buffer;
+    return OK;
+}
+
+status_t DashPlayer::LocalFileSource::getDuration(int64_t *durationUs) {
+    if (mDurationUs < 0) {
+        return INVALID_OPERATION;
+    }
+
+    *durationUs = mDurationUs;
+    return OK;
+}
+
+status_t DashPlayer::LocalFileSource::seekTo(int64_t seekTimeUs) {
+    // Applied on the next read of each track.
+    for (int i = 0; i < 2; ++i) {
+        if (mTracks[i].mSource != NULL) {
+            mTracks[i].mPendingSeek = true;
+            mTracks[i].mSeekTimeUs = seekTimeUs;
+        }
+    }
+
+    return OK;
+}
+
+bool DashPlayer::LocalFileSource::isSeekable() {
+    return true;
+}
+
+status_t DashPlayer::LocalFileSource::prepareAsync() {
+    return mInitCheck;
+}
+
+bool DashPlayer::LocalFileSource::isPrepareDone() {
+    return true;
+}
+
+status_t DashPlayer::LocalFileSource::getMediaPresence(
+        bool &audio, bool &video, bool &text) {
+    audio = mTracks[kAudio].mSource != NULL;
+    video = mTracks[kVideo].mSource != NULL;
+    text = false;
+    return OK;
+}
+
+}  // namespace android
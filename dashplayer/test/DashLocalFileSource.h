@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DASH_LOCAL_FILE_SOURCE_H_
+
+#define DASH_LOCAL_FILE_SOURCE_H_
+
+#include "DashPlayerSource.h"
+
+#include <media/stagefright/MediaSource.h>
+
+namespace android {
+
+// Reads a local file through MediaExtractor. It is not part of the
+// player: dashplayer-prefetch-test runs the prefetch stage over it in
+// place of a network source.
+struct DashPlayer::LocalFileSource : public DashPlayer::Source {
+    LocalFileSource(int fd, int64_t offset, int64_t length);
+
+    status_t initCheck() const;
+
+    virtual void start();
+
+    virtual status_t feedMoreTSData();
+
+    virtual sp<MetaData> getFormat(int audio);
+
+    virtual status_t dequeueAccessUnit(
+            int track, sp<ABuffer> *accessUnit);
+
+    virtual status_t getDuration(int64_t *durationUs);
+    virtual status_t seekTo(int64_t seekTimeUs);
+    virtual bool isSeekable();
+    virtual status_t prepareAsync();
+    virtual bool isPrepareDone();
+    virtual status_t getMediaPresence(bool &audio, bool &video, bool &text);
+
+protected:
+    virtual ~LocalFileSource();
+
+private:
+    struct Track {
+        sp<MediaSource> mSource;
+        bool mStarted;
+        bool mEOS;
+        bool mPendingSeek;
+        int64_t mSeekTimeUs;
+    };
+
+    status_t mInitCheck;
+    Track mTracks[2];   // indexed by kVideo and kAudio
+    int64_t mDurationUs;
+
+    DISALLOW_EVIL_CONSTRUCTORS(LocalFileSource);
+};
+
+}  // namespace android
+
+#endif  // DASH_LOCAL_FILE_SOURCE_H_
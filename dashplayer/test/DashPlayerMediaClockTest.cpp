@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Media clock test: feeds DashPlayerMediaClock the audio observations of
+ * a simulated sink whose clock drifts against the system clock, with
+ * jitter on every playout estimate, and checks that the clock tracks the
+ * true playout position, estimates the drift, re-anchors on a jump, never
+ * reads backwards, and holds still while paused.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DashPlayerMediaClock.h"
+
+using namespace android;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+// One observation per 1024 sample AAC buffer at 44.1 kHz.
+static const int64_t kBufferUs = 23220ll;
+static const int64_t kStartRealUs = 1000000000ll;
+
+static uint32_t gSeed = 1;
+
+// Uniform in [-maxUs, maxUs].
+static int64_t jitter(int64_t maxUs) {
+    if (maxUs == 0) {
+        return 0;
+    }
+    // xorshift32
+    gSeed ^= gSeed << 13;
+    gSeed ^= gSeed >> 17;
+    gSeed ^= gSeed << 5;
+    return (int64_t)(gSeed % (uint32_t)(2 * maxUs + 1)) - maxUs;
+}
+
+// Sink playing media time 0 at kStartRealUs, at 1 + ppm/1e6 media us per
+// real us.
+static int64_t truePlayoutUs(int64_t realUs, int32_t ppm) {
+    int64_t elapsedUs = realUs - kStartRealUs;
+    return elapsedUs + elapsedUs * ppm / 1000000ll;
+}
+
+struct TrackResult {
+    int64_t maxErrorUs;     // once settled
+    int32_t driftPpm;       // mean estimate once settled
+    int backwards;          // reads below the previous one
+};
+
+// Runs durationUs of playback. The clock is read between observations,
+// as the renderer does; errors and the drift estimate count from settleUs
+// on. Single drift readings wander by ~100 ppm with this much jitter, so
+// the mean is what gets checked.
+static TrackResult track(const sp<DashPlayerMediaClock> &clock, int32_t ppm,
+                         int64_t jitterUs, int64_t durationUs, int64_t settleUs) {
+    TrackResult result = { 0, 0, 0 };
+    int64_t lastReadUs = -1;
+    int64_t driftSum = 0;
+    int64_t driftCount = 0;
+
+    for (int64_t realUs = kStartRealUs; realUs < kStartRealUs + durationUs;
+            realUs += kBufferUs) {
+        clock->updateFromAudio(truePlayoutUs(realUs, ppm), realUs + jitter(jitterUs));
+
+        int64_t readRealUs = realUs + kBufferUs / 2;
+        int64_t mediaUs = clock->getMediaTimeUs(readRealUs);
+        if (mediaUs < lastReadUs) {
+            ++result.backwards;
+        }
+        lastReadUs = mediaUs;
+
+        if (realUs - kStartRealUs >= settleUs) {
+            int64_t errorUs = mediaUs - truePlayoutUs(readRealUs, ppm);
+            if (errorUs < 0) {
+                errorUs = -errorUs;
+            }
+            if (errorUs > result.maxErrorUs) {
+                result.maxErrorUs = errorUs;
+            }
+            driftSum += clock->getDriftPpm();
+            ++driftCount;
+        }
+    }
+
+    result.driftPpm = driftCount ? (int32_t)(driftSum / driftCount)
+                                 : clock->getDriftPpm();
+    return result;
+}
+
+static void testTracking() {
+    static const int32_t kDrifts[] = { 0, 300, -300 };
+
+    for (size_t i = 0; i < sizeof(kDrifts) / sizeof(kDrifts[0]); ++i) {
+        int32_t ppm = kDrifts[i];
+        sp<DashPlayerMediaClock> clock = new DashPlayerMediaClock();
+        TrackResult r = track(clock, ppm, 3000, 120000000ll, 30000000ll);
+
+        printf("%+4d ppm sink, +-3 ms jitter: max error %lld us, "
+               "mean drift estimate %+d ppm\n", ppm, (long long)r.maxErrorUs, r.driftPpm);
+
+        CHECK(r.maxErrorUs < 1000, "%+d ppm: tracked to %lld us", ppm,
+              (long long)r.maxErrorUs);
+        CHECK(r.driftPpm > ppm - 20 && r.driftPpm < ppm + 20,
+              "%+d ppm: drift estimated as %+d ppm", ppm, r.driftPpm);
+        CHECK(r.backwards == 0, "%+d ppm: media time read backwards %d times",
+              ppm, r.backwards);
+    }
+}
+
+// A sink further off than the filter may follow is clamped, not chased.
+static void testRateClamp() {
+    sp<DashPlayerMediaClock> clock = new DashPlayerMediaClock();
+    TrackResult r = track(clock, 5000, 0, 60000000ll, 0);
+    CHECK(r.driftPpm <= 1000, "rate followed a 5000 ppm sink to %+d ppm",
+          r.driftPpm);
+}
+
+// An observation far off the prediction is an underrun or a new sink,
+// and the clock jumps to it instead of slewing.
+static void testResync() {
+    sp<DashPlayerMediaClock> clock = new DashPlayerMediaClock();
+    track(clock, 0, 0, 5000000ll, 0);
+
+    int64_t realUs = kStartRealUs + 5000000ll;
+    int64_t mediaUs = truePlayoutUs(realUs, 0) + 500000ll;
+    clock->updateFromAudio(mediaUs, realUs);
+
+    int64_t readUs = clock->getMediaTimeUs(realUs);
+    CHECK(readUs >= mediaUs - 1000 && readUs <= mediaUs + 1000,
+          "500 ms jump read as %lld us, expected %lld us",
+          (long long)readUs, (long long)mediaUs);
+}
+
+static void testPause() {
+    sp<DashPlayerMediaClock> clock = new DashPlayerMediaClock();
+    track(clock, 0, 0, 2000000ll, 0);
+
+    int64_t pauseUs = kStartRealUs + 2000000ll;
+    clock->pause(pauseUs);
+    int64_t pausedMediaUs = clock->getMediaTimeUs(pauseUs);
+
+    // Observations while paused must not move the clock.
+    clock->updateFromAudio(truePlayoutUs(pauseUs + 1000000ll, 0), pauseUs + 1000000ll);
+    CHECK(clock->getMediaTimeUs(pauseUs + 3000000ll) == pausedMediaUs,
+          "media time moved while paused");
+
+    int64_t resumeUs = pauseUs + 3000000ll;
+    clock->resume(resumeUs);
+    int64_t mediaUs = clock->getMediaTimeUs(resumeUs + 100000ll);
+    CHECK(mediaUs >= pausedMediaUs + 99000 && mediaUs <= pausedMediaUs + 101000,
+          "100 ms after resume read %lld us past the pause point",
+          (long long)(mediaUs - pausedMediaUs));
+}
+
+int main(int argc, char **argv) {
+    testTracking();
+    testRateClamp();
+    testResync();
+    testPause();
+
+    if (failures) {
+        printf("dashplayer-clock-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("dashplayer-clock-test: all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Vsync scheduler test: plays 24/25/30/50/60/120 fps streams against a
+ * simulated 60 Hz display, with the render anchor jittering from frame to
+ * frame the way it does when it follows the audio clock, and checks that
+ * every frame lands on a vsync, none shares a refresh, and the refresh
+ * pattern is the stream's steady cadence (2:3 for 24 fps, 2:3:2:3:2 for
+ * 25 fps, ...).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DashPlayerVsyncScheduler.h"
+
+using namespace android;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static const int64_t kPeriodUs = 16667ll;
+static const int64_t kEpochUs = 1003210ll;
+static const int kNumFrames = 600;
+static const int kNumPhases = 16;
+
+// Display with a fixed refresh, read at a time the test controls.
+struct SimVsyncSource : public DashPlayerVsyncSource {
+    SimVsyncSource() : mNowUs(0), mValid(true) {}
+
+    virtual status_t getVsync(int64_t *vsyncUs, int64_t *periodUs) {
+        if (!mValid) {
+            return NO_INIT;
+        }
+        *vsyncUs = kEpochUs + ((mNowUs - kEpochUs) / kPeriodUs) * kPeriodUs;
+        *periodUs = kPeriodUs;
+        return OK;
+    }
+
+    int64_t mNowUs;
+    bool mValid;
+};
+
+static uint32_t gSeed = 1;
+
+// Uniform in [-maxUs, maxUs].
+static int64_t jitter(int64_t maxUs) {
+    gSeed = gSeed * 1103515245u + 12345u;
+    return (int64_t)((gSeed >> 8) % (uint32_t)(2 * maxUs + 1)) - maxUs;
+}
+
+// Plays one stream whose anchor sits phaseUs past a vsync. refreshes is
+// the number of vsyncs per cadence of cadenceFrames presented frames.
+static void playCadence(int fps, int64_t phaseUs, int64_t jitterUs,
+                        int cadenceFrames, int refreshes, int keepEvery) {
+    sp<SimVsyncSource> source = new SimVsyncSource();
+    sp<DashPlayerVsyncScheduler> scheduler = new DashPlayerVsyncScheduler(source);
+
+    int64_t frameUs = 1000000ll / fps;
+    int64_t anchorUs = kEpochUs + 300 * kPeriodUs + phaseUs;
+    int64_t lastPresentUs = -1;
+    int64_t maxErrorUs = 0;
+    int presented = 0;
+    int redundant = 0;
+    int *intervals = new int[kNumFrames];
+    int numIntervals = 0;
+
+    for (int i = 0; i < kNumFrames; ++i) {
+        // Both due times come from the same anchor reading.
+        int64_t j = jitter(jitterUs);
+        int64_t realTimeUs = anchorUs + i * 1000000ll / fps + j;
+        int64_t nextRealTimeUs = anchorUs + (i + 1) * 1000000ll / fps + j;
+
+        // The renderer schedules a frame when the previous one drains.
+        source->mNowUs = realTimeUs - frameUs;
+
+        bool isRedundant;
+        int64_t presentUs =
+            scheduler->schedule(realTimeUs, nextRealTimeUs, &isRedundant);
+        if (isRedundant) {
+            ++redundant;
+            continue;
+        }
+        scheduler->onFramePresented(realTimeUs, presentUs);
+        ++presented;
+
+        CHECK((presentUs - kEpochUs) % kPeriodUs == 0,
+              "%d fps frame %d presented off the vsync grid", fps, i);
+        int64_t errorUs = presentUs > realTimeUs
+            ? presentUs - realTimeUs : realTimeUs - presentUs;
+        if (errorUs > maxErrorUs) {
+            maxErrorUs = errorUs;
+        }
+        if (lastPresentUs >= 0) {
+            CHECK(presentUs > lastPresentUs,
+                  "%d fps frame %d shares a refresh with the previous one", fps, i);
+            intervals[numIntervals++] = (int)((presentUs - lastPresentUs) / kPeriodUs);
+        }
+        lastPresentUs = presentUs;
+    }
+
+    CHECK(maxErrorUs <= kPeriodUs,
+          "%d fps presented up to %lld us from due time", fps, (long long)maxErrorUs);
+    CHECK(presented * keepEvery == kNumFrames,
+          "%d fps presented %d of %d frames", fps, presented, kNumFrames);
+    CHECK(redundant * keepEvery == kNumFrames * (keepEvery - 1),
+          "%d fps flagged %d redundant frames", fps, redundant);
+
+    int lo = refreshes / cadenceFrames;
+    int hi = (refreshes + cadenceFrames - 1) / cadenceFrames;
+    int breaks = 0;
+    for (int i = 0; i < numIntervals; ++i) {
+        if (intervals[i] < lo || intervals[i] > hi) {
+            ++breaks;
+            continue;
+        }
+        if (i + cadenceFrames <= numIntervals) {
+            int sum = 0;
+            for (int k = 0; k < cadenceFrames; ++k) {
+                sum += intervals[i + k];
+            }
+            if (sum != refreshes) {
+                ++breaks;
+            }
+        }
+    }
+    CHECK(breaks == 0, "%d fps at phase %lld us: cadence broken %d times",
+          fps, (long long)phaseUs, breaks);
+
+    delete[] intervals;
+}
+
+// The stream may start anywhere between two vsyncs.
+static void testCadence(int fps, int64_t jitterUs,
+                        int cadenceFrames, int refreshes, int keepEvery) {
+    int before = failures;
+    for (int i = 0; i < kNumPhases; ++i) {
+        playCadence(fps, i * kPeriodUs / kNumPhases, jitterUs,
+                    cadenceFrames, refreshes, keepEvery);
+    }
+    printf("%3d fps on 60 Hz, +-%lld us anchor jitter, %d start phases: %s\n",
+           fps, (long long)jitterUs, kNumPhases,
+           failures == before ? "ok" : "FAILED");
+}
+
+// Without vsync timing the scheduler hands back the due time untouched.
+static void testNoVsync() {
+    sp<SimVsyncSource> source = new SimVsyncSource();
+    source->mValid = false;
+    sp<DashPlayerVsyncScheduler> scheduler = new DashPlayerVsyncScheduler(source);
+
+    bool isRedundant = true;
+    int64_t presentUs = scheduler->schedule(2000123ll, 2033456ll, &isRedundant);
+    CHECK(presentUs == 2000123ll, "due time changed without vsync timing");
+    CHECK(!isRedundant, "frame flagged redundant without vsync timing");
+}
+
+int main(int argc, char **argv) {
+    // A cadence of q frames leaves 1/(2q) of a refresh between a phase
+    // and the rounding boundary, and the grid is locked on one jittered
+    // anchor reading, so the jitter has to stay under half of that, less
+    // the drift of the stream against the 16667 us refresh: 2.1 ms for
+    // 24 fps, but only 0.8 ms for the 5 frame cadences.
+    testCadence(24, 1500, 2, 5, 1);
+    testCadence(25, 500, 5, 12, 1);
+    testCadence(30, 2000, 1, 2, 1);
+    testCadence(50, 500, 5, 6, 1);
+    testCadence(60, 2000, 1, 1, 1);
+    testCadence(120, 2000, 1, 1, 2);
+    testNoVsync();
+
+    if (failures) {
+        printf("dashplayer-vsync-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("dashplayer-vsync-test: all checks passed\n");
+    return 0;
+}
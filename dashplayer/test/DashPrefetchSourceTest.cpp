@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *      with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Prefetch test: runs DashPlayer::PrefetchSource over the file-backed
+ * LocalFileSource and checks that
+ *  - access units come out of the prefetch queues in the order the file
+ *    gives them, with the file's track formats,
+ *  - buffering is only reported from the watermarks, never just for
+ *    starting, and starts and ends alternate,
+ *  - a seek inside the prefetched range is served from the queues and
+ *    resumes video on a sync sample, while one outside it is refused.
+ *
+ * Usage: dashplayer-prefetch-test <media file>
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <utils/Vector.h>
+
+#include "DashPrefetchSource.h"
+#include "DashLocalFileSource.h"
+
+using namespace android;
+
+static int failures = 0;
+
+#define EXPECT(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static const int kNumTracks = 2;            // kVideo and kAudio
+static const size_t kCompareUnits = 1000;   // per track
+static const int64_t kLowWatermarkUs = 500000ll;
+static const int64_t kHighWatermarkUs = 1000000ll;
+static const int64_t kTargetDurationUs = 2000000ll;
+static const int64_t kTimeoutUs = 10000000ll;
+
+static int gFd = -1;
+static int64_t gFileLength = 0;
+
+static sp<DashPlayer::LocalFileSource> openFile() {
+    return new DashPlayer::LocalFileSource(gFd, 0, gFileLength);
+}
+
+static const char *trackName(int track) {
+    return track == DashPlayer::kAudio ? "audio" : "video";
+}
+
+// Records the buffering notifications a source posts.
+struct BufferingListener : public AHandler {
+    BufferingListener()
+        : mStarts(0),
+          mEnds(0),
+          mOutOfOrder(0),
+          mBuffering(false) {
+    }
+
+    void getCounts(int *starts, int *ends, int *outOfOrder) {
+        Mutex::Autolock autoLock(mLock);
+        *starts = mStarts;
+        *ends = mEnds;
+        *outOfOrder = mOutOfOrder;
+    }
+
+    // Waits until at least one buffering end has been seen.
+    bool waitForEnd(int64_t timeoutUs) {
+        Mutex::Autolock autoLock(mLock);
+        int64_t deadlineUs = ALooper::GetNowUs() + timeoutUs;
+        while (mEnds == 0) {
+            int64_t leftUs = deadlineUs - ALooper::GetNowUs();
+            if (leftUs <= 0) {
+                return false;
+            }
+            mCondition.waitRelative(mLock, leftUs * 1000ll);
+        }
+        return true;
+    }
+
+protected:
+    virtual void onMessageReceived(const sp<AMessage> &msg) {
+        sp<AMessage> request;
+        int32_t what;
+        if (!msg->findMessage("source-request", &request)
+                || !request->findInt32("what", &what)) {
+            return;
+        }
+
+        int32_t prefetch = 0;
+        request->findInt32("prefetch", &prefetch);
+        EXPECT(prefetch, "buffering event not tagged as the prefetch stage's");
+
+        Mutex::Autolock autoLock(mLock);
+        if (what == DashPlayer::kWhatBufferingStart) {
+            mOutOfOrder += mBuffering ? 1 : 0;
+            mBuffering = true;
+            ++mStarts;
+        } else if (what == DashPlayer::kWhatBufferingEnd) {
+            mOutOfOrder += mBuffering ? 0 : 1;
+            mBuffering = false;
+            ++mEnds;
+        }
+        mCondition.signal();
+    }
+
+private:
+    Mutex mLock;
+    Condition mCondition;
+    int mStarts;
+    int mEnds;
+    int mOutOfOrder;
+    bool mBuffering;
+};
+
+struct Unit {
+    int64_t mTimeUs;
+    bool mIsSync;
+};
+
+// Pulls up to kCompareUnits access units per track out of source,
+// waiting out -EWOULDBLOCK.
+static void readUnits(const sp<DashPlayer::Source> &source,
+                      Vector<Unit> units[kNumTracks]) {
+    bool done[kNumTracks];
+    for (int track = 0; track < kNumTracks; ++track) {
+        done[track] = (source->getFormat(track) == NULL);
+    }
+
+    int64_t deadlineUs = ALooper::GetNowUs() + kTimeoutUs;
+    while (!done[DashPlayer::kVideo] || !done[DashPlayer::kAudio]) {
+        bool progress = false;
+        for (int track = 0; track < kNumTracks; ++track) {
+            if (done[track]) {
+                continue;
+            }
+
+            sp<ABuffer> accessUnit;
+            status_t err = source->dequeueAccessUnit(track, &accessUnit);
+            if (err == -EWOULDBLOCK) {
+                continue;
+            }
+            progress = true;
+
+            if (err == INFO_DISCONTINUITY) {
+                continue;
+            } else if (err != OK) {
+                done[track] = true;
+                continue;
+            }
+
+            Unit unit;
+            CHECK(accessUnit->meta()->findInt64("timeUs", &unit.mTimeUs));
+            int32_t isSync = 0;
+            unit.mIsSync =
+                accessUnit->meta()->findInt32("isSync", &isSync) && isSync;
+            units[track].push(unit);
+            if (units[track].size() >= kCompareUnits) {
+                done[track] = true;
+            }
+        }
+
+        if (!progress) {
+            if (ALooper::GetNowUs() > deadlineUs) {
+                EXPECT(false, "timed out reading access units");
+                break;
+            }
+            usleep(2000);
+        }
+    }
+}
+
+static sp<DashPlayer::PrefetchSource> createPrefetch(
+        const sp<AMessage> &notify, int64_t lowUs) {
+    sp<DashPlayer::LocalFileSource> file = openFile();
+    sp<DashPlayer::PrefetchSource> prefetch = new DashPlayer::PrefetchSource(file);
+    prefetch->setWatermarks(lowUs, kHighWatermarkUs, kTargetDurationUs);
+    prefetch->setupSourceData(notify, DashPlayer::kTrackAll);
+    return prefetch;
+}
+
+// Same access units, same order, same formats as reading the file
+// directly; buffering reported start first and alternating.
+static void testOrderAndBuffering(const sp<AMessage> &notify,
+                                  const sp<BufferingListener> &listener) {
+    sp<DashPlayer::LocalFileSource> file = openFile();
+    file->start();
+    Vector<Unit> expected[kNumTracks];
+    readUnits(file, expected);
+
+    sp<DashPlayer::PrefetchSource> prefetch =
+        createPrefetch(notify, kLowWatermarkUs);
+    prefetch->start();
+
+    EXPECT(listener->waitForEnd(kTimeoutUs), "prefetch never reported buffering end");
+
+    for (int track = 0; track < kNumTracks; ++track) {
+        sp<MetaData> want = file->getFormat(track);
+        sp<MetaData> got = prefetch->getFormat(track);
+        EXPECT((want == NULL) == (got == NULL), "%s format presence differs",
+               trackName(track));
+        if (want == NULL || got == NULL) {
+            continue;
+        }
+
+        const char *wantMime, *gotMime;
+        CHECK(want->findCString(kKeyMIMEType, &wantMime));
+        EXPECT(got->findCString(kKeyMIMEType, &gotMime)
+               && !strcasecmp(wantMime, gotMime),
+               "%s format differs from the file's", trackName(track));
+    }
+
+    Vector<Unit> units[kNumTracks];
+    readUnits(prefetch, units);
+
+    for (int track = 0; track < kNumTracks; ++track) {
+        EXPECT(units[track].size() == expected[track].size(),
+               "%s: %d access units prefetched, %d in the file", trackName(track),
+               (int)units[track].size(), (int)expected[track].size());
+        size_t n = units[track].size() < expected[track].size()
+            ? units[track].size() : expected[track].size();
+        for (size_t i = 0; i < n; ++i) {
+            if (units[track][i].mTimeUs != expected[track][i].mTimeUs) {
+                EXPECT(false, "%s access unit %d at %lld us, expected %lld us",
+                       trackName(track), (int)i, units[track][i].mTimeUs,
+                       expected[track][i].mTimeUs);
+                break;
+            }
+        }
+    }
+
+    prefetch->stop();
+
+    int starts, ends, outOfOrder;
+    listener->getCounts(&starts, &ends, &outOfOrder);
+    EXPECT(starts >= 1, "no buffering start while the queues filled");
+    EXPECT(outOfOrder == 0, "%d buffering events out of order", outOfOrder);
+}
+
+// With a low watermark of zero the queues never run low, so there must
+// be no buffering events at all.
+static void testNoSpuriousBuffering(const sp<AMessage> &notify,
+                                    const sp<BufferingListener> &listener) {
+    int starts0, ends0, outOfOrder0;
+    listener->getCounts(&starts0, &ends0, &outOfOrder0);
+
+    sp<DashPlayer::PrefetchSource> prefetch = createPrefetch(notify, 0);
+    prefetch->start();
+    usleep(500000);
+    prefetch->stop();
+
+    int starts, ends, outOfOrder;
+    listener->getCounts(&starts, &ends, &outOfOrder);
+    EXPECT(starts == starts0 && ends == ends0,
+           "buffering reported without the queues running low");
+}
+
+static void testSeekWithinBuffer(const sp<AMessage> &notify,
+                                 const sp<BufferingListener> &listener) {
+    // Where the file starts, read without disturbing the queues.
+    sp<DashPlayer::LocalFileSource> file = openFile();
+    file->start();
+    int track = file->getFormat(DashPlayer::kVideo) != NULL
+        ? DashPlayer::kVideo : DashPlayer::kAudio;
+    sp<ABuffer> accessUnit;
+    CHECK_EQ(file->dequeueAccessUnit(track, &accessUnit), (status_t)OK);
+    int64_t firstTimeUs;
+    CHECK(accessUnit->meta()->findInt64("timeUs", &firstTimeUs));
+    file.clear();
+
+    int starts0, ends0, outOfOrder0;
+    listener->getCounts(&starts0, &ends0, &outOfOrder0);
+
+    sp<DashPlayer::PrefetchSource> prefetch =
+        createPrefetch(notify, kLowWatermarkUs);
+    prefetch->start();
+
+    // Filled up to the high watermark once buffering has ended again.
+    int64_t deadlineUs = ALooper::GetNowUs() + kTimeoutUs;
+    int starts, ends, outOfOrder;
+    do {
+        usleep(10000);
+        listener->getCounts(&starts, &ends, &outOfOrder);
+    } while (ends == ends0 && ALooper::GetNowUs() < deadlineUs);
+    EXPECT(ends > ends0, "prefetch never reported buffering end");
+
+    int64_t resumeTimeUs;
+    EXPECT(prefetch->seekWithinBuffer(firstTimeUs + 60000000ll, true, &resumeTimeUs)
+           != OK, "seek a minute ahead served from a %lld us buffer",
+           kTargetDurationUs);
+
+    int64_t targetUs = firstTimeUs + kLowWatermarkUs;
+    status_t err = prefetch->seekWithinBuffer(targetUs, true, &resumeTimeUs);
+    EXPECT(err == OK, "seek %lld us ahead not served from the buffer (%d)",
+           kLowWatermarkUs, err);
+    if (err == OK) {
+        EXPECT(resumeTimeUs == targetUs, "accurate seek resumes at %lld us", resumeTimeUs);
+
+        err = prefetch->dequeueAccessUnit(track, &accessUnit);
+        EXPECT(err == OK, "nothing to dequeue after the seek (%d)", err);
+
+        int64_t timeUs = -1;
+        int32_t isSync = 0;
+        if (err == OK) {
+            CHECK(accessUnit->meta()->findInt64("timeUs", &timeUs));
+            accessUnit->meta()->findInt32("isSync", &isSync);
+        }
+        EXPECT(timeUs >= firstTimeUs && timeUs <= targetUs,
+               "resumed at %lld us for a seek to %lld us", timeUs, targetUs);
+        EXPECT(track == DashPlayer::kAudio || isSync,
+               "video resumed on a non-sync sample");
+    }
+
+    prefetch->stop();
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <media file>\n", argv[0]);
+        return 1;
+    }
+
+    gFd = open(argv[1], O_RDONLY);
+    struct stat st;
+    if (gFd < 0 || fstat(gFd, &st) != 0) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    gFileLength = st.st_size;
+
+    DataSource::RegisterDefaultSniffers();
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("dashplayer-prefetch-test");
+    looper->start();
+
+    sp<BufferingListener> listener = new BufferingListener;
+    looper->registerHandler(listener);
+    sp<AMessage> notify = new AMessage('bufN', listener->id());
+
+    if (openFile()->initCheck() != OK) {
+        fprintf(stderr, "%s has no playable audio or video track\n", argv[1]);
+        close(gFd);
+        return 1;
+    }
+
+    testOrderAndBuffering(notify, listener);
+    testNoSpuriousBuffering(notify, listener);
+    testSeekWithinBuffer(notify, listener);
+
+    looper->unregisterHandler(listener->id());
+    looper->stop();
+    close(gFd);
+
+    if (failures) {
+        printf("dashplayer-prefetch-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("dashplayer-prefetch-test: all checks passed\n");
+    return 0;
+}
@@ -58,6 +58,7 @@ public:
     C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags);
     int32_t getBuffReq(int32_t port, C2DBuffReq *req);
     int32_t dumpOutput(char * filename, char mode);
+    bool canConvert();
 protected:
     virtual ~C2DColorConverter();
     virtual int convertC2D(int srcFd, void * srcData, int dstFd, void * dstData);
@@ -75,6 +76,9 @@ private:
     virtual bool unmapGPUAddr(uint32_t gAddr);
     virtual size_t calcLumaAlign(ColorConvertFormat format);
     virtual size_t calcSizeAlign(ColorConvertFormat format);
+    virtual uint32_t getC2DRotation();
+    virtual bool isSemiPlanar420(ColorConvertFormat format);
+    virtual int convertCPU(void * srcData, void * dstData);
 
     void *mC2DLibHandle;
     LINK_c2dCreateSurface mC2DCreateSurface;
@@ -103,12 +107,30 @@ private:
     enum ColorConvertFormat mSrcFormat;
     enum ColorConvertFormat mDstFormat;
     int32_t mFlags;
+    ColorConvertRotation mRotation;
 
     int mError;
 };
 
 C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags)
 {
+    // Geometry is set up first so that convertCPU can still be used when
+    // the C2D library or the kgsl device is not available
+    mSrcWidth = srcWidth;
+    mSrcHeight = srcHeight;
+    mDstWidth = dstWidth;
+    mDstHeight = dstHeight;
+    mSrcFormat = srcFormat;
+    mDstFormat = dstFormat;
+    mSrcSize = calcSize(srcFormat, srcWidth, srcHeight);
+    mDstSize = calcSize(dstFormat, dstWidth, dstHeight);
+    mSrcYSize = calcYSize(srcFormat, srcWidth, srcHeight);
+    mDstYSize = calcYSize(dstFormat, dstWidth, dstHeight);
+
+    mFlags = flags;
+    mRotation = (ColorConvertRotation)(flags & C2D_FLAGS_ROTATION_MASK);
+    mKgslFd = -1;
+
      mError = 0;
      mC2DLibHandle = dlopen("libC2D2.so", RTLD_NOW);
      if (!mC2DLibHandle) {
@@ -133,18 +155,6 @@ C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t d
          return;
      }
 
-    mSrcWidth = srcWidth;
-    mSrcHeight = srcHeight;
-    mDstWidth = dstWidth;
-    mDstHeight = dstHeight;
-    mSrcFormat = srcFormat;
-    mDstFormat = dstFormat;
-    mSrcSize = calcSize(srcFormat, srcWidth, srcHeight);
-    mDstSize = calcSize(dstFormat, dstWidth, dstHeight);
-    mSrcYSize = calcYSize(srcFormat, srcWidth, srcHeight);
-    mDstYSize = calcYSize(dstFormat, dstWidth, dstHeight);
-
-    mFlags = flags; // can be used for rotation
     mKgslFd = open("/dev/kgsl-2d0", O_RDWR | O_SYNC);
     if (mKgslFd < 0) {
         ALOGE("Cannot open device kgsl-2d0, trying kgsl-3d0\n");
@@ -166,8 +176,14 @@ C2DColorConverter::C2DColorConverter(size_t srcWidth, size_t srcHeight, size_t d
     mBlit.source_rect.height = srcHeight << 16;
     mBlit.target_rect.x = 0 << 16;
     mBlit.target_rect.y = 0 << 16;
-    mBlit.target_rect.width = dstWidth << 16;
-    mBlit.target_rect.height = dstHeight << 16;
+    // the target rect is given in the unrotated target space
+    if (mRotation == ROTATE_90 || mRotation == ROTATE_270) {
+        mBlit.target_rect.width = dstHeight << 16;
+        mBlit.target_rect.height = dstWidth << 16;
+    } else {
+        mBlit.target_rect.width = dstWidth << 16;
+        mBlit.target_rect.height = dstHeight << 16;
+    }
     mBlit.config_mask = C2D_ALPHA_BLEND_NONE | C2D_NO_BILINEAR_BIT | C2D_NO_ANTIALIASING_BIT | C2D_TARGET_RECT_BIT;
     mBlit.surface_id = mSrcSurface;
 }
@@ -204,6 +220,10 @@ int C2DColorConverter::convertC2D(int srcFd, void * srcData, int dstFd, void * d
     C2D_STATUS ret;
 
     if (mError) {
+        if (srcData && dstData &&
+            isSemiPlanar420(mSrcFormat) && isSemiPlanar420(mDstFormat)) {
+            return convertCPU(srcData, dstData);
+        }
         ALOGE("C2D library initialization failed\n");
         return mError;
     }
@@ -236,7 +256,7 @@ int C2DColorConverter::convertC2D(int srcFd, void * srcData, int dstFd, void * d
     }
 
     mBlit.surface_id = mSrcSurface;
-    ret = mC2DDraw(mDstSurface, C2D_TARGET_ROTATE_0, 0, 0, 0, &mBlit, 1);
+    ret = mC2DDraw(mDstSurface, getC2DRotation(), 0, 0, 0, &mBlit, 1);
     mC2DFinish(mDstSurface);
 
     bool unmappedSrcSuccess;
@@ -265,6 +285,206 @@ int C2DColorConverter::convertC2D(int srcFd, void * srcData, int dstFd, void * d
     }
 }
 
+uint32_t C2DColorConverter::getC2DRotation()
+{
+    switch (mRotation) {
+        case ROTATE_90:
+            return C2D_TARGET_ROTATE_90;
+        case ROTATE_180:
+            return C2D_TARGET_ROTATE_180;
+        case ROTATE_270:
+            return C2D_TARGET_ROTATE_270;
+        case ROTATE_0:
+        default:
+            return C2D_TARGET_ROTATE_0;
+    }
+}
+
+bool C2DColorConverter::isSemiPlanar420(ColorConvertFormat format)
+{
+    return (format == YCbCr420SP || format == NV12_2K);
+}
+
+/*
+ * Without C2D only the semi-planar CPU path is left, so any other format
+ * pair is refused when the converter is created rather than per frame.
+ */
+bool C2DColorConverter::canConvert()
+{
+    return !mError || (isSemiPlanar420(mSrcFormat) && isSemiPlanar420(mDstFormat));
+}
+
+/*
+ * Rotates an 8 bit plane (luma) or a plane of 16 bit CbCr pairs (chroma).
+ * w/h are the source dimensions in elements, strides are in bytes.
+ */
+static void rotatePlane8(const uint8_t *src, size_t srcStride, uint8_t *dst,
+        size_t dstStride, size_t w, size_t h, ColorConvertRotation rotation)
+{
+    size_t x = 0, y = 0;
+
+    if (rotation == ROTATE_180) {
+        for (y = 0; y < h; y++) {
+            const uint8_t *s = src + y * srcStride;
+            uint8_t *d = dst + (h - 1 - y) * dstStride;
+            x = 0;
+#ifdef __ARM_NEON__
+            for (; x + 8 <= w; x += 8) {
+                vst1_u8(d + w - x - 8, vrev64_u8(vld1_u8(s + x)));
+            }
+#endif
+            for (; x < w; x++) {
+                d[w - 1 - x] = s[x];
+            }
+        }
+        return;
+    }
+
+    size_t blockW = 0, blockH = 0;
+#ifdef __ARM_NEON__
+    blockW = w & ~7;
+    blockH = h & ~7;
+    for (y = 0; y < blockH; y += 8) {
+        for (x = 0; x < blockW; x += 8) {
+            const uint8_t *s = src + y * srcStride + x;
+            uint8x8x2_t t0 = vtrn_u8(vld1_u8(s), vld1_u8(s + srcStride));
+            uint8x8x2_t t1 = vtrn_u8(vld1_u8(s + 2 * srcStride), vld1_u8(s + 3 * srcStride));
+            uint8x8x2_t t2 = vtrn_u8(vld1_u8(s + 4 * srcStride), vld1_u8(s + 5 * srcStride));
+            uint8x8x2_t t3 = vtrn_u8(vld1_u8(s + 6 * srcStride), vld1_u8(s + 7 * srcStride));
+            uint16x4x2_t u0 = vtrn_u16(vreinterpret_u16_u8(t0.val[0]), vreinterpret_u16_u8(t1.val[0]));
+            uint16x4x2_t u1 = vtrn_u16(vreinterpret_u16_u8(t0.val[1]), vreinterpret_u16_u8(t1.val[1]));
+            uint16x4x2_t u2 = vtrn_u16(vreinterpret_u16_u8(t2.val[0]), vreinterpret_u16_u8(t3.val[0]));
+            uint16x4x2_t u3 = vtrn_u16(vreinterpret_u16_u8(t2.val[1]), vreinterpret_u16_u8(t3.val[1]));
+            uint32x2x2_t v0 = vtrn_u32(vreinterpret_u32_u16(u0.val[0]), vreinterpret_u32_u16(u2.val[0]));
+            uint32x2x2_t v1 = vtrn_u32(vreinterpret_u32_u16(u1.val[0]), vreinterpret_u32_u16(u3.val[0]));
+            uint32x2x2_t v2 = vtrn_u32(vreinterpret_u32_u16(u0.val[1]), vreinterpret_u32_u16(u2.val[1]));
+            uint32x2x2_t v3 = vtrn_u32(vreinterpret_u32_u16(u1.val[1]), vreinterpret_u32_u16(u3.val[1]));
+            // column c of the source block
+            uint8x8_t col[8] = {
+                vreinterpret_u8_u32(v0.val[0]), vreinterpret_u8_u32(v1.val[0]),
+                vreinterpret_u8_u32(v2.val[0]), vreinterpret_u8_u32(v3.val[0]),
+                vreinterpret_u8_u32(v0.val[1]), vreinterpret_u8_u32(v1.val[1]),
+                vreinterpret_u8_u32(v2.val[1]), vreinterpret_u8_u32(v3.val[1]) };
+            for (int c = 0; c < 8; c++) {
+                if (rotation == ROTATE_90) {
+                    vst1_u8(dst + (x + c) * dstStride + (h - y - 8), vrev64_u8(col[c]));
+                } else {
+                    vst1_u8(dst + (w - 1 - x - c) * dstStride + y, col[c]);
+                }
+            }
+        }
+    }
+#endif
+    for (y = 0; y < h; y++) {
+        const uint8_t *s = src + y * srcStride;
+        // only the right and bottom borders are left when NEON ran
+        for (x = (y < blockH) ? blockW : 0; x < w; x++) {
+            if (rotation == ROTATE_90) {
+                dst[x * dstStride + (h - 1 - y)] = s[x];
+            } else {
+                dst[(w - 1 - x) * dstStride + y] = s[x];
+            }
+        }
+    }
+}
+
+static void rotatePlane16(const uint8_t *src, size_t srcStride, uint8_t *dst,
+        size_t dstStride, size_t w, size_t h, ColorConvertRotation rotation)
+{
+    size_t x = 0, y = 0;
+
+    if (rotation == ROTATE_180) {
+        for (y = 0; y < h; y++) {
+            const uint16_t *s = (const uint16_t *)(src + y * srcStride);
+            uint16_t *d = (uint16_t *)(dst + (h - 1 - y) * dstStride);
+            x = 0;
+#ifdef __ARM_NEON__
+            for (; x + 4 <= w; x += 4) {
+                vst1_u16(d + w - x - 4, vrev64_u16(vld1_u16(s + x)));
+            }
+#endif
+            for (; x < w; x++) {
+                d[w - 1 - x] = s[x];
+            }
+        }
+        return;
+    }
+
+    size_t blockW = 0, blockH = 0;
+#ifdef __ARM_NEON__
+    blockW = w & ~3;
+    blockH = h & ~3;
+    for (y = 0; y < blockH; y += 4) {
+        for (x = 0; x < blockW; x += 4) {
+            const uint16_t *s = (const uint16_t *)(src + y * srcStride) + x;
+            const size_t sStride = srcStride / 2;
+            uint16x4x2_t t0 = vtrn_u16(vld1_u16(s), vld1_u16(s + sStride));
+            uint16x4x2_t t1 = vtrn_u16(vld1_u16(s + 2 * sStride), vld1_u16(s + 3 * sStride));
+            uint32x2x2_t v0 = vtrn_u32(vreinterpret_u32_u16(t0.val[0]), vreinterpret_u32_u16(t1.val[0]));
+            uint32x2x2_t v1 = vtrn_u32(vreinterpret_u32_u16(t0.val[1]), vreinterpret_u32_u16(t1.val[1]));
+            uint16x4_t col[4] = {
+                vreinterpret_u16_u32(v0.val[0]), vreinterpret_u16_u32(v1.val[0]),
+                vreinterpret_u16_u32(v0.val[1]), vreinterpret_u16_u32(v1.val[1]) };
+            for (int c = 0; c < 4; c++) {
+                if (rotation == ROTATE_90) {
+                    uint16_t *d = (uint16_t *)(dst + (x + c) * dstStride);
+                    vst1_u16(d + (h - y - 4), vrev64_u16(col[c]));
+                } else {
+                    uint16_t *d = (uint16_t *)(dst + (w - 1 - x - c) * dstStride);
+                    vst1_u16(d + y, col[c]);
+                }
+            }
+        }
+    }
+#endif
+    for (y = 0; y < h; y++) {
+        const uint16_t *s = (const uint16_t *)(src + y * srcStride);
+        for (x = (y < blockH) ? blockW : 0; x < w; x++) {
+            if (rotation == ROTATE_90) {
+                ((uint16_t *)(dst + x * dstStride))[h - 1 - y] = s[x];
+            } else {
+                ((uint16_t *)(dst + (w - 1 - x) * dstStride))[y] = s[x];
+            }
+        }
+    }
+}
+
+/*
+ * CPU path used when C2D is not available. Only semi-planar 4:2:0 to
+ * semi-planar 4:2:0 is handled, with an optional rotation.
+ */
+int C2DColorConverter::convertCPU(void * srcData, void * dstData)
+{
+    const uint8_t *src = (const uint8_t *)srcData;
+    uint8_t *dst = (uint8_t *)dstData;
+    size_t srcStride = calcStride(mSrcFormat, mSrcWidth);
+    size_t dstStride = calcStride(mDstFormat, mDstWidth);
+    bool swapped = (mRotation == ROTATE_90 || mRotation == ROTATE_270);
+
+    if ((swapped && (mDstWidth != mSrcHeight || mDstHeight != mSrcWidth)) ||
+        (!swapped && (mDstWidth != mSrcWidth || mDstHeight != mSrcHeight))) {
+        ALOGE("CPU conversion cannot scale %dx%d -> %dx%d\n",
+              mSrcWidth, mSrcHeight, mDstWidth, mDstHeight);
+        return -1;
+    }
+
+    if (mRotation == ROTATE_0) {
+        for (size_t y = 0; y < mSrcHeight; y++) {
+            memcpy(dst + y * dstStride, src + y * srcStride, mSrcWidth);
+        }
+        for (size_t y = 0; y < mSrcHeight / 2; y++) {
+            memcpy(dst + mDstYSize + y * dstStride,
+                   src + mSrcYSize + y * srcStride, mSrcWidth);
+        }
+        return 0;
+    }
+
+    rotatePlane8(src, srcStride, dst, dstStride, mSrcWidth, mSrcHeight, mRotation);
+    rotatePlane16(src + mSrcYSize, srcStride, dst + mDstYSize, dstStride,
+                  mSrcWidth / 2, mSrcHeight / 2, mRotation);
+    return 0;
+}
+
 bool C2DColorConverter::isYUVSurface(ColorConvertFormat format)
 {
     switch (format) {
@@ -669,7 +889,13 @@ int32_t C2DColorConverter::dumpOutput(char * filename, char mode) {
 
 extern "C" C2DColorConverterBase* createC2DColorConverter(size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight, ColorConvertFormat srcFormat, ColorConvertFormat dstFormat, int32_t flags)
 {
-    return new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags);
+    C2DColorConverter *converter = new C2DColorConverter(srcWidth, srcHeight, dstWidth, dstHeight, srcFormat, dstFormat, flags);
+    if (!converter->canConvert()) {
+        ALOGE("No conversion path for format %d -> %d without C2D\n", srcFormat, dstFormat);
+        delete (C2DColorConverterBase *)converter;
+        return NULL;
+    }
+    return converter;
 }
 
 extern "C" void destroyC2DColorConverter(C2DColorConverterBase* C2DCC)
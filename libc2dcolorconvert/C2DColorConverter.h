@@ -92,6 +92,20 @@ typedef enum {
   C2D_OUTPUT,
 } C2D_PORT;
 
+/* Clockwise rotation applied during the conversion, passed in the low bits
+ * of the flags argument of createC2DColorConverter. For 90/270 the caller
+ * passes destination dimensions that are already swapped. When C2D is not
+ * available only semi-planar 4:2:0 to semi-planar 4:2:0 is converted, on
+ * the CPU; createC2DColorConverter returns NULL for any other pair. */
+typedef enum {
+  ROTATE_0 = 0,
+  ROTATE_90,
+  ROTATE_180,
+  ROTATE_270,
+} ColorConvertRotation;
+
+#define C2D_FLAGS_ROTATION_MASK 0x3
+
 class C2DColorConverterBase {
 
 public:
@@ -20,6 +20,10 @@ MM_CORE_TARGET = 8660
 OMXCORE_CFLAGS += -DENABLE_DRMPLAY
 else ifeq ($(TARGET_BOARD_PLATFORM),msm8960)
 MM_CORE_TARGET = 8960
+#HEVC decoder role needs a kernel that exposes VDEC_CODECTYPE_HEVC
+ifeq ($(TARGET_HAS_VIDC_HEVC),true)
+OMXCORE_CFLAGS += -DHEVC_DECODER_SUPPORT
+endif
 else ifeq ($(TARGET_BOARD_PLATFORM),msm8974)
 MM_CORE_TARGET = 8974
 else
@@ -368,6 +368,24 @@ enum OMX_QCOM_EXTN_INDEXTYPE
 
     /*"OMX.QCOM.index.param.video.EnableSmoothStreaming"*/
     OMX_QcomIndexParamEnableSmoothStreaming = 0x7F000023,
+
+    /*"OMX.QCOM.index.config.video.ROIInfo"*/
+    OMX_QcomIndexConfigVideoROIInfo = 0x7F000024,
+
+    /*"OMX.QCOM.index.param.video.LookAhead"*/
+    OMX_QcomIndexParamVideoLookAhead = 0x7F000025,
+
+    /*"OMX.QCOM.index.param.video.FrameRateConversion"*/
+    OMX_QcomIndexParamVideoFrameRateConversion = 0x7F000026,
+
+    /*"OMX.QCOM.index.param.video.SceneCutDetection"*/
+    OMX_QcomIndexParamVideoSceneCutDetection = 0x7F000027,
+
+    /*"OMX.QCOM.index.param.video.ThumbnailMode"*/
+    OMX_QcomIndexParamVideoThumbnailMode = 0x7F000029,
+
+    /*"OMX.QCOM.index.config.video.HDRInfo"*/
+    OMX_QcomIndexConfigVideoHDRInfo = 0x7F00002A,
 };
 
 /**
@@ -533,6 +551,158 @@ typedef struct OMX_QCOM_VIDEO_CONFIG_QPRANGE
 } OMX_QCOM_VIDEO_CONFIG_QPRANGE;
 
 
+/**
+ * A single region of interest for the video encoder. Coordinates are in
+ * pixels of the encoded frame and are rounded outwards to macroblock
+ * boundaries by the component.
+ *
+ * STRUCT MEMBERS:
+ *  nLeft, nTop     : Top-left corner of the region
+ *  nWidth, nHeight : Size of the region
+ *  nDeltaQP        : QP offset for every macroblock of the region,
+ *                    negative values spend more bits on the region
+ */
+typedef struct OMX_QCOM_VIDEO_ROI_RECT
+{
+   OMX_U32 nLeft;
+   OMX_U32 nTop;
+   OMX_U32 nWidth;
+   OMX_U32 nHeight;
+   OMX_S32 nDeltaQP;
+} OMX_QCOM_VIDEO_ROI_RECT;
+
+#define OMX_QCOM_VIDEO_MAX_ROI_RECTS 8
+#define OMX_QCOM_VIDEO_MAX_ROI_DELTA_QP 51
+
+/**
+ * This structure describes the parameters corresponding to the
+ * OMX_QcomIndexConfigVideoROIInfo extension. This parameter can be set
+ * dynamically during any state except the state invalid and applies to
+ * every following frame until it is changed or disabled. Either a list of
+ * rectangles or a per-macroblock QP delta map (one OMX_S8 per macroblock in
+ * raster order) is supplied; if both are present the map is used. The map
+ * follows the structure inline and is sized by the configured resolution,
+ * so nSize must cover nQPMapSize bytes of nQPMap. get_config does not read
+ * the map back and returns only the fixed part. This is set on the out port.
+ * Only available when the kernel exposes VEN_IOCTL_SET_QP_MAP.
+ */
+typedef struct OMX_QCOM_VIDEO_CONFIG_ROIINFO
+{
+   OMX_U32 nSize;           /** Size of the structure in bytes */
+   OMX_VERSIONTYPE nVersion;/** OMX specification version information */
+   OMX_U32 nPortIndex;      /** Portindex which is extended by this structure */
+   OMX_BOOL bEnable;        /** OMX_FALSE clears any previous ROI setting */
+   OMX_U32 nRectCount;      /** Number of valid entries in sRects */
+   OMX_QCOM_VIDEO_ROI_RECT sRects[OMX_QCOM_VIDEO_MAX_ROI_RECTS];
+   OMX_U32 nQPMapSize;      /** Valid bytes in nQPMap, 0 if not used */
+   OMX_S8 nQPMap[1];        /** nQPMapSize per-macroblock QP deltas */
+} OMX_QCOM_VIDEO_CONFIG_ROIINFO;
+
+/**
+ * This structure describes the parameters corresponding to the
+ * OMX_QcomIndexParamVideoLookAhead extension. When enabled the encoder
+ * holds up to nLookAheadFrames input frames before they are encoded and
+ * uses a downscaled luma analysis of them to place IDR frames on scene
+ * cuts and to shift bits between simple and complex stretches. The bitrate
+ * is scaled by 0.75 to 1.25 and averages out to the target over the window;
+ * with rate control disabled the same scale is applied as a per-frame
+ * offset to the session QP. The input port should be given
+ * nLookAheadFrames more buffers than usual.
+ * This parameter can be set in the loaded state only, on the out port.
+ */
+typedef struct OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE
+{
+   OMX_U32 nSize;           /** Size of the structure in bytes */
+   OMX_VERSIONTYPE nVersion;/** OMX specification version information */
+   OMX_U32 nPortIndex;      /** Portindex which is extended by this structure */
+   OMX_BOOL bEnable;        /** Enable/disable the look-ahead queue */
+   OMX_U32 nLookAheadFrames;/** Number of future frames analysed, 1 to 16 */
+   OMX_BOOL bSceneCutIDR;   /** Request an IDR on detected scene cuts */
+   OMX_BOOL bAdaptiveBitrate;/** Scale the target bitrate with complexity */
+} OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE;
+
+/**
+ * This structure describes the parameters corresponding to the
+ * OMX_QcomIndexParamVideoFrameRateConversion extension. When enabled the
+ * encoder paces its input to the configured encode frame rate using the
+ * buffer timestamps: frames arriving ahead of their slot are dropped and,
+ * if bAllowDuplicate is set, a frame following a gap is also encoded into
+ * the empty slots before it; the frame itself keeps its timestamp.
+ * Independently of the rate, frames are dropped while more than
+ * nDropWatermark input buffers wait for the encoder. Dropped buffers are
+ * returned at once through EmptyBufferDone. Duplication applies to
+ * byte-buffer input only and is not combined with look-ahead.
+ * The counters are read only and can be queried in any state; the
+ * parameter can be set in the loaded state only, on the in port.
+ */
+typedef struct OMX_QCOM_VIDEO_PARAM_FRCTYPE
+{
+   OMX_U32 nSize;           /** Size of the structure in bytes */
+   OMX_VERSIONTYPE nVersion;/** OMX specification version information */
+   OMX_U32 nPortIndex;      /** Portindex which is extended by this structure */
+   OMX_BOOL bEnable;        /** Enable/disable the conversion stage */
+   OMX_BOOL bAllowDuplicate;/** Repeat frames to fill gaps in the input */
+   OMX_U32 nDropWatermark;  /** Input buffers held before dropping, 0 disables */
+   OMX_U32 nFramesDropped;  /** Frames dropped to meet the encode rate */
+   OMX_U32 nFramesDroppedOverload; /** Frames dropped above the watermark */
+   OMX_U32 nFramesDuplicated;/** Extra frames encoded to fill gaps */
+} OMX_QCOM_VIDEO_PARAM_FRCTYPE;
+
+/**
+ * This structure describes the parameters corresponding to the
+ * OMX_QcomIndexParamVideoSceneCutDetection extension. When enabled every
+ * input frame's subsampled luma histogram is compared with the previous
+ * one and an IDR frame is requested on a scene cut. With bResetGOP the
+ * intra period restarts at the inserted IDR, so the regular IDR spacing
+ * is kept relative to the last cut. bResetGOP only applies to intra
+ * periods of P frames where every intra frame is an IDR (nBFrames 0,
+ * nIDRPeriod 0 or 1); with other periods it is cleared and cuts only
+ * insert an IDR.
+ * nFramesDetected is read only; the parameter can be set in the loaded
+ * state only, on the out port.
+ */
+typedef struct OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE
+{
+   OMX_U32 nSize;           /** Size of the structure in bytes */
+   OMX_VERSIONTYPE nVersion;/** OMX specification version information */
+   OMX_U32 nPortIndex;      /** Portindex which is extended by this structure */
+   OMX_BOOL bEnable;        /** Enable/disable scene cut detection */
+   OMX_U32 nThreshold;      /** Histogram difference for a cut, 1 to 512 */
+   OMX_BOOL bResetGOP;      /** Restart the intra period at a cut */
+   OMX_U32 nFramesDetected; /** Number of cuts detected so far */
+} OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE;
+
+/**
+ * This structure describes the parameters corresponding to the
+ * OMX_QcomIndexConfigVideoHDRInfo extension. It returns the static HDR
+ * metadata of the stream seen so far on the out port: the VUI colour
+ * description and the mastering display colour volume and content light
+ * level SEI messages. bValid is OMX_FALSE when the stream carries none
+ * of them. Chromaticities are in units of 0.00002 and luminances in the
+ * units of the SEI messages. Get only, HEVC decoder.
+ */
+typedef struct OMX_QCOM_VIDEO_CONFIG_HDRINFOTYPE
+{
+   OMX_U32 nSize;                    /** Size of the structure in bytes */
+   OMX_VERSIONTYPE nVersion;         /** OMX specification version information */
+   OMX_U32 nPortIndex;               /** Portindex which is extended by this structure */
+   OMX_BOOL bValid;                  /** Any of the fields below was signalled */
+   OMX_U32 nColourPrimaries;         /** VUI colour_primaries */
+   OMX_U32 nTransferCharacteristics; /** VUI transfer_characteristics */
+   OMX_U32 nMatrixCoeffs;            /** VUI matrix_coeffs */
+   OMX_BOOL bFullRange;              /** VUI video_full_range_flag */
+   OMX_BOOL bMasteringDisplay;       /** Mastering display SEI fields valid */
+   OMX_U32 nDisplayPrimariesX[3];    /** G, B, R x chromaticity */
+   OMX_U32 nDisplayPrimariesY[3];    /** G, B, R y chromaticity */
+   OMX_U32 nWhitePointX;             /** White point x chromaticity */
+   OMX_U32 nWhitePointY;             /** White point y chromaticity */
+   OMX_U32 nMaxDisplayLuminance;     /** 0.0001 cd/m2 units */
+   OMX_U32 nMinDisplayLuminance;     /** 0.0001 cd/m2 units */
+   OMX_BOOL bContentLightLevel;      /** Content light level SEI fields valid */
+   OMX_U32 nMaxContentLightLevel;    /** MaxCLL, cd/m2 */
+   OMX_U32 nMaxPicAverageLightLevel; /** MaxFALL, cd/m2 */
+} OMX_QCOM_VIDEO_CONFIG_HDRINFOTYPE;
+
 typedef struct OMX_VENDOR_EXTRADATATYPE  {
     OMX_U32 nPortIndex;
     OMX_U32 nDataSize;
@@ -871,6 +1041,17 @@ typedef struct QOMX_INDEXTIMESTAMPREORDER {
 #define OMX_QCOM_INDEX_PARAM_VIDEO_SYNCFRAMEDECODINGMODE "OMX.QCOM.index.param.video.SyncFrameDecodingMode"
 #define OMX_QCOM_INDEX_PARAM_INDEXEXTRADATA "OMX.QCOM.index.param.IndexExtraData"
 #define OMX_QCOM_INDEX_PARAM_VIDEO_SLICEDELIVERYMODE "OMX.QCOM.index.param.SliceDeliveryMode"
+#define OMX_QCOM_INDEX_CONFIG_VIDEO_ROIINFO "OMX.QCOM.index.config.video.ROIInfo"
+#define OMX_QCOM_INDEX_PARAM_VIDEO_LOOKAHEAD "OMX.QCOM.index.param.video.LookAhead"
+#define OMX_QCOM_INDEX_PARAM_VIDEO_FRAMERATECONVERSION "OMX.QCOM.index.param.video.FrameRateConversion"
+#define OMX_QCOM_INDEX_PARAM_VIDEO_SCENECUTDETECTION "OMX.QCOM.index.param.video.SceneCutDetection"
+/* Takes a QOMX_ENABLETYPE, loaded state only. The decoder decodes sync
+   frames only, outputs in decode order, drops the output buffer count to
+   the minimum when enabled (the client may raise it again), and flags
+   the first decoded picture with EOS; input queued after it is returned
+   undecoded until the next flush. */
+#define OMX_QCOM_INDEX_PARAM_VIDEO_THUMBNAILMODE "OMX.QCOM.index.param.video.ThumbnailMode"
+#define OMX_QCOM_INDEX_CONFIG_VIDEO_HDRINFO "OMX.QCOM.index.config.video.HDRInfo"
 
 typedef enum {
     QOMX_VIDEO_FRAME_PACKING_CHECKERBOARD = 0,
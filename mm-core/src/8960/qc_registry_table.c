@@ -55,6 +55,24 @@ omx_core_cb_type core[] =
       "video_decoder.avc"
     }
   },
+#ifdef HEVC_DECODER_SUPPORT
+  {
+    "OMX.qcom.video.decoder.hevc",
+    NULL,   // Create instance function
+    // Unique instance handle
+    {
+      NULL,
+      NULL,
+      NULL,
+      NULL
+    },
+    NULL,   // Shared object library handle
+    "libOmxVdec.so",
+    {
+      "video_decoder.hevc"
+    }
+  },
+#endif
   {
     "OMX.qcom.video.decoder.mpeg4",
     NULL,   // Create instance function
@@ -43,6 +43,11 @@ endif
 
 libOmxVdec-def += -D_ANDROID_ICS_
 
+# HEVC needs a kernel that exposes VDEC_CODECTYPE_HEVC
+ifeq ($(TARGET_HAS_VIDC_HEVC),true)
+libOmxVdec-def += -DHEVC_DECODER_SUPPORT
+endif
+
 #ifeq ($(TARGET_USES_ION),true)
 libOmxVdec-def += -DUSE_ION
 #endif
@@ -98,9 +103,11 @@ LOCAL_SHARED_LIBRARIES += libqdMetaData
 
 LOCAL_SRC_FILES         := src/frameparser.cpp
 LOCAL_SRC_FILES         += src/h264_utils.cpp
+LOCAL_SRC_FILES         += src/hevc_utils.cpp
 LOCAL_SRC_FILES         += src/ts_parser.cpp
 LOCAL_SRC_FILES         += src/mp4_utils.cpp
 LOCAL_SRC_FILES         += src/omx_vdec.cpp
+LOCAL_SRC_FILES         += src/vdec_output_table.cpp
 LOCAL_SRC_FILES         += ../common/src/extra_data_handler.cpp
 LOCAL_SRC_FILES         += ../common/src/vidc_color_converter.cpp
 
@@ -154,6 +161,54 @@ LOCAL_ADDITIONAL_DEPENDENCIES  := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
 
 include $(BUILD_EXECUTABLE)
 
+# ---------------------------------------------------------------------------------
+# 			Make the parser-test (mm-vdec-parser-test)
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+mm-vdec-parser-test-inc    := hardware/qcom/media/mm-core/inc
+mm-vdec-parser-test-inc    += $(LOCAL_PATH)/inc
+mm-vdec-parser-test-inc    += $(OMX_VIDEO_PATH)/vidc/common/inc
+mm-vdec-parser-test-inc    += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+
+LOCAL_MODULE                    := mm-vdec-parser-test
+LOCAL_MODULE_TAGS               := debug
+LOCAL_CFLAGS                    := $(libOmxVdec-def)
+LOCAL_C_INCLUDES                := $(mm-vdec-parser-test-inc)
+LOCAL_PRELINK_MODULE            := false
+LOCAL_SHARED_LIBRARIES          := liblog libcutils
+
+LOCAL_SRC_FILES                 := src/frameparser.cpp
+LOCAL_SRC_FILES                 += src/h264_utils.cpp
+LOCAL_SRC_FILES                 += src/hevc_utils.cpp
+LOCAL_SRC_FILES                 += test/frame_parser_test.cpp
+
+LOCAL_ADDITIONAL_DEPENDENCIES  := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+include $(BUILD_EXECUTABLE)
+
+# ---------------------------------------------------------------------------------
+# 			Make the benchmark (mm-vdec-bench)
+# ---------------------------------------------------------------------------------
+include $(CLEAR_VARS)
+
+mm-vdec-bench-inc    := hardware/qcom/media/mm-core/inc
+mm-vdec-bench-inc    += $(LOCAL_PATH)/inc
+mm-vdec-bench-inc    += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include
+
+LOCAL_MODULE                    := mm-vdec-bench
+LOCAL_MODULE_TAGS               := debug
+LOCAL_CFLAGS                    := $(libOmxVdec-def)
+LOCAL_C_INCLUDES                := $(mm-vdec-bench-inc)
+LOCAL_PRELINK_MODULE            := false
+
+LOCAL_SRC_FILES                 := test/vdec_bench.cpp
+LOCAL_SRC_FILES                 += src/vdec_output_table.cpp
+
+LOCAL_ADDITIONAL_DEPENDENCIES  := $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+include $(BUILD_EXECUTABLE)
+
 endif #BUILD_TINY_ANDROID
 
 # ---------------------------------------------------------------------------------
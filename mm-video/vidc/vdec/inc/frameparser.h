@@ -31,6 +31,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "OMX_Core.h"
 #include "OMX_QCOMExtns.h"
 #include "h264_utils.h"
+#include "hevc_utils.h"
 //#include <stdlib.h>
 
 enum codec_type
@@ -41,7 +42,8 @@ enum codec_type
     CODEC_TYPE_H264 = 2,
     CODEC_TYPE_VC1 = 3,
     CODEC_TYPE_MPEG2 = 4,
-    CODEC_TYPE_MAX = CODEC_TYPE_MPEG2
+    CODEC_TYPE_HEVC = 5,
+    CODEC_TYPE_MAX = CODEC_TYPE_HEVC
 };
 
 enum state_start_code_parse
@@ -74,6 +76,7 @@ public:
 		                        OMX_BUFFERHEADERTYPE *dest ,
 							              OMX_U32 *partialframe);
 	void flush ();
+	bool start_code_found ();
 	 frame_parse ();
 	~frame_parse ();
 
@@ -98,4 +101,55 @@ private:
    void update_skip_frame();
 };
 
+/* Callbacks through which h264_frame_splitter hands the NALs it finds
+   and the frames it completes back to the component feeding it */
+class frame_splitter_client
+{
+
+public:
+	virtual ~frame_splitter_client() {}
+	/* A whole NAL, start code included, was parsed at nal */
+	virtual void nal_parsed (OMX_U8 *nal, OMX_U32 nal_len) = 0;
+	/* The next NAL goes into the frame being assembled */
+	virtual void stamp_frame () = 0;
+	/* The NAL just parsed was assigned to a frame */
+	virtual void nal_assigned () = 0;
+	/* A NAL with a sc_len byte start code was added at offset */
+	virtual void nal_added (OMX_U32 offset, OMX_U32 sc_len) = 0;
+	/* frame is complete: send it on and replace it with the next frame
+	   to fill, NULL if there is none yet */
+	virtual OMX_ERRORTYPE frame_done (OMX_BUFFERHEADERTYPE *&frame) = 0;
+};
+
+/* Splits H.264/HEVC arbitrary bytes input into frames, one NAL per
+   call to split(). A NAL goes through scratch, unless in place parsing
+   is allowed and its header is already in the source: then the frame
+   it belongs to is decided before it is copied, and it is parsed
+   straight into that frame */
+class h264_frame_splitter
+{
+
+public:
+	h264_frame_splitter (frame_parse *frame_parser,
+	                     OMX_BUFFERHEADERTYPE *scratch_buf,
+	                     frame_splitter_client *splitter_client);
+	OMX_ERRORTYPE split (OMX_BUFFERHEADERTYPE *source,
+	                     OMX_BUFFERHEADERTYPE *&dest,
+	                     bool allow_in_place, bool nal_length_mode);
+	OMX_ERRORTYPE finish (OMX_BUFFERHEADERTYPE *dest, bool &new_frame);
+	void reset ();
+
+	unsigned nal_count;
+	bool look_ahead_nal;
+	/* the pending NAL (length in scratch) is parsed straight into the
+	   tail of dest rather than into scratch */
+	bool nal_in_place;
+
+private:
+	frame_parse *parser;
+	OMX_BUFFERHEADERTYPE *scratch;
+	frame_splitter_client *client;
+	bool append_scratch (OMX_BUFFERHEADERTYPE *dest);
+};
+
 #endif /* FRAMEPARSER_H */
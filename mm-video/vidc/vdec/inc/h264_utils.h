@@ -184,15 +184,20 @@ class H264_Utils
 {
 public:
     H264_Utils();
-    ~H264_Utils();
-    void initialize_frame_checking_environment();
+    virtual ~H264_Utils();
+    virtual void initialize_frame_checking_environment();
     void allocate_rbsp_buffer(uint32 inputBufferSize);
-    bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
-                    OMX_IN OMX_U32 size_of_nal_length_field,
-                    OMX_OUT OMX_BOOL &isNewFrame);
+    virtual bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
+                            OMX_IN OMX_U32 size_of_nal_length_field,
+                            OMX_OUT OMX_BOOL &isNewFrame);
+    virtual bool isNewFrame(OMX_IN OMX_U8 *nal,
+                            OMX_IN OMX_U32 nal_length,
+                            OMX_OUT OMX_BOOL &isNewFrame);
     uint32 nalu_type;
 
 private:
+    void check_new_frame(NALU &nal_unit, OMX_U32 numBytesInRBSP,
+                         OMX_BOOL &isNewFrame);
     boolean extract_rbsp(OMX_IN   OMX_U8  *buffer,
                          OMX_IN   OMX_U32 buffer_length,
                          OMX_IN   OMX_U32 size_of_nal_length_field,
@@ -237,6 +242,9 @@ class perf_metrics
 #define NO_PAN_SCAN_BIT   0x00000100
 #define MAX_PAN_SCAN_RECT 3
 #define VALID_TS(ts)      ((ts < LLONG_MAX)? true : false)
+/* NAL bytes needed to decide on a frame boundary from the NAL header and
+   first_mb_in_slice, with room for emulation prevention bytes */
+#define H264_NAL_PEEK_SIZE 16
 #define NALU_TYPE_VUI (NALU_TYPE_RESERVED + 1)
 
 enum SEI_PAYLOAD_TYPE
@@ -343,21 +351,9 @@ typedef struct
 } h264_pan_scan;
 
 #ifdef PANSCAN_HDLR
-template <class NODE_STRUCT>
-class omx_dl_list
-{
-public:
-  omx_dl_list() { head = tail = NULL; } ;
-  ~omx_dl_list() {};
-  void add_multiple(NODE_STRUCT *data_arr, int data_num);
-  NODE_STRUCT *remove_first();
-  NODE_STRUCT *remove_last();
-  void add_last(NODE_STRUCT *data_ptr);
-  NODE_STRUCT *watch_first();
-  NODE_STRUCT *watch_last();
-private:
-  NODE_STRUCT *head, *tail;
-};
+#define PANSCAN_RING_SIZE 32
+#define PANSCAN_HASH_BITS 6
+#define PANSCAN_HASH_SIZE (1 << PANSCAN_HASH_BITS)
 
 class panscan_handler
 {
@@ -374,11 +370,16 @@ private:
     h264_pan_scan pan_scan_param;
     OMX_S64  start_ts, end_ts;
     bool active;
-    PANSCAN_NODE *next, *prev;
+    bool used;
   } PANSCAN_NODE;
-  omx_dl_list<PANSCAN_NODE> panscan_used;
-  omx_dl_list<PANSCAN_NODE> panscan_free;
+  PANSCAN_NODE *node_at(int pos);
+  void release(PANSCAN_NODE *panscan_node);
+  int ts_hash(OMX_S64 frame_ts);
+  // Ring of panscan data in decode order, oldest entry at panscan_head
   PANSCAN_NODE *panscan_data;
+  int panscan_size, panscan_head, panscan_cnt;
+  // start_ts -> ring slot, checked against the slot's start_ts on lookup
+  int panscan_ts_slot[PANSCAN_HASH_SIZE];
 };
 
 #if 1 // Debug panscan data
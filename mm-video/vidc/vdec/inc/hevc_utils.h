@@ -0,0 +1,187 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef HEVC_UTILS_H
+#define HEVC_UTILS_H
+
+/*========================================================================
+
+                                 O p e n M M
+         U t i l i t i e s   a n d   H e l p e r   R o u t i n e s
+
+*//** @file hevc_utils.h
+This module contains HEVC video decoder utilities and helper routines.
+
+*//*====================================================================== */
+
+#include "h264_utils.h"
+
+/* NAL bytes needed to decide on an access unit boundary: the two byte
+   NAL unit header and first_slice_segment_in_pic_flag */
+#define HEVC_NAL_PEEK_SIZE 3
+#define HEVC_MAX_SUB_LAYERS 7
+#define HEVC_MAX_SHORT_TERM_RPS 64
+#define HEVC_MAX_DELTA_POCS 16
+/* hvcC: fixed part up to and including numOfArrays */
+#define HEVC_HVCC_HEADER_SIZE 23
+
+typedef enum {
+  HEVC_NALU_TYPE_RSV_VCL_N10 = 10,
+  HEVC_NALU_TYPE_BLA_W_LP = 16,
+  HEVC_NALU_TYPE_RSV_IRAP_VCL23 = 23,
+  HEVC_NALU_TYPE_RSV_VCL31 = 31,
+  HEVC_NALU_TYPE_VPS = 32,
+  HEVC_NALU_TYPE_SPS,
+  HEVC_NALU_TYPE_PPS,
+  HEVC_NALU_TYPE_AUD,
+  HEVC_NALU_TYPE_EOS,
+  HEVC_NALU_TYPE_EOB,
+  HEVC_NALU_TYPE_FD,
+  HEVC_NALU_TYPE_PREFIX_SEI,
+  HEVC_NALU_TYPE_SUFFIX_SEI,
+  HEVC_NALU_TYPE_RSV_NVCL41,
+  HEVC_NALU_TYPE_RSV_NVCL44 = 44,
+  HEVC_NALU_TYPE_UNSPEC48 = 48,
+  HEVC_NALU_TYPE_UNSPEC55 = 55
+} HEVC_NALU_TYPE;
+
+enum HEVC_SEI_PAYLOAD_TYPE
+{
+  HEVC_SEI_MASTERING_DISPLAY_COLOUR_VOLUME = 137,
+  HEVC_SEI_CONTENT_LIGHT_LEVEL_INFO = 144
+};
+
+typedef struct
+{
+  OMX_U8   aspect_ratio_info_present_flag;
+  h264_aspect_ratio_info aspect_ratio_info;
+  OMX_U8   video_signal_type_present_flag;
+  OMX_U8   video_full_range_flag;
+  OMX_U8   colour_primaries;
+  OMX_U8   transfer_characteristics;
+  OMX_U8   matrix_coeffs;
+  OMX_U8   field_seq_flag;
+  OMX_U8   timing_info_present_flag;
+  OMX_U32  num_units_in_tick;
+  OMX_U32  time_scale;
+} hevc_vui_param;
+
+typedef struct
+{
+  OMX_U32  num_negative;
+  OMX_U32  num_positive;
+  OMX_S32  delta_poc_s0[HEVC_MAX_DELTA_POCS];
+  OMX_S32  delta_poc_s1[HEVC_MAX_DELTA_POCS];
+} hevc_st_rps;
+
+/* Static HDR metadata: colour description from the VUI plus the
+   mastering display and content light level SEI messages */
+typedef struct
+{
+  OMX_U8   colour_primaries;
+  OMX_U8   transfer_characteristics;
+  OMX_U8   matrix_coeffs;
+  OMX_U8   video_full_range_flag;
+  bool     mastering_display_present;
+  OMX_U16  display_primaries_x[3];
+  OMX_U16  display_primaries_y[3];
+  OMX_U16  white_point_x;
+  OMX_U16  white_point_y;
+  OMX_U32  max_display_mastering_luminance;
+  OMX_U32  min_display_mastering_luminance;
+  bool     content_light_level_present;
+  OMX_U16  max_content_light_level;
+  OMX_U16  max_pic_average_light_level;
+} hevc_hdr_info;
+
+/* Access unit boundary detection for HEVC byte streams (7.4.2.4.4).
+   nalu_type is reported with the NALU_TYPE values of H.264 so that the
+   callers of H264_Utils work unchanged; the HEVC type is in hevc_nalu_type */
+class HEVC_Utils : public H264_Utils
+{
+public:
+    HEVC_Utils();
+    ~HEVC_Utils();
+    void initialize_frame_checking_environment();
+    bool isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
+                    OMX_IN OMX_U32 size_of_nal_length_field,
+                    OMX_OUT OMX_BOOL &isNewFrame);
+    bool isNewFrame(OMX_IN OMX_U8 *nal,
+                    OMX_IN OMX_U32 nal_length,
+                    OMX_OUT OMX_BOOL &isNewFrame);
+    uint32 hevc_nalu_type;
+
+private:
+    bool m_vcl_data;
+};
+
+class hevc_stream_parser
+{
+  public:
+    hevc_stream_parser();
+    ~hevc_stream_parser();
+    void reset();
+    void parse_nal(OMX_U8* data_ptr, OMX_U32 data_len);
+    void fill_aspect_ratio_info(OMX_QCOM_ASPECT_RATIO *dest_aspect_ratio);
+    void get_frame_rate(OMX_U32 *frame_rate);
+    bool get_hdr_info(hevc_hdr_info *hdr);
+  private:
+    void init_bitstream(OMX_U8* data, OMX_U32 size);
+    OMX_U32 extract_bits(OMX_U32 n);
+    void skip_bits(OMX_U32 n);
+    OMX_U32 uev();
+    OMX_S32 sev();
+    void parse_sps();
+    void profile_tier_level(OMX_U32 max_sub_layers_minus1);
+    void scaling_list_data();
+    bool st_ref_pic_set(OMX_U32 idx);
+    void parse_vui();
+    void parse_sei();
+    void sei_mastering_display();
+    void sei_content_light_level();
+
+    OMX_U8* bitstream;
+    OMX_U32 bitstream_bytes;
+    OMX_U32 byte_pos;
+    OMX_U32 bit_pos;
+    OMX_U32 zero_cntr;
+    OMX_U32 bits_read;
+    bool    overrun;
+
+    hevc_vui_param vui_param;
+    hevc_hdr_info  hdr_info;
+    hevc_st_rps    st_rps[HEVC_MAX_SHORT_TERM_RPS];
+};
+
+/* Unpacks the parameter set arrays of an hvcC record into NAL units
+   prefixed with a nal_length byte big endian length. With dest NULL the
+   record is only validated and sized, otherwise each NAL unit is also
+   handed to parser. Returns the unpacked size, 0 if the record is bad */
+OMX_U32 hevc_unpack_hvcc(OMX_U8 *src, OMX_U32 src_size, OMX_U32 nal_length,
+                         OMX_U8 *dest, hevc_stream_parser *parser);
+
+#endif /* HEVC_UTILS_H */
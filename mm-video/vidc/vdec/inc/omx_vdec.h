@@ -112,6 +112,7 @@ extern "C"{
 #endif
 #include "extra_data_handler.h"
 #include "ts_parser.h"
+#include "vdec_output_table.h"
 #include "vidc_color_converter.h"
 extern "C" {
   OMX_API void * get_omx_component_factory_fn(void);
@@ -188,6 +189,8 @@ extern "C" {
 #define OMX_CORE_WVGA_WIDTH          800
 
 #define DESC_BUFFER_SIZE (8192 * 16)
+#define DEMUX_OFFSETS_INIT_SIZE 256
+#define VDEC_CACHE_LINE_SIZE 64
 
 #ifdef _ANDROID_
 #define MAX_NUM_INPUT_OUTPUT_BUFFERS 32
@@ -198,6 +201,7 @@ extern "C" {
 #define OMX_TIMEINFO_EXTRADATA  0x00040000
 #define OMX_PORTDEF_EXTRADATA   0x00080000
 #define OMX_EXTNUSER_EXTRADATA  0x00100000
+#define MAX_EXTRADATA_RECORDS   4
 #define DRIVER_EXTRADATA_MASK   0x0000FFFF
 
 #define OMX_INTERLACE_EXTRADATA_SIZE ((sizeof(OMX_OTHER_EXTRADATATYPE) +\
@@ -220,6 +224,7 @@ enum port_indexes
     OMX_CORE_INPUT_PORT_INDEX        =0,
     OMX_CORE_OUTPUT_PORT_INDEX       =1
 };
+
 #ifdef USE_ION
 struct vdec_ion
 {
@@ -522,6 +527,7 @@ private:
     {
         OMX_U8 *buf_addr;
         OMX_U32 desc_data_size;
+        OMX_U32 alloc_size;
     };
     bool allocate_done(void);
     bool allocate_input_done(void);
@@ -566,6 +572,7 @@ private:
 
     OMX_ERRORTYPE allocate_desc_buffer(OMX_U32 index);
     OMX_ERRORTYPE allocate_output_headers();
+    OMX_ERRORTYPE allocate_output_header_table();
     bool execute_omx_flush(OMX_U32);
     bool execute_output_flush();
     bool execute_input_flush();
@@ -584,6 +591,9 @@ private:
     OMX_ERRORTYPE push_input_buffer (OMX_HANDLETYPE hComp);
     OMX_ERRORTYPE push_input_sc_codec (OMX_HANDLETYPE hComp);
     OMX_ERRORTYPE push_input_h264 (OMX_HANDLETYPE hComp);
+    void set_h264_frame_ts();
+    void update_h264_last_au_ts();
+    void parse_h264_nal_side_data(OMX_U8 *nal, OMX_U32 nal_len);
     OMX_ERRORTYPE push_input_vc1 (OMX_HANDLETYPE hComp);
 
     OMX_ERRORTYPE fill_this_buffer_proxy(OMX_HANDLETYPE       hComp,
@@ -593,6 +603,8 @@ private:
     bool release_output_done();
     bool release_input_done();
     OMX_ERRORTYPE get_buffer_req(vdec_allocatorproperty *buffer_prop);
+    unsigned int get_output_extradata_size();
+    bool output_buffers_fit();
     OMX_ERRORTYPE set_buffer_req(vdec_allocatorproperty *buffer_prop);
     OMX_ERRORTYPE start_port_reconfig();
     OMX_ERRORTYPE update_picture_resolution();
@@ -601,6 +613,7 @@ private:
     void set_frame_rate(OMX_S64 act_timestamp);
     void handle_extradata_secure(OMX_BUFFERHEADERTYPE *p_buf_hdr);
     void handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr);
+    void update_extradata_records();
     OMX_ERRORTYPE enable_extradata(OMX_U32 requested_extradata, bool enable = true);
     void print_debug_extradata(OMX_OTHER_EXTRADATATYPE *extra);
 #ifdef DISPLAYCAF
@@ -629,6 +642,9 @@ private:
     void append_extn_extradata(OMX_OTHER_EXTRADATATYPE *extra, OMX_OTHER_EXTRADATATYPE *p_extn);
     void append_user_extradata(OMX_OTHER_EXTRADATATYPE *extra, OMX_OTHER_EXTRADATATYPE *p_user);
     void insert_demux_addr_offset(OMX_U32 address_offset);
+    void insert_demux_nal_offset(OMX_U32 address_offset, OMX_U32 sc_len);
+    bool rewrite_nal_length_prefixes(OMX_U8 *buf, OMX_U32 len,
+                                     bool record_offsets);
     void extract_demux_addr_offsets(OMX_BUFFERHEADERTYPE *buf_hdr);
     OMX_ERRORTYPE handle_demux_data(OMX_BUFFERHEADERTYPE *buf_hdr);
     OMX_U32 count_MB_in_extradata(OMX_OTHER_EXTRADATATYPE *extra);
@@ -713,6 +729,8 @@ private:
     OMX_BUFFERHEADERTYPE  *m_inp_mem_ptr;
     // Output memory pointer
     OMX_BUFFERHEADERTYPE  *m_out_mem_ptr;
+    // Output buffer owners, indexed like m_out_mem_ptr
+    OMX_U32               *m_out_buf_state;
     // number of input bitstream error frame count
     unsigned int m_inp_err_count;
 #ifdef _ANDROID_
@@ -770,6 +788,22 @@ private:
     omx_cmd_queue m_input_free_q;
     bool arbitrary_bytes;
     OMX_BUFFERHEADERTYPE  h264_scratch;
+    /* Passes what m_h264_splitter finds on to the H.264 helpers */
+    class h264_splitter_client: public frame_splitter_client
+    {
+    public:
+        h264_splitter_client(omx_vdec *vdec): m_vdec(vdec), m_hcomp(NULL) {}
+        void nal_parsed(OMX_U8 *nal, OMX_U32 nal_len);
+        void stamp_frame();
+        void nal_assigned();
+        void nal_added(OMX_U32 offset, OMX_U32 sc_len);
+        OMX_ERRORTYPE frame_done(OMX_BUFFERHEADERTYPE *&frame);
+
+        omx_vdec *m_vdec;
+        OMX_HANDLETYPE m_hcomp;
+    };
+    h264_splitter_client m_h264_client;
+    h264_frame_splitter m_h264_splitter;
     OMX_BUFFERHEADERTYPE  *psource_frame;
     OMX_BUFFERHEADERTYPE  *pdest_frame;
     OMX_BUFFERHEADERTYPE  *m_inp_heap_ptr;
@@ -778,9 +812,16 @@ private:
     codec_type codec_type_parse;
     bool first_frame_meta;
     unsigned frame_count;
-    unsigned nal_count;
     unsigned nal_length;
-    bool look_ahead_nal;
+    /* 4 byte NAL length prefixes are rewritten into start codes in the
+       input buffer itself; the walk state carries across buffers */
+    bool nal_length_in_place;
+    OMX_U32 avcc_nal_left;
+    OMX_U32 avcc_prefix;
+    OMX_U32 avcc_prefix_bytes;
+    /* thumbnail mode: stop decoding once one picture has been output */
+    bool m_thumbnail_mode;
+    bool m_thumbnail_done;
     int first_frame;
     unsigned char *first_buffer;
     int first_frame_size;
@@ -789,8 +830,12 @@ private:
     enum vc1_profile_type m_vc1_profile;
     OMX_S64 h264_last_au_ts;
     OMX_U32 h264_last_au_flags;
-    OMX_U32 m_demux_offsets[8192];
+    /* start code offsets of the frame about to be queued, grown on demand */
+    OMX_U32 *m_demux_offsets;
     OMX_U32 m_demux_entries;
+    OMX_U32 m_demux_capacity;
+    // start code length of the last entry added by insert_demux_nal_offset
+    OMX_U32 m_demux_last_sc_len;
     OMX_U32 m_disp_hor_size;
     OMX_U32 m_disp_vert_size;
 
@@ -802,7 +847,11 @@ private:
     bool in_reconfig;
     OMX_NATIVE_WINDOWTYPE m_display_id;
     h264_stream_parser *h264_parser;
+    hevc_stream_parser *hevc_parser;
     OMX_U32 client_extradata;
+    /* enabled OMX extradata records, in the order they are appended */
+    OMX_U32 m_extradata_records[MAX_EXTRADATA_RECORDS];
+    OMX_U32 m_extradata_record_cnt;
 #ifdef _ANDROID_
     bool m_debug_timestamp;
     bool perf_flag;
@@ -813,6 +862,7 @@ private:
     bool m_use_android_native_buffers;
     bool m_debug_extradata;
     bool m_debug_concealedmb;
+    bool m_debug_panframedata;
 #endif
 #ifdef MAX_RES_1080P
     MP4_Utils mp4_headerparser;
@@ -858,6 +908,20 @@ private:
     // added for smooth streaming
     private_handle_t * native_buffer[MAX_NUM_INPUT_OUTPUT_BUFFERS];
     bool m_use_smoothstreaming;
+    /* driver keeps the output buffers across resolution changes they
+       can hold, only the geometry of the native buffers is updated */
+    bool m_reconfig_in_place;
+    /* keep-buffers mode was turned on by the native buffer path */
+    bool m_reconfig_in_place_drv;
+    /* vidc.dec.reconfig.inplace, native buffers only keep-buffers mode */
+    bool m_reconfig_in_place_allowed;
+    /* geometry of the frame each output buffer holds; frames decoded
+       before a resolution change keep the old one until the first frame
+       at the new crop takes m_pending_dim */
+    BufferDim_t m_out_dim[MAX_NUM_INPUT_OUTPUT_BUFFERS];
+    BufferDim_t m_frame_dim;
+    BufferDim_t m_pending_dim;
+    bool m_dim_pending;
 
     unsigned int m_fill_output_msg;
     class allocate_color_convert_buf {
@@ -0,0 +1,54 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef VDEC_OUTPUT_TABLE_H
+#define VDEC_OUTPUT_TABLE_H
+
+#include <linux/msm_vidc_dec.h>
+#include "OMX_Core.h"
+
+// Output buffer owner, one entry per output buffer header
+enum vdec_out_buf_state
+{
+    VDEC_OUT_BUF_UNUSED,
+    VDEC_OUT_BUF_WITH_CLIENT,
+    VDEC_OUT_BUF_WITH_DRIVER
+};
+
+/* Per frame output bookkeeping, done through the buffer index only: the
+   owner array, the driver payload table on FTB, and the header and the
+   response table entry on FBD. */
+bool vdec_output_queue(OMX_U32 *state,
+                       const struct vdec_bufferpayload *payload,
+                       OMX_U32 index, void *client_data,
+                       struct vdec_fillbuffer_cmd *fill);
+bool vdec_output_done(OMX_U32 *state,
+                      struct vdec_output_frameinfo *resp,
+                      OMX_BUFFERHEADERTYPE *hdr, OMX_U32 index,
+                      const struct vdec_output_frameinfo *frame);
+
+#endif /* VDEC_OUTPUT_TABLE_H */
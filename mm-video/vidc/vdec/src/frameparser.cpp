@@ -125,6 +125,12 @@ int frame_parse::init_start_codes (codec_type codec_type_parse)
                 start_code = MPEG2_start_code;
                 mask_code = MPEG2_mask_code;
                 break;
+	case CODEC_TYPE_HEVC:
+		/* Same Annex B byte stream format as H.264, access units
+		   are put together by HEVC_Utils */
+		start_code = H264_start_code;
+		mask_code = H264_mask_code;
+		break;
         }
 	return 1;
 }
@@ -623,6 +629,13 @@ void frame_parse::flush ()
     skip_frame_boundary = false;
 }
 
+/* True when the last parse stopped right after a start code, i.e. the
+   next source byte is the first byte of the next NAL/frame header */
+bool frame_parse::start_code_found ()
+{
+    return (parse_state == A4 || parse_state == A5);
+}
+
 void frame_parse::parse_additional_start_code(OMX_U8 *psource,
                 OMX_U32 *parsed_length)
 {
@@ -673,3 +686,258 @@ void frame_parse::update_skip_frame()
         skip_frame_boundary = true;
     }
 }
+
+/* Length of the start code data begins with, 0 if there is none */
+static OMX_U32 start_code_length(const OMX_U8 *data, OMX_U32 len)
+{
+    if (len >= 4 && !data[0] && !data[1] && !data[2] && data[3] == 0x01)
+        return 4;
+    if (len >= 3 && !data[0] && !data[1] && data[2] == 0x01)
+        return 3;
+    return 0;
+}
+
+h264_frame_splitter::h264_frame_splitter (frame_parse *frame_parser,
+                                          OMX_BUFFERHEADERTYPE *scratch_buf,
+                                          frame_splitter_client *splitter_client):
+                                          nal_count(0),
+                                          look_ahead_nal(false),
+                                          nal_in_place(false),
+                                          parser(frame_parser),
+                                          scratch(scratch_buf),
+                                          client(splitter_client)
+{
+}
+
+void h264_frame_splitter::reset ()
+{
+    nal_count = 0;
+    look_ahead_nal = false;
+    nal_in_place = false;
+}
+
+/* Move the NAL in scratch to the end of dest */
+bool h264_frame_splitter::append_scratch (OMX_BUFFERHEADERTYPE *dest)
+{
+    if ((dest->nAllocLen - dest->nFilledLen) < scratch->nFilledLen)
+        return false;
+    if (scratch->nFilledLen)
+        client->nal_added(dest->nFilledLen,
+            start_code_length(scratch->pBuffer, scratch->nFilledLen));
+    memcpy (dest->pBuffer + dest->nFilledLen,
+            scratch->pBuffer, scratch->nFilledLen);
+    dest->nFilledLen += scratch->nFilledLen;
+    scratch->nFilledLen = 0;
+    return true;
+}
+
+/* Parse the next NAL out of source and add it to dest, sending dest on
+   through the client first when the NAL starts a new frame. dest is
+   left NULL when no frame is free to take its place */
+OMX_ERRORTYPE h264_frame_splitter::split (OMX_BUFFERHEADERTYPE *source,
+                                          OMX_BUFFERHEADERTYPE *&dest,
+                                          bool allow_in_place,
+                                          bool nal_length_mode)
+{
+    OMX_U32 partial_frame = 1;
+    OMX_BOOL isNewFrame = OMX_FALSE;
+    OMX_ERRORTYPE ret;
+
+    DEBUG_PRINT_LOW("\n Pending scratch nFilledLen %d look_ahead_nal %d",
+                    scratch->nFilledLen, look_ahead_nal);
+    DEBUG_PRINT_LOW("\n Pending dest nFilledLen %d", dest->nFilledLen);
+    if (scratch->nFilledLen && look_ahead_nal)
+    {
+        look_ahead_nal = false;
+        if (!append_scratch(dest))
+        {
+            DEBUG_PRINT_ERROR("\n Error:1: Destination buffer overflow for H264");
+            return OMX_ErrorBadParameter;
+        }
+        DEBUG_PRINT_LOW("\n Copy the previous NAL (scratch) into Dest frame");
+    }
+    if (!nal_in_place && allow_in_place && !nal_length_mode && nal_count &&
+        !scratch->nFilledLen && parser->start_code_found() &&
+        source->nFilledLen >= H264_NAL_PEEK_SIZE)
+    {
+        /* The next NAL header sits right at the source offset: decide
+           which frame the NAL belongs to before copying it. The frame
+           is stamped before the NAL is parsed, so clients that need the
+           NAL parsed first do not allow in place parsing */
+        parser->mutils->isNewFrame(source->pBuffer + source->nOffset,
+                                   H264_NAL_PEEK_SIZE, isNewFrame);
+        nal_count++;
+        nal_in_place = true;
+        client->stamp_frame();
+        if (isNewFrame && dest->nFilledLen)
+        {
+            dest->nFlags &= ~OMX_BUFFERFLAG_EOS;
+            ret = client->frame_done(dest);
+            if (ret != OMX_ErrorNone)
+                return ret;
+            /* Parse the NAL once the next frame buffer is available */
+            if (dest == NULL)
+                return OMX_ErrorNone;
+        }
+    }
+    if (nal_in_place)
+    {
+        OMX_BUFFERHEADERTYPE nal_dest = *scratch;
+        nal_dest.pBuffer = dest->pBuffer + dest->nFilledLen;
+        nal_dest.nAllocLen = dest->nAllocLen - dest->nFilledLen;
+        nal_dest.nOffset = 0;
+        if (parser->parse_sc_frame(source, &nal_dest, &partial_frame) == -1)
+        {
+            DEBUG_PRINT_ERROR("\n Error In Parsing Return Error");
+            return OMX_ErrorBadParameter;
+        }
+        scratch->nFilledLen = nal_dest.nFilledLen;
+        scratch->nTimeStamp = nal_dest.nTimeStamp;
+        scratch->nFlags = nal_dest.nFlags;
+    }
+    else if (!nal_length_mode)
+    {
+        DEBUG_PRINT_LOW("\n Zero NAL, hence parse using start code");
+        if (parser->parse_sc_frame(source, scratch, &partial_frame) == -1)
+        {
+            DEBUG_PRINT_ERROR("\n Error In Parsing Return Error");
+            return OMX_ErrorBadParameter;
+        }
+    }
+    else
+    {
+        DEBUG_PRINT_LOW("\n Non-zero NAL length clip, hence parse with NAL size");
+        if (parser->parse_h264_nallength(source, scratch, &partial_frame) == -1)
+        {
+            DEBUG_PRINT_ERROR("\n Error In Parsing NAL size, Return Error");
+            return OMX_ErrorBadParameter;
+        }
+    }
+
+    if (partial_frame)
+    {
+        DEBUG_PRINT_LOW("\n Not a Complete Frame, dest nFilledLen %d", dest->nFilledLen);
+        /*Check if Destination Buffer is full*/
+        if (nal_in_place ?
+            (dest->nAllocLen == dest->nFilledLen + scratch->nFilledLen) :
+            (scratch->nAllocLen == scratch->nFilledLen + scratch->nOffset))
+        {
+            DEBUG_PRINT_ERROR("\nERROR: Frame Not found though Destination Filled");
+            return OMX_ErrorStreamCorrupt;
+        }
+        return OMX_ErrorNone;
+    }
+
+    if (nal_count == 0 && scratch->nFilledLen == 0)
+    {
+        DEBUG_PRINT_LOW("\n First NAL with Zero Length, hence Skip");
+        nal_count++;
+        scratch->nTimeStamp = source->nTimeStamp;
+        scratch->nFlags = source->nFlags;
+    }
+    else if (nal_in_place)
+    {
+        OMX_U8 *nal = dest->pBuffer + dest->nFilledLen;
+        DEBUG_PRINT_LOW("\n Parsed New NAL in place Length = %d", scratch->nFilledLen);
+        client->nal_parsed(nal, scratch->nFilledLen);
+        client->nal_assigned();
+        client->nal_added(dest->nFilledLen,
+            start_code_length(nal, scratch->nFilledLen));
+        dest->nFilledLen += scratch->nFilledLen;
+        if (parser->mutils->nalu_type == NALU_TYPE_EOSEQ)
+            dest->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
+        scratch->nFilledLen = 0;
+        nal_in_place = false;
+    }
+    else
+    {
+        DEBUG_PRINT_LOW("\n Parsed New NAL Length = %d", scratch->nFilledLen);
+        if (scratch->nFilledLen)
+        {
+            client->nal_parsed(scratch->pBuffer, scratch->nFilledLen);
+            parser->mutils->isNewFrame(scratch, 0, isNewFrame);
+            nal_count++;
+            client->stamp_frame();
+            client->nal_assigned();
+        }
+
+        if (!isNewFrame)
+        {
+            DEBUG_PRINT_LOW("\n Not a NewFrame Copy into Dest len %d",
+                            scratch->nFilledLen);
+            if (!append_scratch(dest))
+            {
+                DEBUG_PRINT_LOW("\n Error:2: Destination buffer overflow for H264");
+                return OMX_ErrorBadParameter;
+            }
+            if (parser->mutils->nalu_type == NALU_TYPE_EOSEQ)
+                dest->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
+        }
+        else if (scratch->nFilledLen)
+        {
+            if (dest->nFilledLen == 0)
+            {
+                DEBUG_PRINT_LOW("\n Copy the Current Frame since and push it");
+                if (!append_scratch(dest))
+                {
+                    DEBUG_PRINT_ERROR("\n Error:3: Destination buffer overflow for H264");
+                    return OMX_ErrorBadParameter;
+                }
+            }
+            else
+            {
+                /* The NAL waits in scratch until the next call */
+                look_ahead_nal = true;
+                if (source->nFilledLen || scratch->nFilledLen)
+                {
+                    DEBUG_PRINT_LOW("\n Reset the EOS Flag");
+                    dest->nFlags &= ~OMX_BUFFERFLAG_EOS;
+                }
+                ret = client->frame_done(dest);
+                if (ret != OMX_ErrorNone)
+                    return ret;
+            }
+        }
+    }
+    return OMX_ErrorNone;
+}
+
+/* End of stream: the NAL left over has no start code behind it to end
+   it. It is added to dest, unless it starts a new frame while dest
+   holds one: new_frame is set then and the NAL stays in scratch */
+OMX_ERRORTYPE h264_frame_splitter::finish (OMX_BUFFERHEADERTYPE *dest,
+                                           bool &new_frame)
+{
+    OMX_BOOL isNewFrame = OMX_FALSE;
+
+    new_frame = false;
+    if (nal_in_place)
+    {
+        /* The last NAL is already in the frame it was found to belong
+           to, just account for it */
+        if (scratch->nFilledLen)
+            client->nal_added(dest->nFilledLen,
+                start_code_length(dest->pBuffer + dest->nFilledLen,
+                                  scratch->nFilledLen));
+        dest->nFilledLen += scratch->nFilledLen;
+        scratch->nFilledLen = 0;
+        nal_in_place = false;
+        return OMX_ErrorNone;
+    }
+    if ((dest->nAllocLen - dest->nFilledLen) < scratch->nFilledLen)
+    {
+        DEBUG_PRINT_ERROR("\nERROR:4: Destination buffer overflow for H264");
+        return OMX_ErrorBadParameter;
+    }
+    if (dest->nFilledLen)
+    {
+        parser->mutils->isNewFrame(scratch, 0, isNewFrame);
+        if (isNewFrame)
+        {
+            new_frame = true;
+            return OMX_ErrorNone;
+        }
+    }
+    append_scratch(dest);
+    return OMX_ErrorNone;
+}
@@ -385,7 +385,6 @@ bool H264_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
                             OMX_OUT OMX_BOOL &isNewFrame)
 {
     NALU nal_unit;
-    uint16 first_mb_in_slice = 0;
     OMX_IN OMX_U32 numBytesInRBSP = 0;
     OMX_IN OMX_U8 *buffer = p_buf_hdr->pBuffer;
     OMX_IN OMX_U32 buffer_length = p_buf_hdr->nFilledLen;
@@ -404,72 +403,155 @@ bool H264_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
     }
     else
     {
-      nalu_type = nal_unit.nalu_type;
-      switch (nal_unit.nalu_type)
+      check_new_frame(nal_unit, numBytesInRBSP, isNewFrame);
+    }
+    m_prv_nalu = nal_unit;
+    ALOGV("get_h264_nal_type - newFrame value %d\n",isNewFrame);
+    return eRet;
+}
+
+/*===========================================================================
+FUNCTION:
+  H264_Utils::isNewFrame
+
+DESCRIPTION:
+  Same decision as above, made from the first bytes of a NAL in place.
+  Only the NAL header and the start of the slice header are looked at,
+  so the caller can decide where a NAL goes before copying it.
+
+INPUT/OUTPUT PARAMETERS:
+  <In>
+    nal : NAL unit starting at the NAL header byte (no start code)
+    nal_length : bytes available at nal, H264_NAL_PEEK_SIZE is enough
+  <out>
+    isNewFrame: true if the NAL belongs to a differenet frame
+                false if the NAL belongs to a current frame
+
+RETURN VALUE:
+  boolean  true, if nal parsing is successful
+           false, if the nal parsing has errors
+
+SIDE EFFECTS:
+  None.
+===========================================================================*/
+bool H264_Utils::isNewFrame(OMX_IN OMX_U8 *nal,
+                            OMX_IN OMX_U32 nal_length,
+                            OMX_OUT OMX_BOOL &isNewFrame)
+{
+    NALU nal_unit;
+    OMX_U32 numBytesInRBSP = 0;
+    OMX_U32 zero_count = 0;
+    OMX_U32 pos = 1;
+
+    if (nal == NULL || nal_length == 0)
+    {
+        ALOGE("ERROR: In %s() - empty NAL", __func__);
+        isNewFrame = OMX_FALSE;
+        return false;
+    }
+    nal_unit.forbidden_zero_bit = nal[0] & 0x80;
+    nal_unit.nal_ref_idc = (nal[0] & 0x60) >> 5;
+    nal_unit.nalu_type = nal[0] & 0x1f;
+
+    if (nal_length > H264_NAL_PEEK_SIZE)
+      nal_length = H264_NAL_PEEK_SIZE;
+    while (pos < nal_length)
+    {
+      if (zero_count == 2)
       {
-        case NALU_TYPE_IDR:
-        case NALU_TYPE_NON_IDR:
+        if (nal[pos] == EMULATION_PREVENTION_THREE_BYTE)
         {
-          ALOGV("\n AU Boundary with NAL type %d ",nal_unit.nalu_type);
-          if (m_forceToStichNextNAL)
-          {
-            isNewFrame = OMX_FALSE;
-          }
-          else
-          {
-            RbspParser rbsp_parser(m_rbspBytes, (m_rbspBytes+numBytesInRBSP));
-            first_mb_in_slice = rbsp_parser.ue();
-
-            if((!first_mb_in_slice) || /*(slice.prv_frame_num != slice.frame_num ) ||*/
-               ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
-               /*( ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) && (nal_unit.nalu_type == NALU_TYPE_IDR)) && (slice.idr_pic_id != slice.prv_idr_pic_id) ) || */
-               ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) )
-            {
-              //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
-              isNewFrame = OMX_TRUE;
-            }
-            else
-            {
-              isNewFrame = OMX_FALSE;
-            }
-          }
-          m_au_data = true;
-          m_forceToStichNextNAL = false;
+          pos++;
+          zero_count = 0;
+          continue;
+        }
+        if (nal[pos] <= 0x01)
+        {
+          numBytesInRBSP -= 2;
           break;
         }
-        case NALU_TYPE_SPS:
-        case NALU_TYPE_PPS:
-        case NALU_TYPE_SEI:
+        zero_count = 0;
+      }
+      zero_count++;
+      if (nal[pos] != 0)
+        zero_count = 0;
+      m_rbspBytes[numBytesInRBSP++] = nal[pos++];
+    }
+
+    check_new_frame(nal_unit, numBytesInRBSP, isNewFrame);
+    m_prv_nalu = nal_unit;
+    ALOGV("isNewFrame: in place nal type %d newFrame %d",
+        nal_unit.nalu_type, isNewFrame);
+    return true;
+}
+
+void H264_Utils::check_new_frame(NALU &nal_unit, OMX_U32 numBytesInRBSP,
+                                 OMX_BOOL &isNewFrame)
+{
+    uint16 first_mb_in_slice = 0;
+
+    nalu_type = nal_unit.nalu_type;
+    switch (nal_unit.nalu_type)
+    {
+      case NALU_TYPE_IDR:
+      case NALU_TYPE_NON_IDR:
+      {
+        ALOGV("\n AU Boundary with NAL type %d ",nal_unit.nalu_type);
+        if (m_forceToStichNextNAL)
+        {
+          isNewFrame = OMX_FALSE;
+        }
+        else
         {
-          ALOGV("\n Non-AU boundary with NAL type %d", nal_unit.nalu_type);
-          if(m_au_data)
+          RbspParser rbsp_parser(m_rbspBytes, (m_rbspBytes+numBytesInRBSP));
+          first_mb_in_slice = rbsp_parser.ue();
+
+          if((!first_mb_in_slice) || /*(slice.prv_frame_num != slice.frame_num ) ||*/
+             ( (m_prv_nalu.nal_ref_idc != nal_unit.nal_ref_idc) && ( nal_unit.nal_ref_idc * m_prv_nalu.nal_ref_idc == 0 ) ) ||
+             /*( ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) && (nal_unit.nalu_type == NALU_TYPE_IDR)) && (slice.idr_pic_id != slice.prv_idr_pic_id) ) || */
+             ( (m_prv_nalu.nalu_type != nal_unit.nalu_type ) && ((m_prv_nalu.nalu_type == NALU_TYPE_IDR) || (nal_unit.nalu_type == NALU_TYPE_IDR)) ) )
           {
+            //ALOGV("Found a New Frame due to NALU_TYPE_IDR/NALU_TYPE_NON_IDR");
             isNewFrame = OMX_TRUE;
-            m_au_data = false;
           }
           else
           {
-            isNewFrame =  OMX_FALSE;
+            isNewFrame = OMX_FALSE;
           }
-
-          m_forceToStichNextNAL = true;
-          break;
         }
-        case NALU_TYPE_ACCESS_DELIM:
-        case NALU_TYPE_UNSPECIFIED:
-        case NALU_TYPE_EOSEQ:
-        case NALU_TYPE_EOSTREAM:
-        default:
+        m_au_data = true;
+        m_forceToStichNextNAL = false;
+        break;
+      }
+      case NALU_TYPE_SPS:
+      case NALU_TYPE_PPS:
+      case NALU_TYPE_SEI:
+      {
+        ALOGV("\n Non-AU boundary with NAL type %d", nal_unit.nalu_type);
+        if(m_au_data)
+        {
+          isNewFrame = OMX_TRUE;
+          m_au_data = false;
+        }
+        else
         {
           isNewFrame =  OMX_FALSE;
-          // Do not update m_forceToStichNextNAL
-          break;
         }
-      } // end of switch
-    } // end of if
-    m_prv_nalu = nal_unit;
-    ALOGV("get_h264_nal_type - newFrame value %d\n",isNewFrame);
-    return eRet;
+
+        m_forceToStichNextNAL = true;
+        break;
+      }
+      case NALU_TYPE_ACCESS_DELIM:
+      case NALU_TYPE_UNSPECIFIED:
+      case NALU_TYPE_EOSEQ:
+      case NALU_TYPE_EOSTREAM:
+      default:
+      {
+        isNewFrame =  OMX_FALSE;
+        // Do not update m_forceToStichNextNAL
+        break;
+      }
+    } // end of switch
 }
 
 void perf_metrics::start()
@@ -529,7 +611,7 @@ h264_stream_parser::h264_stream_parser()
   {
     ALOGE("ERROR: Panscan hdl was not allocated!");
   }
-  else if (!panscan_hdl->initialize(10))
+  else if (!panscan_hdl->initialize(PANSCAN_RING_SIZE))
   {
     ALOGE("ERROR: Allocating memory for panscan!");
     delete panscan_hdl;
@@ -1519,7 +1601,11 @@ OMX_S64 h264_stream_parser::process_ts_with_sei_vui(OMX_S64 timestamp)
 
 #ifdef PANSCAN_HDLR
 
-panscan_handler::panscan_handler() : panscan_data(NULL) {}
+panscan_handler::panscan_handler() : panscan_data(NULL), panscan_size(0),
+  panscan_head(0), panscan_cnt(0)
+{
+  memset(panscan_ts_slot, -1, sizeof(panscan_ts_slot));
+}
 
 panscan_handler::~panscan_handler()
 {
@@ -1533,172 +1619,149 @@ panscan_handler::~panscan_handler()
 bool panscan_handler::initialize(int num_data)
 {
   bool ret = false;
-  if (!panscan_data)
+  if (panscan_data)
   {
-    panscan_data = (PANSCAN_NODE *) malloc (sizeof(PANSCAN_NODE) * num_data);
+    ALOGE("ERROR: Old panscan memory must be freed to allocate new");
+  }
+  else if (num_data <= 0 || num_data > PANSCAN_HASH_SIZE / 2)
+  {
+    ALOGE("ERROR: Invalid panscan ring size(%d)", num_data);
+  }
+  else
+  {
+    panscan_data = (PANSCAN_NODE *) calloc (num_data, sizeof(PANSCAN_NODE));
     if (panscan_data)
     {
-      panscan_free.add_multiple(panscan_data, num_data);
+      panscan_size = num_data;
       ret = true;
     }
   }
-  else
+  return ret;
+}
+
+panscan_handler::PANSCAN_NODE *panscan_handler::node_at(int pos)
+{
+  return &panscan_data[(panscan_head + pos) % panscan_size];
+}
+
+int panscan_handler::ts_hash(OMX_S64 frame_ts)
+{
+  // Fibonacci hashing, timestamps are usually multiples of the frame period
+  return (int)(((OMX_U64)frame_ts * 0x9E3779B97F4A7C15ULL) >>
+               (64 - PANSCAN_HASH_BITS));
+}
+
+void panscan_handler::release(PANSCAN_NODE *panscan_node)
+{
+  panscan_node->used = false;
+  // Entries released out of decode order stay in the ring
+  // until everything older than them is released as well
+  while (panscan_cnt && !node_at(0)->used)
   {
-    ALOGE("ERROR: Old panscan memory must be freed to allocate new");
+    panscan_head = (panscan_head + 1) % panscan_size;
+    panscan_cnt--;
   }
-  return ret;
 }
 
 h264_pan_scan *panscan_handler::get_free()
 {
-  h264_pan_scan *data = NULL;
-  PANSCAN_NODE *panscan_node = panscan_used.watch_last();
-  panscan_node = (!panscan_node || VALID_TS(panscan_node->start_ts))?
-                 panscan_free.remove_first() :
-                 panscan_used.remove_last();
-  if (panscan_node)
+  PANSCAN_NODE *panscan_node = NULL;
+  if (!panscan_data)
+    return NULL;
+  if (panscan_cnt)
+    panscan_node = node_at(panscan_cnt - 1);
+  if (!panscan_node || !panscan_node->used ||
+      VALID_TS(panscan_node->start_ts))
   {
-    panscan_node->start_ts = LLONG_MAX;
-    panscan_node->end_ts = LLONG_MAX;
-    panscan_node->pan_scan_param.rect_id = NO_PAN_SCAN_BIT;
-    panscan_node->active = false;
-    panscan_used.add_last(panscan_node);
-    data = &panscan_node->pan_scan_param;
+    // Recycle the oldest entry when the ring is full
+    if (panscan_cnt == panscan_size)
+      release(node_at(0));
+    panscan_node = node_at(panscan_cnt++);
   }
-  return data;
+  panscan_node->start_ts = LLONG_MAX;
+  panscan_node->end_ts = LLONG_MAX;
+  panscan_node->pan_scan_param.rect_id = NO_PAN_SCAN_BIT;
+  panscan_node->active = false;
+  panscan_node->used = true;
+  return &panscan_node->pan_scan_param;
 }
 
 h264_pan_scan *panscan_handler::get_populated(OMX_S64 frame_ts)
 {
   h264_pan_scan *data = NULL;
-  PANSCAN_NODE *panscan_node = panscan_used.watch_first();
-  while (panscan_node && !data)
+  PANSCAN_NODE *panscan_node = NULL;
+  PANSCAN_NODE *oldest;
+  if (VALID_TS(frame_ts))
+  {
+    // Frames carrying their own panscan SEI are matched exactly,
+    // regardless of how far decode order is from display order.
+    // Done first, as frames decoded after it but displayed before it
+    // cut its end_ts short
+    int slot = panscan_ts_slot[ts_hash(frame_ts)];
+    if (slot >= 0 && slot < panscan_size && panscan_data[slot].used &&
+        panscan_data[slot].start_ts == frame_ts)
+      panscan_node = &panscan_data[slot];
+  }
+  // Release the oldest entries once frame_ts has gone past their end_ts
+  while (panscan_cnt)
   {
+    oldest = node_at(0);
+    if (oldest == panscan_node || !VALID_TS(oldest->start_ts) ||
+        frame_ts < oldest->end_ts ||
+        (!oldest->active && frame_ts < oldest->start_ts))
+      break;
+    release(oldest);
+  }
+  if (!panscan_node && panscan_cnt)
+  {
+    panscan_node = node_at(0);
     if (VALID_TS(panscan_node->start_ts))
     {
       if (panscan_node->active && frame_ts < panscan_node->start_ts)
+      {
         panscan_node->start_ts = frame_ts;
-      if (frame_ts >= panscan_node->start_ts)
-        if (frame_ts < panscan_node->end_ts)
-        {
-          data = &panscan_node->pan_scan_param;
-          panscan_node->active = true;
-        }
-        else
-        {
-          panscan_free.add_last(panscan_used.remove_first());
-          panscan_node = panscan_used.watch_first();
-        }
-      else
-        // Finish search if current timestamp has not reached
-        // start timestamp of first panscan data.
+        panscan_ts_slot[ts_hash(frame_ts)] = panscan_node - panscan_data;
+      }
+      // Finish search if current timestamp has not reached
+      // start timestamp of first panscan data.
+      if (frame_ts < panscan_node->start_ts)
         panscan_node = NULL;
     }
-    else
-    {
-      // Only one panscan data is stored for clips
-      // with invalid timestamps in every frame
-      data = &panscan_node->pan_scan_param;
-      panscan_node->active = true;
-    }
+    // else only one panscan data is stored for clips
+    // with invalid timestamps in every frame
   }
-  if (data)
+  if (panscan_node)
+  {
+    data = &panscan_node->pan_scan_param;
+    panscan_node->active = true;
     if (data->rect_repetition_period == 0)
-      panscan_free.add_last(panscan_used.remove_first());
+      release(panscan_node);
     else if (data->rect_repetition_period > 1)
       data->rect_repetition_period -= 2;
+  }
   PRINT_PANSCAN_DATA(panscan_node);
   return data;
 }
 
 void panscan_handler::update_last(OMX_S64 frame_ts)
 {
-  PANSCAN_NODE *panscan_node = panscan_used.watch_last();
-  if (panscan_node && !VALID_TS(panscan_node->start_ts))
+  PANSCAN_NODE *panscan_node = panscan_cnt ? node_at(panscan_cnt - 1) : NULL;
+  if (panscan_node && panscan_node->used && !VALID_TS(panscan_node->start_ts))
   {
     panscan_node->start_ts = frame_ts;
+    if (VALID_TS(frame_ts))
+      panscan_ts_slot[ts_hash(frame_ts)] = panscan_node - panscan_data;
     PRINT_PANSCAN_DATA(panscan_node);
-    if (panscan_node->prev)
+    if (panscan_cnt > 1 && node_at(panscan_cnt - 2)->used)
     {
-      if (frame_ts < panscan_node->prev->end_ts)
-        panscan_node->prev->end_ts = frame_ts;
+      PANSCAN_NODE *prev_node = node_at(panscan_cnt - 2);
+      if (frame_ts < prev_node->end_ts)
+        prev_node->end_ts = frame_ts;
       else if (!VALID_TS(frame_ts))
-        panscan_node->prev->pan_scan_param.rect_repetition_period = 0;
-      PRINT_PANSCAN_DATA(panscan_node->prev);
-    }
-  }
-}
-
-template <class NODE_STRUCT>
-void omx_dl_list<NODE_STRUCT>::add_multiple(NODE_STRUCT *data_arr, int data_num)
-{
-  for (int idx = 0; idx < data_num; idx++)
-    add_last(&data_arr[idx]);
-}
-
-template <class NODE_STRUCT>
-NODE_STRUCT *omx_dl_list<NODE_STRUCT>::remove_first()
-{
-  NODE_STRUCT *data = head;
-  if (head)
-  {
-    if (head->next)
-    {
-      head = head->next;
-      head->prev = NULL;
-    }
-    else
-      head = tail = NULL;
-    data->next = data->prev = NULL;
-  }
-  return data;
-}
-
-template <class NODE_STRUCT>
-NODE_STRUCT *omx_dl_list<NODE_STRUCT>::remove_last()
-{
-  NODE_STRUCT *data = tail;
-  if (tail)
-  {
-    if (tail->prev)
-    {
-      tail = tail->prev;
-      tail->next = NULL;
+        prev_node->pan_scan_param.rect_repetition_period = 0;
+      PRINT_PANSCAN_DATA(prev_node);
     }
-    else
-      head = tail = NULL;
-    data->next = data->prev = NULL;
   }
-  return data;
-}
-
-template <class NODE_STRUCT>
-void omx_dl_list<NODE_STRUCT>::add_last(NODE_STRUCT* data_ptr)
-{
-  if (data_ptr)
-  {
-    data_ptr->next = NULL;
-    data_ptr->prev = tail;
-    if (tail)
-    {
-      tail->next = data_ptr;
-      tail = data_ptr;
-    }
-    else
-      head = tail = data_ptr;
-  }
-}
-
-template <class NODE_STRUCT>
-NODE_STRUCT* omx_dl_list<NODE_STRUCT>::watch_first()
-{
-  return head;
-}
-
-template <class NODE_STRUCT>
-NODE_STRUCT* omx_dl_list<NODE_STRUCT>::watch_last()
-{
-  return tail;
 }
 
 #endif
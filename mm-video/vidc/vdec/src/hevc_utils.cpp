@@ -0,0 +1,755 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*========================================================================
+
+                      O p e n M M
+         V i d e o   U t i l i t i e s
+
+*//** @file hevc_utils.cpp
+  This module contains HEVC utilities and helper routines.
+
+@par EXTERNALIZED FUNCTIONS
+
+@par INITIALIZATION AND SEQUENCING REQUIREMENTS
+  (none)
+
+*//*====================================================================== */
+
+/* =======================================================================
+
+                     INCLUDE FILES FOR MODULE
+
+========================================================================== */
+#include "hevc_utils.h"
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#ifdef _ANDROID_
+    extern "C"{
+        #include<utils/Log.h>
+    }
+#endif
+
+/* Table E-1, same sample aspect ratios as H.264 */
+static const OMX_U8 hevc_sar[17][2] =
+{
+  {0, 0}, {1, 1}, {12, 11}, {10, 11}, {16, 11}, {40, 33}, {24, 11},
+  {20, 11}, {32, 11}, {80, 33}, {18, 11}, {15, 11}, {64, 33}, {160, 99},
+  {4, 3}, {3, 2}, {2, 1}
+};
+
+HEVC_Utils::HEVC_Utils(): hevc_nalu_type(0),
+                          m_vcl_data(false)
+{
+  initialize_frame_checking_environment();
+}
+
+HEVC_Utils::~HEVC_Utils()
+{
+}
+
+void HEVC_Utils::initialize_frame_checking_environment()
+{
+  H264_Utils::initialize_frame_checking_environment();
+  m_vcl_data = false;
+  nalu_type = NALU_TYPE_UNSPECIFIED;
+}
+
+/*===========================================================================
+FUNCTION:
+  HEVC_Utils::isNewFrame
+
+DESCRIPTION:
+  Same as the in place variant below, for a NAL preceded by a start code
+  or by a NAL length field.
+===========================================================================*/
+bool HEVC_Utils::isNewFrame(OMX_BUFFERHEADERTYPE *p_buf_hdr,
+                            OMX_IN OMX_U32 size_of_nal_length_field,
+                            OMX_OUT OMX_BOOL &isNewFrame)
+{
+  OMX_U8 *buffer = p_buf_hdr->pBuffer;
+  OMX_U32 buffer_length = p_buf_hdr->nFilledLen;
+  OMX_U32 pos = size_of_nal_length_field;
+
+  if (!size_of_nal_length_field)
+  {
+    // Search start_code_prefix_one_3bytes (0x000001)
+    while (pos + 2 < buffer_length &&
+           (buffer[pos] || buffer[pos + 1] || buffer[pos + 2] != 0x01))
+      pos++;
+    pos += 3;
+  }
+  if (pos >= buffer_length)
+  {
+    ALOGE("ERROR: In %s() - no NAL header", __func__);
+    isNewFrame = OMX_FALSE;
+    return false;
+  }
+  return HEVC_Utils::isNewFrame(buffer + pos, buffer_length - pos, isNewFrame);
+}
+
+/*===========================================================================
+FUNCTION:
+  HEVC_Utils::isNewFrame
+
+DESCRIPTION:
+  Decides on an access unit boundary from the NAL unit header and
+  first_slice_segment_in_pic_flag, which is the first bit after the
+  header, so no RBSP extraction is needed. An access unit starts with the
+  first AUD, VPS, SPS, PPS, prefix SEI or reserved/unspecified prefix NAL
+  after the slices of the previous one, or with a slice that has
+  first_slice_segment_in_pic_flag set. EOS, EOB, filler data and suffix
+  SEI always belong to the current access unit.
+
+INPUT/OUTPUT PARAMETERS:
+  <In>
+    nal : NAL unit starting at the NAL header (no start code)
+    nal_length : bytes available at nal, HEVC_NAL_PEEK_SIZE is enough
+  <out>
+    isNewFrame: true if the NAL belongs to a differenet frame
+                false if the NAL belongs to a current frame
+
+RETURN VALUE:
+  boolean  true, if nal parsing is successful
+           false, if the nal parsing has errors
+===========================================================================*/
+bool HEVC_Utils::isNewFrame(OMX_IN OMX_U8 *nal,
+                            OMX_IN OMX_U32 nal_length,
+                            OMX_OUT OMX_BOOL &isNewFrame)
+{
+  OMX_U32 layer_id;
+
+  isNewFrame = OMX_FALSE;
+  if (nal == NULL || nal_length < 2)
+  {
+    ALOGE("ERROR: In %s() - short NAL", __func__);
+    nalu_type = NALU_TYPE_UNSPECIFIED;
+    return false;
+  }
+  if (nal[0] & 0x80)
+  {
+    ALOGE("ERROR: In %s() - forbidden_zero_bit set", __func__);
+  }
+  hevc_nalu_type = (nal[0] >> 1) & 0x3f;
+  layer_id = ((nal[0] & 0x01) << 5) | (nal[1] >> 3);
+
+  if (hevc_nalu_type <= HEVC_NALU_TYPE_RSV_VCL31)
+  {
+    nalu_type = (hevc_nalu_type >= HEVC_NALU_TYPE_BLA_W_LP &&
+                 hevc_nalu_type <= HEVC_NALU_TYPE_RSV_IRAP_VCL23) ?
+                NALU_TYPE_IDR : NALU_TYPE_NON_IDR;
+    if (!layer_id && nal_length >= HEVC_NAL_PEEK_SIZE &&
+        (nal[2] & 0x80) && m_vcl_data)
+      isNewFrame = OMX_TRUE;
+    m_vcl_data = true;
+  }
+  else
+  {
+    switch (hevc_nalu_type)
+    {
+      case HEVC_NALU_TYPE_SPS:
+        nalu_type = NALU_TYPE_SPS;
+        break;
+      case HEVC_NALU_TYPE_PPS:
+        nalu_type = NALU_TYPE_PPS;
+        break;
+      case HEVC_NALU_TYPE_AUD:
+        nalu_type = NALU_TYPE_ACCESS_DELIM;
+        break;
+      case HEVC_NALU_TYPE_EOS:
+        nalu_type = NALU_TYPE_EOSEQ;
+        break;
+      case HEVC_NALU_TYPE_EOB:
+        nalu_type = NALU_TYPE_EOSTREAM;
+        break;
+      case HEVC_NALU_TYPE_FD:
+        nalu_type = NALU_TYPE_FILLER_DATA;
+        break;
+      case HEVC_NALU_TYPE_PREFIX_SEI:
+      case HEVC_NALU_TYPE_SUFFIX_SEI:
+        nalu_type = NALU_TYPE_SEI;
+        break;
+      default:
+        nalu_type = NALU_TYPE_UNSPECIFIED;
+        break;
+    }
+    if (!layer_id && m_vcl_data &&
+        (hevc_nalu_type <= HEVC_NALU_TYPE_AUD ||
+         hevc_nalu_type == HEVC_NALU_TYPE_PREFIX_SEI ||
+         (hevc_nalu_type >= HEVC_NALU_TYPE_RSV_NVCL41 &&
+          hevc_nalu_type <= HEVC_NALU_TYPE_RSV_NVCL44) ||
+         (hevc_nalu_type >= HEVC_NALU_TYPE_UNSPEC48 &&
+          hevc_nalu_type <= HEVC_NALU_TYPE_UNSPEC55)))
+    {
+      isNewFrame = OMX_TRUE;
+      m_vcl_data = false;
+    }
+  }
+  ALOGV("isNewFrame: hevc nal type %d layer %d newFrame %d",
+      hevc_nalu_type, layer_id, isNewFrame);
+  return true;
+}
+
+hevc_stream_parser::hevc_stream_parser()
+{
+  reset();
+}
+
+hevc_stream_parser::~hevc_stream_parser()
+{
+}
+
+void hevc_stream_parser::reset()
+{
+  init_bitstream(NULL, 0);
+  memset(&vui_param, 0, sizeof(vui_param));
+  memset(&hdr_info, 0, sizeof(hdr_info));
+  memset(st_rps, 0, sizeof(st_rps));
+}
+
+void hevc_stream_parser::init_bitstream(OMX_U8* data, OMX_U32 size)
+{
+  bitstream = data;
+  bitstream_bytes = size;
+  byte_pos = 0;
+  bit_pos = 0;
+  zero_cntr = 0;
+  bits_read = 0;
+  overrun = false;
+}
+
+/* Reads n (<= 32) bits, skipping emulation prevention bytes. Reading past
+   the end of the NAL returns zeros and sets overrun. */
+OMX_U32 hevc_stream_parser::extract_bits(OMX_U32 n)
+{
+  OMX_U32 value = 0;
+  while (n--)
+  {
+    if (!bit_pos)
+    {
+      if (zero_cntr == 2 && byte_pos < bitstream_bytes &&
+          bitstream[byte_pos] == EMULATION_PREVENTION_THREE_BYTE)
+      {
+        byte_pos++;
+        zero_cntr = 0;
+      }
+      if (byte_pos >= bitstream_bytes)
+      {
+        overrun = true;
+        return 0;
+      }
+      zero_cntr = bitstream[byte_pos] ? 0 : (zero_cntr + 1);
+    }
+    value = (value << 1) | ((bitstream[byte_pos] >> (7 - bit_pos)) & 0x01);
+    bits_read++;
+    if (++bit_pos == 8)
+    {
+      bit_pos = 0;
+      byte_pos++;
+    }
+  }
+  return value;
+}
+
+void hevc_stream_parser::skip_bits(OMX_U32 n)
+{
+  while (n && !overrun)
+  {
+    OMX_U32 bits = (n > 32) ? 32 : n;
+    extract_bits(bits);
+    n -= bits;
+  }
+}
+
+OMX_U32 hevc_stream_parser::uev()
+{
+  OMX_U32 lead_zero_bits = 0;
+  while (!extract_bits(1))
+  {
+    if (overrun || ++lead_zero_bits > 31)
+    {
+      overrun = true;
+      return 0;
+    }
+  }
+  return ((1U << lead_zero_bits) - 1) + extract_bits(lead_zero_bits);
+}
+
+OMX_S32 hevc_stream_parser::sev()
+{
+  OMX_U32 code_num = uev();
+  if (code_num & 1)
+    return (OMX_S32)((code_num >> 1) + 1);
+  return -(OMX_S32)(code_num >> 1);
+}
+
+void hevc_stream_parser::parse_nal(OMX_U8* data_ptr, OMX_U32 data_len)
+{
+  OMX_U32 pos = 0, nal_type, layer_id;
+  if (!data_ptr || data_len < 3)
+    return;
+  // NALs from the bitstream come with a start code, those from hvcC do not
+  if (!data_ptr[0] && !data_ptr[1])
+  {
+    while (pos + 2 < data_len &&
+           (data_ptr[pos] || data_ptr[pos + 1] || data_ptr[pos + 2] != 0x01))
+      pos++;
+    pos += 3;
+  }
+  if (pos + 2 >= data_len)
+    return;
+  nal_type = (data_ptr[pos] >> 1) & 0x3f;
+  layer_id = ((data_ptr[pos] & 0x01) << 5) | (data_ptr[pos + 1] >> 3);
+  if (layer_id)
+    return;
+  switch (nal_type)
+  {
+    case HEVC_NALU_TYPE_SPS:
+      init_bitstream(data_ptr + pos + 2, data_len - pos - 2);
+      parse_sps();
+      break;
+    case HEVC_NALU_TYPE_PREFIX_SEI:
+      init_bitstream(data_ptr + pos + 2, data_len - pos - 2);
+      parse_sei();
+      break;
+    default:
+      break;
+  }
+}
+
+void hevc_stream_parser::profile_tier_level(OMX_U32 max_sub_layers_minus1)
+{
+  bool profile_present[HEVC_MAX_SUB_LAYERS];
+  bool level_present[HEVC_MAX_SUB_LAYERS];
+  OMX_U32 i;
+
+  skip_bits(8);   // general_profile_space, tier_flag, profile_idc
+  skip_bits(32);  // general_profile_compatibility_flag[32]
+  skip_bits(48);  // source/constraint flags and reserved bits
+  skip_bits(8);   // general_level_idc
+  for (i = 0; i < max_sub_layers_minus1; i++)
+  {
+    profile_present[i] = extract_bits(1);
+    level_present[i] = extract_bits(1);
+  }
+  if (max_sub_layers_minus1)
+    skip_bits(2 * (8 - max_sub_layers_minus1));  // reserved_zero_2bits
+  for (i = 0; i < max_sub_layers_minus1; i++)
+  {
+    if (profile_present[i])
+      skip_bits(88);
+    if (level_present[i])
+      skip_bits(8);
+  }
+}
+
+void hevc_stream_parser::scaling_list_data()
+{
+  for (OMX_U32 size_id = 0; size_id < 4; size_id++)
+  {
+    for (OMX_U32 matrix_id = 0; matrix_id < 6;
+         matrix_id += (size_id == 3) ? 3 : 1)
+    {
+      if (!extract_bits(1))   // scaling_list_pred_mode_flag
+      {
+        uev();                // scaling_list_pred_matrix_id_delta
+      }
+      else
+      {
+        OMX_U32 coef_num = STD_MIN(64, 1 << (4 + (size_id << 1)));
+        if (size_id > 1)
+          sev();              // scaling_list_dc_coef_minus8
+        for (OMX_U32 i = 0; i < coef_num && !overrun; i++)
+          sev();              // scaling_list_delta_coef
+      }
+    }
+  }
+}
+
+/* st_ref_pic_set() of the SPS. The delta POCs are kept (7-61, 7-62) since
+   the size of a predicted set depends on the set it is predicted from. */
+bool hevc_stream_parser::st_ref_pic_set(OMX_U32 idx)
+{
+  hevc_st_rps *rps = &st_rps[idx];
+  OMX_U32 i;
+
+  if (idx && extract_bits(1))   // inter_ref_pic_set_prediction_flag
+  {
+    // In the SPS a set is always predicted from the one before it
+    hevc_st_rps *ref = &st_rps[idx - 1];
+    OMX_U32 num_delta_pocs = ref->num_negative + ref->num_positive;
+    bool use_delta[2 * HEVC_MAX_DELTA_POCS + 1];
+    OMX_S32 d_poc_s0[2 * HEVC_MAX_DELTA_POCS + 1];
+    OMX_S32 d_poc_s1[2 * HEVC_MAX_DELTA_POCS + 1];
+    OMX_S32 sign = extract_bits(1);
+    OMX_S32 delta_rps = (1 - 2 * sign) * (OMX_S32)(uev() + 1);
+    OMX_U32 num_negative = 0, num_positive = 0;
+    OMX_S32 d_poc;
+    int j;
+
+    for (i = 0; i <= num_delta_pocs; i++)
+    {
+      // use_delta_flag is only present when used_by_curr_pic_flag is 0
+      use_delta[i] = extract_bits(1) || extract_bits(1);
+    }
+    // Collected first, a predicted set may hold num_delta_pocs + 1 entries
+    for (j = (int)ref->num_positive - 1; j >= 0; j--)
+    {
+      d_poc = ref->delta_poc_s1[j] + delta_rps;
+      if (d_poc < 0 && use_delta[ref->num_negative + j])
+        d_poc_s0[num_negative++] = d_poc;
+    }
+    if (delta_rps < 0 && use_delta[num_delta_pocs])
+      d_poc_s0[num_negative++] = delta_rps;
+    for (j = 0; j < (int)ref->num_negative; j++)
+    {
+      d_poc = ref->delta_poc_s0[j] + delta_rps;
+      if (d_poc < 0 && use_delta[j])
+        d_poc_s0[num_negative++] = d_poc;
+    }
+    for (j = (int)ref->num_negative - 1; j >= 0; j--)
+    {
+      d_poc = ref->delta_poc_s0[j] + delta_rps;
+      if (d_poc > 0 && use_delta[j])
+        d_poc_s1[num_positive++] = d_poc;
+    }
+    if (delta_rps > 0 && use_delta[num_delta_pocs])
+      d_poc_s1[num_positive++] = delta_rps;
+    for (j = 0; j < (int)ref->num_positive; j++)
+    {
+      d_poc = ref->delta_poc_s1[j] + delta_rps;
+      if (d_poc > 0 && use_delta[ref->num_negative + j])
+        d_poc_s1[num_positive++] = d_poc;
+    }
+    if (num_negative > HEVC_MAX_DELTA_POCS || num_positive > HEVC_MAX_DELTA_POCS)
+    {
+      ALOGE("ERROR: Invalid predicted short term RPS %u/%u",
+          num_negative, num_positive);
+      return false;
+    }
+    rps->num_negative = num_negative;
+    rps->num_positive = num_positive;
+    memcpy(rps->delta_poc_s0, d_poc_s0, num_negative * sizeof(OMX_S32));
+    memcpy(rps->delta_poc_s1, d_poc_s1, num_positive * sizeof(OMX_S32));
+  }
+  else
+  {
+    OMX_S32 poc = 0;
+    rps->num_negative = uev();
+    rps->num_positive = uev();
+    if (rps->num_negative > HEVC_MAX_DELTA_POCS ||
+        rps->num_positive > HEVC_MAX_DELTA_POCS)
+    {
+      ALOGE("ERROR: Invalid short term RPS %u/%u",
+          rps->num_negative, rps->num_positive);
+      rps->num_negative = rps->num_positive = 0;
+      return false;
+    }
+    for (i = 0; i < rps->num_negative; i++)
+    {
+      poc -= (OMX_S32)(uev() + 1);  // delta_poc_s0_minus1
+      rps->delta_poc_s0[i] = poc;
+      skip_bits(1);                 // used_by_curr_pic_s0_flag
+    }
+    poc = 0;
+    for (i = 0; i < rps->num_positive; i++)
+    {
+      poc += (OMX_S32)(uev() + 1);  // delta_poc_s1_minus1
+      rps->delta_poc_s1[i] = poc;
+      skip_bits(1);                 // used_by_curr_pic_s1_flag
+    }
+  }
+  return !overrun;
+}
+
+void hevc_stream_parser::parse_sps()
+{
+  OMX_U32 max_sub_layers_minus1, log2_max_poc_lsb, num_rps, i;
+
+  skip_bits(4);                     // sps_video_parameter_set_id
+  max_sub_layers_minus1 = extract_bits(3);
+  skip_bits(1);                     // sps_temporal_id_nesting_flag
+  if (max_sub_layers_minus1 >= HEVC_MAX_SUB_LAYERS)
+  {
+    ALOGE("ERROR: Invalid sps_max_sub_layers_minus1 %u", max_sub_layers_minus1);
+    return;
+  }
+  profile_tier_level(max_sub_layers_minus1);
+  uev();                            // sps_seq_parameter_set_id
+  if (uev() == 3)                   // chroma_format_idc
+    skip_bits(1);                   // separate_colour_plane_flag
+  uev();                            // pic_width_in_luma_samples
+  uev();                            // pic_height_in_luma_samples
+  if (extract_bits(1))              // conformance_window_flag
+  {
+    uev(); uev(); uev(); uev();
+  }
+  uev();                            // bit_depth_luma_minus8
+  uev();                            // bit_depth_chroma_minus8
+  log2_max_poc_lsb = uev() + 4;
+  // sps_sub_layer_ordering_info_present_flag
+  for (i = extract_bits(1) ? 0 : max_sub_layers_minus1;
+       i <= max_sub_layers_minus1; i++)
+  {
+    uev(); uev(); uev();            // max_dec_pic_buffering, num_reorder, latency
+  }
+  uev(); uev();                     // luma coding block sizes
+  uev(); uev();                     // luma transform block sizes
+  uev(); uev();                     // max_transform_hierarchy_depth_inter/intra
+  // scaling_list_enabled_flag, sps_scaling_list_data_present_flag
+  if (extract_bits(1) && extract_bits(1))
+    scaling_list_data();
+  skip_bits(2);                     // amp, sample_adaptive_offset
+  if (extract_bits(1))              // pcm_enabled_flag
+  {
+    skip_bits(8);                   // pcm sample bit depths
+    uev(); uev();                   // pcm luma coding block sizes
+    skip_bits(1);                   // pcm_loop_filter_disabled_flag
+  }
+  num_rps = uev();                  // num_short_term_ref_pic_sets
+  if (overrun || num_rps > HEVC_MAX_SHORT_TERM_RPS || log2_max_poc_lsb > 16)
+  {
+    ALOGE("ERROR: Invalid SPS num_rps %u log2_max_poc_lsb %u",
+        num_rps, log2_max_poc_lsb);
+    return;
+  }
+  for (i = 0; i < num_rps; i++)
+    if (!st_ref_pic_set(i))
+      return;
+  if (extract_bits(1))              // long_term_ref_pics_present_flag
+  {
+    OMX_U32 num_long_term = uev();
+    for (i = 0; i < num_long_term && !overrun; i++)
+      skip_bits(log2_max_poc_lsb + 1);  // lt_ref_pic_poc_lsb_sps, used flag
+  }
+  skip_bits(2);                     // temporal_mvp, strong_intra_smoothing
+  if (extract_bits(1) && !overrun)  // vui_parameters_present_flag
+    parse_vui();
+}
+
+void hevc_stream_parser::parse_vui()
+{
+  hevc_vui_param vui;
+  memset(&vui, 0, sizeof(vui));
+
+  if ((vui.aspect_ratio_info_present_flag = extract_bits(1)))
+  {
+    vui.aspect_ratio_info.aspect_ratio_idc = extract_bits(8);
+    if (vui.aspect_ratio_info.aspect_ratio_idc == 255)  // EXTENDED_SAR
+    {
+      vui.aspect_ratio_info.aspect_ratio_x = extract_bits(16);
+      vui.aspect_ratio_info.aspect_ratio_y = extract_bits(16);
+    }
+    else if (vui.aspect_ratio_info.aspect_ratio_idc < 17)
+    {
+      vui.aspect_ratio_info.aspect_ratio_x =
+        hevc_sar[vui.aspect_ratio_info.aspect_ratio_idc][0];
+      vui.aspect_ratio_info.aspect_ratio_y =
+        hevc_sar[vui.aspect_ratio_info.aspect_ratio_idc][1];
+    }
+  }
+  if (extract_bits(1))              // overscan_info_present_flag
+    skip_bits(1);                   // overscan_appropriate_flag
+  // Unspecified unless a colour description follows
+  vui.colour_primaries = 2;
+  vui.transfer_characteristics = 2;
+  vui.matrix_coeffs = 2;
+  if ((vui.video_signal_type_present_flag = extract_bits(1)))
+  {
+    skip_bits(3);                   // video_format
+    vui.video_full_range_flag = extract_bits(1);
+    if (extract_bits(1))            // colour_description_present_flag
+    {
+      vui.colour_primaries = extract_bits(8);
+      vui.transfer_characteristics = extract_bits(8);
+      vui.matrix_coeffs = extract_bits(8);
+    }
+  }
+  if (extract_bits(1))              // chroma_loc_info_present_flag
+  {
+    uev(); uev();
+  }
+  skip_bits(1);                     // neutral_chroma_indication_flag
+  vui.field_seq_flag = extract_bits(1);
+  skip_bits(1);                     // frame_field_info_present_flag
+  if (extract_bits(1))              // default_display_window_flag
+  {
+    uev(); uev(); uev(); uev();
+  }
+  if ((vui.timing_info_present_flag = extract_bits(1)))
+  {
+    vui.num_units_in_tick = extract_bits(32);
+    vui.time_scale = extract_bits(32);
+  }
+  // POC proportionality, HRD and bitstream restriction are not needed
+  if (overrun)
+  {
+    ALOGE("ERROR: VUI parsing ran past the SPS");
+    return;
+  }
+  vui_param = vui;
+  ALOGV("parse_vui: sar %u:%u colour %u/%u/%u timing %u/%u",
+      vui.aspect_ratio_info.aspect_ratio_x, vui.aspect_ratio_info.aspect_ratio_y,
+      vui.colour_primaries, vui.transfer_characteristics, vui.matrix_coeffs,
+      vui.num_units_in_tick, vui.time_scale);
+}
+
+void hevc_stream_parser::parse_sei()
+{
+  // Stop before the rbsp_trailing_bits byte
+  while (!overrun && byte_pos + 1 < bitstream_bytes)
+  {
+    OMX_U32 payload_type = 0, payload_size = 0, byte, start;
+    while ((byte = extract_bits(8)) == 0xFF && !overrun)
+      payload_type += 255;
+    payload_type += byte;
+    while ((byte = extract_bits(8)) == 0xFF && !overrun)
+      payload_size += 255;
+    payload_size += byte;
+    if (overrun)
+      break;
+    start = bits_read;
+    switch (payload_type)
+    {
+      case HEVC_SEI_MASTERING_DISPLAY_COLOUR_VOLUME:
+        sei_mastering_display();
+        break;
+      case HEVC_SEI_CONTENT_LIGHT_LEVEL_INFO:
+        sei_content_light_level();
+        break;
+      default:
+        ALOGV("parse_sei: payload type %u size %u skipped",
+            payload_type, payload_size);
+        break;
+    }
+    if (bits_read - start < (payload_size << 3))
+      skip_bits((payload_size << 3) - (bits_read - start));
+  }
+}
+
+void hevc_stream_parser::sei_mastering_display()
+{
+  hevc_hdr_info hdr = hdr_info;
+  for (int i = 0; i < 3; i++)
+  {
+    hdr.display_primaries_x[i] = extract_bits(16);
+    hdr.display_primaries_y[i] = extract_bits(16);
+  }
+  hdr.white_point_x = extract_bits(16);
+  hdr.white_point_y = extract_bits(16);
+  hdr.max_display_mastering_luminance = extract_bits(32);
+  hdr.min_display_mastering_luminance = extract_bits(32);
+  if (!overrun)
+  {
+    hdr.mastering_display_present = true;
+    hdr_info = hdr;
+  }
+}
+
+void hevc_stream_parser::sei_content_light_level()
+{
+  OMX_U16 max_cll = extract_bits(16);
+  OMX_U16 max_fall = extract_bits(16);
+  if (!overrun)
+  {
+    hdr_info.content_light_level_present = true;
+    hdr_info.max_content_light_level = max_cll;
+    hdr_info.max_pic_average_light_level = max_fall;
+  }
+}
+
+void hevc_stream_parser::fill_aspect_ratio_info(OMX_QCOM_ASPECT_RATIO *dest_aspect_ratio)
+{
+  if (dest_aspect_ratio && vui_param.aspect_ratio_info_present_flag)
+  {
+    dest_aspect_ratio->aspectRatioX = vui_param.aspect_ratio_info.aspect_ratio_x;
+    dest_aspect_ratio->aspectRatioY = vui_param.aspect_ratio_info.aspect_ratio_y;
+  }
+}
+
+void hevc_stream_parser::get_frame_rate(OMX_U32 *frame_rate)
+{
+  // With field_seq_flag every picture is a field
+  if (vui_param.timing_info_present_flag && vui_param.num_units_in_tick != 0)
+    *frame_rate = vui_param.time_scale /
+                  (vui_param.num_units_in_tick * (vui_param.field_seq_flag ? 2 : 1));
+}
+
+bool hevc_stream_parser::get_hdr_info(hevc_hdr_info *hdr)
+{
+  if (!hdr)
+    return false;
+  *hdr = hdr_info;
+  hdr->colour_primaries = vui_param.colour_primaries;
+  hdr->transfer_characteristics = vui_param.transfer_characteristics;
+  hdr->matrix_coeffs = vui_param.matrix_coeffs;
+  hdr->video_full_range_flag = vui_param.video_full_range_flag;
+  return vui_param.video_signal_type_present_flag ||
+         hdr_info.mastering_display_present ||
+         hdr_info.content_light_level_present;
+}
+
+OMX_U32 hevc_unpack_hvcc(OMX_U8 *src, OMX_U32 src_size, OMX_U32 nal_length,
+                         OMX_U8 *dest, hevc_stream_parser *parser)
+{
+  // hvcC: 23 byte fixed part, then numOfArrays arrays of
+  // { type, numNalus(16), { nalUnitLength(16), nalUnit }* }
+  OMX_U32 pos = HEVC_HVCC_HEADER_SIZE, dst_size = 0, num_arrays, num_nalus, len;
+
+  if (!src || src_size < HEVC_HVCC_HEADER_SIZE || !nal_length || nal_length > 4)
+    return 0;
+  num_arrays = src[22];
+  while (num_arrays--)
+  {
+    if (pos + 3 > src_size)
+      return 0;
+    num_nalus = (src[pos + 1] << 8) | src[pos + 2];
+    pos += 3;
+    while (num_nalus--)
+    {
+      if (pos + 2 > src_size)
+        return 0;
+      len = (src[pos] << 8) | src[pos + 1];
+      pos += 2;
+      if (len > src_size - pos)
+        return 0;
+      if (dest)
+      {
+        for (OMX_U32 i = 0; i < nal_length; i++)
+          dest[i] = (len >> ((nal_length - 1 - i) * 8)) & 0xff;
+        memcpy(dest + nal_length, src + pos, len);
+        dest += nal_length + len;
+        if (parser)
+          parser->parse_nal(src + pos, len);
+      }
+      dst_size += nal_length + len;
+      pos += len;
+    }
+  }
+  return dst_size;
+}
@@ -493,6 +493,7 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       m_app_data(NULL),
                       m_inp_mem_ptr(NULL),
                       m_out_mem_ptr(NULL),
+                      m_out_buf_state(NULL),
                       m_phdr_pmem_ptr(NULL),
                       pending_input_buffers(0),
                       pending_output_buffers(0),
@@ -511,6 +512,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       input_use_buffer (false),
                       output_use_buffer (false),
                       arbitrary_bytes (true),
+                      m_h264_client (this),
+                      m_h264_splitter (&m_frame_parser, &h264_scratch,
+                                       &m_h264_client),
                       psource_frame (NULL),
                       pdest_frame (NULL),
                       m_inp_heap_ptr (NULL),
@@ -519,8 +523,12 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       first_frame_meta (true),
                       frame_count (0),
                       nal_length(0),
-                      nal_count (0),
-                      look_ahead_nal (false),
+                      nal_length_in_place (false),
+                      avcc_nal_left (0),
+                      avcc_prefix (0),
+                      avcc_prefix_bytes (0),
+                      m_thumbnail_mode (false),
+                      m_thumbnail_done (false),
                       first_frame(0),
                       first_buffer(NULL),
                       first_frame_size (0),
@@ -534,7 +542,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       m_display_id(NULL),
                       ouput_egl_buffers(false),
                       h264_parser(NULL),
+                      hevc_parser(NULL),
                       client_extradata(0),
+                      m_extradata_record_cnt(0),
                       h264_last_au_ts(LLONG_MAX),
                       h264_last_au_flags(0),
                       m_inp_err_count(0),
@@ -559,6 +569,10 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                     ,m_desc_buffer_ptr(NULL)
                     ,m_extradata(NULL)
                     ,m_use_smoothstreaming(false)
+                    ,m_reconfig_in_place(false)
+                    ,m_reconfig_in_place_drv(false)
+                    ,m_reconfig_in_place_allowed(false)
+                    ,m_dim_pending(false)
 {
   /* Assumption is that , to begin with , we have all the frames with decoder */
   DEBUG_PRINT_HIGH("In OMX vdec Constructor");
@@ -587,6 +601,16 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
   m_debug_concealedmb = atoi(property_value);
   DEBUG_PRINT_HIGH("vidc.dec.debug.concealedmb value is %d",m_debug_concealedmb);
 
+  property_value[0] = NULL;
+  property_get("vidc.dec.debug.panframedata", property_value, "0");
+  m_debug_panframedata = atoi(property_value);
+
+  property_value[0] = NULL;
+  property_get("vidc.dec.reconfig.inplace", property_value, "0");
+  m_reconfig_in_place_allowed = atoi(property_value) ? true : false;
+  DEBUG_PRINT_HIGH("vidc.dec.reconfig.inplace value is %d",
+                   m_reconfig_in_place_allowed);
+
 #endif
   memset(&m_cmp,0,sizeof(m_cmp));
   memset(&m_cb,0,sizeof(m_cb));
@@ -594,8 +618,10 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
   memset (&h264_scratch,0,sizeof (OMX_BUFFERHEADERTYPE));
   memset (m_hwdevice_name,0,sizeof(m_hwdevice_name));
   memset(&op_buf_rcnfg, 0 ,sizeof(vdec_allocatorproperty));
-  memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
+  m_demux_offsets = NULL;
   m_demux_entries = 0;
+  m_demux_capacity = 0;
+  m_demux_last_sc_len = 0;
   msg_thread_created = false;
   async_thread_created = false;
   drv_ctx.timestamp_adjust = false;
@@ -612,6 +638,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
   m_fill_output_msg = OMX_COMPONENT_GENERATE_FTB;
   client_buffers.set_vdec_client(this);
   memset(native_buffer, 0, sizeof(native_buffer));
+  memset(m_out_dim, 0, sizeof(m_out_dim));
+  memset(&m_frame_dim, 0, sizeof(m_frame_dim));
+  memset(&m_pending_dim, 0, sizeof(m_pending_dim));
 }
 
 
@@ -652,6 +681,12 @@ omx_vdec::~omx_vdec()
 
   pthread_mutex_destroy(&m_lock);
   sem_destroy(&m_cmd_lock);
+  if (m_demux_offsets)
+  {
+    free(m_demux_offsets);
+    m_demux_offsets = NULL;
+  }
+  m_demux_capacity = 0;
 #ifdef _ANDROID_
   if (perf_flag)
   {
@@ -1469,6 +1504,21 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
     strcat(inputfilename, "264");
 #endif
   }
+#ifdef HEVC_DECODER_SUPPORT
+  else if(!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.hevc",\
+         OMX_MAX_STRINGNAME_SIZE))
+  {
+    strlcpy((char *)m_cRole, "video_decoder.hevc",OMX_MAX_STRINGNAME_SIZE);
+    drv_ctx.decoder_format = VDEC_CODECTYPE_HEVC;
+    eCompressionFormat = (OMX_VIDEO_CODINGTYPE)QOMX_VIDEO_CodingHevc;
+    codec_type_parse = CODEC_TYPE_HEVC;
+    m_frame_parser.init_start_codes (codec_type_parse);
+    m_frame_parser.init_nal_length(nal_length);
+#ifdef INPUT_BUFFER_LOG
+    strcat(inputfilename, "265");
+#endif
+  }
+#endif
   else if(!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.vc1",\
          OMX_MAX_STRINGNAME_SIZE))
   {
@@ -1608,7 +1658,8 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
       eRet = enable_extradata(DEFAULT_EXTRADATA);
 #endif
     if ( (codec_type_parse == CODEC_TYPE_VC1) ||
-        (codec_type_parse == CODEC_TYPE_H264)) //add CP check here
+        (codec_type_parse == CODEC_TYPE_H264) ||
+        (codec_type_parse == CODEC_TYPE_HEVC)) //add CP check here
     {
       //Check if dmx can be disabled
       struct vdec_ioctl_msg ioctl_msg = {NULL, NULL};
@@ -1638,11 +1689,15 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
         }
       }
     }
-    if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264)
+    if (codec_type_parse == CODEC_TYPE_H264 ||
+        codec_type_parse == CODEC_TYPE_HEVC)
     {
       if (m_frame_parser.mutils == NULL)
       {
-        m_frame_parser.mutils = new H264_Utils();
+        if (codec_type_parse == CODEC_TYPE_HEVC)
+          m_frame_parser.mutils = new HEVC_Utils();
+        else
+          m_frame_parser.mutils = new H264_Utils();
 
         if (m_frame_parser.mutils == NULL)
         {
@@ -1666,11 +1721,23 @@ OMX_ERRORTYPE omx_vdec::component_init(OMX_STRING role)
        }
       }
 
-      h264_parser = new h264_stream_parser();
-      if (!h264_parser)
+      if (codec_type_parse == CODEC_TYPE_HEVC)
       {
-        DEBUG_PRINT_ERROR("ERROR: H264 parser allocation failed!");
-        eRet = OMX_ErrorInsufficientResources;
+        hevc_parser = new hevc_stream_parser();
+        if (!hevc_parser)
+        {
+          DEBUG_PRINT_ERROR("ERROR: HEVC parser allocation failed!");
+          eRet = OMX_ErrorInsufficientResources;
+        }
+      }
+      else
+      {
+        h264_parser = new h264_stream_parser();
+        if (!h264_parser)
+        {
+          DEBUG_PRINT_ERROR("ERROR: H264 parser allocation failed!");
+          eRet = OMX_ErrorInsufficientResources;
+        }
       }
     }
 
@@ -2514,12 +2581,14 @@ bool omx_vdec::execute_input_flush()
   {
     DEBUG_PRINT_LOW("\n Reset all the variables before flusing");
     h264_scratch.nFilledLen = 0;
-    nal_count = 0;
-    look_ahead_nal = false;
+    m_h264_splitter.reset();
+    avcc_nal_left = 0;
+    avcc_prefix = 0;
+    avcc_prefix_bytes = 0;
+    m_thumbnail_done = false;
     frame_count = 0;
     h264_last_au_ts = LLONG_MAX;
     h264_last_au_flags = 0;
-    memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
     m_demux_entries = 0;
     DEBUG_PRINT_LOW("\n Initialize parser");
     if (m_frame_parser.mutils)
@@ -3024,6 +3093,13 @@ OMX_ERRORTYPE  omx_vdec::get_parameter(OMX_IN OMX_HANDLETYPE     hComp,
 #endif
           break;
         }
+    case OMX_QcomIndexParamVideoThumbnailMode:
+        {
+          DEBUG_PRINT_LOW("get_parameter: OMX_QcomIndexParamVideoThumbnailMode\n");
+          ((QOMX_ENABLETYPE *)paramData)->bEnable =
+              m_thumbnail_mode ? OMX_TRUE : OMX_FALSE;
+          break;
+        }
 #if defined (_ANDROID_HONEYCOMB_) || defined (_ANDROID_ICS_)
     case OMX_GoogleAndroidIndexGetAndroidNativeBufferUsage:
         {
@@ -3393,6 +3469,20 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                   eRet =OMX_ErrorUnsupportedSetting;
               }
           }
+#ifdef HEVC_DECODER_SUPPORT
+          else if(!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.hevc",OMX_MAX_STRINGNAME_SIZE))
+          {
+              if(!strncmp((char*)comp_role->cRole,"video_decoder.hevc",OMX_MAX_STRINGNAME_SIZE))
+              {
+                  strlcpy((char*)m_cRole,"video_decoder.hevc",OMX_MAX_STRINGNAME_SIZE);
+              }
+              else
+              {
+                  DEBUG_PRINT_ERROR("Setparameter: unknown Index %s\n", comp_role->cRole);
+                  eRet =OMX_ErrorUnsupportedSetting;
+              }
+          }
+#endif
           else if(!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.mpeg4",OMX_MAX_STRINGNAME_SIZE))
           {
               if(!strncmp((const char*)comp_role->cRole,"video_decoder.mpeg4",OMX_MAX_STRINGNAME_SIZE))
@@ -3553,6 +3643,12 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
                   }
               }
 #endif
+              if (m_thumbnail_mode &&
+                  pictureOrder->eOutputPictureOrder != QOMX_VIDEO_DECODE_ORDER)
+              {
+                  DEBUG_PRINT_HIGH("only decode order is supported for thumbnail mode");
+                  eRet = OMX_ErrorBadParameter;
+              }
               if (eRet == OMX_ErrorNone && pic_order != drv_ctx.picture_order)
               {
                   drv_ctx.picture_order = pic_order;
@@ -3716,6 +3812,25 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
           if(enableNativeBuffers) {
               m_enable_android_native_buffers = enableNativeBuffers->enable;
           }
+#ifdef MAX_RES_1080P
+          /* The driver mode can not be turned off again, with native
+           * buffers disabled INFO_CONFIG_CHANGED falls back to a full
+           * port reconfig */
+          if (!m_enable_android_native_buffers)
+              m_reconfig_in_place = false;
+          /* Native buffers carry their geometry, so a smaller resolution
+           * can be decoded into the buffers already allocated */
+          if (m_enable_android_native_buffers && m_reconfig_in_place_allowed &&
+              !secure_mode && !m_use_smoothstreaming && !m_reconfig_in_place &&
+              m_state == OMX_StateLoaded)
+          {
+              if (ioctl(drv_ctx.video_driver_fd,
+                        VDEC_IOCTL_SET_CONT_ON_RECONFIG) < 0)
+                  DEBUG_PRINT_ERROR("Failed to enable reconfig in place on driver.");
+              else
+                  m_reconfig_in_place = m_reconfig_in_place_drv = true;
+          }
+#endif
       }
       break;
     case OMX_GoogleAndroidIndexUseAndroidNativeBuffer:
@@ -3743,6 +3858,61 @@ OMX_ERRORTYPE  omx_vdec::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
         }
       }
       break;
+    case OMX_QcomIndexParamVideoThumbnailMode:
+      {
+        QOMX_ENABLETYPE *thumbnail = (QOMX_ENABLETYPE *)paramData;
+        DEBUG_PRINT_HIGH("set_parameter: OMX_QcomIndexParamVideoThumbnailMode %d",
+            thumbnail->bEnable);
+        if (m_state != OMX_StateLoaded)
+        {
+          eRet = OMX_ErrorIncorrectStateOperation;
+          break;
+        }
+        if (!thumbnail->bEnable)
+        {
+          if (m_thumbnail_mode)
+          {
+            DEBUG_PRINT_ERROR("\n Thumbnail mode can not be turned off");
+            eRet = OMX_ErrorUnsupportedSetting;
+          }
+          break;
+        }
+        drv_ctx.idr_only_decoding = 1;
+        if (ioctl(drv_ctx.video_driver_fd,
+                  VDEC_IOCTL_SET_IDR_ONLY_DECODING) < 0)
+        {
+          DEBUG_PRINT_ERROR("Failed to set IDR only decoding on driver.");
+          eRet = OMX_ErrorHardware;
+          break;
+        }
+        /* Pictures come out as soon as they are decoded, so no
+           DPB worth of output buffers is needed to reorder them */
+        drv_ctx.picture_order = VDEC_ORDER_DECODE;
+        ioctl_msg.in = &drv_ctx.picture_order;
+        ioctl_msg.out = NULL;
+        if (ioctl(drv_ctx.video_driver_fd, VDEC_IOCTL_SET_PICTURE_ORDER,
+            (void*)&ioctl_msg) < 0)
+        {
+          DEBUG_PRINT_ERROR("\n Set picture order failed");
+          eRet = OMX_ErrorUnsupportedSetting;
+          break;
+        }
+        time_stamp_dts.set_timestamp_reorder_mode(false);
+        m_thumbnail_mode = true;
+        m_thumbnail_done = false;
+        eRet = get_buffer_req(&drv_ctx.op_buf);
+        /* Decode order needs no more than the minimum output count. Trim
+           it once here, so a count the client sets afterwards is kept */
+        if (eRet == OMX_ErrorNone &&
+            drv_ctx.op_buf.actualcount > drv_ctx.op_buf.mincount)
+        {
+          drv_ctx.op_buf.actualcount = drv_ctx.op_buf.mincount;
+          eRet = set_buffer_req(&drv_ctx.op_buf);
+        }
+        DEBUG_PRINT_HIGH("Thumbnail mode with %d output buffers",
+            drv_ctx.op_buf.actualcount);
+      }
+      break;
     case OMX_QcomIndexEnableExtnUserData:
       {
         if(!secure_mode || drv_ctx.enable_sec_metadata)
@@ -3874,6 +4044,45 @@ OMX_ERRORTYPE  omx_vdec::get_config(OMX_IN OMX_HANDLETYPE      hComp,
       memcpy(rect, &rectangle, sizeof(OMX_CONFIG_RECTTYPE));
       break;
     }
+    case OMX_QcomIndexConfigVideoHDRInfo:
+    {
+      OMX_QCOM_VIDEO_CONFIG_HDRINFOTYPE *hdrInfo =
+        (OMX_QCOM_VIDEO_CONFIG_HDRINFOTYPE *) configData;
+      hevc_hdr_info hdr;
+
+      if (!hevc_parser)
+      {
+        DEBUG_PRINT_ERROR("get_config: HDR info supported for HEVC only");
+        eRet = OMX_ErrorUnsupportedIndex;
+        break;
+      }
+      if (hdrInfo->nPortIndex != OMX_CORE_OUTPUT_PORT_INDEX)
+      {
+        eRet = OMX_ErrorBadPortIndex;
+        break;
+      }
+      hdrInfo->bValid = hevc_parser->get_hdr_info(&hdr) ? OMX_TRUE : OMX_FALSE;
+      hdrInfo->nColourPrimaries = hdr.colour_primaries;
+      hdrInfo->nTransferCharacteristics = hdr.transfer_characteristics;
+      hdrInfo->nMatrixCoeffs = hdr.matrix_coeffs;
+      hdrInfo->bFullRange = hdr.video_full_range_flag ? OMX_TRUE : OMX_FALSE;
+      hdrInfo->bMasteringDisplay = hdr.mastering_display_present ? OMX_TRUE : OMX_FALSE;
+      for (int i = 0; i < 3; i++)
+      {
+        hdrInfo->nDisplayPrimariesX[i] = hdr.display_primaries_x[i];
+        hdrInfo->nDisplayPrimariesY[i] = hdr.display_primaries_y[i];
+      }
+      hdrInfo->nWhitePointX = hdr.white_point_x;
+      hdrInfo->nWhitePointY = hdr.white_point_y;
+      hdrInfo->nMaxDisplayLuminance = hdr.max_display_mastering_luminance;
+      hdrInfo->nMinDisplayLuminance = hdr.min_display_mastering_luminance;
+      hdrInfo->bContentLightLevel = hdr.content_light_level_present ? OMX_TRUE : OMX_FALSE;
+      hdrInfo->nMaxContentLightLevel = hdr.max_content_light_level;
+      hdrInfo->nMaxPicAverageLightLevel = hdr.max_pic_average_light_level;
+      DEBUG_PRINT_LOW("get_config: HDR info valid %d primaries %u transfer %u",
+        hdrInfo->bValid, hdrInfo->nColourPrimaries, hdrInfo->nTransferCharacteristics);
+      break;
+    }
 
     default:
     {
@@ -3937,6 +4146,7 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
       // Retrieve size of NAL length field
       // byte #4 contains the size of NAL lenght field
       nal_length = (config->pData[4] & 0x03) + 1;
+      nal_length_in_place = (nal_length == 4);
 
       extra_size = 0;
       if (nal_length > 2)
@@ -3983,6 +4193,40 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
         len = 0;
       }
     }
+    else if (!strcmp(drv_ctx.kind, "OMX.qcom.video.decoder.hevc"))
+    {
+      OMX_U8 *pSrc = config->pData;
+      OMX_U32 src_size = config->nDataSize;
+      OMX_U32 dst_size;
+      if (!pSrc || src_size < HEVC_HVCC_HEADER_SIZE)
+      {
+        DEBUG_PRINT_ERROR("\n set_config: hvcC too short (%d)", src_size);
+        return OMX_ErrorBadParameter;
+      }
+      nal_length = (pSrc[21] & 0x03) + 1;
+      nal_length_in_place = (nal_length == 4);
+      m_frame_parser.init_nal_length(nal_length);
+      if(m_vendor_config.pData)
+      {
+        free(m_vendor_config.pData);
+        m_vendor_config.pData = NULL;
+        m_vendor_config.nDataSize = 0;
+      }
+      // Validate and size the parameter sets first, then copy them out
+      // with the stream's own NAL length prefix
+      dst_size = hevc_unpack_hvcc(pSrc, src_size, nal_length, NULL, NULL);
+      if (!dst_size)
+        return OMX_ErrorBadParameter;
+      m_vendor_config.pData = (OMX_U8 *) malloc(dst_size);
+      if (!m_vendor_config.pData)
+        return OMX_ErrorInsufficientResources;
+      hevc_unpack_hvcc(pSrc, src_size, nal_length, m_vendor_config.pData,
+                       hevc_parser);
+      m_vendor_config.nPortIndex = config->nPortIndex;
+      m_vendor_config.nDataSize = dst_size;
+      DEBUG_PRINT_LOW("Rxd hvcC nPortIndex[%d] len[%d]\n",
+           m_vendor_config.nPortIndex, m_vendor_config.nDataSize);
+    }
     else if (!strcmp(drv_ctx.kind, "OMX.qcom.video.decoder.mpeg4") ||
              !strcmp(drv_ctx.kind, "OMX.qcom.video.decoder.mpeg2"))
     {
@@ -4046,6 +4290,11 @@ OMX_ERRORTYPE  omx_vdec::set_config(OMX_IN OMX_HANDLETYPE      hComp,
     pNal = reinterpret_cast < OMX_VIDEO_CONFIG_NALSIZE * >(configData);
     nal_length = pNal->nNaluBytes;
     m_frame_parser.init_nal_length(nal_length);
+    /* 4 byte lengths are turned into start codes in the client buffer,
+       which then goes through the start code path */
+    nal_length_in_place = (nal_length == 4 &&
+                           (codec_type_parse == CODEC_TYPE_H264 ||
+                            codec_type_parse == CODEC_TYPE_HEVC));
     DEBUG_PRINT_LOW("\n OMX_IndexConfigVideoNalSize called with Size %d",nal_length);
     return ret;
   }
@@ -4079,6 +4328,12 @@ OMX_ERRORTYPE  omx_vdec::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
     else if (!strncmp(paramName, "OMX.QCOM.index.param.video.SyncFrameDecodingMode",sizeof("OMX.QCOM.index.param.video.SyncFrameDecodingMode") - 1)) {
         *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoSyncFrameDecodingMode;
     }
+    else if (!strncmp(paramName, OMX_QCOM_INDEX_PARAM_VIDEO_THUMBNAILMODE,sizeof(OMX_QCOM_INDEX_PARAM_VIDEO_THUMBNAILMODE) - 1)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoThumbnailMode;
+    }
+    else if (!strncmp(paramName, OMX_QCOM_INDEX_CONFIG_VIDEO_HDRINFO,sizeof(OMX_QCOM_INDEX_CONFIG_VIDEO_HDRINFO) - 1)) {
+        *indexType = (OMX_INDEXTYPE)OMX_QcomIndexConfigVideoHDRInfo;
+    }
 #ifdef MAX_RES_1080P
     else if (!strncmp(paramName, "OMX.QCOM.index.param.IndexExtraData",sizeof("OMX.QCOM.index.param.IndexExtraData") - 1))
     {
@@ -4361,6 +4616,7 @@ OMX_ERRORTYPE  omx_vdec::use_output_buffer(
      }
      m_pmem_info[i].offset = drv_ctx.ptr_outputbuffer[i].offset;
      m_pmem_info[i].pmem_fd = drv_ctx.ptr_outputbuffer[i].pmem_fd;
+     m_out_buf_state[i] = VDEC_OUT_BUF_WITH_CLIENT;
 
      *bufferHdr = (m_out_mem_ptr + i );
      if(secure_mode)
@@ -4598,6 +4854,7 @@ OMX_ERRORTYPE omx_vdec::free_input_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
          free(m_desc_buffer_ptr[index].buf_addr);
          m_desc_buffer_ptr[index].buf_addr = NULL;
          m_desc_buffer_ptr[index].desc_data_size = 0;
+         m_desc_buffer_ptr[index].alloc_size = 0;
        }
 #ifdef USE_ION
        free_ion_memory(&drv_ctx.ip_buf_ion_info[index]);
@@ -4638,6 +4895,7 @@ OMX_ERRORTYPE omx_vdec::free_output_buffer(OMX_BUFFERHEADERTYPE *bufferHdr)
     if (ioctl (drv_ctx.video_driver_fd, VDEC_IOCTL_FREE_BUFFER,
           &ioctl_msg) < 0)
       DEBUG_PRINT_ERROR("\nRelease output buffer failed in VCD");
+    m_out_buf_state[index] = VDEC_OUT_BUF_UNUSED;
 
 #ifdef _ANDROID_
     if(m_enable_android_native_buffers) {
@@ -5002,184 +5260,56 @@ OMX_ERRORTYPE  omx_vdec::allocate_output_buffer(
   struct ion_fd_data fd_ion_data;
 #endif
 
-  int nBufHdrSize        = 0;
-  int nPlatformEntrySize = 0;
-  int nPlatformListSize  = 0;
-  int nPMEMInfoSize = 0;
   int pmem_fd = -1;
   unsigned char *pmem_baseaddress = NULL;
 
-  OMX_QCOM_PLATFORM_PRIVATE_LIST      *pPlatformList;
-  OMX_QCOM_PLATFORM_PRIVATE_ENTRY     *pPlatformEntry;
-  OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pPMEMInfo;
-
   if (!m_out_mem_ptr)
   {
     DEBUG_PRINT_HIGH("\n Allocate o/p buffer Header: Cnt(%d) Sz(%d)",
       drv_ctx.op_buf.actualcount,
       drv_ctx.op_buf.buffer_size);
 
-    DEBUG_PRINT_LOW("Allocating First Output Buffer(%d)\n",
-      drv_ctx.op_buf.actualcount);
-
-    nBufHdrSize        = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_BUFFERHEADERTYPE);
-
-    nPMEMInfoSize      = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO);
-    nPlatformListSize  = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_LIST);
-    nPlatformEntrySize = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_ENTRY);
-
-    DEBUG_PRINT_LOW("TotalBufHdr %d BufHdrSize %d PMEM %d PL %d\n",nBufHdrSize,
-                         sizeof(OMX_BUFFERHEADERTYPE),
-                         nPMEMInfoSize,
-                         nPlatformListSize);
-    DEBUG_PRINT_LOW("PE %d OutputBuffer Count %d \n",nPlatformEntrySize,
-                         drv_ctx.op_buf.actualcount);
-
-    m_out_mem_ptr = (OMX_BUFFERHEADERTYPE  *)calloc(nBufHdrSize,1);
-    // Alloc mem for platform specific info
-    char *pPtr=NULL;
-    pPtr = (char*) calloc(nPlatformListSize + nPlatformEntrySize +
-                                     nPMEMInfoSize,1);
-    drv_ctx.ptr_outputbuffer = (struct vdec_bufferpayload *)\
-      calloc (sizeof(struct vdec_bufferpayload),
-      drv_ctx.op_buf.actualcount);
-    drv_ctx.ptr_respbuffer = (struct vdec_output_frameinfo  *)\
-      calloc (sizeof (struct vdec_output_frameinfo),
-      drv_ctx.op_buf.actualcount);
-#ifdef USE_ION
-    drv_ctx.op_buf_ion_info = (struct vdec_ion *)\
-      calloc (sizeof(struct vdec_ion),
-      drv_ctx.op_buf.actualcount);
-#endif
-#ifdef _ANDROID_
-    m_heap_ptr = (struct vidc_heap *)\
-       calloc (sizeof(struct vidc_heap),
-      drv_ctx.op_buf.actualcount);
-#endif
-
-    if(m_out_mem_ptr && pPtr && drv_ctx.ptr_outputbuffer
-       && drv_ctx.ptr_respbuffer
-#ifdef _ANDROID_
-	   && m_heap_ptr
-#endif
-	   )
-    {
-      drv_ctx.ptr_outputbuffer[0].mmaped_size =
-        (drv_ctx.op_buf.buffer_size *
-         drv_ctx.op_buf.actualcount);
-      bufHdr          =  m_out_mem_ptr;
-      m_platform_list = (OMX_QCOM_PLATFORM_PRIVATE_LIST *)(pPtr);
-      m_platform_entry= (OMX_QCOM_PLATFORM_PRIVATE_ENTRY *)
-                        (((char *) m_platform_list)  + nPlatformListSize);
-      m_pmem_info     = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)
-                        (((char *) m_platform_entry) + nPlatformEntrySize);
-      pPlatformList   = m_platform_list;
-      pPlatformEntry  = m_platform_entry;
-      pPMEMInfo       = m_pmem_info;
-
-      DEBUG_PRINT_LOW("Memory Allocation Succeeded for OUT port%p\n",m_out_mem_ptr);
-
-      // Settting the entire storage nicely
-      DEBUG_PRINT_LOW("bHdr %p OutMem %p PE %p\n",bufHdr, m_out_mem_ptr,pPlatformEntry);
-      DEBUG_PRINT_LOW(" Pmem Info = %p \n",pPMEMInfo);
-      for(i=0; i < drv_ctx.op_buf.actualcount ; i++)
-      {
-        bufHdr->nSize              = sizeof(OMX_BUFFERHEADERTYPE);
-        bufHdr->nVersion.nVersion  = OMX_SPEC_VERSION;
-        // Set the values when we determine the right HxW param
-        bufHdr->nAllocLen          = 0;
-        bufHdr->nFilledLen         = 0;
-        bufHdr->pAppPrivate        = NULL;
-        bufHdr->nOutputPortIndex   = OMX_CORE_OUTPUT_PORT_INDEX;
-        // Platform specific PMEM Information
-        // Initialize the Platform Entry
-        //DEBUG_PRINT_LOW("Initializing the Platform Entry for %d\n",i);
-        pPlatformEntry->type       = OMX_QCOM_PLATFORM_PRIVATE_PMEM;
-        pPlatformEntry->entry      = pPMEMInfo;
-        // Initialize the Platform List
-        pPlatformList->nEntries    = 1;
-        pPlatformList->entryList   = pPlatformEntry;
-        // Keep pBuffer NULL till vdec is opened
-        bufHdr->pBuffer            = NULL;
-
-        pPMEMInfo->offset          =  0;
-        pPMEMInfo->pmem_fd = 0;
-        bufHdr->pPlatformPrivate = pPlatformList;
-        drv_ctx.ptr_outputbuffer[i].pmem_fd = -1;
-#ifdef USE_ION
-        drv_ctx.op_buf_ion_info[i].ion_device_fd =-1;
-#endif
-        /*Create a mapping between buffers*/
-        bufHdr->pOutputPortPrivate = &drv_ctx.ptr_respbuffer[i];
-        drv_ctx.ptr_respbuffer[i].client_data = (void *)\
-                                            &drv_ctx.ptr_outputbuffer[i];
+    eRet = allocate_output_header_table();
 #ifdef _ANDROID_
-        m_heap_ptr[i].video_heap_ptr = NULL;
-#endif
-        // Move the buffer and buffer header pointers
-        bufHdr++;
-        pPMEMInfo++;
-        pPlatformEntry++;
-        pPlatformList++;
-      }
-#ifdef MAX_RES_1080P
-      if(eRet == OMX_ErrorNone && drv_ctx.enable_sec_metadata)
+    if (eRet == OMX_ErrorNone)
+    {
+      m_heap_ptr = (struct vidc_heap *)\
+         calloc (sizeof(struct vidc_heap),
+        drv_ctx.op_buf.actualcount);
+      if (!m_heap_ptr)
       {
-        eRet = vdec_alloc_meta_buffers();
-        if (eRet) {
-          DEBUG_PRINT_ERROR("ERROR in allocating meta buffers\n");
-          return OMX_ErrorInsufficientResources;
-        }
+        DEBUG_PRINT_ERROR("Output heap info alloc failed\n");
+        free_output_buffer_header();
+        eRet = OMX_ErrorInsufficientResources;
       }
+    }
+#endif
+    if (eRet != OMX_ErrorNone)
+      return eRet;
 
-      if(eRet == OMX_ErrorNone && drv_ctx.decoder_format == VDEC_CODECTYPE_H264)
-      {
-        //Allocate the h264_mv_buffer
-        eRet = vdec_alloc_h264_mv();
-        if(eRet) {
-          DEBUG_PRINT_ERROR("ERROR in allocating MV buffers\n");
-          return OMX_ErrorInsufficientResources;
-        }
+    drv_ctx.ptr_outputbuffer[0].mmaped_size =
+      (drv_ctx.op_buf.buffer_size *
+       drv_ctx.op_buf.actualcount);
+#ifdef MAX_RES_1080P
+    if(drv_ctx.enable_sec_metadata)
+    {
+      eRet = vdec_alloc_meta_buffers();
+      if (eRet) {
+        DEBUG_PRINT_ERROR("ERROR in allocating meta buffers\n");
+        return OMX_ErrorInsufficientResources;
       }
-#endif
     }
-    else
+
+    if(drv_ctx.decoder_format == VDEC_CODECTYPE_H264)
     {
-      DEBUG_PRINT_ERROR("Output buf mem alloc failed[0x%x][0x%x]\n",\
-                                        m_out_mem_ptr, pPtr);
-      if(m_out_mem_ptr)
-      {
-        free(m_out_mem_ptr);
-        m_out_mem_ptr = NULL;
-      }
-      if(pPtr)
-      {
-        free(pPtr);
-        pPtr = NULL;
-      }
-      if(drv_ctx.ptr_outputbuffer)
-      {
-        free(drv_ctx.ptr_outputbuffer);
-        drv_ctx.ptr_outputbuffer = NULL;
-      }
-      if(drv_ctx.ptr_respbuffer)
-      {
-        free(drv_ctx.ptr_respbuffer);
-        drv_ctx.ptr_respbuffer = NULL;
+      //Allocate the h264_mv_buffer
+      eRet = vdec_alloc_h264_mv();
+      if(eRet) {
+        DEBUG_PRINT_ERROR("ERROR in allocating MV buffers\n");
+        return OMX_ErrorInsufficientResources;
       }
-#ifdef USE_ION
-    if (drv_ctx.op_buf_ion_info) {
-        DEBUG_PRINT_LOW("\n Free o/p ion context");
-	free(drv_ctx.op_buf_ion_info);
-        drv_ctx.op_buf_ion_info = NULL;
     }
 #endif
-      eRet =  OMX_ErrorInsufficientResources;
-    }
   }
 
   for (i=0; i< drv_ctx.op_buf.actualcount; i++)
@@ -5283,6 +5413,7 @@ OMX_ERRORTYPE  omx_vdec::allocate_output_buffer(
 #else
     m_pmem_info[i].pmem_fd = drv_ctx.ptr_outputbuffer[i].pmem_fd ;
 #endif
+    m_out_buf_state[i] = VDEC_OUT_BUF_WITH_CLIENT;
     setbuffers.buffer_type = VDEC_BUFFER_TYPE_OUTPUT;
     memcpy (&setbuffers.buffer,&drv_ctx.ptr_outputbuffer [i],
             sizeof (vdec_bufferpayload));
@@ -5758,7 +5889,7 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     }
   }
 #endif
-  if(input_flush_progress == true
+  if(input_flush_progress == true || m_thumbnail_done
 #ifdef MAX_RES_1080P
      || not_coded_vop
 #endif
@@ -5781,6 +5912,24 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
   /*for use buffer we need to memcpy the data*/
   temp_buffer->buffer_len = buffer->nFilledLen;
 
+  if (nal_length_in_place && !arbitrary_bytes)
+  {
+    /* Whole frame per buffer: the demux table comes straight from the
+       length fields, so the buffer is never scanned for start codes */
+    OMX_BUFFERHEADERTYPE *src = input_use_buffer ?
+        &m_inp_heap_ptr[nPortIndex] : buffer;
+    m_demux_entries = 0;
+    if (!rewrite_nal_length_prefixes(src->pBuffer + src->nOffset,
+                                     buffer->nFilledLen, true))
+    {
+      DEBUG_PRINT_ERROR("\n ETBProxy: NAL lengths overrun frame %p", buffer);
+      avcc_nal_left = 0;
+      avcc_prefix = 0;
+      avcc_prefix_bytes = 0;
+      m_demux_entries = 0;
+    }
+  }
+
   if (input_use_buffer)
   {
     if (buffer->nFilledLen <= temp_buffer->buffer_len)
@@ -5869,15 +6018,13 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     DEBUG_PRINT_HIGH("\n Rxd i/p EOS, Notify Driver that EOS has been reached");
     frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
     h264_scratch.nFilledLen = 0;
-    nal_count = 0;
-    look_ahead_nal = false;
+    m_h264_splitter.reset();
     frame_count = 0;
     if (m_frame_parser.mutils)
       m_frame_parser.mutils->initialize_frame_checking_environment();
     m_frame_parser.flush();
     h264_last_au_ts = LLONG_MAX;
     h264_last_au_flags = 0;
-    memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
     m_demux_entries = 0;
   }
   DEBUG_PRINT_LOW("[ETBP] pBuf(%p) nTS(%lld) Sz(%d)",
@@ -5972,8 +6119,7 @@ OMX_ERRORTYPE  omx_vdec::fill_this_buffer_proxy(
   struct vdec_ioctl_msg ioctl_msg = {NULL,NULL};
   OMX_BUFFERHEADERTYPE *buffer = bufferAdd;
   struct vdec_fillbuffer_cmd fillbuffer;
-  struct vdec_bufferpayload     *ptr_outputbuffer = NULL;
-  struct vdec_output_frameinfo  *ptr_respbuffer = NULL;
+  unsigned index = 0;
 
 
   if (bufferAdd == NULL || ((buffer - client_buffers.get_il_buf_hdr()) >
@@ -5992,31 +6138,31 @@ OMX_ERRORTYPE  omx_vdec::fill_this_buffer_proxy(
   }
   pending_output_buffers++;
   buffer = client_buffers.get_dr_buf_hdr(bufferAdd);
-  ptr_respbuffer = (struct vdec_output_frameinfo*)buffer->pOutputPortPrivate;
-  if (ptr_respbuffer)
+  index = buffer - m_out_mem_ptr;
+  if (buffer == NULL || index >= drv_ctx.op_buf.actualcount)
   {
-    ptr_outputbuffer =  (struct vdec_bufferpayload*)ptr_respbuffer->client_data;
+      DEBUG_PRINT_ERROR("FTB buffer not in the output table");
+      bufferAdd->nFilledLen = 0;
+      m_cb.FillBufferDone (hComp,m_app_data,bufferAdd);
+      pending_output_buffers--;
+      return OMX_ErrorBadParameter;
   }
-
-  if (ptr_respbuffer == NULL || ptr_outputbuffer == NULL)
+  if (!vdec_output_queue(m_out_buf_state, drv_ctx.ptr_outputbuffer,
+                         index, buffer, &fillbuffer))
   {
-      DEBUG_PRINT_ERROR("resp buffer or outputbuffer is NULL");
-      buffer->nFilledLen = 0;
-      m_cb.FillBufferDone (hComp,m_app_data,buffer);
+      /* Queued twice, the driver still owns it: leave it there */
+      DEBUG_PRINT_ERROR("FTB of buffer %d already with the driver", index);
       pending_output_buffers--;
       return OMX_ErrorBadParameter;
   }
 
-  memcpy (&fillbuffer.buffer,ptr_outputbuffer,\
-          sizeof(struct vdec_bufferpayload));
-  fillbuffer.client_data = buffer;
-
   ioctl_msg.in = &fillbuffer;
   ioctl_msg.out = NULL;
   if (ioctl (drv_ctx.video_driver_fd,
          VDEC_IOCTL_FILL_OUTPUT_BUFFER,&ioctl_msg) < 0)
   {
     DEBUG_PRINT_ERROR("\n Decoder frame failed");
+    m_out_buf_state[index] = VDEC_OUT_BUF_WITH_CLIENT;
     m_cb.FillBufferDone (hComp,m_app_data,buffer);
     pending_output_buffers--;
     return OMX_ErrorBadParameter;
@@ -6131,6 +6277,12 @@ OMX_ERRORTYPE  omx_vdec::component_deinit(OMX_IN OMX_HANDLETYPE hComp)
 	h264_parser = NULL;
     }
 
+    if (hevc_parser)
+    {
+        delete hevc_parser;
+        hevc_parser = NULL;
+    }
+
     if (m_frame_parser.mutils)
     {
         DEBUG_PRINT_LOW("\n Free utils parser");
@@ -6368,6 +6520,21 @@ OMX_ERRORTYPE  omx_vdec::component_role_enum(OMX_IN OMX_HANDLETYPE hComp,
       eRet = OMX_ErrorNoMore;
     }
   }
+#ifdef HEVC_DECODER_SUPPORT
+  else if(!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.hevc",OMX_MAX_STRINGNAME_SIZE))
+  {
+    if((0 == index) && role)
+    {
+      strlcpy((char *)role, "video_decoder.hevc",OMX_MAX_STRINGNAME_SIZE);
+      DEBUG_PRINT_LOW("component_role_enum: role %s\n",role);
+    }
+    else
+    {
+      DEBUG_PRINT_LOW("\n No more roles \n");
+      eRet = OMX_ErrorNoMore;
+    }
+  }
+#endif
   else if( (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.vc1",OMX_MAX_STRINGNAME_SIZE)) ||
            (!strncmp(drv_ctx.kind, "OMX.qcom.video.decoder.wmv",OMX_MAX_STRINGNAME_SIZE))
            )
@@ -6630,7 +6797,6 @@ bool omx_vdec::release_input_done(void)
 OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
                                OMX_BUFFERHEADERTYPE * buffer)
 {
-  OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pPMEMInfo = NULL;
   if (!buffer || (buffer - m_out_mem_ptr) >= drv_ctx.op_buf.actualcount)
   {
     DEBUG_PRINT_ERROR("\n [FBD] ERROR in ptr(%p)", buffer);
@@ -6647,9 +6813,7 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
   }
 
 #ifdef _ANDROID_
-  char value[PROPERTY_VALUE_MAX];
-  property_get("vidc.dec.debug.panframedata", value, NULL);
-  if (atoi(value))
+  if (m_debug_panframedata)
   {
     if (buffer->nFlags & QOMX_VIDEO_BUFFERFLAG_EOSEQ)
     {
@@ -6673,6 +6837,15 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
       buffer, buffer->pBuffer);
   pending_output_buffers --;
 
+  if (m_thumbnail_mode && !m_thumbnail_done && !output_flush_progress &&
+      buffer->nFilledLen)
+  {
+    /* The thumbnail is out, nothing after it needs decoding */
+    DEBUG_PRINT_HIGH("\n Thumbnail decoded, signal EOS");
+    m_thumbnail_done = true;
+    buffer->nFlags |= OMX_BUFFERFLAG_EOS;
+  }
+
   if (buffer->nFlags & OMX_BUFFERFLAG_EOS)
   {
     DEBUG_PRINT_HIGH("\n Output EOS has been reached");
@@ -6795,10 +6968,8 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
       rst_prev_ts = true;
       }
 
-    pPMEMInfo = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)
-                ((OMX_QCOM_PLATFORM_PRIVATE_LIST *)
-                buffer->pPlatformPrivate)->entryList->entry;
-    DEBUG_PRINT_LOW("\n Before FBD callback Accessed Pmeminfo %d",pPMEMInfo->pmem_fd);
+    DEBUG_PRINT_LOW("\n Before FBD callback fd %d",
+        drv_ctx.ptr_outputbuffer[buffer - m_out_mem_ptr].pmem_fd);
     OMX_BUFFERHEADERTYPE *il_buffer;
     il_buffer = client_buffers.get_il_buf_hdr(buffer);
     if (il_buffer)
@@ -6808,7 +6979,8 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
       return OMX_ErrorBadParameter;
     }
 
-    DEBUG_PRINT_LOW("\n After Fill Buffer Done callback %d",pPMEMInfo->pmem_fd);
+    DEBUG_PRINT_LOW("\n After Fill Buffer Done callback %d",
+        drv_ctx.ptr_outputbuffer[buffer - m_out_mem_ptr].pmem_fd);
   }
   else
   {
@@ -6816,12 +6988,10 @@ OMX_ERRORTYPE omx_vdec::fill_buffer_done(OMX_HANDLETYPE hComp,
   }
 
  // ss change
- if (m_use_smoothstreaming) {
+ if (m_use_smoothstreaming || m_reconfig_in_place) {
     OMX_U32 buf_index = buffer - m_out_mem_ptr;
     private_handle_t * handle = NULL;
-    BufferDim_t dim;
-    dim.sliceWidth = m_port_def.format.video.nStride;
-    dim.sliceHeight = m_port_def.format.video.nSliceHeight;
+    BufferDim_t dim = m_out_dim[buf_index];
     handle = (private_handle_t *)native_buffer[buf_index];
     DEBUG_PRINT_LOW("set metadata: update buffer geo with stride %d slice %d", dim.sliceWidth, dim.sliceHeight);
     setMetaData(handle, UPDATE_BUFFER_GEOMETRY, (void*)&dim);
@@ -6881,7 +7051,7 @@ int omx_vdec::async_message_process (void *context, void* message)
   omx_vdec* omx = NULL;
   struct vdec_msginfo *vdec_msg = NULL;
   OMX_BUFFERHEADERTYPE* omxhdr = NULL;
-  struct vdec_output_frameinfo *output_respbuf = NULL;
+  unsigned index = 0;
 
   if (context == NULL || message == NULL)
   {
@@ -6980,20 +7150,14 @@ int omx_vdec::async_message_process (void *context, void* message)
         vdec_msg->msgdata.output_frame.flags &= ~OMX_BUFFERFLAG_SYNCFRAME;
     }
 
-    if (omxhdr && omxhdr->pOutputPortPrivate &&
-        ((omxhdr - omx->m_out_mem_ptr) < omx->drv_ctx.op_buf.actualcount) &&
-         (((struct vdec_output_frameinfo *)omxhdr->pOutputPortPrivate
-            - omx->drv_ctx.ptr_respbuffer) < omx->drv_ctx.op_buf.actualcount))
+    index = omxhdr - omx->m_out_mem_ptr;
+    if (omxhdr && index < omx->drv_ctx.op_buf.actualcount)
     {
-      if (vdec_msg->msgdata.output_frame.len <=  omxhdr->nAllocLen)
+      /* The index is all the tables need, pOutputPortPrivate of entry
+         index is ptr_respbuffer + index by construction */
+      if (vdec_output_done(omx->m_out_buf_state, omx->drv_ctx.ptr_respbuffer,
+                           omxhdr, index, &vdec_msg->msgdata.output_frame))
       {
-        omxhdr->nFilledLen = vdec_msg->msgdata.output_frame.len;
-        omxhdr->nOffset = vdec_msg->msgdata.output_frame.offset;
-        omxhdr->nTimeStamp = vdec_msg->msgdata.output_frame.time_stamp;
-        omxhdr->nFlags = (vdec_msg->msgdata.output_frame.flags);
-
-        output_respbuf = (struct vdec_output_frameinfo *)\
-                          omxhdr->pOutputPortPrivate;
         if (omxhdr->nFilledLen && ((omx->rectangle.nLeft != vdec_msg->msgdata.output_frame.framesize.left)
             || (omx->rectangle.nTop != vdec_msg->msgdata.output_frame.framesize.top)
             || (omx->rectangle.nWidth != vdec_msg->msgdata.output_frame.framesize.right)
@@ -7012,24 +7176,19 @@ int omx_vdec::async_message_process (void *context, void* message)
                 omx->rectangle.nWidth, omx->rectangle.nHeight);
             omx->post_event (OMX_CORE_OUTPUT_PORT_INDEX, OMX_IndexConfigCommonOutputCrop,
                 OMX_COMPONENT_GENERATE_PORT_RECONFIG);
+            /* first frame at the new size, later frames take its geometry */
+            if (omx->m_dim_pending)
+            {
+                omx->m_frame_dim = omx->m_pending_dim;
+                omx->m_dim_pending = false;
+            }
         }
-
-        output_respbuf->framesize.bottom =
-          vdec_msg->msgdata.output_frame.framesize.bottom;
-        output_respbuf->framesize.left =
-          vdec_msg->msgdata.output_frame.framesize.left;
-        output_respbuf->framesize.right =
-          vdec_msg->msgdata.output_frame.framesize.right;
-        output_respbuf->framesize.top =
-          vdec_msg->msgdata.output_frame.framesize.top;
-        output_respbuf->len = vdec_msg->msgdata.output_frame.len;
-        output_respbuf->offset = vdec_msg->msgdata.output_frame.offset;
-        output_respbuf->time_stamp = vdec_msg->msgdata.output_frame.time_stamp;
-        output_respbuf->flags = vdec_msg->msgdata.output_frame.flags;
-        output_respbuf->pic_type = vdec_msg->msgdata.output_frame.pic_type;
-        output_respbuf->interlaced_format = vdec_msg->msgdata.output_frame.interlaced_format;
-        output_respbuf->aspect_ratio_info =
-           vdec_msg->msgdata.output_frame.aspect_ratio_info;
+        if (!omx->m_frame_dim.sliceWidth)
+        {
+            omx->m_frame_dim.sliceWidth = omx->drv_ctx.video_resolution.stride;
+            omx->m_frame_dim.sliceHeight = omx->drv_ctx.video_resolution.scan_lines;
+        }
+        omx->m_out_dim[index] = omx->m_frame_dim;
 
         if (omx->output_use_buffer)
           memcpy ( omxhdr->pBuffer,
@@ -7037,8 +7196,6 @@ int omx_vdec::async_message_process (void *context, void* message)
                     vdec_msg->msgdata.output_frame.offset),
                     vdec_msg->msgdata.output_frame.len );
       }
-      else
-        omxhdr->nFilledLen = 0;
       omx->post_event ((unsigned int)omxhdr, vdec_msg->status_code,
                        OMX_COMPONENT_GENERATE_FBD);
     }
@@ -7051,16 +7208,39 @@ int omx_vdec::async_message_process (void *context, void* message)
     break;
   case VDEC_MSG_EVT_CONFIG_CHANGED:
     DEBUG_PRINT_HIGH("\n Port settings changed");
+    memset(&omx->m_frame_dim, 0, sizeof(omx->m_frame_dim));
+    omx->m_dim_pending = false;
     omx->post_event (OMX_CORE_OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition,
                      OMX_COMPONENT_GENERATE_PORT_RECONFIG);
     break;
   case VDEC_MSG_EVT_INFO_CONFIG_CHANGED:
   {
     DEBUG_PRINT_HIGH("\n Port settings changed info");
-    // get_buffer_req and populate port defn structure
+    if (omx->m_reconfig_in_place_drv && !omx->m_use_smoothstreaming &&
+        (!omx->m_reconfig_in_place || !omx->output_buffers_fit()))
+    {
+      /* Native buffers were disabled since, or the buffers held can not
+         take the new resolution after all */
+      DEBUG_PRINT_HIGH("\n Output buffers not kept, full port reconfig");
+      memset(&omx->m_frame_dim, 0, sizeof(omx->m_frame_dim));
+      omx->m_dim_pending = false;
+      omx->post_event (OMX_CORE_OUTPUT_PORT_INDEX, OMX_IndexParamPortDefinition,
+                       OMX_COMPONENT_GENERATE_PORT_RECONFIG);
+      break;
+    }
+    // get_buffer_req and populate port defn structure, the new crop
+    // is signalled with the first frame decoded at the new resolution
     OMX_ERRORTYPE eRet = OMX_ErrorNone;
+    if (!omx->m_frame_dim.sliceWidth)
+    {
+      omx->m_frame_dim.sliceWidth = omx->drv_ctx.video_resolution.stride;
+      omx->m_frame_dim.sliceHeight = omx->drv_ctx.video_resolution.scan_lines;
+    }
     omx->m_port_def.nPortIndex = 1;
     eRet = omx->update_portdef(&(omx->m_port_def));
+    omx->m_pending_dim.sliceWidth = omx->drv_ctx.video_resolution.stride;
+    omx->m_pending_dim.sliceHeight = omx->drv_ctx.video_resolution.scan_lines;
+    omx->m_dim_pending = true;
     break;
   }
   default:
@@ -7095,6 +7275,17 @@ OMX_ERRORTYPE omx_vdec::empty_this_buffer_proxy_arbitrary (
     return OMX_ErrorNone;
   }
 
+  if (nal_length_in_place &&
+      (!rewrite_nal_length_prefixes(buffer->pBuffer + buffer->nOffset,
+                                    buffer->nFilledLen, false) &&
+       (buffer->nFlags & OMX_BUFFERFLAG_EOS)))
+  {
+    DEBUG_PRINT_ERROR("\n ETBProxyArb: stream ends inside a NAL");
+    avcc_nal_left = 0;
+    avcc_prefix = 0;
+    avcc_prefix_bytes = 0;
+  }
+
   if (psource_frame == NULL)
   {
     DEBUG_PRINT_LOW("\n Set Buffer as source Buffer %p time stamp %d",buffer,buffer->nTimeStamp);
@@ -7164,6 +7355,7 @@ OMX_ERRORTYPE omx_vdec::push_input_buffer (OMX_HANDLETYPE hComp)
         ret =  push_input_sc_codec(hComp);
       break;
       case CODEC_TYPE_H264:
+      case CODEC_TYPE_HEVC:
         ret = push_input_h264(hComp);
       break;
       case CODEC_TYPE_VC1:
@@ -7304,195 +7496,34 @@ OMX_ERRORTYPE omx_vdec::push_input_sc_codec(OMX_HANDLETYPE hComp)
   return OMX_ErrorNone;
 }
 
+#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
+/* Extradata taken from SEI parsed on the input side */
+#define H264_INPUT_SEI_EXTRADATA (OMX_TIMEINFO_EXTRADATA | OMX_FRAMEINFO_EXTRADATA)
+#else
+#define H264_INPUT_SEI_EXTRADATA 0
+#endif
+
 OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
 {
-  OMX_U32 partial_frame = 1;
   unsigned address,p2,id;
-  OMX_BOOL isNewFrame = OMX_FALSE;
   OMX_BOOL generate_ebd = OMX_TRUE;
+  OMX_ERRORTYPE ret;
+  bool nal_length_mode = nal_length && !nal_length_in_place;
 
   if (h264_scratch.pBuffer == NULL)
   {
     DEBUG_PRINT_ERROR("\nERROR:H.264 Scratch Buffer not allocated");
     return OMX_ErrorBadParameter;
   }
-  DEBUG_PRINT_LOW("\n Pending h264_scratch.nFilledLen %d "
-      "look_ahead_nal %d", h264_scratch.nFilledLen, look_ahead_nal);
-  DEBUG_PRINT_LOW("\n Pending pdest_frame->nFilledLen %d",pdest_frame->nFilledLen);
-  if (h264_scratch.nFilledLen && look_ahead_nal)
-  {
-    look_ahead_nal = false;
-    if ((pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-         h264_scratch.nFilledLen)
-    {
-      memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-              h264_scratch.pBuffer,h264_scratch.nFilledLen);
-      pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-      DEBUG_PRINT_LOW("\n Copy the previous NAL (h264 scratch) into Dest frame");
-      h264_scratch.nFilledLen = 0;
-    }
-    else
-    {
-      DEBUG_PRINT_ERROR("\n Error:1: Destination buffer overflow for H264");
-      return OMX_ErrorBadParameter;
-    }
-  }
-  if (nal_length == 0)
-  {
-    DEBUG_PRINT_LOW("\n Zero NAL, hence parse using start code");
-    if (m_frame_parser.parse_sc_frame(psource_frame,
-        &h264_scratch,&partial_frame) == -1)
-    {
-      DEBUG_PRINT_ERROR("\n Error In Parsing Return Error");
-      return OMX_ErrorBadParameter;
-    }
-  }
-  else
-  {
-    DEBUG_PRINT_LOW("\n Non-zero NAL length clip, hence parse with NAL size %d ",nal_length);
-    if (m_frame_parser.parse_h264_nallength(psource_frame,
-        &h264_scratch,&partial_frame) == -1)
-    {
-      DEBUG_PRINT_ERROR("\n Error In Parsing NAL size, Return Error");
-      return OMX_ErrorBadParameter;
-    }
-  }
-
-  if (partial_frame == 0)
-  {
-    if (nal_count == 0 && h264_scratch.nFilledLen == 0)
-    {
-      DEBUG_PRINT_LOW("\n First NAL with Zero Length, hence Skip");
-      nal_count++;
-      h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
-      h264_scratch.nFlags = psource_frame->nFlags;
-    }
-    else
-    {
-      DEBUG_PRINT_LOW("\n Parsed New NAL Length = %d",h264_scratch.nFilledLen);
-      if(h264_scratch.nFilledLen)
-      {
-          h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer, h264_scratch.nFilledLen,
-                                 NALU_TYPE_SPS);
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-        if (client_extradata & OMX_TIMEINFO_EXTRADATA)
-          h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                                  h264_scratch.nFilledLen, NALU_TYPE_SEI);
-        else if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-          // If timeinfo is present frame info from SEI is already processed
-          h264_parser->parse_nal((OMX_U8*)h264_scratch.pBuffer,
-                                  h264_scratch.nFilledLen, NALU_TYPE_SEI);
-#endif
-        m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-        nal_count++;
-        if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
-          pdest_frame->nTimeStamp = h264_last_au_ts;
-          pdest_frame->nFlags = h264_last_au_flags;
-#ifdef PANSCAN_HDLR
-          if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-            h264_parser->update_panscan_data(h264_last_au_ts);
-#endif
-        }
-        if(m_frame_parser.mutils->nalu_type == NALU_TYPE_NON_IDR ||
-           m_frame_parser.mutils->nalu_type == NALU_TYPE_IDR) {
-          h264_last_au_ts = h264_scratch.nTimeStamp;
-          h264_last_au_flags = h264_scratch.nFlags;
-#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-          if (client_extradata & OMX_TIMEINFO_EXTRADATA)
-          {
-            OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(h264_last_au_ts);
-            if (!VALID_TS(h264_last_au_ts))
-              h264_last_au_ts = ts_in_sei;
-          }
-#endif
-        } else
-          h264_last_au_ts = LLONG_MAX;
-      }
-
-      if (!isNewFrame)
-      {
-        if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-            h264_scratch.nFilledLen)
-        {
-          DEBUG_PRINT_LOW("\n Not a NewFrame Copy into Dest len %d",
-              h264_scratch.nFilledLen);
-          memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-              h264_scratch.pBuffer,h264_scratch.nFilledLen);
-          pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-          if(m_frame_parser.mutils->nalu_type == NALU_TYPE_EOSEQ)
-            pdest_frame->nFlags |= QOMX_VIDEO_BUFFERFLAG_EOSEQ;
-          h264_scratch.nFilledLen = 0;
-        }
-        else
-        {
-          DEBUG_PRINT_LOW("\n Error:2: Destination buffer overflow for H264");
-          return OMX_ErrorBadParameter;
-        }
-      }
-      else if(h264_scratch.nFilledLen)
-      {
-        look_ahead_nal = true;
-        DEBUG_PRINT_LOW("\n Frame Found start Decoding Size =%d TimeStamp = %x",
-                     pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
-        DEBUG_PRINT_LOW("\n Found a frame size = %d number = %d",
-                     pdest_frame->nFilledLen,frame_count++);
-
-        if (pdest_frame->nFilledLen == 0)
-        {
-          DEBUG_PRINT_LOW("\n Copy the Current Frame since and push it");
-          look_ahead_nal = false;
-          if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-               h264_scratch.nFilledLen)
-          {
-            memcpy ((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                    h264_scratch.pBuffer,h264_scratch.nFilledLen);
-            pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-            h264_scratch.nFilledLen = 0;
-          }
-          else
-          {
-            DEBUG_PRINT_ERROR("\n Error:3: Destination buffer overflow for H264");
-            return OMX_ErrorBadParameter;
-          }
-        }
-        else
-        {
-          if(psource_frame->nFilledLen || h264_scratch.nFilledLen)
-          {
-            DEBUG_PRINT_LOW("\n Reset the EOS Flag");
-            pdest_frame->nFlags &= ~OMX_BUFFERFLAG_EOS;
-          }
-          /*Push the frame to the Decoder*/
-          if (empty_this_buffer_proxy(hComp,pdest_frame) != OMX_ErrorNone)
-          {
-            return OMX_ErrorBadParameter;
-          }
-          //frame_count++;
-          pdest_frame = NULL;
-          if (m_input_free_q.m_size)
-          {
-            m_input_free_q.pop_entry(&address,&p2,&id);
-            pdest_frame = (OMX_BUFFERHEADERTYPE *) address;
-            DEBUG_PRINT_LOW("\n Pop the next pdest_buffer %p",pdest_frame);
-            pdest_frame->nFilledLen = 0;
-            pdest_frame->nFlags = 0;
-            pdest_frame->nTimeStamp = LLONG_MAX;
-          }
-        }
-      }
-    }
-  }
-  else
-  {
-    DEBUG_PRINT_LOW("\n Not a Complete Frame, pdest_frame->nFilledLen %d",pdest_frame->nFilledLen);
-    /*Check if Destination Buffer is full*/
-    if (h264_scratch.nAllocLen ==
-        h264_scratch.nFilledLen + h264_scratch.nOffset)
-    {
-      DEBUG_PRINT_ERROR("\nERROR: Frame Not found though Destination Filled");
-      return OMX_ErrorStreamCorrupt;
-    }
-  }
+  /* Sessions that take extradata from the SEI stay on the h264_scratch
+     path, which parses the SEI before set_h264_frame_ts() hands the
+     pan-scan data to the frame */
+  m_h264_client.m_hcomp = hComp;
+  ret = m_h264_splitter.split(psource_frame, pdest_frame,
+                              !(client_extradata & H264_INPUT_SEI_EXTRADATA),
+                              nal_length_mode);
+  if (ret != OMX_ErrorNone)
+    return ret;
 
   if (!psource_frame->nFilledLen)
   {
@@ -7502,49 +7533,23 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
     {
       if (pdest_frame)
       {
+        OMX_TICKS nal_ts = h264_scratch.nTimeStamp;
+        bool residual = pdest_frame->nFilledLen != 0;
+        bool new_frame = false;
+
         DEBUG_PRINT_LOW("\n EOS Reached Pass Last Buffer");
-        if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
-             h264_scratch.nFilledLen)
+        if (m_h264_splitter.finish(pdest_frame, new_frame) != OMX_ErrorNone)
         {
-            if (pdest_frame->nFilledLen == 0)
-            {
-                /* No residual frame from before, send whatever
-                 * we have left */
-                memcpy((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                h264_scratch.pBuffer, h264_scratch.nFilledLen);
-                pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                h264_scratch.nFilledLen = 0;
-                pdest_frame->nTimeStamp = h264_scratch.nTimeStamp;
-            }
-            else
-            {
-                m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-                if (!isNewFrame)
-                {
-                    /* Have a residual frame, but we know that the
-                     * AU in this frame is belonging to whatever
-                     * frame we had left over.  So append it */
-                    memcpy((pdest_frame->pBuffer + pdest_frame->nFilledLen),
-                    h264_scratch.pBuffer, h264_scratch.nFilledLen);
-                    pdest_frame->nFilledLen += h264_scratch.nFilledLen;
-                    h264_scratch.nFilledLen = 0;
-                    pdest_frame->nTimeStamp = h264_last_au_ts;
-                }
-                else
-                {
-                    /* Completely new frame, let's just push what
-                     * we have now.  The resulting EBD would trigger
-                     * another push */
-                    generate_ebd = OMX_FALSE;
-                    pdest_frame->nTimeStamp = h264_last_au_ts;
-                    h264_last_au_ts = h264_scratch.nTimeStamp;
-                }
-            }
+          return OMX_ErrorBadParameter;
         }
-        else
+        /* A residual frame takes the time stamp of its access unit */
+        pdest_frame->nTimeStamp = residual ? h264_last_au_ts : nal_ts;
+        if (new_frame)
         {
-          DEBUG_PRINT_ERROR("\nERROR:4: Destination buffer overflow for H264");
-          return OMX_ErrorBadParameter;
+          /* Completely new frame, let's just push what we have now.
+           * The resulting EBD would trigger another push */
+          generate_ebd = OMX_FALSE;
+          h264_last_au_ts = nal_ts;
         }
 
         /* Iff we coalesced two buffers, inherit the flags of both bufs */
@@ -7558,13 +7563,14 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
            DEBUG_PRINT_HIGH("No frames sent to driver yet, "
               "So send zero length EOS buffer");
            pdest_frame->nFilledLen = 0;
+           m_demux_entries = 0;
         }
 #endif
         DEBUG_PRINT_LOW("pdest_frame->nFilledLen = %d, nFlags = 0x%x, TimeStamp = %x",
                      pdest_frame->nFilledLen, pdest_frame->nFlags, pdest_frame->nTimeStamp);
         DEBUG_PRINT_LOW("\n Push AU frame number %d to driver", frame_count++);
 #ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
-        if (client_extradata & OMX_TIMEINFO_EXTRADATA)
+        if (h264_parser && (client_extradata & OMX_TIMEINFO_EXTRADATA))
         {
           OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(pdest_frame->nTimeStamp);
           if (!VALID_TS(pdest_frame->nTimeStamp))
@@ -7603,6 +7609,100 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
   return OMX_ErrorNone;
 }
 
+void omx_vdec::h264_splitter_client::nal_parsed(OMX_U8 *nal, OMX_U32 nal_len)
+{
+  m_vdec->parse_h264_nal_side_data(nal, nal_len);
+}
+
+void omx_vdec::h264_splitter_client::stamp_frame()
+{
+  m_vdec->set_h264_frame_ts();
+}
+
+void omx_vdec::h264_splitter_client::nal_assigned()
+{
+  m_vdec->update_h264_last_au_ts();
+}
+
+void omx_vdec::h264_splitter_client::nal_added(OMX_U32 offset, OMX_U32 sc_len)
+{
+  m_vdec->insert_demux_nal_offset(offset, sc_len);
+}
+
+/* Push the complete frame to the decoder and pick the next one to fill */
+OMX_ERRORTYPE omx_vdec::h264_splitter_client::frame_done(OMX_BUFFERHEADERTYPE *&frame)
+{
+  unsigned address,p2,id;
+
+  DEBUG_PRINT_LOW("\n Found a frame size = %d number = %d",
+                  frame->nFilledLen, m_vdec->frame_count++);
+  /*Push the frame to the Decoder*/
+  if (m_vdec->empty_this_buffer_proxy(m_hcomp,frame) != OMX_ErrorNone)
+  {
+    return OMX_ErrorBadParameter;
+  }
+  frame = NULL;
+  if (m_vdec->m_input_free_q.m_size)
+  {
+    m_vdec->m_input_free_q.pop_entry(&address,&p2,&id);
+    frame = (OMX_BUFFERHEADERTYPE *) address;
+    DEBUG_PRINT_LOW("\n Pop the next pdest_buffer %p",frame);
+    frame->nFilledLen = 0;
+    frame->nFlags = 0;
+    frame->nTimeStamp = LLONG_MAX;
+  }
+  return OMX_ErrorNone;
+}
+
+/* Stamp the frame being assembled with the last access unit's time
+   stamp if it has none yet */
+void omx_vdec::set_h264_frame_ts()
+{
+  if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
+    pdest_frame->nTimeStamp = h264_last_au_ts;
+    pdest_frame->nFlags = h264_last_au_flags;
+#ifdef PANSCAN_HDLR
+    if (h264_parser && (client_extradata & OMX_FRAMEINFO_EXTRADATA))
+      h264_parser->update_panscan_data(h264_last_au_ts);
+#endif
+  }
+}
+
+/* Remember the time stamp of the NAL in h264_scratch if it is a slice */
+void omx_vdec::update_h264_last_au_ts()
+{
+  if(m_frame_parser.mutils->nalu_type == NALU_TYPE_NON_IDR ||
+     m_frame_parser.mutils->nalu_type == NALU_TYPE_IDR) {
+    h264_last_au_ts = h264_scratch.nTimeStamp;
+    h264_last_au_flags = h264_scratch.nFlags;
+#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
+    if (h264_parser && (client_extradata & OMX_TIMEINFO_EXTRADATA))
+    {
+      OMX_S64 ts_in_sei = h264_parser->process_ts_with_sei_vui(h264_last_au_ts);
+      if (!VALID_TS(h264_last_au_ts))
+        h264_last_au_ts = ts_in_sei;
+    }
+#endif
+  } else
+    h264_last_au_ts = LLONG_MAX;
+}
+
+/* Hand a complete NAL (start code included) to the stream parser for the
+   VUI and SEI side data */
+void omx_vdec::parse_h264_nal_side_data(OMX_U8 *nal, OMX_U32 nal_len)
+{
+  if (hevc_parser)
+  {
+    hevc_parser->parse_nal(nal, nal_len);
+    return;
+  }
+  h264_parser->parse_nal(nal, nal_len, NALU_TYPE_SPS);
+#ifndef PROCESS_EXTRADATA_IN_OUTPUT_PORT
+  if (client_extradata & (OMX_TIMEINFO_EXTRADATA | OMX_FRAMEINFO_EXTRADATA))
+    h264_parser->parse_nal(nal, nal_len, NALU_TYPE_SEI);
+#endif
+}
+
 OMX_ERRORTYPE omx_vdec::push_input_vc1 (OMX_HANDLETYPE hComp)
 {
     OMX_U8 *buf, *pdest;
@@ -7839,11 +7939,9 @@ void omx_vdec::free_output_buffer_header()
     m_platform_list = NULL;
   }
 
-  if (drv_ctx.ptr_respbuffer)
-  {
-    free (drv_ctx.ptr_respbuffer);
-    drv_ctx.ptr_respbuffer = NULL;
-  }
+  /* ptr_respbuffer and m_out_buf_state live in the ptr_outputbuffer block */
+  drv_ctx.ptr_respbuffer = NULL;
+  m_out_buf_state = NULL;
   if (drv_ctx.ptr_outputbuffer)
   {
     free (drv_ctx.ptr_outputbuffer);
@@ -7940,27 +8038,9 @@ OMX_ERRORTYPE omx_vdec::get_buffer_req(vdec_allocatorproperty *buffer_prop)
             drv_ctx.video_resolution.frame_height);
     }
 
-    if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
-    {
-      DEBUG_PRINT_HIGH("Frame info extra data enabled!");
-      extra_data_size += OMX_FRAMEINFO_EXTRADATA_SIZE;
-    }
-    if (client_extradata & OMX_INTERLACE_EXTRADATA)
-    {
-      DEBUG_PRINT_HIGH("Interlace extra data enabled!");
-      extra_data_size += OMX_INTERLACE_EXTRADATA_SIZE;
-    }
-    if (client_extradata & OMX_PORTDEF_EXTRADATA)
-    {
-       extra_data_size += OMX_PORTDEF_EXTRADATA_SIZE;
-       DEBUG_PRINT_HIGH("Smooth streaming enabled extra_data_size=%d\n",
-         extra_data_size);
-    }
+    extra_data_size = get_output_extradata_size();
     if (extra_data_size)
-    {
-      extra_data_size += sizeof(OMX_OTHER_EXTRADATATYPE); //Space for terminator
       buf_size = ((buf_size + 3)&(~3)); //Align extradata start address to 64Bit
-    }
     buf_size += extra_data_size;
     buf_size = (buf_size + buffer_prop->alignment - 1)&(~(buffer_prop->alignment - 1));
     DEBUG_PRINT_LOW("GetBufReq UPDATE: ActCnt(%d) Size(%d) BufSize(%d)",
@@ -7978,6 +8058,60 @@ OMX_ERRORTYPE omx_vdec::get_buffer_req(vdec_allocatorproperty *buffer_prop)
   return eRet;
 }
 
+/* Space the enabled extradata takes at the end of each output buffer */
+unsigned int omx_vdec::get_output_extradata_size()
+{
+  unsigned int extra_data_size = 0;
+
+  if (client_extradata & OMX_FRAMEINFO_EXTRADATA)
+  {
+    DEBUG_PRINT_HIGH("Frame info extra data enabled!");
+    extra_data_size += OMX_FRAMEINFO_EXTRADATA_SIZE;
+  }
+  if (client_extradata & OMX_INTERLACE_EXTRADATA)
+  {
+    DEBUG_PRINT_HIGH("Interlace extra data enabled!");
+    extra_data_size += OMX_INTERLACE_EXTRADATA_SIZE;
+  }
+  if (client_extradata & OMX_PORTDEF_EXTRADATA)
+  {
+     extra_data_size += OMX_PORTDEF_EXTRADATA_SIZE;
+     DEBUG_PRINT_HIGH("Smooth streaming enabled extra_data_size=%d\n",
+       extra_data_size);
+  }
+  if (extra_data_size)
+    extra_data_size += sizeof(OMX_OTHER_EXTRADATATYPE); //Space for terminator
+  return extra_data_size;
+}
+
+/* Checks the driver's current output requirements against the buffers
+   the port holds, without committing them to the driver */
+bool omx_vdec::output_buffers_fit()
+{
+  struct vdec_ioctl_msg ioctl_msg = {NULL, NULL};
+  vdec_allocatorproperty req = drv_ctx.op_buf;
+  unsigned int buf_size, extra_data_size;
+
+  ioctl_msg.out = &req;
+  if (ioctl (drv_ctx.video_driver_fd, VDEC_IOCTL_GET_BUFFER_REQ,
+      (void*)&ioctl_msg) < 0)
+  {
+    DEBUG_PRINT_ERROR("Requesting buffer requirements failed");
+    return false;
+  }
+  buf_size = req.buffer_size;
+  extra_data_size = get_output_extradata_size();
+  if (extra_data_size)
+    buf_size = ((buf_size + 3)&(~3));
+  buf_size += extra_data_size;
+  DEBUG_PRINT_HIGH("Reconfig in place: need (#%d: %u) hold (#%d: %u)",
+    req.mincount, buf_size, drv_ctx.op_buf.actualcount,
+    drv_ctx.op_buf.buffer_size);
+  return (buf_size <= drv_ctx.op_buf.buffer_size &&
+          req.mincount <= drv_ctx.op_buf.actualcount &&
+          req.alignment && !(drv_ctx.op_buf.alignment % req.alignment));
+}
+
 OMX_ERRORTYPE omx_vdec::set_buffer_req(vdec_allocatorproperty *buffer_prop)
 {
   struct vdec_ioctl_msg ioctl_msg = {NULL, NULL};
@@ -8030,7 +8164,10 @@ OMX_ERRORTYPE omx_vdec::start_port_reconfig()
       {
         DEBUG_PRINT_HIGH("Interlace format detected (%x)!", drv_ctx.interlace);
         if(!secure_mode || drv_ctx.enable_sec_metadata)
+        {
           client_extradata |= OMX_INTERLACE_EXTRADATA;
+          update_extradata_records();
+        }
         else {
           DEBUG_PRINT_ERROR("secure mode interlaced format not supported");
           eRet = OMX_ErrorUnsupportedSetting;
@@ -8148,143 +8285,152 @@ OMX_ERRORTYPE omx_vdec::update_portdef(OMX_PARAM_PORTDEFINITIONTYPE *portDefn)
 OMX_ERRORTYPE omx_vdec::allocate_output_headers()
 {
   OMX_ERRORTYPE eRet = OMX_ErrorNone;
-  OMX_BUFFERHEADERTYPE *bufHdr = NULL;
-  unsigned i= 0;
 
   if(!m_out_mem_ptr) {
     DEBUG_PRINT_HIGH("\n Use o/p buffer case - Header List allocation");
-    int nBufHdrSize        = 0;
-    int nPlatformEntrySize = 0;
-    int nPlatformListSize  = 0;
-    int nPMEMInfoSize = 0;
-    OMX_QCOM_PLATFORM_PRIVATE_LIST      *pPlatformList;
-    OMX_QCOM_PLATFORM_PRIVATE_ENTRY     *pPlatformEntry;
-    OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pPMEMInfo;
-
-    DEBUG_PRINT_LOW("Setting First Output Buffer(%d)\n",
-      drv_ctx.op_buf.actualcount);
-    nBufHdrSize        = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_BUFFERHEADERTYPE);
-
-    nPMEMInfoSize      = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO);
-    nPlatformListSize  = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_LIST);
-    nPlatformEntrySize = drv_ctx.op_buf.actualcount *
-                         sizeof(OMX_QCOM_PLATFORM_PRIVATE_ENTRY);
-
-    DEBUG_PRINT_LOW("TotalBufHdr %d BufHdrSize %d PMEM %d PL %d\n",nBufHdrSize,
-                         sizeof(OMX_BUFFERHEADERTYPE),
-                         nPMEMInfoSize,
-                         nPlatformListSize);
-    DEBUG_PRINT_LOW("PE %d bmSize %d \n",nPlatformEntrySize,
-                         m_out_bm_count);
-    m_out_mem_ptr = (OMX_BUFFERHEADERTYPE  *)calloc(nBufHdrSize,1);
-    // Alloc mem for platform specific info
-    char *pPtr=NULL;
-    pPtr = (char*) calloc(nPlatformListSize + nPlatformEntrySize +
-                                     nPMEMInfoSize,1);
-    drv_ctx.ptr_outputbuffer = (struct vdec_bufferpayload *) \
-      calloc (sizeof(struct vdec_bufferpayload),
-      drv_ctx.op_buf.actualcount);
-    drv_ctx.ptr_respbuffer = (struct vdec_output_frameinfo  *)\
-      calloc (sizeof (struct vdec_output_frameinfo),
-      drv_ctx.op_buf.actualcount);
+    eRet = allocate_output_header_table();
+  } else {
+    eRet =  OMX_ErrorInsufficientResources;
+  }
+  return eRet;
+}
+
+/* Allocates and links the output port header table. The OMX headers and
+   their platform private entries are only read by the client and set up
+   here. What every FTB and FBD touches, the driver payload and response
+   tables and the buffer owners, shares one block, each array starting on
+   its own cache line, and is reached by index without walking the
+   headers. */
+OMX_ERRORTYPE omx_vdec::allocate_output_header_table()
+{
+  OMX_BUFFERHEADERTYPE *bufHdr = NULL;
+  OMX_QCOM_PLATFORM_PRIVATE_LIST      *pPlatformList;
+  OMX_QCOM_PLATFORM_PRIVATE_ENTRY     *pPlatformEntry;
+  OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pPMEMInfo;
+  unsigned count = drv_ctx.op_buf.actualcount;
+  unsigned i = 0;
+  int nBufHdrSize        = count * sizeof(OMX_BUFFERHEADERTYPE);
+  int nPMEMInfoSize      = count * sizeof(OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO);
+  int nPlatformListSize  = count * sizeof(OMX_QCOM_PLATFORM_PRIVATE_LIST);
+  int nPlatformEntrySize = count * sizeof(OMX_QCOM_PLATFORM_PRIVATE_ENTRY);
+  size_t nPayloadSize    = (count * sizeof(struct vdec_bufferpayload) +
+                            VDEC_CACHE_LINE_SIZE - 1) & ~(VDEC_CACHE_LINE_SIZE - 1);
+  size_t nRespSize       = (count * sizeof(struct vdec_output_frameinfo) +
+                            VDEC_CACHE_LINE_SIZE - 1) & ~(VDEC_CACHE_LINE_SIZE - 1);
+  size_t nStateSize      = count * sizeof(OMX_U32);
+  char *pPtr = NULL;
+  void *pDrvTable = NULL;
+
+  DEBUG_PRINT_LOW("TotalBufHdr %d BufHdrSize %d PMEM %d PL %d\n",nBufHdrSize,
+                       sizeof(OMX_BUFFERHEADERTYPE),
+                       nPMEMInfoSize,
+                       nPlatformListSize);
+  DEBUG_PRINT_LOW("PE %d Payload %d Resp %d OutputBuffer Count %d \n",
+                       nPlatformEntrySize, nPayloadSize, nRespSize, count);
+
+  m_out_mem_ptr = (OMX_BUFFERHEADERTYPE  *)calloc(nBufHdrSize,1);
+  // Alloc mem for platform specific info
+  pPtr = (char*) calloc(nPlatformListSize + nPlatformEntrySize +
+                                   nPMEMInfoSize,1);
+  if (posix_memalign(&pDrvTable, VDEC_CACHE_LINE_SIZE,
+                     nPayloadSize + nRespSize + nStateSize))
+    pDrvTable = NULL;
 #ifdef USE_ION
-    drv_ctx.op_buf_ion_info = (struct vdec_ion * ) \
-      calloc (sizeof(struct vdec_ion),drv_ctx.op_buf.actualcount);
-#endif
-
-    if(m_out_mem_ptr && pPtr && drv_ctx.ptr_outputbuffer
-       && drv_ctx.ptr_respbuffer)
-    {
-      bufHdr          =  m_out_mem_ptr;
-      m_platform_list = (OMX_QCOM_PLATFORM_PRIVATE_LIST *)(pPtr);
-      m_platform_entry= (OMX_QCOM_PLATFORM_PRIVATE_ENTRY *)
-                        (((char *) m_platform_list)  + nPlatformListSize);
-      m_pmem_info     = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)
-                        (((char *) m_platform_entry) + nPlatformEntrySize);
-      pPlatformList   = m_platform_list;
-      pPlatformEntry  = m_platform_entry;
-      pPMEMInfo       = m_pmem_info;
-
-      DEBUG_PRINT_LOW("Memory Allocation Succeeded for OUT port%p\n",m_out_mem_ptr);
-
-      // Settting the entire storage nicely
-      DEBUG_PRINT_LOW("bHdr %p OutMem %p PE %p\n",bufHdr,
-                      m_out_mem_ptr,pPlatformEntry);
-      DEBUG_PRINT_LOW(" Pmem Info = %p \n",pPMEMInfo);
-      for(i=0; i < drv_ctx.op_buf.actualcount ; i++)
-      {
-        bufHdr->nSize              = sizeof(OMX_BUFFERHEADERTYPE);
-        bufHdr->nVersion.nVersion  = OMX_SPEC_VERSION;
-        // Set the values when we determine the right HxW param
-        bufHdr->nAllocLen          = 0;
-        bufHdr->nFilledLen         = 0;
-        bufHdr->pAppPrivate        = NULL;
-        bufHdr->nOutputPortIndex   = OMX_CORE_OUTPUT_PORT_INDEX;
-        pPlatformEntry->type       = OMX_QCOM_PLATFORM_PRIVATE_PMEM;
-        pPlatformEntry->entry      = pPMEMInfo;
-        // Initialize the Platform List
-        pPlatformList->nEntries    = 1;
-        pPlatformList->entryList   = pPlatformEntry;
-        // Keep pBuffer NULL till vdec is opened
-        bufHdr->pBuffer            = NULL;
-        pPMEMInfo->offset          =  0;
-        pPMEMInfo->pmem_fd = 0;
-        bufHdr->pPlatformPrivate = pPlatformList;
-        drv_ctx.ptr_outputbuffer[i].pmem_fd = -1;
+  drv_ctx.op_buf_ion_info = (struct vdec_ion *)\
+    calloc (sizeof(struct vdec_ion),count);
+#endif
+
+  if (!m_out_mem_ptr || !pPtr || !pDrvTable
 #ifdef USE_ION
-        drv_ctx.op_buf_ion_info[i].ion_device_fd =-1;
+      || !drv_ctx.op_buf_ion_info
 #endif
-        /*Create a mapping between buffers*/
-        bufHdr->pOutputPortPrivate = &drv_ctx.ptr_respbuffer[i];
-        drv_ctx.ptr_respbuffer[i].client_data = (void *) \
-                                            &drv_ctx.ptr_outputbuffer[i];
-        // Move the buffer and buffer header pointers
-        bufHdr++;
-        pPMEMInfo++;
-        pPlatformEntry++;
-        pPlatformList++;
-      }
+     )
+  {
+    DEBUG_PRINT_ERROR("Output buf mem alloc failed[0x%x][0x%x]\n",\
+                                      m_out_mem_ptr, pPtr);
+    if(m_out_mem_ptr)
+    {
+      free(m_out_mem_ptr);
+      m_out_mem_ptr = NULL;
     }
-    else
+    if(pPtr)
     {
-      DEBUG_PRINT_ERROR("Output buf mem alloc failed[0x%x][0x%x]\n",\
-                                        m_out_mem_ptr, pPtr);
-      if(m_out_mem_ptr)
-      {
-        free(m_out_mem_ptr);
-        m_out_mem_ptr = NULL;
-      }
-      if(pPtr)
-      {
-        free(pPtr);
-        pPtr = NULL;
-      }
-      if(drv_ctx.ptr_outputbuffer)
-      {
-        free(drv_ctx.ptr_outputbuffer);
-        drv_ctx.ptr_outputbuffer = NULL;
-      }
-      if(drv_ctx.ptr_respbuffer)
-      {
-        free(drv_ctx.ptr_respbuffer);
-        drv_ctx.ptr_respbuffer = NULL;
-      }
+      free(pPtr);
+      pPtr = NULL;
+    }
+    if(pDrvTable)
+    {
+      free(pDrvTable);
+      pDrvTable = NULL;
+    }
 #ifdef USE_ION
     if (drv_ctx.op_buf_ion_info) {
-        DEBUG_PRINT_LOW("\n Free o/p ion context");
-	free(drv_ctx.op_buf_ion_info);
-        drv_ctx.op_buf_ion_info = NULL;
+      DEBUG_PRINT_LOW("\n Free o/p ion context");
+      free(drv_ctx.op_buf_ion_info);
+      drv_ctx.op_buf_ion_info = NULL;
     }
 #endif
-      eRet =  OMX_ErrorInsufficientResources;
-    }
-  } else {
-    eRet =  OMX_ErrorInsufficientResources;
+    return OMX_ErrorInsufficientResources;
   }
-  return eRet;
+
+  memset(pDrvTable, 0, nPayloadSize + nRespSize + nStateSize);
+  drv_ctx.ptr_outputbuffer = (struct vdec_bufferpayload *)pDrvTable;
+  drv_ctx.ptr_respbuffer = (struct vdec_output_frameinfo *)
+                           ((char *)pDrvTable + nPayloadSize);
+  m_out_buf_state = (OMX_U32 *)((char *)pDrvTable + nPayloadSize + nRespSize);
+
+  bufHdr          =  m_out_mem_ptr;
+  m_platform_list = (OMX_QCOM_PLATFORM_PRIVATE_LIST *)(pPtr);
+  m_platform_entry= (OMX_QCOM_PLATFORM_PRIVATE_ENTRY *)
+                    (((char *) m_platform_list)  + nPlatformListSize);
+  m_pmem_info     = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)
+                    (((char *) m_platform_entry) + nPlatformEntrySize);
+  pPlatformList   = m_platform_list;
+  pPlatformEntry  = m_platform_entry;
+  pPMEMInfo       = m_pmem_info;
+
+  DEBUG_PRINT_LOW("Memory Allocation Succeeded for OUT port%p\n",m_out_mem_ptr);
+
+  // Settting the entire storage nicely
+  DEBUG_PRINT_LOW("bHdr %p OutMem %p PE %p\n",bufHdr, m_out_mem_ptr,pPlatformEntry);
+  DEBUG_PRINT_LOW(" Pmem Info = %p \n",pPMEMInfo);
+  for(i=0; i < count ; i++)
+  {
+    bufHdr->nSize              = sizeof(OMX_BUFFERHEADERTYPE);
+    bufHdr->nVersion.nVersion  = OMX_SPEC_VERSION;
+    // Set the values when we determine the right HxW param
+    bufHdr->nAllocLen          = 0;
+    bufHdr->nFilledLen         = 0;
+    bufHdr->pAppPrivate        = NULL;
+    bufHdr->nOutputPortIndex   = OMX_CORE_OUTPUT_PORT_INDEX;
+    // Platform specific PMEM Information
+    // Initialize the Platform Entry
+    pPlatformEntry->type       = OMX_QCOM_PLATFORM_PRIVATE_PMEM;
+    pPlatformEntry->entry      = pPMEMInfo;
+    // Initialize the Platform List
+    pPlatformList->nEntries    = 1;
+    pPlatformList->entryList   = pPlatformEntry;
+    // Keep pBuffer NULL till vdec is opened
+    bufHdr->pBuffer            = NULL;
+
+    pPMEMInfo->offset          =  0;
+    pPMEMInfo->pmem_fd = 0;
+    bufHdr->pPlatformPrivate = pPlatformList;
+    drv_ctx.ptr_outputbuffer[i].pmem_fd = -1;
+#ifdef USE_ION
+    drv_ctx.op_buf_ion_info[i].ion_device_fd =-1;
+#endif
+    /*Create a mapping between buffers*/
+    bufHdr->pOutputPortPrivate = &drv_ctx.ptr_respbuffer[i];
+    drv_ctx.ptr_respbuffer[i].client_data = (void *)\
+                                        &drv_ctx.ptr_outputbuffer[i];
+    // Move the buffer and buffer header pointers
+    bufHdr++;
+    pPMEMInfo++;
+    pPlatformEntry++;
+    pPlatformList++;
+  }
+  return OMX_ErrorNone;
 }
 
 void omx_vdec::complete_pending_buffer_done_cbs()
@@ -8603,6 +8749,8 @@ void omx_vdec::handle_extradata_secure(OMX_BUFFERHEADERTYPE *p_buf_hdr)
       /* vui extra data (frame_rate) information */
       if (h264_parser)
         h264_parser->get_frame_rate(&frame_rate);
+      else if (hevc_parser)
+        hevc_parser->get_frame_rate(&frame_rate);
       append_frame_info_extradata(p_extra, num_conceal_MB,
           ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->pic_type,
           p_buf_hdr->nTimeStamp, frame_rate,
@@ -8760,65 +8908,73 @@ void omx_vdec::handle_extradata(OMX_BUFFERHEADERTYPE *p_buf_hdr)
       h264_parser->parse_nal((OMX_U8*)p_sei->data, p_sei->nDataSize, NALU_TYPE_SEI);
   }
 #endif
-#if defined(VDEC_EXTRADATA_EXT_DATA) && defined(VDEC_EXTRADATA_USER_DATA)
-  if (client_extradata & OMX_EXTNUSER_EXTRADATA && p_extra)
+  /* Append only the records the client enabled, each written once in
+     place; the list is kept by update_extradata_records() */
+  for (OMX_U32 r = 0; r < m_extradata_record_cnt && p_extra; r++)
   {
-    p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-    for(int i = 0; i < extn_user_data_cnt; i++)
+    OMX_U8 *buf_end = pBuffer + p_buf_hdr->nAllocLen;
+    switch (m_extradata_records[r])
     {
-      if (((OMX_U8*)p_extra + p_extn_user[i]->nSize) <
-                        (pBuffer + p_buf_hdr->nAllocLen))
+#if defined(VDEC_EXTRADATA_EXT_DATA) && defined(VDEC_EXTRADATA_USER_DATA)
+    case OMX_EXTNUSER_EXTRADATA:
+      p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
+      for(int i = 0; i < extn_user_data_cnt; i++)
       {
-        if (p_extn_user[i]->eType == VDEC_EXTRADATA_EXT_DATA)
+        if (((OMX_U8*)p_extra + p_extn_user[i]->nSize) < buf_end)
         {
-          append_extn_extradata(p_extra, p_extn_user[i]);
-          p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
-        }
-        else if (p_extn_user[i]->eType == VDEC_EXTRADATA_USER_DATA)
-        {
-          append_user_extradata(p_extra, p_extn_user[i]);
-          p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+          if (p_extn_user[i]->eType == VDEC_EXTRADATA_EXT_DATA)
+          {
+            append_extn_extradata(p_extra, p_extn_user[i]);
+            p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+          }
+          else if (p_extn_user[i]->eType == VDEC_EXTRADATA_USER_DATA)
+          {
+            append_user_extradata(p_extra, p_extn_user[i]);
+            p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+          }
         }
       }
-    }
-  }
+      break;
 #endif
-  if ((client_extradata & OMX_INTERLACE_EXTRADATA) && p_extra &&
-      ((OMX_U8*)p_extra + OMX_INTERLACE_EXTRADATA_SIZE) <
-       (pBuffer + p_buf_hdr->nAllocLen))
-  {
-    p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-    append_interlace_extradata(p_extra,
+    case OMX_INTERLACE_EXTRADATA:
+      if (((OMX_U8*)p_extra + OMX_INTERLACE_EXTRADATA_SIZE) < buf_end)
+      {
+        p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
+        append_interlace_extradata(p_extra,
 #ifdef DISPLAYCAF
-         ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->interlaced_format, index);
+             ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->interlaced_format, index);
 #else
-         ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->interlaced_format);
+             ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->interlaced_format);
 #endif
-    p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
-  }
-  if (client_extradata & OMX_FRAMEINFO_EXTRADATA && p_extra &&
-      ((OMX_U8*)p_extra + OMX_FRAMEINFO_EXTRADATA_SIZE) <
-       (pBuffer + p_buf_hdr->nAllocLen))
-  {
-    p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-    /* vui extra data (frame_rate) information */
-    if (h264_parser)
-        h264_parser->get_frame_rate(&frame_rate);
-    append_frame_info_extradata(p_extra, num_conceal_MB,
-        ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->pic_type,
-        p_buf_hdr->nTimeStamp, frame_rate,
-        &((struct vdec_output_frameinfo *)
-          p_buf_hdr->pOutputPortPrivate)->aspect_ratio_info);
-    p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
-  }
-  if ((client_extradata & OMX_PORTDEF_EXTRADATA) &&
-       p_extra != NULL &&
-      ((OMX_U8*)p_extra + OMX_PORTDEF_EXTRADATA_SIZE) <
-       (pBuffer + p_buf_hdr->nAllocLen))
-  {
-    p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
-    append_portdef_extradata(p_extra);
-    p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+      }
+      break;
+    case OMX_FRAMEINFO_EXTRADATA:
+      if (((OMX_U8*)p_extra + OMX_FRAMEINFO_EXTRADATA_SIZE) < buf_end)
+      {
+        p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
+        /* vui extra data (frame_rate) information */
+        if (h264_parser)
+            h264_parser->get_frame_rate(&frame_rate);
+        else if (hevc_parser)
+            hevc_parser->get_frame_rate(&frame_rate);
+        append_frame_info_extradata(p_extra, num_conceal_MB,
+            ((struct vdec_output_frameinfo *)p_buf_hdr->pOutputPortPrivate)->pic_type,
+            p_buf_hdr->nTimeStamp, frame_rate,
+            &((struct vdec_output_frameinfo *)
+              p_buf_hdr->pOutputPortPrivate)->aspect_ratio_info);
+        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+      }
+      break;
+    case OMX_PORTDEF_EXTRADATA:
+      if (((OMX_U8*)p_extra + OMX_PORTDEF_EXTRADATA_SIZE) < buf_end)
+      {
+        p_buf_hdr->nFlags |= OMX_BUFFERFLAG_EXTRADATA;
+        append_portdef_extradata(p_extra);
+        p_extra = (OMX_OTHER_EXTRADATATYPE *) (((OMX_U8 *) p_extra) + p_extra->nSize);
+      }
+      break;
+    }
   }
   if (p_buf_hdr->nFlags & OMX_BUFFERFLAG_EXTRADATA)
     if (p_extra &&
@@ -8890,6 +9046,7 @@ OMX_ERRORTYPE omx_vdec::enable_extradata(OMX_U32 requested_extradata, bool enabl
   if (driver_extradata != drv_ctx.extradata)
   {
     client_extradata = requested_extradata;
+    update_extradata_records();
     drv_ctx.extradata = driver_extradata;
     ioctl_msg.in = &drv_ctx.extradata;
     ioctl_msg.out = NULL;
@@ -8905,6 +9062,7 @@ OMX_ERRORTYPE omx_vdec::enable_extradata(OMX_U32 requested_extradata, bool enabl
   else if ((client_extradata & ~DRIVER_EXTRADATA_MASK) != (requested_extradata & ~DRIVER_EXTRADATA_MASK))
   {
     client_extradata = requested_extradata;
+    update_extradata_records();
     drv_ctx.op_buf.buffer_size += extradata_size;
     // align the buffer size
     drv_ctx.op_buf.buffer_size = (drv_ctx.op_buf.buffer_size + drv_ctx.op_buf.alignment - 1)&(~(drv_ctx.op_buf.alignment - 1));
@@ -8916,6 +9074,27 @@ OMX_ERRORTYPE omx_vdec::enable_extradata(OMX_U32 requested_extradata, bool enabl
   return ret;
 }
 
+/* Output order of the OMX extradata records handle_extradata() appends */
+static const OMX_U32 extradata_record_order[MAX_EXTRADATA_RECORDS] =
+{
+  OMX_EXTNUSER_EXTRADATA,
+  OMX_INTERLACE_EXTRADATA,
+  OMX_FRAMEINFO_EXTRADATA,
+  OMX_PORTDEF_EXTRADATA
+};
+
+void omx_vdec::update_extradata_records()
+{
+  m_extradata_record_cnt = 0;
+  for (int i = 0; i < MAX_EXTRADATA_RECORDS; i++)
+  {
+    if (client_extradata & extradata_record_order[i])
+      m_extradata_records[m_extradata_record_cnt++] = extradata_record_order[i];
+  }
+  DEBUG_PRINT_LOW("update_extradata_records: %d records for [%x]",
+    m_extradata_record_cnt, client_extradata);
+}
+
 OMX_U32 omx_vdec::count_MB_in_extradata(OMX_OTHER_EXTRADATATYPE *extra)
 {
   OMX_U32 num_MB = 0, byte_count = 0, num_MB_in_frame = 0;
@@ -9079,22 +9258,25 @@ void omx_vdec::append_frame_info_extradata(OMX_OTHER_EXTRADATATYPE *extra,
     frame_info->interlaceType = OMX_QCOM_InterlaceInterleaveFrameBottomFieldFirst;
   else
     frame_info->interlaceType = OMX_QCOM_InterlaceFrameProgressive;
-  memset(&frame_info->panScan,0,sizeof(frame_info->panScan));
-  memset(&frame_info->aspectRatio, 0, sizeof(frame_info->aspectRatio));
-  memset(&frame_info->displayAspectRatio, 0, sizeof(frame_info->displayAspectRatio));
+  /* Only the windows numWindows counts are valid, so no need to clear
+     the window array; every other field is written exactly once */
+  frame_info->panScan.numWindows = 0;
   if (drv_ctx.decoder_format == VDEC_CODECTYPE_H264)
   {
     h264_parser->fill_pan_scan_data(&frame_info->panScan, timestamp);
   }
 
   fill_aspect_ratio_info(aspect_ratio_info, frame_info);
-  if (drv_ctx.decoder_format == VDEC_CODECTYPE_MPEG2)
+  if (drv_ctx.decoder_format == VDEC_CODECTYPE_MPEG2 &&
+      m_disp_hor_size && m_disp_vert_size)
   {
-    if (m_disp_hor_size && m_disp_vert_size)
-    {
-      frame_info->displayAspectRatio.displayHorizontalSize = m_disp_hor_size;
-      frame_info->displayAspectRatio.displayVerticalSize = m_disp_vert_size;
-    }
+    frame_info->displayAspectRatio.displayHorizontalSize = m_disp_hor_size;
+    frame_info->displayAspectRatio.displayVerticalSize = m_disp_vert_size;
+  }
+  else
+  {
+    frame_info->displayAspectRatio.displayHorizontalSize = 0;
+    frame_info->displayAspectRatio.displayVerticalSize = 0;
   }
   frame_info->nConcealedMacroblocks = num_conceal_mb;
   frame_info->nFrameRate = frame_rate;
@@ -9171,6 +9353,9 @@ void omx_vdec::fill_aspect_ratio_info(
   {
     m_extradata->aspectRatio.aspectRatioX = aspect_ratio_info->par_width;
     m_extradata->aspectRatio.aspectRatioY = aspect_ratio_info->par_height;
+    /* The VUI sample aspect ratio overrides what the driver reported */
+    if (hevc_parser)
+      hevc_parser->fill_aspect_ratio_info(&m_extradata->aspectRatio);
   }
   DEBUG_PRINT_LOW("aspectRatioX %d aspectRatioX %d", m_extradata->aspectRatio.aspectRatioX,
                                                      m_extradata->aspectRatio.aspectRatioY);
@@ -9254,6 +9439,7 @@ OMX_ERRORTYPE  omx_vdec::allocate_desc_buffer(OMX_U32 index)
     DEBUG_PRINT_ERROR("\ndesc buffer Allocation failed ");
     return OMX_ErrorInsufficientResources;
   }
+  m_desc_buffer_ptr[index].alloc_size = DESC_BUFFER_SIZE;
 
   return eRet;
 }
@@ -9261,19 +9447,80 @@ OMX_ERRORTYPE  omx_vdec::allocate_desc_buffer(OMX_U32 index)
 void omx_vdec::insert_demux_addr_offset(OMX_U32 address_offset)
 {
   DEBUG_PRINT_LOW("Inserting address offset (%d) at idx (%d)", address_offset,m_demux_entries);
-  if (m_demux_entries < 8192)
+  if (m_demux_entries == m_demux_capacity)
   {
-    m_demux_offsets[m_demux_entries++] = address_offset;
+    OMX_U32 capacity = m_demux_capacity ? (m_demux_capacity * 2) : DEMUX_OFFSETS_INIT_SIZE;
+    OMX_U32 *offsets = (OMX_U32 *)realloc(m_demux_offsets, capacity * sizeof(OMX_U32));
+    if (offsets == NULL)
+    {
+      DEBUG_PRINT_ERROR("Failed to grow demux table to %d entries", capacity);
+      return;
+    }
+    m_demux_offsets = offsets;
+    m_demux_capacity = capacity;
   }
+  m_demux_offsets[m_demux_entries++] = address_offset;
   return;
 }
 
+/* Adds the start code of sc_len bytes at address_offset to the demux
+   table of the frame being built. A start code followed by at most one
+   byte before the next is not a NAL of its own and is dropped in favour
+   of the next one. The arbitrary bytes H.264 path calls this for every
+   NAL it appends, so the frame does not need to be rescanned by
+   extract_demux_addr_offsets(). */
+void omx_vdec::insert_demux_nal_offset(OMX_U32 address_offset, OMX_U32 sc_len)
+{
+  if (!drv_ctx.disable_dmx)
+    return;
+
+  if (m_demux_entries &&
+      (address_offset - (m_demux_offsets[m_demux_entries - 1] +
+                         m_demux_last_sc_len)) <= 1)
+  {
+    DEBUG_PRINT_ERROR("FOUND Consecutive start Code, Hence skip one");
+    m_demux_entries--;
+  }
+  insert_demux_addr_offset(address_offset);
+  m_demux_last_sc_len = sc_len;
+}
+
+/* Overwrite each 4 byte big endian NAL length in buf with a start code
+   and skip over the NAL payload. Prefixes and payloads may straddle
+   buffers; returns true if buf ends on a NAL boundary. */
+bool omx_vdec::rewrite_nal_length_prefixes(OMX_U8 *buf, OMX_U32 len,
+                                           bool record_offsets)
+{
+  OMX_U32 pos = 0;
+
+  while (pos < len)
+  {
+    if (avcc_nal_left)
+    {
+      OMX_U32 skip = (len - pos < avcc_nal_left) ? (len - pos) : avcc_nal_left;
+      pos += skip;
+      avcc_nal_left -= skip;
+      continue;
+    }
+    if (record_offsets && avcc_prefix_bytes == 0)
+      insert_demux_nal_offset(pos, 4);
+    avcc_prefix = (avcc_prefix << 8) | buf[pos];
+    buf[pos++] = (avcc_prefix_bytes == 3) ? 0x01 : 0x00;
+    if (++avcc_prefix_bytes == 4)
+    {
+      avcc_nal_left = avcc_prefix;
+      avcc_prefix = 0;
+      avcc_prefix_bytes = 0;
+    }
+  }
+  return (avcc_nal_left == 0 && avcc_prefix_bytes == 0);
+}
+
 void omx_vdec::extract_demux_addr_offsets(OMX_BUFFERHEADERTYPE *buf_hdr)
 {
   OMX_U32 bytes_to_parse = buf_hdr->nFilledLen;
   OMX_U8 *buf = buf_hdr->pBuffer + buf_hdr->nOffset;
   OMX_U32 index = 0;
-  OMX_U32 prev_sc_index = 0;
 
   m_demux_entries = 0;
 
@@ -9284,18 +9531,10 @@ void omx_vdec::extract_demux_addr_offsets(OMX_BUFFERHEADERTYPE *buf_hdr)
          ((buf[index] == 0x00) && (buf[index+1] == 0x00) &&
           (buf[index+2] == 0x01)) )
     {
-      if ((((index+3) - prev_sc_index) <= 4) && m_demux_entries)
-      {
-	 DEBUG_PRINT_ERROR("FOUND Consecutive start Code, Hence skip one");
-         m_demux_entries--;
-      }
       //Found start code, insert address offset
-      insert_demux_addr_offset(index);
-      if (buf[index+2] == 0x01) // 3 byte start code
-        index += 3;
-      else                      //4 byte start code
-        index += 4;
-      prev_sc_index = index;
+      OMX_U32 sc_len = (buf[index+2] == 0x01) ? 3 : 4;
+      insert_demux_nal_offset(index, sc_len);
+      index += sc_len;
     }
     else
       index++;
@@ -9314,6 +9553,7 @@ OMX_ERRORTYPE omx_vdec::handle_demux_data(OMX_BUFFERHEADERTYPE *p_buf_hdr)
   OMX_U32 suffix_byte = 0;
   OMX_U32 demux_index = 0;
   OMX_U32 buffer_index = 0;
+  OMX_U32 desc_size = 0;
 
   if (m_desc_buffer_ptr == NULL)
   {
@@ -9328,12 +9568,28 @@ OMX_ERRORTYPE omx_vdec::handle_demux_data(OMX_BUFFERHEADERTYPE *p_buf_hdr)
     return OMX_ErrorBadParameter;
   }
 
+  /* one descriptor per NAL, a possible VC1 terminator and the end word */
+  desc_size = ((m_demux_entries + 1) * 16) + sizeof(OMX_U32);
+  if (m_desc_buffer_ptr[buffer_index].buf_addr &&
+      desc_size > m_desc_buffer_ptr[buffer_index].alloc_size)
+  {
+    OMX_U8 *buf_addr = (OMX_U8 *)realloc(m_desc_buffer_ptr[buffer_index].buf_addr,
+                                         desc_size);
+    if (buf_addr)
+    {
+      DEBUG_PRINT_HIGH("Grew desc buffer %d to %d bytes", buffer_index, desc_size);
+      m_desc_buffer_ptr[buffer_index].buf_addr = buf_addr;
+      m_desc_buffer_ptr[buffer_index].alloc_size = desc_size;
+    }
+  }
+
   p_demux_data = (OMX_U8 *) m_desc_buffer_ptr[buffer_index].buf_addr;
 
   if ( ((OMX_U8*)p_demux_data == NULL) ||
-      ((m_demux_entries * 16) + 1) > DESC_BUFFER_SIZE)
+      desc_size > m_desc_buffer_ptr[buffer_index].alloc_size)
   {
     DEBUG_PRINT_ERROR("Insufficient buffer. Cannot append demux entries.");
+    m_demux_entries = 0;
     return OMX_ErrorBadParameter;
   }
   else
@@ -9392,7 +9648,6 @@ OMX_ERRORTYPE omx_vdec::handle_demux_data(OMX_BUFFERHEADERTYPE *p_buf_hdr)
     m_desc_buffer_ptr[buffer_index].desc_data_size = (m_demux_entries * 16) + sizeof(OMX_U32);
     DEBUG_PRINT_LOW("desc table data size=%d", m_desc_buffer_ptr[buffer_index].desc_data_size);
   }
-  memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
   m_demux_entries = 0;
   DEBUG_PRINT_LOW("Demux table complete!");
   return OMX_ErrorNone;
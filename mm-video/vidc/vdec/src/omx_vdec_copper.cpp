@@ -468,6 +468,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       input_use_buffer (false),
                       output_use_buffer (false),
                       arbitrary_bytes (true),
+                      m_h264_client (this),
+                      m_h264_splitter (&m_frame_parser, &h264_scratch,
+                                       &m_h264_client),
                       psource_frame (NULL),
                       pdest_frame (NULL),
                       m_inp_heap_ptr (NULL),
@@ -476,8 +479,12 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       first_frame_meta (true),
                       frame_count (0),
                       nal_length(0),
-                      nal_count (0),
-                      look_ahead_nal (false),
+                      nal_length_in_place (false),
+                      avcc_nal_left (0),
+                      avcc_prefix (0),
+                      avcc_prefix_bytes (0),
+                      m_thumbnail_mode (false),
+                      m_thumbnail_done (false),
                       first_frame(0),
                       first_buffer(NULL),
                       first_frame_size (0),
@@ -491,7 +498,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
                       m_display_id(NULL),
                       ouput_egl_buffers(false),
                       h264_parser(NULL),
+                      hevc_parser(NULL),
                       client_extradata(0),
+                      m_extradata_record_cnt(0),
                       h264_last_au_ts(LLONG_MAX),
                       h264_last_au_flags(0),
                       m_inp_err_count(0),
@@ -537,6 +546,10 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
   m_debug_concealedmb = atoi(property_value);
   DEBUG_PRINT_HIGH("vidc.dec.debug.concealedmb value is %d",m_debug_concealedmb);
 
+  property_value[0] = NULL;
+  property_get("vidc.dec.debug.panframedata", property_value, "0");
+  m_debug_panframedata = atoi(property_value);
+
 #endif
   memset(&m_cmp,0,sizeof(m_cmp));
   memset(&m_cb,0,sizeof(m_cb));
@@ -544,8 +557,9 @@ omx_vdec::omx_vdec(): m_state(OMX_StateInvalid),
   memset (&h264_scratch,0,sizeof (OMX_BUFFERHEADERTYPE));
   memset (m_hwdevice_name,0,sizeof(m_hwdevice_name));
   memset(&op_buf_rcnfg, 0 ,sizeof(vdec_allocatorproperty));
-  memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
+  m_demux_offsets = NULL;
   m_demux_entries = 0;
+  m_demux_capacity = 0;
   drv_ctx.timestamp_adjust = false;
   drv_ctx.video_driver_fd = -1;
   m_vendor_config.pData = NULL;
@@ -589,6 +603,12 @@ omx_vdec::~omx_vdec()
   close(drv_ctx.video_driver_fd);
   pthread_mutex_destroy(&m_lock);
   sem_destroy(&m_cmd_lock);
+  if (m_demux_offsets)
+  {
+    free(m_demux_offsets);
+    m_demux_offsets = NULL;
+  }
+  m_demux_capacity = 0;
   if (perf_flag)
   {
     DEBUG_PRINT_HIGH("--> TOTAL PROCESSING TIME");
@@ -2334,12 +2354,10 @@ bool omx_vdec::execute_input_flush()
   {
     DEBUG_PRINT_LOW("\n Reset all the variables before flusing");
     h264_scratch.nFilledLen = 0;
-    nal_count = 0;
-    look_ahead_nal = false;
+    m_h264_splitter.reset();
     frame_count = 0;
     h264_last_au_ts = LLONG_MAX;
     h264_last_au_flags = 0;
-    memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
     m_demux_entries = 0;
     DEBUG_PRINT_LOW("\n Initialize parser");
     if (m_frame_parser.mutils)
@@ -5373,15 +5391,13 @@ OMX_ERRORTYPE  omx_vdec::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         h
     DEBUG_PRINT_HIGH("\n Rxd i/p EOS, Notify Driver that EOS has been reached");
     frameinfo.flags |= VDEC_BUFFERFLAG_EOS;
     h264_scratch.nFilledLen = 0;
-    nal_count = 0;
-    look_ahead_nal = false;
+    m_h264_splitter.reset();
     frame_count = 0;
     if (m_frame_parser.mutils)
       m_frame_parser.mutils->initialize_frame_checking_environment();
     m_frame_parser.flush();
     h264_last_au_ts = LLONG_MAX;
     h264_last_au_flags = 0;
-    memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
     m_demux_entries = 0;
   }
     struct v4l2_buffer buf = {0};
@@ -6744,11 +6760,11 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
     return OMX_ErrorBadParameter;
   }
   DEBUG_PRINT_LOW("\n Pending h264_scratch.nFilledLen %d "
-      "look_ahead_nal %d", h264_scratch.nFilledLen, look_ahead_nal);
+      "look_ahead_nal %d", h264_scratch.nFilledLen, m_h264_splitter.look_ahead_nal);
   DEBUG_PRINT_LOW("\n Pending pdest_frame->nFilledLen %d",pdest_frame->nFilledLen);
-  if (h264_scratch.nFilledLen && look_ahead_nal)
+  if (h264_scratch.nFilledLen && m_h264_splitter.look_ahead_nal)
   {
-    look_ahead_nal = false;
+    m_h264_splitter.look_ahead_nal = false;
     if ((pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
          h264_scratch.nFilledLen)
     {
@@ -6787,10 +6803,10 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
 
   if (partial_frame == 0)
   {
-    if (nal_count == 0 && h264_scratch.nFilledLen == 0)
+    if (m_h264_splitter.nal_count == 0 && h264_scratch.nFilledLen == 0)
     {
       DEBUG_PRINT_LOW("\n First NAL with Zero Length, hence Skip");
-      nal_count++;
+      m_h264_splitter.nal_count++;
       h264_scratch.nTimeStamp = psource_frame->nTimeStamp;
       h264_scratch.nFlags = psource_frame->nFlags;
     }
@@ -6811,7 +6827,7 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
                                   h264_scratch.nFilledLen, NALU_TYPE_SEI);
 #endif
         m_frame_parser.mutils->isNewFrame(&h264_scratch, 0, isNewFrame);
-        nal_count++;
+        m_h264_splitter.nal_count++;
         if (VALID_TS(h264_last_au_ts) && !VALID_TS(pdest_frame->nTimeStamp)) {
           pdest_frame->nTimeStamp = h264_last_au_ts;
           pdest_frame->nFlags = h264_last_au_flags;
@@ -6858,7 +6874,7 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
       }
       else
       {
-        look_ahead_nal = true;
+        m_h264_splitter.look_ahead_nal = true;
         DEBUG_PRINT_LOW("\n Frame Found start Decoding Size =%d TimeStamp = %x",
                      pdest_frame->nFilledLen,pdest_frame->nTimeStamp);
         DEBUG_PRINT_LOW("\n Found a frame size = %d number = %d",
@@ -6867,7 +6883,7 @@ OMX_ERRORTYPE omx_vdec::push_input_h264 (OMX_HANDLETYPE hComp)
         if (pdest_frame->nFilledLen == 0)
         {
           DEBUG_PRINT_LOW("\n Copy the Current Frame since and push it");
-          look_ahead_nal = false;
+          m_h264_splitter.look_ahead_nal = false;
           if ( (pdest_frame->nAllocLen - pdest_frame->nFilledLen) >=
                h264_scratch.nFilledLen)
           {
@@ -8206,10 +8222,19 @@ OMX_ERRORTYPE  omx_vdec::allocate_desc_buffer(OMX_U32 index)
 void omx_vdec::insert_demux_addr_offset(OMX_U32 address_offset)
 {
   DEBUG_PRINT_LOW("Inserting address offset (%d) at idx (%d)", address_offset,m_demux_entries);
-  if (m_demux_entries < 8192)
+  if (m_demux_entries == m_demux_capacity)
   {
-    m_demux_offsets[m_demux_entries++] = address_offset;
+    OMX_U32 capacity = m_demux_capacity ? (m_demux_capacity * 2) : DEMUX_OFFSETS_INIT_SIZE;
+    OMX_U32 *offsets = (OMX_U32 *)realloc(m_demux_offsets, capacity * sizeof(OMX_U32));
+    if (offsets == NULL)
+    {
+      DEBUG_PRINT_ERROR("Failed to grow demux table to %d entries", capacity);
+      return;
+    }
+    m_demux_offsets = offsets;
+    m_demux_capacity = capacity;
   }
+  m_demux_offsets[m_demux_entries++] = address_offset;
   return;
 }
 
@@ -8330,7 +8355,6 @@ OMX_ERRORTYPE omx_vdec::handle_demux_data(OMX_BUFFERHEADERTYPE *p_buf_hdr)
     m_desc_buffer_ptr[buffer_index].desc_data_size = (m_demux_entries * 16) + sizeof(OMX_U32);
     DEBUG_PRINT_LOW("desc table data size=%d", m_desc_buffer_ptr[buffer_index].desc_data_size);
   }
-  memset(m_demux_offsets, 0, ( sizeof(OMX_U32) * 8192) );
   m_demux_entries = 0;
   DEBUG_PRINT_LOW("Demux table complete!");
   return OMX_ErrorNone;
@@ -0,0 +1,69 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <string.h>
+#include "vdec_output_table.h"
+
+/* FTB: fill the driver command for buffer index and hand the buffer to
+   the driver. False if the driver owns it already */
+bool vdec_output_queue(OMX_U32 *state,
+                       const struct vdec_bufferpayload *payload,
+                       OMX_U32 index, void *client_data,
+                       struct vdec_fillbuffer_cmd *fill)
+{
+    if (state[index] == VDEC_OUT_BUF_WITH_DRIVER)
+        return false;
+    memcpy(&fill->buffer, &payload[index], sizeof(fill->buffer));
+    fill->client_data = client_data;
+    state[index] = VDEC_OUT_BUF_WITH_DRIVER;
+    return true;
+}
+
+/* FBD: take buffer index back from the driver and copy the frame info
+   to its header, and the fields the extradata code reads later to its
+   response entry. False if the frame does not fit the buffer, which is
+   then returned empty */
+bool vdec_output_done(OMX_U32 *state,
+                      struct vdec_output_frameinfo *resp,
+                      OMX_BUFFERHEADERTYPE *hdr, OMX_U32 index,
+                      const struct vdec_output_frameinfo *frame)
+{
+    state[index] = VDEC_OUT_BUF_WITH_CLIENT;
+    if (frame->len > hdr->nAllocLen)
+    {
+        hdr->nFilledLen = 0;
+        return false;
+    }
+    hdr->nFilledLen = frame->len;
+    hdr->nOffset = frame->offset;
+    hdr->nTimeStamp = frame->time_stamp;
+    hdr->nFlags = frame->flags;
+    resp[index].pic_type = frame->pic_type;
+    resp[index].interlaced_format = frame->interlaced_format;
+    resp[index].aspect_ratio_info = frame->aspect_ratio_info;
+    return true;
+}
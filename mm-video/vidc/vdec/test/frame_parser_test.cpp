@@ -0,0 +1,489 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+    Frame parser test: splits elementary streams into access units with
+    the splitter omx_vdec's arbitrary bytes mode uses, with the source
+    cut at every possible point, and checks the access units found. Also
+    checks the hvcC parameter set unpacking and the pan-scan lookup of
+    frames displayed out of decode order.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "OMX_Core.h"
+#include "frameparser.h"
+#include "h264_utils.h"
+#include "hevc_utils.h"
+
+#define MAX_TEST_FRAMES 16
+#define TEST_BUF_SIZE   4096
+
+struct au_list
+{
+    OMX_U32 count;
+    OMX_U32 nals;
+    OMX_U32 len[MAX_TEST_FRAMES];
+    OMX_U8 data[MAX_TEST_FRAMES][TEST_BUF_SIZE];
+};
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+/* SPS, PPS, SEI and a two slice IDR picture, two P pictures of which
+   the second is led by an SEI, then a single slice P picture */
+static const OMX_U8 h264_sps[] = {0x00,0x00,0x00,0x01,0x67,0x42,0x00,0x1e,
+    0xab,0x40,0x50,0x1e,0xc8,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x80};
+static const OMX_U8 h264_pps[] = {0x00,0x00,0x00,0x01,0x68,0xce,0x38,0x80};
+static const OMX_U8 h264_sei[] = {0x00,0x00,0x01,0x06,0x05,0x10,0xdc,0x45,
+    0xe9,0xbd,0xe6,0xd9,0x48,0xb7,0x96,0x2c,0xd8,0x20,0xd9,0x23,0xee,0xef,
+    0x80};
+static const OMX_U8 h264_idr0[] = {0x00,0x00,0x00,0x01,0x65,0x88,0x84,0x21,
+    0xa0,0x00,0x00,0x03,0x00,0x1f,0xaa,0xbb,0xcc,0xdd,0xee,0xf1,0xf2,0xf3,
+    0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0x80};
+static const OMX_U8 h264_idr1[] = {0x00,0x00,0x01,0x65,0x40,0x88,0x42,0x13,
+    0x57,0x9b,0xdf,0x11,0x22,0x33,0x44,0x55,0x66,0x77,0x88,0x99,0x80};
+static const OMX_U8 h264_p0[] = {0x00,0x00,0x00,0x01,0x41,0x9a,0x02,0x04,
+    0x06,0x08,0x0a,0x0c,0x0e,0x10,0x12,0x14,0x16,0x18,0x1a,0x1c,0x80};
+static const OMX_U8 h264_p1[] = {0x00,0x00,0x01,0x41,0x4a,0x21,0x43,0x65,
+    0x87,0xa9,0xcb,0xed,0x80};
+static const OMX_U8 h264_p2[] = {0x00,0x00,0x00,0x01,0x41,0x9a,0x24,0x68,
+    0xac,0xe1,0x35,0x79,0xbd,0xf2,0x46,0x8a,0xce,0x13,0x57,0x9b,0xdf,0x80};
+static const OMX_U8 h264_p3[] = {0x00,0x00,0x00,0x01,0x41,0x9b,0x11,0x80};
+
+/* VPS, SPS, PPS, prefix SEI and a two slice IDR picture closed by a
+   suffix SEI; a two slice TRAIL_R picture with a slice of layer 1 that
+   has first_slice_segment_in_pic_flag set; an AUD and a TRAIL_R picture */
+static const OMX_U8 hevc_vps[] = {0x00,0x00,0x00,0x01,0x40,0x01,0x0c,0x01,
+    0xff,0xff,0x01,0x60,0x80};
+static const OMX_U8 hevc_sps[] = {0x00,0x00,0x00,0x01,0x42,0x01,0x01,0x01,
+    0x60,0x10,0x90,0xa0,0x03,0xc0,0x80};
+static const OMX_U8 hevc_pps[] = {0x00,0x00,0x01,0x44,0x01,0xc1,0x72,0xb4,
+    0x62,0x40};
+static const OMX_U8 hevc_prefix_sei[] = {0x00,0x00,0x00,0x01,0x4e,0x01,0x05,
+    0x04,0x11,0x22,0x33,0x44,0x80};
+static const OMX_U8 hevc_idr0[] = {0x00,0x00,0x00,0x01,0x26,0x01,0xaf,0x09,
+    0x40,0x00,0x00,0x03,0x00,0x5a,0x3b,0x1c,0x2d,0x80};
+static const OMX_U8 hevc_idr1[] = {0x00,0x00,0x01,0x26,0x01,0x2f,0x11,0x22,
+    0x33,0x44,0x55,0x80};
+static const OMX_U8 hevc_suffix_sei[] = {0x00,0x00,0x00,0x01,0x50,0x01,0x84,
+    0x02,0xab,0xcd,0x80};
+static const OMX_U8 hevc_trail0[] = {0x00,0x00,0x00,0x01,0x02,0x01,0xd0,0x12,
+    0x34,0x56,0x78,0x9a,0x80};
+static const OMX_U8 hevc_trail1[] = {0x00,0x00,0x01,0x02,0x01,0x50,0x21,0x43,
+    0x65,0x80};
+static const OMX_U8 hevc_layer1[] = {0x00,0x00,0x00,0x01,0x02,0x09,0xd0,0x77,
+    0x66,0x55,0x80};
+static const OMX_U8 hevc_aud[] = {0x00,0x00,0x00,0x01,0x46,0x01,0x50};
+static const OMX_U8 hevc_trail2[] = {0x00,0x00,0x00,0x01,0x02,0x01,0xd0,0x9a,
+    0xbc,0xde,0x80};
+
+static OMX_U32 append(OMX_U8 *dst, OMX_U32 len, const OMX_U8 *src,
+                      OMX_U32 src_len)
+{
+    memcpy(dst + len, src, src_len);
+    return len + src_len;
+}
+
+static void emit_au(au_list *aus, const OMX_U8 *data, OMX_U32 len)
+{
+    if (aus->count < MAX_TEST_FRAMES)
+    {
+        memcpy(aus->data[aus->count], data, len);
+        aus->len[aus->count] = len;
+    }
+    aus->count++;
+}
+
+/* Collects the frames h264_frame_splitter completes */
+class test_splitter_client: public frame_splitter_client
+{
+public:
+    test_splitter_client(au_list *list): aus(list) {}
+    void nal_parsed(OMX_U8 *nal, OMX_U32 nal_len) {}
+    void stamp_frame() {}
+    void nal_assigned() {}
+    void nal_added(OMX_U32 offset, OMX_U32 sc_len) { aus->nals++; }
+    OMX_ERRORTYPE frame_done(OMX_BUFFERHEADERTYPE *&frame)
+    {
+        emit_au(aus, frame->pBuffer, frame->nFilledLen);
+        frame->nFilledLen = 0;
+        return OMX_ErrorNone;
+    }
+
+    au_list *aus;
+};
+
+/* Feeds the stream to h264_frame_splitter the way omx_vdec's arbitrary
+   bytes mode does, in pieces cut at cut_a and cut_b, with or without in
+   place NAL parsing allowed */
+static void split_stream(codec_type codec, const OMX_U8 *stream,
+                         OMX_U32 stream_len, OMX_U32 cut_a, OMX_U32 cut_b,
+                         bool in_place, au_list *aus)
+{
+    frame_parse parser;
+    OMX_BUFFERHEADERTYPE source, scratch, frame;
+    OMX_BUFFERHEADERTYPE *dest = &frame;
+    test_splitter_client client(aus);
+    h264_frame_splitter splitter(&parser, &scratch, &client);
+    OMX_U32 cuts[3] = {cut_a, cut_b, stream_len};
+    OMX_U32 start = 0, i;
+    bool new_frame = false;
+
+    memset(aus, 0, sizeof(*aus));
+    /* The parser owns mutils, as in omx_vdec */
+    if (codec == CODEC_TYPE_HEVC)
+        parser.mutils = new HEVC_Utils();
+    else
+        parser.mutils = new H264_Utils();
+    parser.mutils->allocate_rbsp_buffer(TEST_BUF_SIZE);
+    parser.init_start_codes(codec);
+    memset(&scratch, 0, sizeof(scratch));
+    scratch.pBuffer = (OMX_U8 *) calloc(1, TEST_BUF_SIZE);
+    scratch.nAllocLen = TEST_BUF_SIZE;
+    memset(&frame, 0, sizeof(frame));
+    frame.pBuffer = (OMX_U8 *) calloc(1, TEST_BUF_SIZE);
+    frame.nAllocLen = TEST_BUF_SIZE;
+
+    for (i = 0; i < 3; i++)
+    {
+        if (cuts[i] <= start)
+            continue;
+        memset(&source, 0, sizeof(source));
+        source.pBuffer = (OMX_U8 *) stream + start;
+        source.nFilledLen = cuts[i] - start;
+        start = cuts[i];
+
+        while (source.nFilledLen)
+            CHECK(splitter.split(&source, dest, in_place, false) == OMX_ErrorNone,
+                  "split error");
+    }
+
+    /* End of stream: the last NAL has no start code behind it. A NAL
+       that starts a new frame is split off into a frame of its own */
+    CHECK(splitter.finish(dest, new_frame) == OMX_ErrorNone, "finish error");
+    if (new_frame)
+    {
+        client.frame_done(dest);
+        CHECK(splitter.finish(dest, new_frame) == OMX_ErrorNone && !new_frame,
+              "finish error on a new frame");
+    }
+    if (frame.nFilledLen)
+        emit_au(aus, frame.pBuffer, frame.nFilledLen);
+    free(frame.pBuffer);
+    free(scratch.pBuffer);
+}
+
+static bool same_aus(const au_list *a, const au_list *b)
+{
+    OMX_U32 i;
+
+    if (a->count != b->count || a->nals != b->nals)
+        return false;
+    for (i = 0; i < a->count && i < MAX_TEST_FRAMES; i++)
+    {
+        if (a->len[i] != b->len[i] ||
+            memcmp(a->data[i], b->data[i], a->len[i]))
+            return false;
+    }
+    return true;
+}
+
+/* The parser hands every NAL on with a 4 byte start code */
+static OMX_U32 append_nal(OMX_U8 *dst, OMX_U32 len, const OMX_U8 *nal,
+                          OMX_U32 nal_len)
+{
+    static const OMX_U8 start_code[4] = {0x00,0x00,0x00,0x01};
+    OMX_U32 sc_len = nal[2] == 0x01 ? 3 : 4;
+
+    len = append(dst, len, start_code, sizeof(start_code));
+    return append(dst, len, nal + sc_len, nal_len - sc_len);
+}
+
+struct test_nal
+{
+    const OMX_U8 *nal;
+    OMX_U32 len;
+    bool au_start;
+};
+
+/* Splits the concatenated NALs at every single cut and every pair of
+   cuts, on both parser paths, against the access units marked au_start */
+static void check_split_points(const char *name, codec_type codec,
+                               const test_nal *nals, OMX_U32 nal_cnt)
+{
+    OMX_U8 stream[TEST_BUF_SIZE], au[TEST_BUF_SIZE];
+    OMX_U32 len = 0, au_len = 0, a, b, i;
+    au_list expected, scratch_aus, in_place_aus;
+
+    memset(&expected, 0, sizeof(expected));
+    for (i = 0; i < nal_cnt; i++)
+    {
+        len = append(stream, len, nals[i].nal, nals[i].len);
+        if (nals[i].au_start && au_len)
+        {
+            emit_au(&expected, au, au_len);
+            au_len = 0;
+        }
+        au_len = append_nal(au, au_len, nals[i].nal, nals[i].len);
+    }
+    emit_au(&expected, au, au_len);
+    expected.nals = nal_cnt;
+
+    split_stream(codec, stream, len, len, len, false, &scratch_aus);
+    CHECK(same_aus(&scratch_aus, &expected),
+          "%s whole buffer: %u access units, expected %u",
+          name, scratch_aus.count, expected.count);
+
+    for (a = 1; a < len; a++)
+    {
+        for (b = a; b < len; b++)
+        {
+            split_stream(codec, stream, len, a, b, false, &scratch_aus);
+            split_stream(codec, stream, len, a, b, true, &in_place_aus);
+            CHECK(same_aus(&scratch_aus, &expected),
+                  "%s scratch split at %u/%u: %u access units",
+                  name, a, b, scratch_aus.count);
+            CHECK(same_aus(&in_place_aus, &expected),
+                  "%s in place split at %u/%u: %u access units",
+                  name, a, b, in_place_aus.count);
+        }
+    }
+}
+
+static void test_h264_split_points()
+{
+    static const test_nal nals[] = {
+        {h264_sps, sizeof(h264_sps), true},
+        {h264_pps, sizeof(h264_pps), false},
+        {h264_sei, sizeof(h264_sei), false},
+        {h264_idr0, sizeof(h264_idr0), false},
+        {h264_idr1, sizeof(h264_idr1), false},
+        {h264_p0, sizeof(h264_p0), true},
+        {h264_p1, sizeof(h264_p1), false},
+        {h264_sei, sizeof(h264_sei), true},
+        {h264_p2, sizeof(h264_p2), false},
+        {h264_p3, sizeof(h264_p3), true},
+    };
+
+    check_split_points("h264", CODEC_TYPE_H264, nals,
+                       sizeof(nals) / sizeof(nals[0]));
+}
+
+/* A slice only starts an access unit with first_slice_segment_in_pic_flag
+   set on layer 0; suffix SEI stays with the picture before it */
+static void test_hevc_split_points()
+{
+    static const test_nal nals[] = {
+        {hevc_vps, sizeof(hevc_vps), true},
+        {hevc_sps, sizeof(hevc_sps), false},
+        {hevc_pps, sizeof(hevc_pps), false},
+        {hevc_prefix_sei, sizeof(hevc_prefix_sei), false},
+        {hevc_idr0, sizeof(hevc_idr0), false},
+        {hevc_idr1, sizeof(hevc_idr1), false},
+        {hevc_suffix_sei, sizeof(hevc_suffix_sei), false},
+        {hevc_trail0, sizeof(hevc_trail0), true},
+        {hevc_trail1, sizeof(hevc_trail1), false},
+        {hevc_layer1, sizeof(hevc_layer1), false},
+        {hevc_aud, sizeof(hevc_aud), true},
+        {hevc_trail2, sizeof(hevc_trail2), false},
+    };
+
+    check_split_points("hevc", CODEC_TYPE_HEVC, nals,
+                       sizeof(nals) / sizeof(nals[0]));
+}
+
+/* Appends one hvcC array holding a single NAL, start code stripped */
+static OMX_U32 append_hvcc_array(OMX_U8 *dst, OMX_U32 len, const OMX_U8 *nal,
+                                 OMX_U32 nal_len)
+{
+    OMX_U32 sc_len = nal[2] == 0x01 ? 3 : 4;
+
+    nal += sc_len;
+    nal_len -= sc_len;
+    dst[len++] = 0x80 | ((nal[0] >> 1) & 0x3f);
+    dst[len++] = 0x00;
+    dst[len++] = 0x01;
+    dst[len++] = (nal_len >> 8) & 0xff;
+    dst[len++] = nal_len & 0xff;
+    return append(dst, len, nal, nal_len);
+}
+
+static void test_hevc_hvcc_unpack()
+{
+    static const OMX_U8 *param_sets[] = {hevc_vps, hevc_sps, hevc_pps};
+    static const OMX_U32 param_set_len[] = {sizeof(hevc_vps), sizeof(hevc_sps),
+                                            sizeof(hevc_pps)};
+    OMX_U8 hvcc[TEST_BUF_SIZE], expected[TEST_BUF_SIZE], out[TEST_BUF_SIZE];
+    OMX_U32 hvcc_len, expected_len, out_len, nal_length, i, j;
+
+    memset(hvcc, 0, HEVC_HVCC_HEADER_SIZE);
+    hvcc[0] = 0x01;
+    hvcc[21] = 0xfc | 0x03;
+    hvcc[22] = 3;
+    hvcc_len = HEVC_HVCC_HEADER_SIZE;
+    for (i = 0; i < 3; i++)
+        hvcc_len = append_hvcc_array(hvcc, hvcc_len, param_sets[i],
+                                     param_set_len[i]);
+
+    for (nal_length = 1; nal_length <= 4; nal_length++)
+    {
+        expected_len = 0;
+        for (i = 0; i < 3; i++)
+        {
+            const OMX_U8 *nal = param_sets[i];
+            OMX_U32 sc_len = nal[2] == 0x01 ? 3 : 4;
+            OMX_U32 len = param_set_len[i] - sc_len;
+
+            for (j = 0; j < nal_length; j++)
+                expected[expected_len++] = (len >> ((nal_length - 1 - j) * 8)) & 0xff;
+            expected_len = append(expected, expected_len, nal + sc_len, len);
+        }
+        out_len = hevc_unpack_hvcc(hvcc, hvcc_len, nal_length, NULL, NULL);
+        CHECK(out_len == expected_len, "hvcC size %u, expected %u",
+              out_len, expected_len);
+        memset(out, 0, sizeof(out));
+        out_len = hevc_unpack_hvcc(hvcc, hvcc_len, nal_length, out, NULL);
+        CHECK(out_len == expected_len && !memcmp(out, expected, expected_len),
+              "hvcC unpack with %u byte lengths", nal_length);
+    }
+
+    /* Any truncation inside the arrays is a bad record */
+    for (i = HEVC_HVCC_HEADER_SIZE; i < hvcc_len; i++)
+        CHECK(!hevc_unpack_hvcc(hvcc, i, 4, NULL, NULL),
+              "hvcC truncated to %u bytes accepted", i);
+    CHECK(!hevc_unpack_hvcc(hvcc, HEVC_HVCC_HEADER_SIZE - 1, 4, NULL, NULL),
+          "hvcC without numOfArrays accepted");
+    hvcc[22] = 0;
+    CHECK(!hevc_unpack_hvcc(hvcc, hvcc_len, 4, NULL, NULL),
+          "hvcC without arrays accepted");
+}
+
+/* Fills the next panscan entry the way sei_pan_scan() does, tagged with
+   id in its first window, then stamps it as set_h264_frame_ts() does */
+static void add_panscan(panscan_handler *panscan, OMX_S64 ts, OMX_S32 id)
+{
+    h264_pan_scan *param = panscan->get_free();
+
+    CHECK(param != NULL, "no free panscan entry for ts %lld", ts);
+    if (!param)
+        return;
+    param->rect_id = 0;
+    param->rect_cancel_flag = 0;
+    param->cnt = 1;
+    param->rect_left_offset[0] = param->rect_top_offset[0] = id;
+    param->rect_right_offset[0] = param->rect_bottom_offset[0] = id;
+    param->rect_repetition_period = 0;
+    panscan->update_last(ts);
+}
+
+/* Tag of the panscan data handed to the frame with time stamp ts, -1 if
+   there is none */
+static OMX_S32 panscan_id(panscan_handler *panscan, OMX_S64 ts)
+{
+    h264_pan_scan *param = panscan->get_populated(ts);
+
+    if (!param || (param->rect_id & NO_PAN_SCAN_BIT))
+        return -1;
+    return param->rect_left_offset[0];
+}
+
+#define PANSCAN_FRAME_US 33333
+
+/* I0 P3 B1 B2 in decode order, displayed as I0 B1 B2 P3: every frame
+   gets its own panscan data */
+static void test_panscan_out_of_order()
+{
+    static const OMX_S32 decode_order[] = {0, 3, 1, 2};
+    panscan_handler panscan;
+    OMX_S32 i;
+
+    CHECK(panscan.initialize(PANSCAN_RING_SIZE), "panscan initialize");
+    for (i = 0; i < 4; i++)
+        add_panscan(&panscan, decode_order[i] * PANSCAN_FRAME_US,
+                    decode_order[i]);
+    for (i = 0; i < 4; i++)
+    {
+        OMX_S32 id = panscan_id(&panscan, i * PANSCAN_FRAME_US);
+        CHECK(id == i, "panscan of display frame %d: got %d", i, id);
+    }
+}
+
+/* More panscan SEIs than PANSCAN_RING_SIZE before the first lookup: the
+   oldest are recycled, and their time stamps must not find the entries
+   that took over their slots */
+static void test_panscan_ring_overflow()
+{
+    const OMX_S32 frames = PANSCAN_RING_SIZE + 8;
+    panscan_handler panscan;
+    OMX_S32 i, id;
+
+    CHECK(panscan.initialize(PANSCAN_RING_SIZE), "panscan initialize");
+    for (i = 0; i < frames; i++)
+        add_panscan(&panscan, i * PANSCAN_FRAME_US, i);
+    for (i = 0; i < frames - PANSCAN_RING_SIZE; i++)
+    {
+        id = panscan_id(&panscan, i * PANSCAN_FRAME_US);
+        CHECK(id == -1, "panscan of recycled frame %d: got %d", i, id);
+    }
+    for (; i < frames; i++)
+    {
+        id = panscan_id(&panscan, i * PANSCAN_FRAME_US);
+        CHECK(id == i, "panscan of frame %d after overflow: got %d", i, id);
+    }
+    /* Everything is released, the ring takes new data again */
+    add_panscan(&panscan, frames * PANSCAN_FRAME_US, frames);
+    id = panscan_id(&panscan, frames * PANSCAN_FRAME_US);
+    CHECK(id == frames, "panscan after the ring drained: got %d", id);
+}
+
+int main(int argc, char **argv)
+{
+    test_h264_split_points();
+    test_hevc_split_points();
+    test_hevc_hvcc_unpack();
+    test_panscan_out_of_order();
+    test_panscan_ring_overflow();
+
+    if (failures)
+    {
+        printf("mm-vdec-parser-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("mm-vdec-parser-test: all checks passed\n");
+    return 0;
+}
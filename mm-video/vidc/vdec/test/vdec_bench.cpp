@@ -0,0 +1,503 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+    Decoder bookkeeping microbenchmarks. No driver is opened; each case
+    runs the per frame work omx_vdec does on its own tables against the
+    way it was done before.
+
+    Usage: mm-vdec-bench [frames] [buffers]
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <linux/msm_vidc_dec.h>
+#include "OMX_Core.h"
+#include "OMX_Component.h"
+#include "OMX_QCOMExtns.h"
+#include "vdec_output_table.h"
+
+#define CACHE_LINE_SIZE   64
+/* Touched between frames to stand in for the rest of the decode work */
+#define EVICT_SIZE        (1024 * 1024)
+
+static volatile OMX_U32 sink;
+static OMX_U8 *evict_buf;
+
+static OMX_U64 now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void evict_caches()
+{
+    OMX_U32 i, sum = 0;
+    for (i = 0; i < EVICT_SIZE; i += CACHE_LINE_SIZE)
+    {
+        evict_buf[i]++;
+        sum += evict_buf[i];
+    }
+    sink += sum;
+}
+
+/* ---------------------------------------------------------------------
+   Output buffer tables: the header walk FTB and FBD did before against
+   the per index bookkeeping omx_vdec does now (vdec_output_table.cpp)
+   --------------------------------------------------------------------- */
+
+struct output_tables
+{
+    OMX_U32 count;
+    OMX_BUFFERHEADERTYPE *hdr;
+    OMX_QCOM_PLATFORM_PRIVATE_LIST *list;
+    OMX_QCOM_PLATFORM_PRIVATE_ENTRY *entry;
+    OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pmem;
+    /* the driver tables as they were, reached through the headers */
+    struct vdec_bufferpayload *walk_payload;
+    struct vdec_output_frameinfo *walk_resp;
+    /* the block allocate_output_header_table() lays out now */
+    void *drv_block;
+    struct vdec_bufferpayload *payload;
+    struct vdec_output_frameinfo *resp;
+    OMX_U32 *state;
+};
+
+static size_t line_align(size_t size)
+{
+    return (size + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1);
+}
+
+static void *alloc_lines(size_t size)
+{
+    void *p = NULL;
+    if (posix_memalign(&p, CACHE_LINE_SIZE, size))
+        return NULL;
+    memset(p, 0, size);
+    return p;
+}
+
+static void free_output_tables(output_tables *t)
+{
+    free(t->hdr);
+    free(t->list);
+    free(t->entry);
+    free(t->pmem);
+    free(t->walk_payload);
+    free(t->walk_resp);
+    free(t->drv_block);
+}
+
+static bool alloc_output_tables(output_tables *t, OMX_U32 count)
+{
+    size_t payload_size = line_align(count * sizeof(*t->payload));
+    size_t resp_size = line_align(count * sizeof(*t->resp));
+    size_t state_size = count * sizeof(*t->state);
+    OMX_U32 i;
+
+    memset(t, 0, sizeof(*t));
+    t->count = count;
+    t->hdr = (OMX_BUFFERHEADERTYPE *)calloc(count, sizeof(*t->hdr));
+    t->list = (OMX_QCOM_PLATFORM_PRIVATE_LIST *)calloc(count, sizeof(*t->list));
+    t->entry = (OMX_QCOM_PLATFORM_PRIVATE_ENTRY *)calloc(count, sizeof(*t->entry));
+    t->pmem = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)calloc(count, sizeof(*t->pmem));
+    t->walk_payload = (struct vdec_bufferpayload *)calloc(count, sizeof(*t->walk_payload));
+    t->walk_resp = (struct vdec_output_frameinfo *)calloc(count, sizeof(*t->walk_resp));
+    t->drv_block = alloc_lines(payload_size + resp_size + state_size);
+    if (!t->hdr || !t->list || !t->entry || !t->pmem || !t->walk_payload ||
+        !t->walk_resp || !t->drv_block)
+    {
+        free_output_tables(t);
+        return false;
+    }
+    t->payload = (struct vdec_bufferpayload *)t->drv_block;
+    t->resp = (struct vdec_output_frameinfo *)((OMX_U8 *)t->drv_block + payload_size);
+    t->state = (OMX_U32 *)((OMX_U8 *)t->drv_block + payload_size + resp_size);
+
+    for (i = 0; i < count; i++)
+    {
+        t->hdr[i].nSize = sizeof(OMX_BUFFERHEADERTYPE);
+        t->hdr[i].nAllocLen = 1920 * 1088 * 3 / 2;
+        t->entry[i].type = OMX_QCOM_PLATFORM_PRIVATE_PMEM;
+        t->entry[i].entry = &t->pmem[i];
+        t->list[i].nEntries = 1;
+        t->list[i].entryList = &t->entry[i];
+        t->hdr[i].pPlatformPrivate = &t->list[i];
+        t->hdr[i].pOutputPortPrivate = &t->walk_resp[i];
+        t->walk_resp[i].client_data = &t->walk_payload[i];
+        t->resp[i].client_data = &t->payload[i];
+        t->walk_payload[i].pmem_fd = t->payload[i].pmem_fd =
+            t->pmem[i].pmem_fd = 100 + i;
+        t->walk_payload[i].buffer_len = t->payload[i].buffer_len =
+            t->hdr[i].nAllocLen;
+        t->state[i] = VDEC_OUT_BUF_WITH_CLIENT;
+    }
+    return true;
+}
+
+/* FTB then FBD of buffer i, reaching every table through the header */
+static void round_trip_headers(output_tables *t, OMX_U32 i,
+                               const struct vdec_output_frameinfo *frame)
+{
+    OMX_BUFFERHEADERTYPE *hdr = &t->hdr[i];
+    struct vdec_output_frameinfo *resp;
+    struct vdec_bufferpayload *payload;
+    struct vdec_fillbuffer_cmd fill;
+    OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *pmem;
+
+    resp = (struct vdec_output_frameinfo *)hdr->pOutputPortPrivate;
+    payload = (struct vdec_bufferpayload *)resp->client_data;
+    memcpy(&fill.buffer, payload, sizeof(fill.buffer));
+    fill.client_data = hdr;
+    sink += fill.buffer.pmem_fd;
+
+    hdr = (OMX_BUFFERHEADERTYPE *)fill.client_data;
+    if ((OMX_U32)(hdr - t->hdr) < t->count && hdr->pOutputPortPrivate &&
+        (OMX_U32)((struct vdec_output_frameinfo *)hdr->pOutputPortPrivate -
+                  t->walk_resp) < t->count)
+    {
+        resp = (struct vdec_output_frameinfo *)hdr->pOutputPortPrivate;
+        if (frame->len <= hdr->nAllocLen)
+        {
+            hdr->nFilledLen = frame->len;
+            hdr->nOffset = frame->offset;
+            hdr->nTimeStamp = frame->time_stamp;
+            hdr->nFlags = frame->flags;
+            resp->framesize = frame->framesize;
+            resp->len = frame->len;
+            resp->offset = frame->offset;
+            resp->time_stamp = frame->time_stamp;
+            resp->flags = frame->flags;
+            resp->pic_type = frame->pic_type;
+            resp->interlaced_format = frame->interlaced_format;
+            resp->aspect_ratio_info = frame->aspect_ratio_info;
+        }
+        else
+            hdr->nFilledLen = 0;
+    }
+    pmem = (OMX_QCOM_PLATFORM_PRIVATE_PMEM_INFO *)
+           ((OMX_QCOM_PLATFORM_PRIVATE_LIST *)hdr->pPlatformPrivate)->entryList->entry;
+    sink += pmem->pmem_fd;
+}
+
+/* The same through omx_vdec's per index bookkeeping */
+static void round_trip_table(output_tables *t, OMX_U32 i,
+                             const struct vdec_output_frameinfo *frame)
+{
+    OMX_BUFFERHEADERTYPE *hdr = &t->hdr[i];
+    struct vdec_fillbuffer_cmd fill;
+    OMX_U32 index = hdr - t->hdr;
+
+    if (index >= t->count ||
+        !vdec_output_queue(t->state, t->payload, index, hdr, &fill))
+        return;
+    sink += fill.buffer.pmem_fd;
+
+    hdr = (OMX_BUFFERHEADERTYPE *)fill.client_data;
+    index = hdr - t->hdr;
+    if (index < t->count)
+        vdec_output_done(t->state, t->resp, hdr, index, frame);
+}
+
+static void bench_output_tables(OMX_U32 frames, OMX_U32 count)
+{
+    output_tables t;
+    struct vdec_output_frameinfo frame;
+    OMX_U64 start, walk_ns = 0, table_ns = 0;
+    OMX_U32 f;
+
+    if (!alloc_output_tables(&t, count))
+    {
+        printf("output tables: allocation failed\n");
+        return;
+    }
+    memset(&frame, 0, sizeof(frame));
+    frame.len = t.hdr[0].nAllocLen;
+    for (f = 0; f < frames; f++)
+    {
+        OMX_U32 i = (f * 7) % count;
+
+        frame.time_stamp = f * 33333LL;
+        evict_caches();
+        start = now_ns();
+        round_trip_headers(&t, i, &frame);
+        walk_ns += now_ns() - start;
+
+        evict_caches();
+        start = now_ns();
+        round_trip_table(&t, i, &frame);
+        table_ns += now_ns() - start;
+    }
+    printf("output tables, %u buffers, %u frames:\n",
+           (unsigned)count, (unsigned)frames);
+    printf("  header walk  %8.1f ns per FTB/FBD\n", (double)walk_ns / frames);
+    printf("  index tables %8.1f ns per FTB/FBD\n", (double)table_ns / frames);
+    free_output_tables(&t);
+}
+
+/* ---------------------------------------------------------------------
+   Output extradata: testing every client_extradata bit per frame against
+   walking the record list update_extradata_records() keeps
+   --------------------------------------------------------------------- */
+
+#define BENCH_INTERLACE_EXTRADATA  0x00020000
+#define BENCH_FRAMEINFO_EXTRADATA  0x00010000
+#define BENCH_PORTDEF_EXTRADATA    0x00080000
+#define BENCH_EXTRADATA_TYPES      3
+
+#define INTERLACE_SIZE ((sizeof(OMX_OTHER_EXTRADATATYPE) +\
+                         sizeof(OMX_STREAMINTERLACEFORMAT) + 3)&(~3))
+#define FRAMEINFO_SIZE ((sizeof(OMX_OTHER_EXTRADATATYPE) +\
+                         sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO) + 3)&(~3))
+#define PORTDEF_SIZE   ((sizeof(OMX_OTHER_EXTRADATATYPE) +\
+                         sizeof(OMX_PARAM_PORTDEFINITIONTYPE) + 3)&(~3))
+#define EXTRADATA_BUF_SIZE 8192
+#define BENCH_SPEC_VERSION 0x00000101
+
+static const OMX_U32 record_order[BENCH_EXTRADATA_TYPES] =
+{
+    BENCH_INTERLACE_EXTRADATA,
+    BENCH_FRAMEINFO_EXTRADATA,
+    BENCH_PORTDEF_EXTRADATA
+};
+
+static OMX_PARAM_PORTDEFINITIONTYPE bench_port_def;
+
+static OMX_OTHER_EXTRADATATYPE *next_extra(OMX_OTHER_EXTRADATATYPE *extra)
+{
+    return (OMX_OTHER_EXTRADATATYPE *)(((OMX_U8 *)extra) + extra->nSize);
+}
+
+static void append_header(OMX_OTHER_EXTRADATATYPE *extra, OMX_U32 size,
+                          OMX_U32 type, OMX_U32 data_size)
+{
+    extra->nSize = size;
+    extra->nVersion.nVersion = BENCH_SPEC_VERSION;
+    extra->nPortIndex = 1;
+    extra->eType = (OMX_EXTRADATATYPE)type;
+    extra->nDataSize = data_size;
+}
+
+static void append_interlace(OMX_OTHER_EXTRADATATYPE *extra)
+{
+    OMX_STREAMINTERLACEFORMAT *fmt;
+    append_header(extra, INTERLACE_SIZE, OMX_ExtraDataInterlaceFormat,
+                  sizeof(OMX_STREAMINTERLACEFORMAT));
+    fmt = (OMX_STREAMINTERLACEFORMAT *)extra->data;
+    fmt->nSize = sizeof(OMX_STREAMINTERLACEFORMAT);
+    fmt->nPortIndex = 1;
+    fmt->bInterlaceFormat = OMX_FALSE;
+    fmt->nInterlaceFormats = OMX_InterlaceFrameProgressive;
+}
+
+static void append_frameinfo(OMX_OTHER_EXTRADATATYPE *extra, OMX_TICKS ts,
+                             bool clear)
+{
+    OMX_QCOM_EXTRADATA_FRAMEINFO *info;
+    append_header(extra, FRAMEINFO_SIZE, OMX_ExtraDataFrameInfo,
+                  sizeof(OMX_QCOM_EXTRADATA_FRAMEINFO));
+    info = (OMX_QCOM_EXTRADATA_FRAMEINFO *)extra->data;
+    info->ePicType = OMX_VIDEO_PictureTypeP;
+    info->interlaceType = OMX_QCOM_InterlaceFrameProgressive;
+    if (clear)
+    {
+        memset(&info->panScan, 0, sizeof(info->panScan));
+        memset(&info->aspectRatio, 0, sizeof(info->aspectRatio));
+        memset(&info->displayAspectRatio, 0, sizeof(info->displayAspectRatio));
+    }
+    info->panScan.numWindows = 0;
+    info->aspectRatio.aspectRatioX = 1;
+    info->aspectRatio.aspectRatioY = 1;
+    info->displayAspectRatio.displayHorizontalSize = 0;
+    info->displayAspectRatio.displayVerticalSize = 0;
+    info->nConcealedMacroblocks = (OMX_U32)ts & 3;
+    info->nFrameRate = 30;
+}
+
+static void append_portdef(OMX_OTHER_EXTRADATATYPE *extra)
+{
+    append_header(extra, PORTDEF_SIZE, OMX_ExtraDataPortDef,
+                  sizeof(OMX_PARAM_PORTDEFINITIONTYPE));
+    memcpy(extra->data, &bench_port_def, sizeof(bench_port_def));
+}
+
+static void append_terminator(OMX_OTHER_EXTRADATATYPE *extra)
+{
+    append_header(extra, sizeof(OMX_OTHER_EXTRADATATYPE), OMX_ExtraDataNone, 0);
+}
+
+/* handle_extradata before the record list */
+static OMX_U32 extradata_by_mask(OMX_U8 *buf, OMX_U32 mask, OMX_TICKS ts)
+{
+    OMX_OTHER_EXTRADATATYPE *extra = (OMX_OTHER_EXTRADATATYPE *)buf;
+    OMX_U8 *buf_end = buf + EXTRADATA_BUF_SIZE;
+    bool appended = false;
+
+    if ((mask & BENCH_INTERLACE_EXTRADATA) &&
+        ((OMX_U8 *)extra + INTERLACE_SIZE) < buf_end)
+    {
+        append_interlace(extra);
+        extra = next_extra(extra);
+        appended = true;
+    }
+    if ((mask & BENCH_FRAMEINFO_EXTRADATA) &&
+        ((OMX_U8 *)extra + FRAMEINFO_SIZE) < buf_end)
+    {
+        append_frameinfo(extra, ts, true);
+        extra = next_extra(extra);
+        appended = true;
+    }
+    if ((mask & BENCH_PORTDEF_EXTRADATA) &&
+        ((OMX_U8 *)extra + PORTDEF_SIZE) < buf_end)
+    {
+        append_portdef(extra);
+        extra = next_extra(extra);
+        appended = true;
+    }
+    if (appended)
+        append_terminator(extra);
+    return (OMX_U8 *)extra - buf;
+}
+
+/* handle_extradata walking the precomputed list */
+static OMX_U32 extradata_by_records(OMX_U8 *buf, const OMX_U32 *records,
+                                    OMX_U32 record_cnt, OMX_TICKS ts)
+{
+    OMX_OTHER_EXTRADATATYPE *extra = (OMX_OTHER_EXTRADATATYPE *)buf;
+    OMX_U8 *buf_end = buf + EXTRADATA_BUF_SIZE;
+    OMX_U32 r;
+
+    for (r = 0; r < record_cnt; r++)
+    {
+        switch (records[r])
+        {
+        case BENCH_INTERLACE_EXTRADATA:
+            if (((OMX_U8 *)extra + INTERLACE_SIZE) < buf_end)
+            {
+                append_interlace(extra);
+                extra = next_extra(extra);
+            }
+            break;
+        case BENCH_FRAMEINFO_EXTRADATA:
+            if (((OMX_U8 *)extra + FRAMEINFO_SIZE) < buf_end)
+            {
+                append_frameinfo(extra, ts, false);
+                extra = next_extra(extra);
+            }
+            break;
+        case BENCH_PORTDEF_EXTRADATA:
+            if (((OMX_U8 *)extra + PORTDEF_SIZE) < buf_end)
+            {
+                append_portdef(extra);
+                extra = next_extra(extra);
+            }
+            break;
+        }
+    }
+    if (record_cnt)
+        append_terminator(extra);
+    return (OMX_U8 *)extra - buf;
+}
+
+static void bench_extradata_case(const char *name, OMX_U32 mask, OMX_U32 frames)
+{
+    OMX_U8 *buf = (OMX_U8 *)alloc_lines(EXTRADATA_BUF_SIZE);
+    OMX_U32 records[BENCH_EXTRADATA_TYPES], record_cnt = 0;
+    OMX_U64 start, mask_ns = 0, list_ns = 0;
+    OMX_U32 f, i, mask_len = 0, list_len = 0;
+
+    if (!buf)
+    {
+        printf("extradata: allocation failed\n");
+        return;
+    }
+    for (i = 0; i < BENCH_EXTRADATA_TYPES; i++)
+        if (mask & record_order[i])
+            records[record_cnt++] = record_order[i];
+
+    for (f = 0; f < frames; f++)
+    {
+        evict_caches();
+        start = now_ns();
+        mask_len = extradata_by_mask(buf, mask, f * 33333LL);
+        mask_ns += now_ns() - start;
+
+        evict_caches();
+        start = now_ns();
+        list_len = extradata_by_records(buf, records, record_cnt, f * 33333LL);
+        list_ns += now_ns() - start;
+    }
+    if (mask_len != list_len)
+        printf("  %s: record lengths differ (%u, %u)\n", name,
+               (unsigned)mask_len, (unsigned)list_len);
+    printf("  %-12s bit tests %8.1f ns, record list %8.1f ns, %u bytes\n",
+           name, (double)mask_ns / frames, (double)list_ns / frames,
+           (unsigned)list_len);
+    free(buf);
+}
+
+static void bench_extradata(OMX_U32 frames)
+{
+    memset(&bench_port_def, 0, sizeof(bench_port_def));
+    bench_port_def.nSize = sizeof(bench_port_def);
+    bench_port_def.nPortIndex = 1;
+    bench_port_def.format.video.nFrameWidth = 1920;
+    bench_port_def.format.video.nFrameHeight = 1080;
+    bench_port_def.format.video.nStride = 1920;
+    bench_port_def.format.video.nSliceHeight = 1088;
+
+    printf("output extradata, %u frames:\n", (unsigned)frames);
+    bench_extradata_case("all types", BENCH_INTERLACE_EXTRADATA |
+                         BENCH_FRAMEINFO_EXTRADATA | BENCH_PORTDEF_EXTRADATA,
+                         frames);
+    bench_extradata_case("frame info", BENCH_FRAMEINFO_EXTRADATA, frames);
+}
+
+int main(int argc, char **argv)
+{
+    OMX_U32 frames = (argc > 1) ? atoi(argv[1]) : 20000;
+    OMX_U32 buffers = (argc > 2) ? atoi(argv[2]) : 22;
+
+    if (!frames || !buffers || buffers > 32)
+    {
+        printf("Usage: mm-vdec-bench [frames] [buffers, up to 32]\n");
+        return -1;
+    }
+    evict_buf = (OMX_U8 *)calloc(1, EVICT_SIZE);
+    if (!evict_buf)
+        return -1;
+
+    bench_output_tables(frames, buffers);
+    bench_extradata(frames);
+
+    free(evict_buf);
+    return 0;
+}
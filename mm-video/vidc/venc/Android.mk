@@ -82,6 +82,8 @@ LOCAL_SHARED_LIBRARIES    := liblog libutils libbinder libcutils \
 
 LOCAL_SRC_FILES   := src/omx_video_base.cpp
 LOCAL_SRC_FILES   += src/omx_video_encoder.cpp
+LOCAL_SRC_FILES   += src/venc_lookahead.cpp
+LOCAL_SRC_FILES   += src/venc_scene_detect.cpp
 ifeq ($(TARGET_BOARD_PLATFORM),msm8974)
 LOCAL_SRC_FILES   += src/video_encoder_device_copper.cpp
 else
@@ -148,6 +150,41 @@ LOCAL_SRC_FILES                 += test/queue.c
 
 include $(BUILD_EXECUTABLE)
 
+# -----------------------------------------------------------------------------
+# 			Make the look-ahead test (mm-venc-lookahead-test)
+# -----------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+venc-lookahead-test-inc         := $(LOCAL_PATH)/inc
+venc-lookahead-test-inc         += hardware/qcom/media/mm-core/inc
+
+LOCAL_MODULE                    := mm-venc-lookahead-test
+LOCAL_MODULE_TAGS               := debug
+LOCAL_C_INCLUDES                := $(venc-lookahead-test-inc)
+LOCAL_PRELINK_MODULE            := false
+
+LOCAL_SRC_FILES                 := src/venc_lookahead.cpp
+LOCAL_SRC_FILES                 += test/venc_lookahead_test.cpp
+
+include $(BUILD_EXECUTABLE)
+
+# -----------------------------------------------------------------------------
+# 			Make the scene cut test (mm-venc-scene-detect-test)
+# -----------------------------------------------------------------------------
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE                    := mm-venc-scene-detect-test
+LOCAL_MODULE_TAGS               := debug
+LOCAL_C_INCLUDES                := $(LOCAL_PATH)/inc
+LOCAL_PRELINK_MODULE            := false
+
+LOCAL_SRC_FILES                 := src/venc_scene_detect.cpp
+LOCAL_SRC_FILES                 += test/venc_scene_detect_test.cpp
+
+include $(BUILD_EXECUTABLE)
+
 endif #BUILD_TINY_ANDROID
 
 # ---------------------------------------------------------------------------------
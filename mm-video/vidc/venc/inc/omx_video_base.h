@@ -46,6 +46,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include<stdlib.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <sys/mman.h>
 #ifdef _ANDROID_
@@ -62,6 +63,8 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "qc_omx_component.h"
 #include "omx_video_common.h"
 #include "extra_data_handler.h"
+#include "venc_lookahead.h"
+#include "venc_scene_detect.h"
 #include <linux/videodev2.h>
 #include <dlfcn.h>
 #include "C2DColorConverter.h"
@@ -135,6 +138,10 @@ static const char* MEM_DEVICE = "/dev/pmem_smipool";
 #ifdef _ANDROID_ICS_
 #define MAX_NUM_INPUT_BUFFERS 32
 #endif
+// Frame rate conversion: input buffers that can be duplicated and the
+// number of times a single frame is repeated at most
+#define OMX_FRC_MAX_INPUT_BUFFERS 32
+#define OMX_FRC_MAX_REPEAT 3
 void* message_thread(void *);
 // OMX video class
 class omx_video: public qc_omx_component
@@ -157,16 +164,21 @@ protected:
 	bool init();
 	bool open(unsigned int height,unsigned int width,
 			  ColorConvertFormat src,
-			  ColorConvertFormat dest);
+			  ColorConvertFormat dest,
+			  unsigned int rotation);
 	bool convert(int src_fd, void *src_viraddr,
 				 int dest_fd,void *dest_viraddr);
 	bool get_buffer_size(int port,unsigned int &buf_size);
+	bool get_buffer_geometry(int port,unsigned int &width,
+				 unsigned int &height,unsigned int &stride);
 	int get_src_format();
+	unsigned int get_rotation();
 	void close();
   private:
      C2DColorConverterBase *c2dcc;
     void *mLibHandle;
 	ColorConvertFormat src_format;
+    unsigned int rotation;
     createC2DColorConverter_t *mConvertOpen;
     destroyC2DColorConverter_t *mConvertClose;
   };
@@ -204,6 +216,8 @@ public:
   virtual bool dev_empty_buf(void *, void *,unsigned,unsigned) = 0;
   virtual bool dev_fill_buf(void *buffer, void *,unsigned,unsigned) = 0;
   virtual bool dev_get_buf_req(OMX_U32 *,OMX_U32 *,OMX_U32 *,OMX_U32) = 0;
+  virtual bool dev_set_config(void *, OMX_INDEXTYPE) = 0;
+  virtual bool dev_set_session_qp(OMX_VIDEO_PARAM_QUANTIZATIONTYPE *) = 0;
   virtual bool dev_get_seq_hdr(void *, unsigned, unsigned *) = 0;
   virtual bool dev_loaded_start(void) = 0;
   virtual bool dev_loaded_stop(void) = 0;
@@ -463,6 +477,22 @@ public:
                                         OMX_BUFFERHEADERTYPE *buffer);
   OMX_ERRORTYPE empty_this_buffer_opaque(OMX_HANDLETYPE hComp,
                                   OMX_BUFFERHEADERTYPE *buffer);
+  OMX_ERRORTYPE queue_input_buffer(OMX_HANDLETYPE hComp,
+                                   OMX_BUFFERHEADERTYPE *buffer,
+                                   unsigned nBufIndex);
+  OMX_ERRORTYPE lookahead_queue_buffer(OMX_HANDLETYPE hComp,
+                                       OMX_BUFFERHEADERTYPE *buffer);
+  void lookahead_apply_decision(venc_lookahead_decision *decision);
+  OMX_U32 input_luma_stride();
+  bool frc_drop_frame(OMX_BUFFERHEADERTYPE *buffer, unsigned nBufIndex);
+  void frc_queue_repeats(OMX_BUFFERHEADERTYPE *buffer, unsigned nBufIndex,
+                         OMX_U8 *pmem_data_buf);
+  void scene_cut_check(OMX_BUFFERHEADERTYPE *buffer, unsigned nBufIndex);
+  const OMX_U8 *scene_map_luma(int fd, unsigned offset, unsigned size,
+                               void **map, unsigned *map_size);
+  bool scene_can_own_gop();
+  void scene_gop_release();
+  bool request_intra_vop();
   OMX_ERRORTYPE push_input_buffer(OMX_HANDLETYPE hComp);
   OMX_ERRORTYPE convert_queue_buffer(OMX_HANDLETYPE hComp,
      struct pmem &Input_pmem_info,unsigned &index);
@@ -541,6 +571,29 @@ public:
   QOMX_VIDEO_INTRAPERIODTYPE m_sIntraperiod;
   OMX_VIDEO_PARAM_ERRORCORRECTIONTYPE m_sErrorCorrection;
   OMX_VIDEO_PARAM_INTRAREFRESHTYPE m_sIntraRefresh;
+  OMX_QCOM_VIDEO_CONFIG_ROIINFO m_sConfigROIInfo;
+  OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE m_sParamLookAhead;
+  venc_lookahead m_lookahead;
+  // bitrate scale currently programmed by the look-ahead, 256 == 1.0
+  unsigned m_lookahead_bitrate_q8;
+  // QP offset currently programmed by the look-ahead in fixed QP sessions
+  int m_lookahead_qp_delta;
+  OMX_QCOM_VIDEO_PARAM_FRCTYPE m_sParamFRC;
+  bool m_frc_started;
+  // timestamp of the next output slot
+  OMX_TICKS m_frc_next_ts;
+  struct frc_repeat_info
+  {
+    OMX_U32 count;        // repeats to queue ahead of the frame
+    OMX_U32 outstanding;  // repeats the device has not returned yet
+    OMX_TICKS interval;   // timestamp step between submissions
+  } m_frc_repeat[OMX_FRC_MAX_INPUT_BUFFERS];
+  OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE m_sParamSceneCut;
+  venc_scene_detect m_scene_detect;
+  // with bResetGOP the periodic IDRs are requested by the component,
+  // counting the frames queued since and including the last IDR
+  bool m_scene_owns_gop;
+  OMX_U32 m_scene_gop_frames;
   OMX_U32 m_sExtraData;
   OMX_U32 m_sDebugSliceinfo;
   OMX_U32 m_input_msg_id;
@@ -73,7 +73,10 @@ private:
   bool dev_fill_buf(void *, void *,unsigned,unsigned);
   bool dev_get_buf_req(OMX_U32 *,OMX_U32 *,OMX_U32 *,OMX_U32);
   bool dev_set_buf_req(OMX_U32 *,OMX_U32 *,OMX_U32 *,OMX_U32);
+  bool dev_set_config(void *, OMX_INDEXTYPE);
+  bool dev_set_session_qp(OMX_VIDEO_PARAM_QUANTIZATIONTYPE *);
   bool update_profile_level();
+  bool validate_roi_info(OMX_QCOM_VIDEO_CONFIG_ROIINFO *roi);
   bool dev_get_seq_hdr(void *, unsigned, unsigned *);
   bool dev_loaded_start(void);
   bool dev_loaded_stop(void);
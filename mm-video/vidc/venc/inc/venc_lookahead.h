@@ -0,0 +1,94 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VENC_LOOKAHEAD_H__
+#define __VENC_LOOKAHEAD_H__
+
+#include <stdlib.h>
+#include "OMX_Core.h"
+
+/* Maximum number of future frames the look-ahead can analyse */
+#define VENC_LOOKAHEAD_MAX_FRAMES 16
+/* Luma is reduced to one sample per (1 << SHIFT) square block */
+#define VENC_LOOKAHEAD_SCALE_SHIFT 3
+
+struct venc_lookahead_decision
+{
+  bool force_idr;       /* frame starts a new scene */
+  unsigned bitrate_q8;  /* target bitrate scale, 256 keeps the configured rate */
+  int qp_delta;         /* the same scale as a QP offset, for fixed QP sessions */
+};
+
+/* Holds input frames ahead of the encoder and rates each one with the
+   SAD between downscaled luma planes of consecutive frames. All calls are
+   made from the component message thread, no locking is done here. */
+class venc_lookahead
+{
+public:
+  venc_lookahead();
+  ~venc_lookahead();
+  bool init(unsigned width, unsigned height, unsigned frames);
+  void deinit();
+  void reset();
+  bool is_initialized() { return thumb[0] != NULL; }
+  bool push(OMX_BUFFERHEADERTYPE *buffer, const unsigned char *luma,
+            unsigned stride);
+  OMX_BUFFERHEADERTYPE *pop(venc_lookahead_decision *decision);
+  unsigned size() { return count; }
+  bool full() { return count >= capacity; }
+
+private:
+  struct entry
+  {
+    OMX_BUFFERHEADERTYPE *buffer;
+    unsigned cost;
+    bool scene_cut;
+  };
+  void downscale(const unsigned char *luma, unsigned stride,
+                 unsigned char *dst);
+  unsigned frame_cost(const unsigned char *cur, const unsigned char *prev);
+
+  entry queue[VENC_LOOKAHEAD_MAX_FRAMES + 1];
+  unsigned head;
+  unsigned count;
+  unsigned capacity;
+  unsigned thumb_width;
+  unsigned thumb_height;
+  unsigned char *thumb[2];
+  unsigned cur_thumb;
+  bool have_prev;
+  /* Q4 running averages of the per sample cost: short term for scene cut
+     detection, long term as the reference for bitrate scaling */
+  unsigned short_cost;
+  unsigned long_cost;
+  unsigned frames_since_cut;
+  /* sum of (bitrate_q8 - 256) handed out so far, paid back over the
+     following window so that the scaling averages out to the target */
+  int bitrate_debt_q8;
+};
+
+#endif // __VENC_LOOKAHEAD_H__
@@ -0,0 +1,66 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#ifndef __VENC_SCENE_DETECT_H__
+#define __VENC_SCENE_DETECT_H__
+
+/* Luma histogram bins, one per 8 code values */
+#define VENC_SCENE_HIST_BINS 32
+/* Largest histogram difference, two completely disjoint frames */
+#define VENC_SCENE_MAX_DIFF 512
+
+/* Scene cut detector working on a subsampled luma histogram. Comparing
+   histograms instead of pixels keeps camera and object motion from
+   looking like cuts. Only every 4th row and every 2nd column are read,
+   so a frame costs 1/8 of its luma samples. With NEON the bins are
+   counted with per-bin compares on 16 samples at a time. */
+class venc_scene_detect
+{
+public:
+  venc_scene_detect();
+  void reset();
+  /* true if the frame starts a new scene, threshold is in units of
+     VENC_SCENE_MAX_DIFF */
+  bool analyze(const unsigned char *luma, unsigned width, unsigned height,
+               unsigned stride, unsigned threshold);
+  /* subsampled luma histogram, NEON when available */
+  static void histogram(const unsigned char *luma, unsigned width,
+                        unsigned height, unsigned stride, unsigned *hist);
+  /* plain C version of the same, the reference for the NEON one */
+  static void histogram_c(const unsigned char *luma, unsigned width,
+                          unsigned height, unsigned stride, unsigned *hist);
+
+private:
+
+  unsigned hist[2][VENC_SCENE_HIST_BINS];
+  unsigned cur;
+  bool have_prev;
+  unsigned avg_diff;
+  unsigned frames_since_cut;
+};
+
+#endif // __VENC_SCENE_DETECT_H__
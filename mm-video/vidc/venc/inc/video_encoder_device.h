@@ -126,6 +126,16 @@ private:
   struct venc_headerextension     hec;
   struct venc_voptimingcfg        voptimecfg;
   struct venc_seqheader           seqhdr;
+#ifdef VEN_IOCTL_SET_QP_MAP
+  /* per-MB QP delta map, rebuilt only when the ROI config changes and
+     pushed to the driver with the next frame */
+  OMX_S8                          *roi_qp_map;
+  unsigned long                   roi_qp_map_size;
+  bool                            roi_qp_map_dirty;
+  bool                            roi_enabled;
+  bool                            roi_probed;
+  pthread_mutex_t                 roi_lock;
+#endif
 
   bool venc_set_profile_level(OMX_U32 eProfile,OMX_U32 eLevel);
   bool venc_set_intra_period(OMX_U32 nPFrames, OMX_U32 nBFrames);
@@ -147,6 +157,10 @@ private:
   bool venc_set_slice_delivery_mode(OMX_BOOL enable);
   bool venc_set_inband_video_header(OMX_BOOL enable);
   bool venc_set_bitstream_restrict_in_vui(OMX_BOOL enable);
+#ifdef VEN_IOCTL_SET_QP_MAP
+  bool venc_set_roi_info(OMX_QCOM_VIDEO_CONFIG_ROIINFO *roi_info);
+  bool venc_send_roi_qp_map();
+#endif
 #ifdef MAX_RES_1080P
   OMX_U32 pmem_free();
   OMX_U32 pmem_allocate(OMX_U32 size, OMX_U32 alignment, OMX_U32 count);
@@ -78,6 +78,9 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #define IS_NOT_ALIGNED( num, to) (num & (to-1))
 #define ALIGN( num, to ) (((num) + (to-1)) & (~(to-1)))
+/* Device intra period while scene cut detection drives the GOP, only
+   used when the client's period is a plain IDR/P pattern */
+#define VENC_SCENE_DEVICE_PFRAMES 0xFFFF
 #define SZ_2K (2048)
 
 typedef struct OMXComponentCapabilityFlagsType
@@ -252,10 +255,17 @@ omx_video::omx_video(): m_state(OMX_StateInvalid),
                         psource_frame(NULL),
                         pdest_frame(NULL),
                         c2d_opened(false),
-                        secure_session(false)
+                        secure_session(false),
+                        m_lookahead_bitrate_q8(256),
+                        m_lookahead_qp_delta(0),
+                        m_frc_started(false),
+                        m_frc_next_ts(0),
+                        m_scene_owns_gop(false),
+                        m_scene_gop_frames(0)
 {
   DEBUG_PRINT_HIGH("\n omx_video(): Inside Constructor()");
   memset(&m_cmp,0,sizeof(m_cmp));
+  memset(m_frc_repeat,0,sizeof(m_frc_repeat));
   memset(&m_pCallbacks,0,sizeof(m_pCallbacks));
   secure_color_format = (int) OMX_COLOR_FormatYUV420SemiPlanar;
   pthread_mutex_init(&m_lock, NULL);
@@ -1403,6 +1413,20 @@ bool omx_video::execute_input_flush(void)
       m_pCallbacks.EmptyBufferDone(&m_cmp,m_app_data,(OMX_BUFFERHEADERTYPE *)p2);
     }
   }
+  /*Frames held by the look-ahead were already counted as pending*/
+  while(m_lookahead.size())
+  {
+    empty_buffer_done(&m_cmp,m_lookahead.pop(NULL));
+  }
+  m_lookahead.reset();
+  m_scene_detect.reset();
+  if(m_sParamFRC.bEnable)
+  {
+    DEBUG_PRINT_HIGH("\n FRC at i/p flush: dropped %u (overload %u), "
+        "duplicated %u", m_sParamFRC.nFramesDropped,
+        m_sParamFRC.nFramesDroppedOverload, m_sParamFRC.nFramesDuplicated);
+    m_frc_started = false;
+  }
   if(mUseProxyColorFormat) {
     if(psource_frame) {
       m_pCallbacks.EmptyBufferDone(&m_cmp,m_app_data,psource_frame);
@@ -1769,6 +1793,30 @@ OMX_ERRORTYPE  omx_video::get_parameter(OMX_IN OMX_HANDLETYPE     hComp,
       intrarefresh->nCirMBs = m_sIntraRefresh.nCirMBs;
       break;
     }
+  case OMX_QcomIndexParamVideoLookAhead:
+    {
+      DEBUG_PRINT_LOW("get_parameter: OMX_QcomIndexParamVideoLookAhead\n");
+      OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE* pParam =
+        reinterpret_cast<OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE*>(paramData);
+      memcpy(pParam, &m_sParamLookAhead, sizeof(m_sParamLookAhead));
+      break;
+    }
+  case OMX_QcomIndexParamVideoFrameRateConversion:
+    {
+      DEBUG_PRINT_LOW("get_parameter: OMX_QcomIndexParamVideoFrameRateConversion\n");
+      OMX_QCOM_VIDEO_PARAM_FRCTYPE* pParam =
+        reinterpret_cast<OMX_QCOM_VIDEO_PARAM_FRCTYPE*>(paramData);
+      memcpy(pParam, &m_sParamFRC, sizeof(m_sParamFRC));
+      break;
+    }
+  case OMX_QcomIndexParamVideoSceneCutDetection:
+    {
+      DEBUG_PRINT_LOW("get_parameter: OMX_QcomIndexParamVideoSceneCutDetection\n");
+      OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE* pParam =
+        reinterpret_cast<OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE*>(paramData);
+      memcpy(pParam, &m_sParamSceneCut, sizeof(m_sParamSceneCut));
+      break;
+    }
   case OMX_QcomIndexPortDefn:
     //TODO
     break;
@@ -1898,6 +1946,7 @@ OMX_ERRORTYPE  omx_video::get_config(OMX_IN OMX_HANDLETYPE      hComp,
   // OMX_IndexConfigVideoBitrate      OMX_VIDEO_CONFIG_BITRATETYPE
   // OMX_IndexConfigVideoFramerate    OMX_CONFIG_FRAMERATETYPE
   // OMX_IndexConfigCommonRotate      OMX_CONFIG_ROTATIONTYPE
+  // OMX_QcomIndexConfigVideoROIInfo  OMX_QCOM_VIDEO_CONFIG_ROIINFO
   ////////////////////////////////////////////////////////////////
 
   if(configData == NULL)
@@ -1940,6 +1989,16 @@ OMX_ERRORTYPE  omx_video::get_config(OMX_IN OMX_HANDLETYPE      hComp,
       memcpy(pParam, &m_sIntraperiod, sizeof(m_sIntraperiod));
       break;
     }
+  case OMX_QcomIndexConfigVideoROIInfo:
+    {
+      DEBUG_PRINT_LOW("get_config:OMX_QcomIndexConfigVideoROIInfo\n");
+      OMX_QCOM_VIDEO_CONFIG_ROIINFO* pParam =
+        reinterpret_cast<OMX_QCOM_VIDEO_CONFIG_ROIINFO*>(configData);
+      // the QP map is owned by the device and is not read back
+      memcpy(pParam, &m_sConfigROIInfo,
+             offsetof(OMX_QCOM_VIDEO_CONFIG_ROIINFO, nQPMap));
+      break;
+    }
   default:
     DEBUG_PRINT_ERROR("ERROR: unsupported index %d", (int) configIndex);
     return OMX_ErrorUnsupportedIndex;
@@ -1970,7 +2029,11 @@ OMX_ERRORTYPE  omx_video::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
     "OMX.QCOM.index.param.SliceDeliveryMode",
     "OMX.google.android.index.storeMetaDataInBuffers",
     "OMX.google.android.index.prependSPSPPSToIDRFrames",
-    "OMX.google.android.index.setVUIStreamRestrictFlag"
+    "OMX.google.android.index.setVUIStreamRestrictFlag",
+    OMX_QCOM_INDEX_CONFIG_VIDEO_ROIINFO,
+    OMX_QCOM_INDEX_PARAM_VIDEO_LOOKAHEAD,
+    OMX_QCOM_INDEX_PARAM_VIDEO_FRAMERATECONVERSION,
+    OMX_QCOM_INDEX_PARAM_VIDEO_SCENECUTDETECTION
   };
 
   if(m_state == OMX_StateInvalid)
@@ -1984,6 +2047,22 @@ OMX_ERRORTYPE  omx_video::get_extension_index(OMX_IN OMX_HANDLETYPE      hComp,
     return OMX_ErrorNone;
   }
 #endif
+  if (!strncmp(paramName, extns[4], strlen(extns[4]))) {
+    *indexType = (OMX_INDEXTYPE)OMX_QcomIndexConfigVideoROIInfo;
+    return OMX_ErrorNone;
+  }
+  if (!strncmp(paramName, extns[5], strlen(extns[5]))) {
+    *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoLookAhead;
+    return OMX_ErrorNone;
+  }
+  if (!strncmp(paramName, extns[6], strlen(extns[6]))) {
+    *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoFrameRateConversion;
+    return OMX_ErrorNone;
+  }
+  if (!strncmp(paramName, extns[7], strlen(extns[7]))) {
+    *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoSceneCutDetection;
+    return OMX_ErrorNone;
+  }
 #ifdef _ANDROID_ICS_
   if (!strncmp(paramName, extns[1], strlen(extns[1]))) {
         *indexType = (OMX_INDEXTYPE)OMX_QcomIndexParamVideoEncodeMetaBufferMode;
@@ -3348,10 +3427,7 @@ RETURN VALUE
 OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE         hComp,
                                                   OMX_IN OMX_BUFFERHEADERTYPE* buffer)
 {
-  OMX_U8 *pmem_data_buf = NULL;
-  int push_cnt = 0;
   unsigned nBufIndex = 0,nBufIndex_meta = 0;
-  OMX_ERRORTYPE ret = OMX_ErrorNone;
 
   DEBUG_PRINT_LOW("\n ETBProxy: buffer[%p]\n", buffer);
 
@@ -3378,6 +3454,52 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE
     DEBUG_PRINT_ERROR("\nERROR: ETBProxy: Input flush in progress");
     return OMX_ErrorNone;
   }
+  // opaque input has been through frc_drop_frame before conversion
+  if(m_sParamFRC.bEnable && !mUseProxyColorFormat &&
+     frc_drop_frame(buffer, nBufIndex))
+  {
+    empty_buffer_done(&m_cmp, buffer);
+    return OMX_ErrorNone;
+  }
+  if(m_sParamLookAhead.bEnable
+#ifdef _ANDROID_ICS_
+     && !meta_mode_enable
+#endif
+     )
+  {
+    return lookahead_queue_buffer(hComp, buffer);
+  }
+  return queue_input_buffer(hComp, buffer, nBufIndex);
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::queue_input_buffer
+
+DESCRIPTION
+  Hands an input frame over to the device, copying or realigning it
+  first when the buffer mode requires it.
+
+PARAMETERS
+  hComp     - component handle
+  buffer    - input buffer header
+  nBufIndex - index of the buffer in the input buffer table
+
+RETURN VALUE
+  OMX Error None if everything went successful.
+
+========================================================================== */
+OMX_ERRORTYPE omx_video::queue_input_buffer(OMX_HANDLETYPE hComp,
+                                            OMX_BUFFERHEADERTYPE *buffer,
+                                            unsigned nBufIndex)
+{
+  OMX_U8 *pmem_data_buf = NULL;
+  OMX_ERRORTYPE ret = OMX_ErrorNone;
+
+  if(m_sParamSceneCut.bEnable)
+  {
+    scene_cut_check(buffer, nBufIndex);
+  }
 #ifdef _ANDROID_ICS_
   if(meta_mode_enable && !mUseProxyColorFormat)
   {
@@ -3411,6 +3533,8 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE
       post_event ((unsigned int)buffer,0,OMX_COMPONENT_GENERATE_EBD);
       return OMX_ErrorBadParameter;
     }
+    /* Without the opaque color format there is no converter stage, so a
+       rotated session expects frames that the client already rotated */
 
     struct pmem Input_pmem_info;
     if(media_buffer->buffer_type == kMetadataBufferTypeCameraSource)
@@ -3475,6 +3599,8 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE
           }
       }
   }
+  if(m_sParamFRC.bEnable)
+    frc_queue_repeats(buffer, nBufIndex, pmem_data_buf);
 #ifdef _COPPER_
   if(dev_empty_buf(buffer, pmem_data_buf,nBufIndex,m_pInput_pmem[nBufIndex].fd) != true)
 #else
@@ -3494,6 +3620,581 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_proxy(OMX_IN OMX_HANDLETYPE
   return ret;
 }
 
+/* ======================================================================
+FUNCTION
+  omx_video::lookahead_queue_buffer
+
+DESCRIPTION
+  Adds an input frame to the look-ahead queue and encodes the oldest
+  queued frame once enough future frames have been analysed. An EOS
+  frame drains the whole queue.
+
+PARAMETERS
+  hComp  - component handle
+  buffer - input buffer header
+
+RETURN VALUE
+  OMX Error None if everything went successful.
+
+========================================================================== */
+OMX_ERRORTYPE omx_video::lookahead_queue_buffer(OMX_HANDLETYPE hComp,
+                                                OMX_BUFFERHEADERTYPE *buffer)
+{
+  OMX_U32 width = m_sInPortDef.format.video.nFrameWidth;
+  OMX_U32 height = m_sInPortDef.format.video.nFrameHeight;
+  OMX_U32 stride = input_luma_stride();
+  OMX_ERRORTYPE ret = OMX_ErrorNone;
+  const OMX_U8 *luma = NULL;
+  bool eos = (buffer->nFlags & OMX_BUFFERFLAG_EOS) ? true : false;
+
+  if(!m_lookahead.is_initialized())
+  {
+    // the client's buffers are all we have, keep one of them free so
+    // that it can always queue the frame which releases the oldest one
+    OMX_U32 frames = m_sParamLookAhead.nLookAheadFrames;
+    if(frames >= m_sInPortDef.nBufferCountActual)
+      frames = m_sInPortDef.nBufferCountActual - 1;
+    if(!frames || !m_lookahead.init(width, height, frames))
+    {
+      DEBUG_PRINT_ERROR("\nERROR: look-ahead init failed (frames %u, "
+          "buffers %u), encoding without it",
+          m_sParamLookAhead.nLookAheadFrames,
+          m_sInPortDef.nBufferCountActual);
+      m_sParamLookAhead.bEnable = OMX_FALSE;
+      return queue_input_buffer(hComp, buffer,
+                                buffer - m_inp_mem_ptr);
+    }
+    DEBUG_PRINT_HIGH("\n look-ahead enabled with %u frames", frames);
+  }
+
+  if(!(buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG) &&
+     buffer->nFilledLen >= stride * height)
+  {
+    luma = buffer->pBuffer + buffer->nOffset;
+  }
+  m_lookahead.push(buffer, luma, stride);
+
+  while(m_lookahead.size() && (m_lookahead.full() || eos))
+  {
+    venc_lookahead_decision decision;
+    OMX_BUFFERHEADERTYPE *next = m_lookahead.pop(&decision);
+
+    lookahead_apply_decision(&decision);
+    ret = queue_input_buffer(hComp, next, next - m_inp_mem_ptr);
+    if(ret != OMX_ErrorNone)
+    {
+      // the failed frame has been returned, the rest go out with the
+      // next flush
+      break;
+    }
+  }
+  return ret;
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::frc_drop_frame
+
+DESCRIPTION
+  Frame rate conversion of the input. Decides from the buffer timestamp
+  and the number of input buffers waiting for the device whether a frame
+  is encoded. For a frame following a gap it records how many repeats
+  queue_input_buffer has to submit into the empty slots ahead of it.
+  Runs before any color conversion, so dropped frames cost nothing.
+
+PARAMETERS
+  buffer    - input buffer header
+  nBufIndex - index of the buffer in the input buffer table
+
+RETURN VALUE
+  true if the frame has to be dropped.
+
+========================================================================== */
+bool omx_video::frc_drop_frame(OMX_BUFFERHEADERTYPE *buffer, unsigned nBufIndex)
+{
+  OMX_TICKS ts = buffer->nTimeStamp;
+  OMX_TICKS interval;
+  OMX_TICKS slots;
+  int held = pending_input_buffers;
+
+  if((buffer->nFlags & (OMX_BUFFERFLAG_EOS | OMX_BUFFERFLAG_CODECCONFIG)) ||
+     !m_sConfigFramerate.xEncodeFramerate)
+  {
+    return false;
+  }
+
+#ifdef _ANDROID_ICS_
+  if(mUseProxyColorFormat)
+  {
+    // ahead of the conversion: count this frame and the ones waiting
+    // to be converted
+    held += 1 + m_opq_meta_q.m_size + (psource_frame ? 1 : 0);
+  }
+  else
+#endif
+  {
+    // pending_input_buffers already includes this frame, the ones parked
+    // in the look-ahead are not waiting for the device
+    held -= (int)m_lookahead.size();
+  }
+  if(m_sParamFRC.nDropWatermark && held > (int)m_sParamFRC.nDropWatermark)
+  {
+    m_sParamFRC.nFramesDroppedOverload++;
+    DEBUG_PRINT_LOW("\n FRC: dropping ts %lld, %d buffers held", ts, held);
+    return true;
+  }
+
+  interval = ((OMX_TICKS)1000000 << 16) / m_sConfigFramerate.xEncodeFramerate;
+  // restart on the first frame and whenever the timeline jumps
+  if(!m_frc_started || ts < m_frc_next_ts - 4 * interval ||
+     ts > m_frc_next_ts + 1000000)
+  {
+    m_frc_started = true;
+    m_frc_next_ts = ts + interval;
+    return false;
+  }
+
+  if(ts + interval / 2 < m_frc_next_ts)
+  {
+    m_sParamFRC.nFramesDropped++;
+    DEBUG_PRINT_LOW("\n FRC: dropping ts %lld, next slot %lld",
+        ts, m_frc_next_ts);
+    return true;
+  }
+
+  // slots left empty since the previous frame
+  slots = (ts - m_frc_next_ts + interval / 2) / interval;
+  m_frc_next_ts += (slots + 1) * interval;
+
+  // V4L2 does not take a buffer that is already queued, so repeats are
+  // only issued to the msm_vidc_enc device
+#ifndef _COPPER_
+  if(slots > 0 && m_sParamFRC.bAllowDuplicate && !m_sParamLookAhead.bEnable &&
+#ifdef _ANDROID_ICS_
+     !meta_mode_enable &&
+#endif
+     nBufIndex < OMX_FRC_MAX_INPUT_BUFFERS)
+  {
+    if(slots > OMX_FRC_MAX_REPEAT)
+      slots = OMX_FRC_MAX_REPEAT;
+    m_frc_repeat[nBufIndex].count = (OMX_U32)slots;
+    m_frc_repeat[nBufIndex].interval = interval;
+  }
+#endif
+  return false;
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::frc_queue_repeats
+
+DESCRIPTION
+  Submits the repeats frc_drop_frame asked for, right before the frame
+  itself is queued. They carry the timestamps of the empty slots ahead of
+  the frame, the frame keeps its own. Each repeat comes back through
+  empty_buffer_done, which only returns the buffer to the client with
+  the last of its submissions.
+
+PARAMETERS
+  buffer        - input buffer header
+  nBufIndex     - index of the buffer in the input buffer table
+  pmem_data_buf - device copy of the pixels for heap buffers
+
+RETURN VALUE
+  None.
+
+========================================================================== */
+void omx_video::frc_queue_repeats(OMX_BUFFERHEADERTYPE *buffer,
+                                  unsigned nBufIndex, OMX_U8 *pmem_data_buf)
+{
+  struct frc_repeat_info *repeat;
+  OMX_TICKS ts = buffer->nTimeStamp;
+
+  if(nBufIndex >= OMX_FRC_MAX_INPUT_BUFFERS)
+    return;
+  repeat = &m_frc_repeat[nBufIndex];
+  while(repeat->count)
+  {
+    buffer->nTimeStamp = ts - repeat->count * repeat->interval;
+#ifdef _COPPER_
+    if(dev_empty_buf(buffer, pmem_data_buf,nBufIndex,m_pInput_pmem[nBufIndex].fd) != true)
+#else
+    if(dev_empty_buf(buffer, pmem_data_buf,0,0) != true)
+#endif
+    {
+      DEBUG_PRINT_ERROR("\nERROR: FRC: repeat at ts %lld failed",
+          buffer->nTimeStamp);
+      repeat->count = 0;
+      break;
+    }
+    repeat->count--;
+    repeat->outstanding++;
+    if(m_scene_owns_gop)
+      m_scene_gop_frames++;
+    m_sParamFRC.nFramesDuplicated++;
+  }
+  buffer->nTimeStamp = ts;
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::request_intra_vop
+
+DESCRIPTION
+  Asks the device to encode the next queued frame as an IDR frame.
+
+PARAMETERS
+  None.
+
+RETURN VALUE
+  true/false
+
+========================================================================== */
+bool omx_video::request_intra_vop()
+{
+  OMX_CONFIG_INTRAREFRESHVOPTYPE intra_vop;
+
+  memset(&intra_vop, 0, sizeof(intra_vop));
+  intra_vop.nSize = sizeof(intra_vop);
+  intra_vop.nVersion.nVersion = OMX_SPEC_VERSION;
+  intra_vop.nPortIndex = (OMX_U32)PORT_INDEX_OUT;
+  intra_vop.IntraRefreshVOP = OMX_TRUE;
+  return dev_set_config(&intra_vop, OMX_IndexConfigVideoIntraVOPRefresh);
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::scene_map_luma
+
+DESCRIPTION
+  Maps the luma plane of a meta buffer read-only for scene cut detection.
+  The mapping only lives for the frame being checked: the client owns
+  the fd and may close it, and the number may come back for another
+  buffer, once the frame is returned.
+
+PARAMETERS
+  fd       - fd of the buffer
+  offset   - offset of the luma plane inside the buffer
+  size     - bytes needed from the offset
+  map      - set to the mapping to munmap after use
+  map_size - set to its length
+
+RETURN VALUE
+  Pointer to the luma plane, NULL on failure.
+
+========================================================================== */
+const OMX_U8 *omx_video::scene_map_luma(int fd, unsigned offset, unsigned size,
+                                        void **map, unsigned *map_size)
+{
+  unsigned page = (unsigned)sysconf(_SC_PAGESIZE);
+  unsigned start = offset & ~(page - 1);
+
+  *map_size = offset - start + size;
+  *map = mmap(NULL, *map_size, PROT_READ, MAP_SHARED, fd, start);
+  if(*map == MAP_FAILED)
+  {
+    DEBUG_PRINT_ERROR("\nERROR: scene cut: mmap of fd %d failed", fd);
+    *map = NULL;
+    return NULL;
+  }
+  return (const OMX_U8 *)*map + (offset - start);
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::scene_can_own_gop
+
+DESCRIPTION
+  Tells whether the component can request the periodic IDRs in place of
+  the device without changing the stream the client asked for. That is
+  only the case for a finite period of P frames where every intra frame
+  is an IDR; B frames and I frames between IDRs stay with the device.
+
+PARAMETERS
+  None.
+
+RETURN VALUE
+  true/false
+
+========================================================================== */
+bool omx_video::scene_can_own_gop()
+{
+  return m_sIntraperiod.nBFrames == 0 &&
+         m_sIntraperiod.nPFrames < VENC_SCENE_DEVICE_PFRAMES &&
+         m_sIntraperiod.nIDRPeriod <= 1;
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::scene_gop_release
+
+DESCRIPTION
+  Hands the intra period back to the device after scene cut detection
+  stopped resetting the GOP.
+
+PARAMETERS
+  None.
+
+RETURN VALUE
+  None.
+
+========================================================================== */
+void omx_video::scene_gop_release()
+{
+  if(!m_scene_owns_gop)
+    return;
+  m_scene_owns_gop = false;
+  if(!dev_set_config(&m_sIntraperiod,
+                     (OMX_INDEXTYPE)QOMX_IndexConfigVideoIntraperiod))
+  {
+    DEBUG_PRINT_ERROR("\nERROR: scene cut: restoring intra period failed");
+  }
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::scene_cut_check
+
+DESCRIPTION
+  Runs scene cut detection on an input frame about to be queued to the
+  device and requests an IDR for it on a cut.
+
+  Reprogramming the intra period does not restart the device GOP, so
+  with bResetGOP the device period is pushed out of the way and the
+  periodic IDRs are requested from here, counting from the last IDR.
+
+PARAMETERS
+  buffer    - input buffer header
+  nBufIndex - index of the buffer in the input buffer table
+
+RETURN VALUE
+  None.
+
+========================================================================== */
+void omx_video::scene_cut_check(OMX_BUFFERHEADERTYPE *buffer, unsigned nBufIndex)
+{
+  OMX_U32 width = m_sInPortDef.format.video.nFrameWidth;
+  OMX_U32 height = m_sInPortDef.format.video.nFrameHeight;
+  OMX_U32 stride = input_luma_stride();
+  unsigned long long gop;
+  const OMX_U8 *luma = NULL;
+  void *map = NULL;
+  unsigned map_size = 0;
+  bool idr = false;
+
+  if(!buffer->nFilledLen ||
+     (buffer->nFlags & OMX_BUFFERFLAG_CODECCONFIG))
+  {
+    return;
+  }
+  if(m_sParamSceneCut.bResetGOP && !m_scene_owns_gop &&
+     !scene_can_own_gop())
+  {
+    DEBUG_PRINT_HIGH("\n scene cut: intra period P %u B %u IDR %u stays "
+        "with the device, GOP is not reset on cuts",
+        m_sIntraperiod.nPFrames, m_sIntraperiod.nBFrames,
+        m_sIntraperiod.nIDRPeriod);
+    m_sParamSceneCut.bResetGOP = OMX_FALSE;
+  }
+  if(m_sParamSceneCut.bResetGOP && !m_scene_owns_gop)
+  {
+    QOMX_VIDEO_INTRAPERIODTYPE period = m_sIntraperiod;
+
+    period.nPFrames = VENC_SCENE_DEVICE_PFRAMES;
+    if(dev_set_config(&period, (OMX_INDEXTYPE)QOMX_IndexConfigVideoIntraperiod))
+    {
+      m_scene_owns_gop = true;
+      m_scene_gop_frames = 0;
+    }
+    else
+    {
+      DEBUG_PRINT_ERROR("\nERROR: scene cut: cannot take over the intra "
+          "period, GOP is not reset on cuts");
+      m_sParamSceneCut.bResetGOP = OMX_FALSE;
+    }
+  }
+#ifdef _ANDROID_ICS_
+  if(mUseProxyColorFormat && nBufIndex < m_sInPortDef.nBufferCountActual)
+  {
+    // converted by C2D, possibly rotated
+    unsigned int c2d_width = 0, c2d_height = 0, c2d_stride = 0;
+
+    if(c2d_opened &&
+       c2d_conv.get_buffer_geometry(C2D_OUTPUT, c2d_width, c2d_height,
+                                    c2d_stride) &&
+       buffer->nFilledLen >= c2d_stride * c2d_height)
+    {
+      width = c2d_width;
+      height = c2d_height;
+      stride = c2d_stride;
+      luma = buffer->pBuffer + buffer->nOffset;
+    }
+  }
+  else if(meta_mode_enable)
+  {
+    encoder_media_buffer_type *media_buffer =
+      (encoder_media_buffer_type *)buffer->pBuffer;
+    int fd = -1;
+    unsigned offset = 0;
+
+    if(media_buffer && media_buffer->meta_handle)
+    {
+      if(media_buffer->buffer_type == kMetadataBufferTypeCameraSource &&
+         media_buffer->meta_handle->numFds == 1)
+      {
+        fd = media_buffer->meta_handle->data[0];
+        offset = media_buffer->meta_handle->data[1];
+      }
+      else if(media_buffer->buffer_type == kMetadataBufferTypeGrallocSource)
+      {
+        fd = ((private_handle_t *)media_buffer->meta_handle)->fd;
+      }
+    }
+    // NV12 from the camera and gralloc, luma rows padded to 16
+    stride = ALIGN(width, 16);
+    if(fd >= 0)
+      luma = scene_map_luma(fd, offset, stride * height, &map, &map_size);
+  }
+  else
+#endif
+  if(buffer->nFilledLen >= stride * height)
+  {
+    luma = buffer->pBuffer + buffer->nOffset;
+  }
+
+  if(luma && m_scene_detect.analyze(luma, width, height, stride,
+                                    m_sParamSceneCut.nThreshold))
+  {
+    m_sParamSceneCut.nFramesDetected++;
+    DEBUG_PRINT_HIGH("\n scene cut at ts %lld, requesting IDR",
+        buffer->nTimeStamp);
+    idr = true;
+  }
+  if(map)
+    munmap(map, map_size);
+  else if(m_scene_owns_gop)
+  {
+    gop = (unsigned long long)m_sIntraperiod.nPFrames +
+          m_sIntraperiod.nBFrames + 1;
+    idr = (m_scene_gop_frames >= gop);
+  }
+  if(idr)
+  {
+    if(!request_intra_vop())
+    {
+      DEBUG_PRINT_ERROR("\nERROR: scene cut IDR request failed");
+    }
+    else
+    {
+      m_scene_gop_frames = 1;
+      return;
+    }
+  }
+  m_scene_gop_frames++;
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::lookahead_apply_decision
+
+DESCRIPTION
+  Programs the device with the frame type and bitrate chosen by the
+  look-ahead for the frame about to be queued. Without rate control
+  the bitrate scale is applied as an offset to the session QP.
+
+PARAMETERS
+  decision - look-ahead result for the frame
+
+RETURN VALUE
+  None.
+
+========================================================================== */
+void omx_video::lookahead_apply_decision(venc_lookahead_decision *decision)
+{
+  if(decision->force_idr && m_sParamLookAhead.bSceneCutIDR)
+  {
+    DEBUG_PRINT_LOW("\n look-ahead: scene cut, requesting IDR");
+    if(!request_intra_vop())
+    {
+      DEBUG_PRINT_ERROR("\nERROR: look-ahead IDR request failed");
+    }
+  }
+
+  if(m_sParamLookAhead.bAdaptiveBitrate &&
+     m_sParamBitrate.eControlRate != OMX_Video_ControlRateDisable &&
+     decision->bitrate_q8 != m_lookahead_bitrate_q8)
+  {
+    // the scale applies to the client's target, m_sConfigBitrate
+    // follows what the device has been programmed with
+    OMX_VIDEO_CONFIG_BITRATETYPE bitrate;
+    memcpy(&bitrate, &m_sConfigBitrate, sizeof(bitrate));
+    bitrate.nEncodeBitrate = (OMX_U32)(((unsigned long long)
+        m_sParamBitrate.nTargetBitrate * decision->bitrate_q8) >> 8);
+    DEBUG_PRINT_LOW("\n look-ahead: bitrate %u -> %u",
+        m_sConfigBitrate.nEncodeBitrate, bitrate.nEncodeBitrate);
+    if(dev_set_config(&bitrate, OMX_IndexConfigVideoBitrate))
+    {
+      m_lookahead_bitrate_q8 = decision->bitrate_q8;
+      m_sConfigBitrate.nEncodeBitrate = bitrate.nEncodeBitrate;
+    }
+    else
+    {
+      DEBUG_PRINT_ERROR("\nERROR: look-ahead bitrate update failed");
+    }
+  }
+
+  if(m_sParamLookAhead.bAdaptiveBitrate &&
+     m_sParamBitrate.eControlRate == OMX_Video_ControlRateDisable &&
+     decision->qp_delta != m_lookahead_qp_delta)
+  {
+    OMX_VIDEO_PARAM_QUANTIZATIONTYPE qp;
+    int max_qp = (m_sOutPortDef.format.video.eCompressionFormat ==
+                  OMX_VIDEO_CodingAVC) ? 51 : 31;
+    int qp_i = (int)m_sSessionQuantization.nQpI + decision->qp_delta;
+    int qp_p = (int)m_sSessionQuantization.nQpP + decision->qp_delta;
+    memcpy(&qp, &m_sSessionQuantization, sizeof(qp));
+    qp.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
+    qp.nQpI = (OMX_U32)(qp_i < 1 ? 1 : (qp_i > max_qp ? max_qp : qp_i));
+    qp.nQpP = (OMX_U32)(qp_p < 1 ? 1 : (qp_p > max_qp ? max_qp : qp_p));
+    DEBUG_PRINT_LOW("\n look-ahead: QP offset %d -> %d, I %u P %u",
+        m_lookahead_qp_delta, decision->qp_delta, qp.nQpI, qp.nQpP);
+    // m_sSessionQuantization keeps the client's values
+    if(dev_set_session_qp(&qp))
+    {
+      m_lookahead_qp_delta = decision->qp_delta;
+    }
+    else
+    {
+      DEBUG_PRINT_ERROR("\nERROR: look-ahead QP update failed");
+    }
+  }
+}
+
+/* ======================================================================
+FUNCTION
+  omx_video::input_luma_stride
+
+DESCRIPTION
+  Luma line pitch of the input frames. The client may pad the lines,
+  a stride below the frame width is not a valid layout and is ignored.
+
+PARAMETERS
+  None.
+
+RETURN VALUE
+  Stride in bytes.
+
+========================================================================== */
+OMX_U32 omx_video::input_luma_stride()
+{
+  OMX_U32 width = m_sInPortDef.format.video.nFrameWidth;
+  OMX_S32 stride = m_sInPortDef.format.video.nStride;
+
+  if(stride > 0 && (OMX_U32)stride >= width)
+    return (OMX_U32)stride;
+  return width;
+}
+
 /* ======================================================================
 FUNCTION
   omx_video::FillThisBuffer
@@ -4066,6 +4767,15 @@ OMX_ERRORTYPE omx_video::empty_buffer_done(OMX_HANDLETYPE         hComp,
     return OMX_ErrorBadParameter;
   }
 
+  // the client gets the buffer back with the last of its submissions
+  if(!mUseProxyColorFormat && buffer_index >= 0 &&
+     buffer_index < OMX_FRC_MAX_INPUT_BUFFERS &&
+     m_frc_repeat[buffer_index].outstanding)
+  {
+    m_frc_repeat[buffer_index].outstanding--;
+    return OMX_ErrorNone;
+  }
+
   pending_input_buffers--;
 
   if(mUseProxyColorFormat && (buffer_index < m_sInPortDef.nBufferCountActual)) {
@@ -4468,6 +5178,7 @@ omx_video::omx_c2d_conv::omx_c2d_conv()
   mConvertOpen = NULL;
   mConvertClose = NULL;
   src_format = NV12_2K;
+  rotation = 0;
 }
 
 bool omx_video::omx_c2d_conv::init() {
@@ -4512,14 +5223,27 @@ bool omx_video::omx_c2d_conv::convert(int src_fd, void *src_viraddr,
 }
 
 bool omx_video::omx_c2d_conv::open(unsigned int height,unsigned int width,
-     ColorConvertFormat src, ColorConvertFormat dest)
+     ColorConvertFormat src, ColorConvertFormat dest, unsigned int degrees)
 {
   bool status = false;
+  int flags = ROTATE_0;
+  unsigned int dst_width = width, dst_height = height;
+  if(degrees == 90 || degrees == 270) {
+    dst_width = height;
+    dst_height = width;
+  }
+  if(degrees == 90)
+    flags = ROTATE_90;
+  else if(degrees == 180)
+    flags = ROTATE_180;
+  else if(degrees == 270)
+    flags = ROTATE_270;
   if(!c2dcc) {
-     c2dcc = mConvertOpen(width, height, width, height,
-             src,dest,0);
+     c2dcc = mConvertOpen(width, height, dst_width, dst_height,
+             src,dest,flags);
      if(c2dcc) {
        src_format = src;
+       rotation = degrees;
        status = true;
      } else
        DEBUG_PRINT_ERROR("\n mConvertOpen failed");
@@ -4557,6 +5281,22 @@ int omx_video::omx_c2d_conv::get_src_format()
   }
   return format;
 }
+unsigned int omx_video::omx_c2d_conv::get_rotation()
+{
+  return rotation;
+}
+bool omx_video::omx_c2d_conv::get_buffer_geometry(int port,unsigned int &width,
+                                                  unsigned int &height,
+                                                  unsigned int &stride)
+{
+  C2DBuffReq bufferreq;
+  if(!c2dcc || c2dcc->getBuffReq(port,&bufferreq))
+    return false;
+  width = bufferreq.width;
+  height = bufferreq.height;
+  stride = bufferreq.stride;
+  return true;
+}
 bool omx_video::omx_c2d_conv::get_buffer_size(int port,unsigned int &buf_size)
 {
   int cret = 0;
@@ -4595,21 +5335,39 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_opaque(OMX_IN OMX_HANDLETYPE hComp,
     updated correctly*/
 
   if(buffer->nFilledLen > 0) {
-    if(c2d_opened && handle->format != c2d_conv.get_src_format()) {
+    /* Rotation is done in the same blit as the color conversion. NV12
+       sources, camera frames included, only go through the converter
+       when they need rotating. */
+    OMX_U32 rotation = m_sConfigFrameRotation.nRotation;
+    int format = (media_buffer->buffer_type == kMetadataBufferTypeCameraSource) ?
+                 HAL_PIXEL_FORMAT_NV12_ENCODEABLE : handle->format;
+    if(c2d_opened && (format != c2d_conv.get_src_format() ||
+                      rotation != c2d_conv.get_rotation())) {
       c2d_conv.close();
       c2d_opened = false;
     }
     if (!c2d_opened) {
-        if (handle->format == HAL_PIXEL_FORMAT_RGBA_8888) {
-          DEBUG_PRINT_ERROR("\n open Color conv for RGBA888");
-          if(!c2d_conv.open(m_sInPortDef.format.video.nFrameHeight,
-               m_sInPortDef.format.video.nFrameWidth,RGBA8888,NV12_2K)){
+        if (format == HAL_PIXEL_FORMAT_RGBA_8888 ||
+            (format == HAL_PIXEL_FORMAT_NV12_ENCODEABLE && rotation)) {
+          // port dimensions are already swapped for 90/270
+          OMX_U32 src_width = m_sInPortDef.format.video.nFrameWidth;
+          OMX_U32 src_height = m_sInPortDef.format.video.nFrameHeight;
+          if(rotation == 90 || rotation == 270) {
+            src_width = m_sInPortDef.format.video.nFrameHeight;
+            src_height = m_sInPortDef.format.video.nFrameWidth;
+          }
+          DEBUG_PRINT_HIGH("\n open Color conv for %s rotation %u",
+              (format == HAL_PIXEL_FORMAT_RGBA_8888)?"RGBA888":"NV12",
+              rotation);
+          if(!c2d_conv.open(src_height, src_width,
+               (format == HAL_PIXEL_FORMAT_RGBA_8888)?RGBA8888:NV12_2K,
+               NV12_2K, rotation)){
              m_pCallbacks.EmptyBufferDone(hComp,m_app_data,buffer);
              DEBUG_PRINT_ERROR("\n Color conv open failed");
              return OMX_ErrorBadParameter;
           }
           c2d_opened = true;
-        } else if(handle->format != HAL_PIXEL_FORMAT_NV12_ENCODEABLE) {
+        } else if(format != HAL_PIXEL_FORMAT_NV12_ENCODEABLE) {
           DEBUG_PRINT_ERROR("\n Incorrect color format");
           m_pCallbacks.EmptyBufferDone(hComp,m_app_data,buffer);
           return OMX_ErrorBadParameter;
@@ -4624,6 +5382,12 @@ OMX_ERRORTYPE  omx_video::empty_this_buffer_opaque(OMX_IN OMX_HANDLETYPE hComp,
     return OMX_ErrorNone;
   }
 
+  if(m_sParamFRC.bEnable && frc_drop_frame(buffer, nBufIndex))
+  {
+    m_pCallbacks.EmptyBufferDone(hComp,m_app_data,buffer);
+    return OMX_ErrorNone;
+  }
+
   if(!psource_frame) {
     psource_frame = buffer;
     ret = push_input_buffer(hComp);
@@ -4701,13 +5465,15 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
            pdest_frame,pdest_frame->nFilledLen);
     }
   } else {
-     uva = (unsigned char *)mmap(NULL, Input_pmem_info.size,
+     // camera frames may sit at an offset inside a shared allocation
+     uva = (unsigned char *)mmap(NULL,
+                           Input_pmem_info.offset + Input_pmem_info.size,
                            PROT_READ|PROT_WRITE,
                            MAP_SHARED,Input_pmem_info.fd,0);
      if(uva == MAP_FAILED) {
        ret = OMX_ErrorBadParameter;
      } else {
-       if(!c2d_conv.convert(Input_pmem_info.fd,uva,
+       if(!c2d_conv.convert(Input_pmem_info.fd,uva + Input_pmem_info.offset,
           m_pInput_pmem[index].fd,pdest_frame->pBuffer)) {
           DEBUG_PRINT_ERROR("\n Color Conversion failed");
           ret = OMX_ErrorBadParameter;
@@ -4731,7 +5497,7 @@ OMX_ERRORTYPE omx_video::convert_queue_buffer(OMX_HANDLETYPE hComp,
                pdest_frame,pdest_frame->nFilledLen);
            }
          }
-         munmap(uva,Input_pmem_info.size);
+         munmap(uva,Input_pmem_info.offset + Input_pmem_info.size);
       }
     }
     if((ret == OMX_ErrorNone) &&
@@ -4792,7 +5558,12 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
       DEBUG_PRINT_LOW("ETB fd = %d, offset = %d, size = %d",Input_pmem_info.fd,
                         Input_pmem_info.offset,
                         Input_pmem_info.size);
-      ret = queue_meta_buffer(hComp,Input_pmem_info);
+      // rotated camera frames go through the converter blit
+      if(c2d_opened && m_sConfigFrameRotation.nRotation &&
+         c2d_conv.get_src_format() == HAL_PIXEL_FORMAT_NV12_ENCODEABLE)
+        ret = convert_queue_buffer(hComp,Input_pmem_info,index);
+      else
+        ret = queue_meta_buffer(hComp,Input_pmem_info);
     } else if(psource_frame->nFlags & OMX_BUFFERFLAG_EOS & mUseProxyColorFormat) {
        ret = convert_queue_buffer(hComp,Input_pmem_info,index);
     } else {
@@ -4801,7 +5572,8 @@ OMX_ERRORTYPE omx_video::push_input_buffer(OMX_HANDLETYPE hComp)
       Input_pmem_info.fd = handle->fd;
       Input_pmem_info.offset = 0;
       Input_pmem_info.size = handle->size;
-      if(handle->format == HAL_PIXEL_FORMAT_RGBA_8888)
+      if(handle->format == HAL_PIXEL_FORMAT_RGBA_8888 ||
+         (c2d_opened && handle->format == c2d_conv.get_src_format()))
         ret = convert_queue_buffer(hComp,Input_pmem_info,index);
       else if(handle->format == HAL_PIXEL_FORMAT_NV12_ENCODEABLE)
         ret = queue_meta_buffer(hComp,Input_pmem_info);
@@ -225,6 +225,29 @@ OMX_ERRORTYPE omx_venc::component_init(OMX_STRING role)
   m_sIntraRefresh.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
   m_sIntraRefresh.eRefreshMode = OMX_VIDEO_IntraRefreshMax;
 
+  OMX_INIT_STRUCT(&m_sConfigROIInfo, OMX_QCOM_VIDEO_CONFIG_ROIINFO);
+  m_sConfigROIInfo.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
+  m_sConfigROIInfo.bEnable = OMX_FALSE;
+
+  OMX_INIT_STRUCT(&m_sParamLookAhead, OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE);
+  m_sParamLookAhead.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
+  m_sParamLookAhead.bEnable = OMX_FALSE;
+  m_sParamLookAhead.nLookAheadFrames = 4;
+  m_sParamLookAhead.bSceneCutIDR = OMX_TRUE;
+  m_sParamLookAhead.bAdaptiveBitrate = OMX_TRUE;
+
+  OMX_INIT_STRUCT(&m_sParamFRC, OMX_QCOM_VIDEO_PARAM_FRCTYPE);
+  m_sParamFRC.nPortIndex = (OMX_U32) PORT_INDEX_IN;
+  m_sParamFRC.bEnable = OMX_FALSE;
+  m_sParamFRC.bAllowDuplicate = OMX_FALSE;
+  m_sParamFRC.nDropWatermark = 0;
+
+  OMX_INIT_STRUCT(&m_sParamSceneCut, OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE);
+  m_sParamSceneCut.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
+  m_sParamSceneCut.bEnable = OMX_FALSE;
+  m_sParamSceneCut.nThreshold = VENC_SCENE_MAX_DIFF / 4;
+  m_sParamSceneCut.bResetGOP = OMX_TRUE;
+
   if(codec_type == OMX_VIDEO_CodingMPEG4)
   {
     m_sParamProfileLevel.eProfile = (OMX_U32) OMX_VIDEO_MPEG4ProfileSimple;
@@ -591,6 +614,7 @@ OMX_ERRORTYPE  omx_venc::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
       m_sConfigFramerate.xEncodeFramerate = portDefn->format.video.xFramerate;
       m_sConfigBitrate.nEncodeBitrate = portDefn->format.video.nBitrate;
       m_sParamBitrate.nTargetBitrate = portDefn->format.video.nBitrate;
+      m_lookahead_bitrate_q8 = 256;
     }
     break;
 
@@ -662,6 +686,7 @@ OMX_ERRORTYPE  omx_venc::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
       m_sParamBitrate.eControlRate = pParam->eControlRate;
       update_profile_level(); //bitrate
       m_sConfigBitrate.nEncodeBitrate = pParam->nTargetBitrate;
+      m_lookahead_bitrate_q8 = 256;
 	  m_sInPortDef.format.video.nBitrate = pParam->nTargetBitrate;
       m_sOutPortDef.format.video.nBitrate = pParam->nTargetBitrate;
       DEBUG_PRINT_LOW("\nbitrate = %u", m_sOutPortDef.format.video.nBitrate);
@@ -926,6 +951,7 @@ OMX_ERRORTYPE  omx_venc::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
         }
         m_sSessionQuantization.nQpI = session_qp->nQpI;
         m_sSessionQuantization.nQpP = session_qp->nQpP;
+        m_lookahead_qp_delta = 0;
       }
       else
       {
@@ -1147,6 +1173,85 @@ OMX_ERRORTYPE  omx_venc::set_parameter(OMX_IN OMX_HANDLETYPE     hComp,
       }
       break;
     }
+  case OMX_QcomIndexParamVideoLookAhead:
+    {
+      OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE* pParam =
+         (OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE*)paramData;
+      if(pParam->nPortIndex != PORT_INDEX_OUT)
+      {
+        DEBUG_PRINT_ERROR("ERROR: OMX_QcomIndexParamVideoLookAhead "
+           "called on wrong port(%d)", pParam->nPortIndex);
+        return OMX_ErrorBadPortIndex;
+      }
+      if(pParam->bEnable == OMX_TRUE &&
+         (pParam->nLookAheadFrames == 0 ||
+          pParam->nLookAheadFrames > VENC_LOOKAHEAD_MAX_FRAMES))
+      {
+        DEBUG_PRINT_ERROR("ERROR: look-ahead of %u frames is not supported "
+           "(max %d)", pParam->nLookAheadFrames, VENC_LOOKAHEAD_MAX_FRAMES);
+        return OMX_ErrorUnsupportedSetting;
+      }
+      memcpy(&m_sParamLookAhead, pParam, sizeof(m_sParamLookAhead));
+      // picked up with the new settings by the first frame
+      m_lookahead.deinit();
+      m_lookahead_bitrate_q8 = 256;
+      m_lookahead_qp_delta = 0;
+      DEBUG_PRINT_HIGH("set_parameter: look-ahead %s, %u frames",
+         (pParam->bEnable == OMX_TRUE) ? "enabled" : "disabled",
+         pParam->nLookAheadFrames);
+      break;
+    }
+  case OMX_QcomIndexParamVideoFrameRateConversion:
+    {
+      OMX_QCOM_VIDEO_PARAM_FRCTYPE* pParam =
+         (OMX_QCOM_VIDEO_PARAM_FRCTYPE*)paramData;
+      if(pParam->nPortIndex != PORT_INDEX_IN)
+      {
+        DEBUG_PRINT_ERROR("ERROR: OMX_QcomIndexParamVideoFrameRateConversion "
+           "called on wrong port(%d)", pParam->nPortIndex);
+        return OMX_ErrorBadPortIndex;
+      }
+      m_sParamFRC.bEnable = pParam->bEnable;
+      m_sParamFRC.bAllowDuplicate = pParam->bAllowDuplicate;
+      m_sParamFRC.nDropWatermark = pParam->nDropWatermark;
+      m_sParamFRC.nFramesDropped = 0;
+      m_sParamFRC.nFramesDroppedOverload = 0;
+      m_sParamFRC.nFramesDuplicated = 0;
+      m_frc_started = false;
+      DEBUG_PRINT_HIGH("set_parameter: FRC %s, duplicate %d, watermark %u",
+         (pParam->bEnable == OMX_TRUE) ? "enabled" : "disabled",
+         pParam->bAllowDuplicate, pParam->nDropWatermark);
+      break;
+    }
+  case OMX_QcomIndexParamVideoSceneCutDetection:
+    {
+      OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE* pParam =
+         (OMX_QCOM_VIDEO_PARAM_SCENECUTTYPE*)paramData;
+      if(pParam->nPortIndex != PORT_INDEX_OUT)
+      {
+        DEBUG_PRINT_ERROR("ERROR: OMX_QcomIndexParamVideoSceneCutDetection "
+           "called on wrong port(%d)", pParam->nPortIndex);
+        return OMX_ErrorBadPortIndex;
+      }
+      if(pParam->bEnable == OMX_TRUE &&
+         (pParam->nThreshold == 0 || pParam->nThreshold > VENC_SCENE_MAX_DIFF))
+      {
+        DEBUG_PRINT_ERROR("ERROR: scene cut threshold %u out of range",
+           pParam->nThreshold);
+        return OMX_ErrorUnsupportedSetting;
+      }
+      m_sParamSceneCut.bEnable = pParam->bEnable;
+      m_sParamSceneCut.nThreshold = pParam->nThreshold;
+      m_sParamSceneCut.bResetGOP = pParam->bResetGOP;
+      m_sParamSceneCut.nFramesDetected = 0;
+      m_scene_detect.reset();
+      if(pParam->bEnable != OMX_TRUE || pParam->bResetGOP != OMX_TRUE)
+        scene_gop_release();
+      DEBUG_PRINT_HIGH("set_parameter: scene cut detection %s, threshold %u",
+         (pParam->bEnable == OMX_TRUE) ? "enabled" : "disabled",
+         pParam->nThreshold);
+      break;
+    }
   case OMX_IndexParamVideoSliceFMO:
   default:
     {
@@ -1246,6 +1351,9 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
         m_sConfigBitrate.nEncodeBitrate = pParam->nEncodeBitrate;
         m_sParamBitrate.nTargetBitrate = pParam->nEncodeBitrate;
         m_sOutPortDef.format.video.nBitrate = pParam->nEncodeBitrate;
+        // the device now runs at the new target unscaled, the look-ahead
+        // rescales from there
+        m_lookahead_bitrate_q8 = 256;
       }
       else
       {
@@ -1303,7 +1411,9 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
            DEBUG_PRINT_HIGH("Dynamically changing B-frames not supported");
            return OMX_ErrorUnsupportedSetting;
         }
-        if(handle->venc_set_config(configData, (OMX_INDEXTYPE) QOMX_IndexConfigVideoIntraperiod) != true)
+        // scene cut detection requests the periodic IDRs while it owns the GOP
+        if(!m_scene_owns_gop &&
+           handle->venc_set_config(configData, (OMX_INDEXTYPE) QOMX_IndexConfigVideoIntraperiod) != true)
         {
           DEBUG_PRINT_ERROR("ERROR: Setting QOMX_IndexConfigVideoIntraperiod failed");
           return OMX_ErrorUnsupportedSetting;
@@ -1311,6 +1421,12 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
         m_sIntraperiod.nPFrames = pParam->nPFrames;
         m_sIntraperiod.nBFrames = pParam->nBFrames;
         m_sIntraperiod.nIDRPeriod = pParam->nIDRPeriod;
+        // a pattern the component cannot request itself goes to the device
+        if(m_scene_owns_gop && !scene_can_own_gop())
+        {
+          scene_gop_release();
+          m_sParamSceneCut.bResetGOP = OMX_FALSE;
+        }
 
         if(m_sOutPortFormat.eCompressionFormat == OMX_VIDEO_CodingMPEG4)
         {
@@ -1386,6 +1502,10 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
           DEBUG_PRINT_ERROR("ERROR: un supported Rotation %u", pParam->nRotation);
           return OMX_ErrorUnsupportedSetting;
       }
+      /* Only the opaque (proxy color format) path rotates the pixels, in
+         the color converter. For byte buffers and plain meta buffers the
+         rotation only swaps the port and device dimensions, and the client
+         queues frames that are already rotated, as before. */
       nRotation = pParam->nRotation - m_sConfigFrameRotation.nRotation;
       if(nRotation < 0)
         nRotation = -nRotation;
@@ -1431,6 +1551,49 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
       }
       break;
     }
+  case OMX_QcomIndexConfigVideoROIInfo:
+    {
+#ifndef VEN_IOCTL_SET_QP_MAP
+      DEBUG_PRINT_ERROR("ERROR: ROI info needs VEN_IOCTL_SET_QP_MAP");
+      return OMX_ErrorUnsupportedIndex;
+#else
+      OMX_QCOM_VIDEO_CONFIG_ROIINFO *pParam =
+        reinterpret_cast<OMX_QCOM_VIDEO_CONFIG_ROIINFO*>(configData);
+      DEBUG_PRINT_HIGH("set_config(): OMX_QcomIndexConfigVideoROIInfo "
+                       "enable %d rects %u map %u", pParam->bEnable,
+                       pParam->nRectCount, pParam->nQPMapSize);
+
+      if(pParam->nPortIndex != PORT_INDEX_OUT)
+      {
+        DEBUG_PRINT_ERROR("ERROR: Unsupported port index: %u", pParam->nPortIndex);
+        return OMX_ErrorBadPortIndex;
+      }
+      if(!validate_roi_info(pParam))
+      {
+        return OMX_ErrorBadParameter;
+      }
+      // an unchanged map is caught by the device, which keeps the only copy
+      if(m_sConfigROIInfo.bEnable == pParam->bEnable &&
+         !pParam->nQPMapSize && !m_sConfigROIInfo.nQPMapSize &&
+         m_sConfigROIInfo.nRectCount == pParam->nRectCount &&
+         !memcmp(m_sConfigROIInfo.sRects, pParam->sRects,
+                 pParam->nRectCount * sizeof(OMX_QCOM_VIDEO_ROI_RECT)))
+      {
+        DEBUG_PRINT_LOW("set_config(): ROI info unchanged");
+        break;
+      }
+      if(handle->venc_set_config(configData,
+          (OMX_INDEXTYPE)OMX_QcomIndexConfigVideoROIInfo) != true)
+      {
+        DEBUG_PRINT_ERROR("ERROR: Setting OMX_QcomIndexConfigVideoROIInfo failed");
+        return OMX_ErrorUnsupportedSetting;
+      }
+      memcpy(&m_sConfigROIInfo, pParam,
+             offsetof(OMX_QCOM_VIDEO_CONFIG_ROIINFO, nQPMap));
+      m_sConfigROIInfo.nSize = sizeof(m_sConfigROIInfo);
+      break;
+#endif
+    }
   default:
     DEBUG_PRINT_ERROR("ERROR: unsupported index %d", (int) configIndex);
     break;
@@ -1439,6 +1602,81 @@ OMX_ERRORTYPE  omx_venc::set_config(OMX_IN OMX_HANDLETYPE      hComp,
   return OMX_ErrorNone;
 }
 
+/* ======================================================================
+FUNCTION
+  omx_venc::validate_roi_info
+
+DESCRIPTION
+  Checks a region of interest config against the current output
+  port dimensions before it is handed to the device.
+
+PARAMETERS
+  roi -- ROI config supplied by the IL client.
+
+RETURN VALUE
+  true if the config can be applied.
+========================================================================== */
+bool omx_venc::validate_roi_info(OMX_QCOM_VIDEO_CONFIG_ROIINFO *roi)
+{
+  OMX_U32 width = m_sOutPortDef.format.video.nFrameWidth;
+  OMX_U32 height = m_sOutPortDef.format.video.nFrameHeight;
+  OMX_U32 num_mbs = ((width + 15) >> 4) * ((height + 15) >> 4);
+  OMX_U32 i;
+
+  if(!roi->bEnable)
+    return true;
+
+  if(roi->nQPMapSize)
+  {
+    if(roi->nQPMapSize != num_mbs ||
+       roi->nSize < offsetof(OMX_QCOM_VIDEO_CONFIG_ROIINFO, nQPMap) + num_mbs)
+    {
+      DEBUG_PRINT_ERROR("ERROR: ROI QP map size %u in %u bytes, expected %u MBs",
+                        roi->nQPMapSize, roi->nSize, num_mbs);
+      return false;
+    }
+    for(i = 0; i < num_mbs; i++)
+    {
+      if(roi->nQPMap[i] > OMX_QCOM_VIDEO_MAX_ROI_DELTA_QP ||
+         roi->nQPMap[i] < -OMX_QCOM_VIDEO_MAX_ROI_DELTA_QP)
+      {
+        DEBUG_PRINT_ERROR("ERROR: ROI QP map delta %d out of range at MB %u",
+                          roi->nQPMap[i], i);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  if(roi->nRectCount == 0 || roi->nRectCount > OMX_QCOM_VIDEO_MAX_ROI_RECTS)
+  {
+    DEBUG_PRINT_ERROR("ERROR: Invalid ROI rect count %u", roi->nRectCount);
+    return false;
+  }
+  for(i = 0; i < roi->nRectCount; i++)
+  {
+    OMX_QCOM_VIDEO_ROI_RECT *rect = &roi->sRects[i];
+    if(!rect->nWidth || !rect->nHeight ||
+       rect->nLeft >= width || rect->nTop >= height ||
+       rect->nWidth > width - rect->nLeft ||
+       rect->nHeight > height - rect->nTop)
+    {
+      DEBUG_PRINT_ERROR("ERROR: ROI rect %u (%u,%u %ux%u) outside %ux%u", i,
+                        rect->nLeft, rect->nTop, rect->nWidth, rect->nHeight,
+                        width, height);
+      return false;
+    }
+    if(rect->nDeltaQP > OMX_QCOM_VIDEO_MAX_ROI_DELTA_QP ||
+       rect->nDeltaQP < -OMX_QCOM_VIDEO_MAX_ROI_DELTA_QP)
+    {
+      DEBUG_PRINT_ERROR("ERROR: ROI rect %u delta QP %d out of range", i,
+                        rect->nDeltaQP);
+      return false;
+    }
+  }
+  return true;
+}
+
 /* ======================================================================
 FUNCTION
   omx_venc::ComponentDeInit
@@ -1617,6 +1855,16 @@ bool omx_venc::dev_set_buf_req(OMX_U32 *min_buff_count,
 
 }
 
+bool omx_venc::dev_set_config(void *configData, OMX_INDEXTYPE index)
+{
+  return handle->venc_set_config(configData, index);
+}
+
+bool omx_venc::dev_set_session_qp(OMX_VIDEO_PARAM_QUANTIZATIONTYPE *session_qp)
+{
+  return handle->venc_set_param(session_qp, OMX_IndexParamVideoQuantization);
+}
+
 int omx_venc::async_message_process (void *context, void* message)
 {
   omx_video* omx = NULL;
@@ -0,0 +1,241 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <string.h>
+#include <math.h>
+#include "venc_lookahead.h"
+
+/* Costs are mean absolute differences of the downscaled luma in Q4 */
+#define COST_Q 4
+/* A frame is a scene cut when its cost is at least this large ... */
+#define SCENECUT_MIN_COST (20 << COST_Q)
+/* ... and this many times the recent average */
+#define SCENECUT_RATIO 3
+/* Never place cuts closer than this, flashes and fades produce bursts */
+#define SCENECUT_MIN_DISTANCE 8
+/* Keeps near static content from asking for tiny bitrates */
+#define BITRATE_COST_BIAS (2 << COST_Q)
+#define BITRATE_MIN_Q8 192
+#define BITRATE_MAX_Q8 320
+#define BITRATE_STEP_Q8 16
+/* Bound on the carried imbalance, a long static stretch should not buy a
+   long complex one at the cap */
+#define BITRATE_DEBT_MAX_Q8 (4 * 256)
+
+venc_lookahead::venc_lookahead():
+  head(0),
+  count(0),
+  capacity(0),
+  thumb_width(0),
+  thumb_height(0),
+  cur_thumb(0),
+  have_prev(false),
+  short_cost(0),
+  long_cost(0),
+  frames_since_cut(SCENECUT_MIN_DISTANCE),
+  bitrate_debt_q8(0)
+{
+  thumb[0] = thumb[1] = NULL;
+  memset(queue, 0, sizeof(queue));
+}
+
+venc_lookahead::~venc_lookahead()
+{
+  deinit();
+}
+
+bool venc_lookahead::init(unsigned width, unsigned height, unsigned frames)
+{
+  deinit();
+  thumb_width = width >> VENC_LOOKAHEAD_SCALE_SHIFT;
+  thumb_height = height >> VENC_LOOKAHEAD_SCALE_SHIFT;
+  if(!thumb_width || !thumb_height || !frames)
+    return false;
+  if(frames > VENC_LOOKAHEAD_MAX_FRAMES)
+    frames = VENC_LOOKAHEAD_MAX_FRAMES;
+  capacity = frames + 1;
+  thumb[0] = (unsigned char *)malloc(thumb_width * thumb_height);
+  thumb[1] = (unsigned char *)malloc(thumb_width * thumb_height);
+  if(!thumb[0] || !thumb[1])
+  {
+    deinit();
+    return false;
+  }
+  reset();
+  return true;
+}
+
+void venc_lookahead::deinit()
+{
+  free(thumb[0]);
+  free(thumb[1]);
+  thumb[0] = thumb[1] = NULL;
+  capacity = 0;
+  reset();
+}
+
+void venc_lookahead::reset()
+{
+  head = count = 0;
+  cur_thumb = 0;
+  have_prev = false;
+  short_cost = long_cost = 0;
+  frames_since_cut = SCENECUT_MIN_DISTANCE;
+  bitrate_debt_q8 = 0;
+}
+
+/* Average of every other row of each block, half the loads of a full mean
+   and indistinguishable from it for the purpose of change detection */
+void venc_lookahead::downscale(const unsigned char *luma, unsigned stride,
+                               unsigned char *dst)
+{
+  const unsigned block = 1 << VENC_LOOKAHEAD_SCALE_SHIFT;
+  const unsigned shift = 2 * VENC_LOOKAHEAD_SCALE_SHIFT - 1;
+
+  for(unsigned by = 0; by < thumb_height; by++)
+  {
+    const unsigned char *row = luma + by * block * stride;
+    for(unsigned bx = 0; bx < thumb_width; bx++)
+    {
+      const unsigned char *p = row + bx * block;
+      unsigned sum = 0;
+      for(unsigned y = 0; y < block; y += 2, p += 2 * stride)
+      {
+        for(unsigned x = 0; x < block; x++)
+          sum += p[x];
+      }
+      *dst++ = (unsigned char)(sum >> shift);
+    }
+  }
+}
+
+unsigned venc_lookahead::frame_cost(const unsigned char *cur,
+                                    const unsigned char *prev)
+{
+  unsigned n = thumb_width * thumb_height;
+  unsigned long long sad = 0;
+
+  for(unsigned i = 0; i < n; i++)
+    sad += abs((int)cur[i] - (int)prev[i]);
+  return (unsigned)((sad << COST_Q) / n);
+}
+
+bool venc_lookahead::push(OMX_BUFFERHEADERTYPE *buffer,
+                          const unsigned char *luma, unsigned stride)
+{
+  entry *e;
+
+  if(!capacity || full())
+    return false;
+  e = &queue[(head + count) % capacity];
+  e->buffer = buffer;
+  e->cost = long_cost;
+  e->scene_cut = false;
+  count++;
+
+  // frames without pixels (EOS, codec config) do not disturb the history
+  if(!luma)
+    return true;
+
+  unsigned next = cur_thumb ^ 1;
+  downscale(luma, stride, thumb[next]);
+  if(have_prev)
+  {
+    unsigned cost = frame_cost(thumb[next], thumb[cur_thumb]);
+    e->cost = cost;
+    if(frames_since_cut >= SCENECUT_MIN_DISTANCE &&
+       cost >= SCENECUT_MIN_COST && cost > short_cost * SCENECUT_RATIO)
+    {
+      e->scene_cut = true;
+      frames_since_cut = 0;
+    }
+    else
+    {
+      // cuts stay out of the averages, they are paid for by the IDR
+      short_cost = long_cost ? (short_cost * 7 + cost) >> 3 : cost;
+      long_cost = long_cost ? (long_cost * 31 + cost) >> 5 : cost;
+    }
+    if(frames_since_cut < SCENECUT_MIN_DISTANCE)
+      frames_since_cut++;
+  }
+  cur_thumb = next;
+  have_prev = true;
+  return true;
+}
+
+OMX_BUFFERHEADERTYPE *venc_lookahead::pop(venc_lookahead_decision *decision)
+{
+  OMX_BUFFERHEADERTYPE *buffer;
+
+  if(!count)
+    return NULL;
+
+  if(decision)
+  {
+    unsigned window = 0, frames = 0;
+    int q8 = 256;
+
+    for(unsigned i = 0; i < count; i++)
+    {
+      entry *e = &queue[(head + i) % capacity];
+      if(!e->scene_cut)
+      {
+        window += e->cost;
+        frames++;
+      }
+    }
+    if(frames && long_cost)
+    {
+      window /= frames;
+      q8 = (int)((256 * (window + BITRATE_COST_BIAS)) /
+                 (long_cost + BITRATE_COST_BIAS));
+      // what earlier frames took above or below the target is returned
+      // over the next two window lengths
+      q8 -= bitrate_debt_q8 / (int)(2 * capacity);
+      if(q8 < BITRATE_MIN_Q8)
+        q8 = BITRATE_MIN_Q8;
+      else if(q8 > BITRATE_MAX_Q8)
+        q8 = BITRATE_MAX_Q8;
+      // coarse steps keep the number of rate control updates low
+      q8 = (q8 + BITRATE_STEP_Q8 / 2) & ~(BITRATE_STEP_Q8 - 1);
+    }
+    bitrate_debt_q8 += q8 - 256;
+    if(bitrate_debt_q8 > BITRATE_DEBT_MAX_Q8)
+      bitrate_debt_q8 = BITRATE_DEBT_MAX_Q8;
+    else if(bitrate_debt_q8 < -BITRATE_DEBT_MAX_Q8)
+      bitrate_debt_q8 = -BITRATE_DEBT_MAX_Q8;
+    decision->force_idr = queue[head].scene_cut;
+    decision->bitrate_q8 = (unsigned)q8;
+    // bits roughly halve for every 6 QP steps
+    decision->qp_delta = (int)lrint(-6.0 * log2(q8 / 256.0));
+  }
+
+  buffer = queue[head].buffer;
+  head = (head + 1) % capacity;
+  count--;
+  return buffer;
+}
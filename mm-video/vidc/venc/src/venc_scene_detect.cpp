@@ -0,0 +1,177 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+#include <string.h>
+#include <stdlib.h>
+#ifdef __ARM_NEON__
+#include <arm_neon.h>
+#endif
+#include "venc_scene_detect.h"
+
+/* Every 4th row and every 2nd column are sampled */
+#define SAMPLE_ROW_STEP 4
+#define BIN_SHIFT 3
+/* A cut also has to stand out this much against the recent average */
+#define SCENECUT_RATIO 3
+/* Flashes and fades produce bursts of large differences */
+#define SCENECUT_MIN_DISTANCE 8
+
+venc_scene_detect::venc_scene_detect()
+{
+  reset();
+}
+
+void venc_scene_detect::reset()
+{
+  memset(hist, 0, sizeof(hist));
+  cur = 0;
+  have_prev = false;
+  avg_diff = 0;
+  frames_since_cut = SCENECUT_MIN_DISTANCE;
+}
+
+/* Four interleaved sub-histograms avoid stalling on back to back
+   increments of the same bin, which is the common case on flat areas */
+void venc_scene_detect::histogram_c(const unsigned char *luma, unsigned width,
+                                    unsigned height, unsigned stride,
+                                    unsigned *out)
+{
+  unsigned sub[4][VENC_SCENE_HIST_BINS];
+
+  memset(sub, 0, sizeof(sub));
+  for(unsigned y = 0; y < height; y += SAMPLE_ROW_STEP)
+  {
+    const unsigned char *row = luma + y * stride;
+    unsigned x = 0;
+    for(; x + 8 <= width; x += 8)
+    {
+      sub[0][row[x] >> BIN_SHIFT]++;
+      sub[1][row[x + 2] >> BIN_SHIFT]++;
+      sub[2][row[x + 4] >> BIN_SHIFT]++;
+      sub[3][row[x + 6] >> BIN_SHIFT]++;
+    }
+    for(; x < width; x += 2)
+      sub[0][row[x] >> BIN_SHIFT]++;
+  }
+  for(unsigned i = 0; i < VENC_SCENE_HIST_BINS; i++)
+    out[i] = sub[0][i] + sub[1][i] + sub[2][i] + sub[3][i];
+}
+
+#ifdef __ARM_NEON__
+/* Adds the 8 bit per lane counts to the totals and clears them */
+static void flush_bins(uint8x16_t *acc, unsigned *out)
+{
+  for(unsigned i = 0; i < VENC_SCENE_HIST_BINS; i++)
+  {
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(acc[i])));
+    out[i] += (unsigned)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+    acc[i] = vdupq_n_u8(0);
+  }
+}
+#endif
+
+/* NEON has no scatter, so instead of incrementing one bin per sample
+   every bin compares itself against 16 samples and subtracts the 0xff
+   matches from its 8 bit lane counters. vld2 drops the odd columns for
+   free. The lane counters are folded into the totals before they can
+   wrap, after 255 vectors. */
+void venc_scene_detect::histogram(const unsigned char *luma, unsigned width,
+                                  unsigned height, unsigned stride,
+                                  unsigned *out)
+{
+#ifdef __ARM_NEON__
+  uint8x16_t acc[VENC_SCENE_HIST_BINS];
+  const uint8x16_t one = vdupq_n_u8(1);
+  unsigned pending = 0;
+
+  memset(out, 0, VENC_SCENE_HIST_BINS * sizeof(*out));
+  for(unsigned i = 0; i < VENC_SCENE_HIST_BINS; i++)
+    acc[i] = vdupq_n_u8(0);
+  for(unsigned y = 0; y < height; y += SAMPLE_ROW_STEP)
+  {
+    const unsigned char *row = luma + y * stride;
+    unsigned x = 0;
+    for(; x + 32 <= width; x += 32)
+    {
+      uint8x16_t idx = vshrq_n_u8(vld2q_u8(row + x).val[0], BIN_SHIFT);
+      uint8x16_t bin = vdupq_n_u8(0);
+      for(unsigned i = 0; i < VENC_SCENE_HIST_BINS; i++)
+      {
+        acc[i] = vsubq_u8(acc[i], vceqq_u8(idx, bin));
+        bin = vaddq_u8(bin, one);
+      }
+      if(++pending == 255)
+      {
+        flush_bins(acc, out);
+        pending = 0;
+      }
+    }
+    for(; x < width; x += 2)
+      out[row[x] >> BIN_SHIFT]++;
+  }
+  flush_bins(acc, out);
+#else
+  histogram_c(luma, width, height, stride, out);
+#endif
+}
+
+bool venc_scene_detect::analyze(const unsigned char *luma, unsigned width,
+                                unsigned height, unsigned stride,
+                                unsigned threshold)
+{
+  unsigned next = cur ^ 1;
+  unsigned total = 0, sad = 0, diff;
+  bool cut = false;
+
+  histogram(luma, width, height, stride, hist[next]);
+  for(unsigned i = 0; i < VENC_SCENE_HIST_BINS; i++)
+  {
+    total += hist[next][i];
+    sad += abs((int)hist[next][i] - (int)hist[cur][i]);
+  }
+  cur = next;
+  if(!have_prev || !total)
+  {
+    have_prev = (total != 0);
+    return false;
+  }
+
+  diff = (unsigned)(((unsigned long long)sad * (VENC_SCENE_MAX_DIFF / 2)) / total);
+  if(frames_since_cut >= SCENECUT_MIN_DISTANCE && diff >= threshold &&
+     diff > avg_diff * SCENECUT_RATIO)
+  {
+    cut = true;
+    frames_since_cut = 0;
+  }
+  else
+  {
+    avg_diff = (avg_diff * 7 + diff) >> 3;
+  }
+  if(frames_since_cut < SCENECUT_MIN_DISTANCE)
+    frames_since_cut++;
+  return cut;
+}
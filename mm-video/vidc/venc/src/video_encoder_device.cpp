@@ -30,6 +30,7 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/prctl.h>
 #include<unistd.h>
 #include <fcntl.h>
+#include <errno.h>
 #include "video_encoder_device.h"
 #include "omx_video_encoder.h"
 #include <media/hardware/HardwareAPI.h>
@@ -149,6 +150,14 @@ venc_dev::venc_dev(class omx_venc *venc_class)
   m_max_allowed_bitrate_check = false;
   m_eLevel = 0;
   m_eProfile = 0;
+#ifdef VEN_IOCTL_SET_QP_MAP
+  roi_qp_map = NULL;
+  roi_qp_map_size = 0;
+  roi_qp_map_dirty = false;
+  roi_enabled = false;
+  roi_probed = false;
+  pthread_mutex_init(&roi_lock, NULL);
+#endif
   pthread_mutex_init(&loaded_start_stop_mlock, NULL);
   pthread_cond_init (&loaded_start_stop_cond, NULL);
   venc_encoder = reinterpret_cast<omx_venc*>(venc_class);
@@ -159,6 +168,11 @@ venc_dev::~venc_dev()
 {
   pthread_cond_destroy(&loaded_start_stop_cond);
   pthread_mutex_destroy(&loaded_start_stop_mlock);
+#ifdef VEN_IOCTL_SET_QP_MAP
+  pthread_mutex_destroy(&roi_lock);
+  if(roi_qp_map)
+    free(roi_qp_map);
+#endif
   DEBUG_PRINT_LOW("venc_dev distructor");
 }
 
@@ -1128,6 +1142,20 @@ bool venc_dev::venc_set_config(void *configData, OMX_INDEXTYPE index)
       }
       break;
     }
+#ifdef VEN_IOCTL_SET_QP_MAP
+  case OMX_QcomIndexConfigVideoROIInfo:
+    {
+      OMX_QCOM_VIDEO_CONFIG_ROIINFO *roi_info =
+         reinterpret_cast<OMX_QCOM_VIDEO_CONFIG_ROIINFO*>(configData);
+      DEBUG_PRINT_LOW("\n venc_set_config: OMX_QcomIndexConfigVideoROIInfo");
+      if(venc_set_roi_info(roi_info) == false)
+      {
+        DEBUG_PRINT_ERROR("\nERROR: Setting ROI info failed");
+        return false;
+      }
+      break;
+    }
+#endif
   default:
     DEBUG_PRINT_ERROR("\n Unsupported config index = %u", index);
     break;
@@ -1682,6 +1710,12 @@ bool venc_dev::venc_empty_buf(void *buffer, void *pmem_data_buf,unsigned,unsigne
 
   DEBUG_PRINT_LOW("DBG: i/p frameinfo: bufhdr->pBuffer = %p, ptrbuffer = %p, offset = %u, len = %u",
       bufhdr->pBuffer, frameinfo.ptrbuffer, frameinfo.offset, frameinfo.len);
+#ifdef VEN_IOCTL_SET_QP_MAP
+  if(roi_qp_map_dirty && !venc_send_roi_qp_map())
+  {
+    DEBUG_PRINT_ERROR("\nERROR: venc_etb: sending ROI QP map failed");
+  }
+#endif
   if(ioctl(m_nDriver_fd,VEN_IOCTL_CMD_ENCODE_FRAME,&ioctl_msg) < 0)
   {
     /*Generate an async error and move to invalid state*/
@@ -1815,6 +1849,138 @@ bool venc_dev::venc_set_bitstream_restrict_in_vui(OMX_BOOL enable)
   return true;
 }
 
+#ifdef VEN_IOCTL_SET_QP_MAP
+bool venc_dev::venc_set_roi_info(OMX_QCOM_VIDEO_CONFIG_ROIINFO *roi_info)
+{
+  unsigned long mb_width = (m_sVenc_cfg.input_width + 15) >> 4;
+  unsigned long mb_height = (m_sVenc_cfg.input_height + 15) >> 4;
+  unsigned long num_mbs = mb_width * mb_height;
+  OMX_U32 i, x, y;
+
+  pthread_mutex_lock(&roi_lock);
+  if(!roi_info->bEnable)
+  {
+    DEBUG_PRINT_HIGH("venc_set_roi_info: ROI disabled");
+    if(roi_enabled && roi_qp_map)
+    {
+      memset(roi_qp_map, 0, roi_qp_map_size);
+      roi_qp_map_dirty = true;
+    }
+    roi_enabled = false;
+    pthread_mutex_unlock(&roi_lock);
+    return true;
+  }
+
+  if(roi_qp_map_size != num_mbs)
+  {
+    OMX_S8 *map = (OMX_S8 *)realloc(roi_qp_map, num_mbs);
+    if(map == NULL)
+    {
+      DEBUG_PRINT_ERROR("\nERROR: venc_set_roi_info: map allocation failed");
+      pthread_mutex_unlock(&roi_lock);
+      return false;
+    }
+    roi_qp_map = map;
+    roi_qp_map_size = num_mbs;
+    memset(roi_qp_map, 0, roi_qp_map_size);
+    roi_qp_map_dirty = true;
+  }
+
+  if(roi_info->nQPMapSize)
+  {
+    if(roi_info->nQPMapSize != num_mbs)
+    {
+      DEBUG_PRINT_ERROR("\nERROR: venc_set_roi_info: map size %u != %lu MBs",
+                        roi_info->nQPMapSize, num_mbs);
+      pthread_mutex_unlock(&roi_lock);
+      return false;
+    }
+    if(!roi_enabled || memcmp(roi_qp_map, roi_info->nQPMap, num_mbs))
+    {
+      memcpy(roi_qp_map, roi_info->nQPMap, num_mbs);
+      roi_qp_map_dirty = true;
+    }
+  }
+  else
+  {
+    // Each MB takes the delta of the last rectangle covering it, written
+    // in place so that re-sending the same rectangles leaves the map clean
+    for(y = 0; y < mb_height; y++)
+    {
+      for(x = 0; x < mb_width; x++)
+      {
+        OMX_S8 delta = 0;
+        for(i = 0; i < roi_info->nRectCount; i++)
+        {
+          OMX_QCOM_VIDEO_ROI_RECT *rect = &roi_info->sRects[i];
+          if(x >= (rect->nLeft >> 4) && y >= (rect->nTop >> 4) &&
+             x < ((rect->nLeft + rect->nWidth + 15) >> 4) &&
+             y < ((rect->nTop + rect->nHeight + 15) >> 4))
+            delta = (OMX_S8)rect->nDeltaQP;
+        }
+        if(roi_qp_map[y * mb_width + x] != delta)
+        {
+          roi_qp_map[y * mb_width + x] = delta;
+          roi_qp_map_dirty = true;
+        }
+      }
+    }
+    if(!roi_enabled)
+      roi_qp_map_dirty = true;
+  }
+  roi_enabled = true;
+  DEBUG_PRINT_HIGH("venc_set_roi_info: %lux%lu MB map, dirty %d",
+                   mb_width, mb_height, roi_qp_map_dirty);
+  pthread_mutex_unlock(&roi_lock);
+
+  // The first map goes out right away so that a driver without the
+  // ioctl is reported here rather than on every frame
+  if(!roi_probed)
+  {
+    if(!venc_send_roi_qp_map() && (errno == ENOTTY || errno == EINVAL))
+    {
+      DEBUG_PRINT_ERROR("\nERROR: ROI QP map is not supported by the driver");
+      pthread_mutex_lock(&roi_lock);
+      roi_enabled = false;
+      roi_qp_map_dirty = false;
+      pthread_mutex_unlock(&roi_lock);
+      return false;
+    }
+    roi_probed = true;
+  }
+  return true;
+}
+
+bool venc_dev::venc_send_roi_qp_map()
+{
+  bool status = true;
+  venc_ioctl_msg ioctl_msg = {NULL,NULL};
+  struct venc_qpmap qp_map;
+
+  pthread_mutex_lock(&roi_lock);
+  if(roi_qp_map_dirty && roi_qp_map)
+  {
+    qp_map.num_mbs = roi_qp_map_size;
+    qp_map.qp_delta = (signed char *)roi_qp_map;
+    ioctl_msg.in = (void*)&qp_map;
+    ioctl_msg.out = NULL;
+    if(ioctl(m_nDriver_fd, VEN_IOCTL_SET_QP_MAP, (void*)&ioctl_msg) < 0)
+    {
+      int err = errno;
+      DEBUG_PRINT_ERROR("\nERROR: Request for setting QP map failed");
+      errno = err;
+      status = false;
+    }
+    else
+    {
+      roi_qp_map_dirty = false;
+    }
+  }
+  pthread_mutex_unlock(&roi_lock);
+  return status;
+}
+#endif
+
 bool venc_dev::venc_set_extradata(OMX_U32 extra_data)
 {
   venc_ioctl_msg ioctl_msg = {NULL,NULL};
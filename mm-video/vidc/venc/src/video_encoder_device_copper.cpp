@@ -1135,6 +1135,12 @@ bool venc_dev::venc_set_config(void *configData, OMX_INDEXTYPE index)
       }
       break;
     }
+  case OMX_QcomIndexConfigVideoROIInfo:
+    {
+      /* No V4L2 control carries a per-MB QP map yet */
+      DEBUG_PRINT_ERROR("\nERROR: ROI QP map is not supported by the driver");
+      return false;
+    }
   default:
     DEBUG_PRINT_ERROR("\n Unsupported config index = %u", index);
     break;
@@ -0,0 +1,244 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+    Look-ahead test: feeds synthetic luma sequences through venc_lookahead
+    the way the component does (push until full, then one pop per push,
+    drain at the end) and checks the decisions: scene cuts, the bitrate
+    scale averaging out to the target, and the QP offset that goes with
+    it. Also reports the analysis cost per frame at 1080p.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "OMX_Core.h"
+#include "venc_lookahead.h"
+
+#define TEST_WINDOW     8
+#define TEST_FRAMES     720
+#define TEST_SEGMENT    60
+#define TEST_CUT_FRAME  450
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static OMX_U64 now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (OMX_U64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* A textured picture with an offset of up to +-amp per 8x8 block that
+   changes every frame, so the frame to frame cost follows amp. Frames
+   from scene 1 use a different texture. */
+static void make_frame(unsigned char *luma, unsigned width, unsigned height,
+                       unsigned frame, unsigned amp, unsigned scene)
+{
+    unsigned seed = frame * 2654435761u + 1;
+
+    for (unsigned by = 0; by < height; by += 8)
+    {
+        for (unsigned bx = 0; bx < width; bx += 8)
+        {
+            seed = seed * 1103515245u + 12345u;
+            int offset = amp ? (int)((seed >> 16) % (2 * amp + 1)) - (int)amp : 0;
+            for (unsigned y = by; y < by + 8 && y < height; y++)
+            {
+                for (unsigned x = bx; x < bx + 8 && x < width; x++)
+                {
+                    int v = scene ? (int)(((x * 7) ^ (y * 3)) & 0xff) :
+                                    (int)((x + 2 * y) & 0x7f) + 64;
+                    v += offset;
+                    luma[y * width + x] = (unsigned char)(v < 0 ? 0 : (v > 255 ? 255 : v));
+                }
+            }
+        }
+    }
+}
+
+/* Low and high motion stretches of TEST_SEGMENT frames, with a cut to a
+   new scene at TEST_CUT_FRAME */
+static unsigned frame_amp(unsigned frame)
+{
+    return ((frame / TEST_SEGMENT) & 1) ? 24 : 2;
+}
+
+struct run_result
+{
+    unsigned decisions;
+    unsigned long long q8_sum;
+    unsigned long long q8_sum_high;
+    unsigned long long q8_sum_low;
+    unsigned high;
+    unsigned low;
+    unsigned idr_count;
+    unsigned idr_frame;
+    unsigned order_errors;
+    unsigned qp_errors;
+};
+
+static void take_decision(venc_lookahead *la, OMX_BUFFERHEADERTYPE *bufs,
+                          unsigned *next_out, run_result *r)
+{
+    venc_lookahead_decision d;
+    OMX_BUFFERHEADERTYPE *buf = la->pop(&d);
+    unsigned frame = *next_out;
+
+    if (buf != &bufs[frame % (TEST_WINDOW + 1)])
+        r->order_errors++;
+    (*next_out)++;
+    r->decisions++;
+    r->q8_sum += d.bitrate_q8;
+    if (frame_amp(frame) > 2)
+    {
+        r->q8_sum_high += d.bitrate_q8;
+        r->high++;
+    }
+    else
+    {
+        r->q8_sum_low += d.bitrate_q8;
+        r->low++;
+    }
+    if (d.force_idr)
+    {
+        r->idr_count++;
+        r->idr_frame = frame;
+    }
+    // a larger share of the bitrate comes with a lower QP and vice versa
+    if ((d.bitrate_q8 > 256 && d.qp_delta >= 0) ||
+        (d.bitrate_q8 < 256 && d.qp_delta <= 0) ||
+        (d.bitrate_q8 == 256 && d.qp_delta != 0))
+        r->qp_errors++;
+}
+
+static void test_decisions()
+{
+    const unsigned width = 320, height = 240;
+    unsigned char *luma = (unsigned char *)malloc(width * height);
+    OMX_BUFFERHEADERTYPE bufs[TEST_WINDOW + 1];
+    venc_lookahead la;
+    run_result r;
+    unsigned next_out = 0;
+
+    memset(&r, 0, sizeof(r));
+    CHECK(la.init(width, height, TEST_WINDOW), "init failed");
+    for (unsigned f = 0; f < TEST_FRAMES; f++)
+    {
+        make_frame(luma, width, height, f, frame_amp(f), f >= TEST_CUT_FRAME);
+        CHECK(la.push(&bufs[f % (TEST_WINDOW + 1)], luma, width),
+              "push of frame %u refused", f);
+        if (la.full())
+            take_decision(&la, bufs, &next_out, &r);
+    }
+    while (la.size())
+        take_decision(&la, bufs, &next_out, &r);
+
+    CHECK(r.decisions == TEST_FRAMES, "%u decisions for %u frames",
+          r.decisions, TEST_FRAMES);
+    CHECK(!r.order_errors, "%u frames out of order", r.order_errors);
+    CHECK(!r.qp_errors, "%u QP offsets against the bitrate scale", r.qp_errors);
+    CHECK(r.idr_count == 1 && r.idr_frame == TEST_CUT_FRAME,
+          "%u scene cut(s), last at %u, expected one at %u",
+          r.idr_count, r.idr_frame, TEST_CUT_FRAME);
+
+    // budget neutral: within 1% of the target over the whole run
+    double mean = (double)r.q8_sum / r.decisions;
+    double mean_high = (double)r.q8_sum_high / r.high;
+    double mean_low = (double)r.q8_sum_low / r.low;
+    printf("bitrate scale: mean %.3f, high motion %.3f, low motion %.3f\n",
+           mean / 256, mean_high / 256, mean_low / 256);
+    CHECK(mean > 256 * 0.99 && mean < 256 * 1.01,
+          "mean bitrate scale %.3f is not budget neutral", mean / 256);
+    CHECK(mean_high > mean_low, "high motion got %.3f, low motion %.3f",
+          mean_high / 256, mean_low / 256);
+
+    // reset drops the carried imbalance with the history
+    venc_lookahead_decision d;
+    la.reset();
+    make_frame(luma, width, height, 0, 2, 0);
+    la.push(&bufs[0], luma, width);
+    CHECK(la.pop(&d) == &bufs[0], "wrong buffer after reset");
+    CHECK(d.bitrate_q8 == 256 && d.qp_delta == 0 && !d.force_idr,
+          "first decision after reset: scale %u qp %d idr %d",
+          d.bitrate_q8, d.qp_delta, d.force_idr);
+
+    free(luma);
+}
+
+static void bench_push_1080p()
+{
+    const unsigned width = 1920, height = 1080, frames = 120;
+    unsigned char *luma[2];
+    OMX_BUFFERHEADERTYPE bufs[TEST_WINDOW + 1];
+    venc_lookahead la;
+    venc_lookahead_decision d;
+    OMX_U64 spent = 0;
+
+    luma[0] = (unsigned char *)malloc(width * height);
+    luma[1] = (unsigned char *)malloc(width * height);
+    make_frame(luma[0], width, height, 0, 8, 0);
+    make_frame(luma[1], width, height, 1, 8, 0);
+    CHECK(la.init(width, height, TEST_WINDOW), "1080p init failed");
+    for (unsigned f = 0; f < frames; f++)
+    {
+        OMX_U64 start = now_ns();
+        la.push(&bufs[f % (TEST_WINDOW + 1)], luma[f & 1], width);
+        if (la.full())
+            la.pop(&d);
+        spent += now_ns() - start;
+    }
+    printf("1080p analysis: %.1f us/frame, %.0f fps on one core\n",
+           spent / 1000.0 / frames, frames * 1e9 / spent);
+    free(luma[0]);
+    free(luma[1]);
+}
+
+int main(int argc, char **argv)
+{
+    test_decisions();
+    bench_push_1080p();
+
+    if (failures)
+    {
+        printf("mm-venc-lookahead-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("mm-venc-lookahead-test: all checks passed\n");
+    return 0;
+}
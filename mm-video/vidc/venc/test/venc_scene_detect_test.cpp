@@ -0,0 +1,172 @@
+/*--------------------------------------------------------------------------
+Copyright (c) 2013, The Linux Foundation. All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of The Linux Foundation nor
+      the names of its contributors may be used to endorse or promote
+      products derived from this software without specific prior written
+      permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NON-INFRINGEMENT ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+--------------------------------------------------------------------------*/
+/*
+    Scene cut detection test: checks the NEON histogram against the C
+    reference, runs a sequence with motion and one cut through the
+    detector, and reports the cost of a 1080p frame against the 1080p60
+    frame interval.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include "venc_scene_detect.h"
+
+#define TEST_THRESHOLD  64
+#define TEST_FRAMES     120
+#define TEST_CUT_FRAME  70
+
+static int failures = 0;
+
+#define CHECK(cond, ...) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+            failures++; \
+        } \
+    } while (0)
+
+static unsigned long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Gradient texture moved by (dx, dy) per frame; scene 1 is a brighter,
+   differently shaped picture */
+static void make_frame(unsigned char *luma, unsigned width, unsigned height,
+                       unsigned stride, unsigned frame, unsigned scene)
+{
+    for (unsigned y = 0; y < height; y++)
+    {
+        for (unsigned x = 0; x < width; x++)
+        {
+            unsigned sx = x + 3 * frame, sy = y + frame;
+            luma[y * stride + x] = scene ?
+                (unsigned char)(160 + ((sx * sy) >> 6) % 96) :
+                (unsigned char)(16 + (sx + 2 * sy) % 128);
+        }
+    }
+}
+
+static void test_histogram_matches_reference()
+{
+    static const unsigned sizes[][2] = {
+        {1920, 1080}, {1280, 720}, {176, 144}, {33, 17}, {31, 9}, {2, 4},
+    };
+    unsigned hist[VENC_SCENE_HIST_BINS], ref[VENC_SCENE_HIST_BINS];
+
+    for (unsigned s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        unsigned width = sizes[s][0], height = sizes[s][1];
+        unsigned stride = (width + 31) & ~31;
+        unsigned char *luma = (unsigned char *)malloc(stride * height);
+
+        // random content, then a flat frame that keeps every lane of one
+        // bin counting until the counters have to be folded
+        for (unsigned pass = 0; pass < 2; pass++)
+        {
+            srand(width * height + pass);
+            for (unsigned i = 0; i < stride * height; i++)
+                luma[i] = pass ? 200 : (unsigned char)rand();
+            venc_scene_detect::histogram(luma, width, height, stride, hist);
+            venc_scene_detect::histogram_c(luma, width, height, stride, ref);
+            CHECK(!memcmp(hist, ref, sizeof(hist)),
+                  "%ux%u pass %u: histogram differs from the reference",
+                  width, height, pass);
+        }
+        free(luma);
+    }
+}
+
+static void test_cut_detection()
+{
+    const unsigned width = 640, height = 360, stride = 640;
+    unsigned char *luma = (unsigned char *)malloc(stride * height);
+    venc_scene_detect detect;
+    unsigned cuts = 0, cut_frame = 0;
+
+    for (unsigned f = 0; f < TEST_FRAMES; f++)
+    {
+        make_frame(luma, width, height, stride, f, f >= TEST_CUT_FRAME);
+        if (detect.analyze(luma, width, height, stride, TEST_THRESHOLD))
+        {
+            cuts++;
+            cut_frame = f;
+        }
+    }
+    CHECK(cuts == 1 && cut_frame == TEST_CUT_FRAME,
+          "%u cut(s), last at %u, expected one at %u", cuts, cut_frame,
+          TEST_CUT_FRAME);
+
+    // after reset the first frame has nothing to compare against
+    detect.reset();
+    CHECK(!detect.analyze(luma, width, height, stride, 0),
+          "cut reported for the first frame after reset");
+    free(luma);
+}
+
+static void bench_1080p()
+{
+    const unsigned width = 1920, height = 1080, stride = 1920, frames = 120;
+    unsigned char *luma[2];
+    venc_scene_detect detect;
+    unsigned long long start, spent;
+
+    luma[0] = (unsigned char *)malloc(stride * height);
+    luma[1] = (unsigned char *)malloc(stride * height);
+    make_frame(luma[0], width, height, stride, 0, 0);
+    make_frame(luma[1], width, height, stride, 1, 0);
+    start = now_ns();
+    for (unsigned f = 0; f < frames; f++)
+        detect.analyze(luma[f & 1], width, height, stride, TEST_THRESHOLD);
+    spent = now_ns() - start;
+    printf("1080p analysis: %.3f ms/frame, %.1f%% of a 60 fps frame interval\n",
+           spent / 1e6 / frames, spent / 1e6 / frames * 100 / (1000.0 / 60));
+    free(luma[0]);
+    free(luma[1]);
+}
+
+int main(int argc, char **argv)
+{
+    test_histogram_matches_reference();
+    test_cut_detection();
+    bench_1080p();
+
+    if (failures)
+    {
+        printf("mm-venc-scene-detect-test: %d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("mm-venc-scene-detect-test: all checks passed\n");
+    return 0;
+}
@@ -235,6 +235,7 @@ struct ProfileType
    char* cInFileName;
    char* cOutFileName;
    OMX_U32 nUserProfile;
+   OMX_U32 nLookAheadFrames;
 };
 
 enum MsgId
@@ -544,6 +545,8 @@ OMX_ERRORTYPE ConfigureEncoder()
    CHK(result);
    portdef.format.video.nFrameWidth = m_sProfile.nFrameWidth;
    portdef.format.video.nFrameHeight = m_sProfile.nFrameHeight;
+   // the look-ahead holds this many frames on top of the usual count
+   portdef.nBufferCountActual += m_sProfile.nLookAheadFrames;
 
    E ("\n Height %d width %d bit rate %d",portdef.format.video.nFrameHeight
       ,portdef.format.video.nFrameWidth,portdef.format.video.nBitrate);
@@ -754,6 +757,22 @@ result = OMX_SetParameter(m_hHandle,
    E("\n OMX_IndexParamVideoPortFormat Set Paramter port");
    CHK(result);
 
+   if (m_sProfile.nLookAheadFrames)
+   {
+      OMX_QCOM_VIDEO_PARAM_LOOKAHEADTYPE lookahead;
+      lookahead.nSize = sizeof(lookahead);
+      lookahead.nPortIndex = (OMX_U32) PORT_INDEX_OUT;
+      lookahead.bEnable = OMX_TRUE;
+      lookahead.nLookAheadFrames = m_sProfile.nLookAheadFrames;
+      lookahead.bSceneCutIDR = OMX_TRUE;
+      lookahead.bAdaptiveBitrate = OMX_TRUE;
+      result = OMX_SetParameter(m_hHandle,
+                                (OMX_INDEXTYPE)OMX_QcomIndexParamVideoLookAhead,
+                                &lookahead);
+      E("\n OMX_QcomIndexParamVideoLookAhead Set Paramter port");
+      CHK(result);
+   }
+
 #if 1
 ///////////////////I N T R A P E R I O D ///////////////////
 
@@ -1597,7 +1616,8 @@ void usage(char* filename)
 
    fprintf(stderr, "usage: %s LIVE <QCIF|QVGA> <MP4|H263> <FPS> <BITRATE> <NFRAMES> <OUTFILE>\n", fname);
    fprintf(stderr, "usage: %s FILE <QCIF|QVGA> <MP4|H263 <FPS> <BITRATE> <NFRAMES> <INFILE> <OUTFILE> ", fname);
-   fprintf(stderr, "<Dynamic config file - opt> <Rate Control - opt> <AVC Slice Mode - opt>\n", fname);
+   fprintf(stderr, "<Dynamic config file - opt> <Rate Control - opt> <AVC Slice Mode - opt> ", fname);
+   fprintf(stderr, "<Profile - opt> <LookAhead frames - opt>\n");
    fprintf(stderr, "usage: %s PROFILE <QCIF|QVGA> <MP4|H263 <FPS> <BITRATE> <NFRAMES> <INFILE>\n", fname);
    fprintf(stderr, "usage: %s PREVIEW <QCIF|QVGA> <FPS> <NFRAMES>\n", fname);
    fprintf(stderr, "usage: %s DISPLAY <QCIF|QVGA> <FPS> <NFRAMES> <INFILE>\n", fname);
@@ -1605,6 +1625,7 @@ void usage(char* filename)
    fprintf(stderr, "       FPS - frames per second\n");
    fprintf(stderr, "       NFRAMES - number of frames to play, 0 for infinite\n");
    fprintf(stderr, "       RateControl (Values 0 - 4 for RC_OFF, RC_CBR_CFR, RC_CBR_VFR, RC_VBR_CFR, RC_VBR_VFR\n");
+   fprintf(stderr, "       LookAhead frames - 0 to 16, 0 disables the look-ahead\n");
    exit(1);
 }
 
@@ -1694,7 +1715,7 @@ void parseArgs(int argc, char** argv)
    {//263
       m_eMode = MODE_FILE_ENCODE;
 
-      if(argc < 9 || argc > 13)
+      if(argc < 9 || argc > 14)
       {
           usage(argv[0]);
       }
@@ -1780,6 +1801,15 @@ void parseArgs(int argc, char** argv)
                   m_sProfile.nUserProfile = 0;
                }
             }
+            if (profile_argi + 1 < argc)
+            {
+               m_sProfile.nLookAheadFrames = strtoul(argv[profile_argi + 1], NULL, 10);
+               if (m_sProfile.nLookAheadFrames > 16)
+               {
+                  E("invalid LookAhead frames %s, using 16", argv[profile_argi + 1]);
+                  m_sProfile.nLookAheadFrames = 16;
+               }
+            }
          }
       }
       m_sProfile.cInFileName = argv[7];